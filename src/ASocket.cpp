@@ -0,0 +1,136 @@
+#include "ASocket.hpp"
+#include <boost/asio/connect.hpp>
+#include <charconv>
+
+// Constructor
+ASocket::ASocket(net::any_io_executor ex, ssl::context& ctx, std::string host, std::string port)
+	: m_strand(net::make_strand(ex)), m_ws(m_strand, ctx), m_host(std::move(host)), m_port(std::move(port)), m_read_done(m_strand){
+	m_pending.reserve(MAX_INFLIGHT);
+	for(size_t i = 0; i < MAX_INFLIGHT; i++) m_pending.emplace_back(m_strand);
+}
+
+// Destructor
+ASocket::~ASocket(){
+	// close() should have run, drop the connection without the closing handshake otherwise
+	beast::error_code ec;
+	beast::get_lowest_layer(m_ws).close(ec);
+}
+
+net::awaitable<int> ASocket::connect(const std::string& path){
+	try {
+		tcp::resolver resolver{m_strand};
+		auto const results = co_await resolver.async_resolve(m_host, m_port, net::use_awaitable);
+		co_await net::async_connect(beast::get_lowest_layer(m_ws), results, net::use_awaitable);
+		beast::get_lowest_layer(m_ws).set_option(tcp::no_delay(true));
+		SSL_set_tlsext_host_name(m_ws.next_layer().native_handle(), m_host.c_str());
+		co_await m_ws.next_layer().async_handshake(ssl::stream_base::client, net::use_awaitable);
+		co_await m_ws.async_handshake(m_host, path, net::use_awaitable);
+	} catch (const std::exception& e) {
+		Logger::instance().log_text(LogId::SOCKET_WS_FAIL, e.what());
+		co_return 1;
+	}
+	m_ws.text(true);
+	m_open = true;
+	m_reading = true;
+	net::co_spawn(m_strand, read_loop(), net::detached);
+	Logger::instance().log(LogId::SOCKET_INIT, "ASocket");
+	Logger::instance().log(LogId::SOCKET_WS_OPEN);
+	co_return 0;
+}
+
+net::awaitable<void> ASocket::read_loop(){
+	beast::flat_buffer buffer;
+	beast::error_code ec;
+	while(true){
+		co_await m_ws.async_read(buffer, net::redirect_error(net::use_awaitable, ec));
+		if(ec) break;
+		std::string msg = beast::buffers_to_string(buffer.data());
+		buffer.consume(buffer.size());
+		if(Socket::is_notification(msg)){
+			if(m_on_notification) m_on_notification(msg);
+			continue;
+		}
+		uint64_t id;
+		if(reply_id(msg, id)) continue;
+		Pending& p = m_pending[id % MAX_INFLIGHT];
+		if(!p.busy || p.id != id) continue; // late reply to a request that timed out
+		p.reply = std::move(msg);
+		p.done = true;
+		p.timer.cancel();
+	}
+	if(ec != websocket::error::closed) Logger::instance().log_text(LogId::SOCKET_ERROR, ec.message(), "ASocket read");
+	Logger::instance().log(LogId::SOCKET_CLOSED);
+	m_open = false;
+	m_reading = false;
+	// Wake everyone still waiting, they find no reply
+	for(Pending& p : m_pending){
+		if(p.busy) p.timer.cancel();
+	}
+	m_read_done.cancel();
+}
+
+net::awaitable<int> ASocket::write(std::string msg){
+	m_writes.push_back(std::move(msg));
+	// A write in progress sends the queue on, a failure shows up as a lost reply
+	if(m_writing) co_return 0;
+	m_writing = true;
+	beast::error_code ec;
+	while(!m_writes.empty() && !ec){
+		co_await m_ws.async_write(net::buffer(m_writes.front()), net::redirect_error(net::use_awaitable, ec));
+		m_writes.pop_front();
+	}
+	m_writing = false;
+	if(ec){
+		m_writes.clear();
+		Logger::instance().log_text(LogId::SOCKET_SEND_FAIL, ec.message());
+		co_return 1;
+	}
+	co_return 0;
+}
+
+net::awaitable<std::pair<int, std::string>> ASocket::request(uint64_t id, std::string msg, std::chrono::milliseconds timeout){
+	if(!m_open) co_return std::make_pair(1, std::string("socket not open"));
+	Pending& p = m_pending[id % MAX_INFLIGHT];
+	if(p.busy) co_return std::make_pair(1, std::string("too many requests in flight"));
+	p.busy = true;
+	p.id = id;
+	p.done = false;
+	p.timer.expires_after(timeout);
+
+	int status = co_await write(std::move(msg));
+	// The reply may already be in if the write had to wait
+	if(!status && !p.done && m_open){
+		beast::error_code ec;
+		co_await p.timer.async_wait(net::redirect_error(net::use_awaitable, ec));
+	}
+	p.busy = false;
+	if(p.done) co_return std::make_pair(0, std::move(p.reply));
+	if(status) co_return std::make_pair(1, std::string("send failed"));
+	co_return std::make_pair(1, std::string(m_open ? "request timed out" : "connection closed"));
+}
+
+net::awaitable<void> ASocket::close(){
+	if(m_open){
+		beast::error_code ec;
+		co_await m_ws.async_close(websocket::close_code::normal, net::redirect_error(net::use_awaitable, ec));
+	}
+	if(m_reading){
+		beast::error_code ec;
+		m_read_done.expires_at(net::steady_timer::time_point::max());
+		co_await m_read_done.async_wait(net::redirect_error(net::use_awaitable, ec));
+	}
+}
+
+void ASocket::set_notification_handler(std::function<void(const std::string&)> handler){
+	m_on_notification = std::move(handler);
+}
+
+// Deribit puts the id ahead of the result, so the first "id" is the top level one
+int ASocket::reply_id(const std::string& msg, uint64_t& id){
+	size_t pos = msg.find("\"id\":");
+	if(pos == std::string::npos) return 1;
+	const char* first = msg.data() + pos + 5;
+	const char* last = msg.data() + msg.size();
+	if(first < last && *first == '"') first++; // ids sent as strings come back as strings
+	return std::from_chars(first, last, id).ec == std::errc() ? 0 : 1;
+}
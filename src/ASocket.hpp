@@ -0,0 +1,82 @@
+#pragma once
+#include <utility> // Boost 1.74 awaitable.hpp uses std::exchange without it
+#include <boost/asio/awaitable.hpp>
+#include <boost/asio/co_spawn.hpp>
+#include <boost/asio/detached.hpp>
+#include <boost/asio/redirect_error.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/asio/strand.hpp>
+#include <boost/asio/use_awaitable.hpp>
+#include <boost/beast/core.hpp>
+#include <boost/beast/ssl.hpp>
+#include <boost/beast/websocket.hpp>
+#include <boost/beast/websocket/ssl.hpp>
+#include <boost/asio/ip/tcp.hpp>
+
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <string>
+#include <vector>
+#include "Logger.hpp"
+#include "Socket.hpp"
+
+namespace beast = boost::beast;         // from <boost/beast.hpp>
+namespace websocket = beast::websocket; // from <boost/beast/websocket.hpp>
+namespace net = boost::asio;            // from <boost/asio.hpp>
+namespace ssl = boost::asio::ssl;       // from <boost/asio/ssl.hpp>
+
+using tcp = boost::asio::ip::tcp;       // from <boost/asio/ip/tcp.hpp>
+
+// Asynchronous WebSocket client on Asio coroutines.
+// One read loop runs for the life of the connection and hands each reply to
+// the coroutine waiting on its JSON-RPC id; writes are queued and issued one
+// at a time. Everything runs on the socket's strand, so coroutines using it
+// must be spawned on executor() and no locks are needed.
+class ASocket{
+public:
+	// Requests awaiting a reply at once, ids map onto slots modulo this
+	static constexpr size_t MAX_INFLIGHT = 256;
+
+	ASocket(net::any_io_executor ex, ssl::context& ctx, std::string host, std::string port); // Constructor
+	~ASocket(); // Destructor
+
+	net::strand<net::any_io_executor> executor() const { return m_strand; }
+	// Resolve, connect, TLS and WebSocket handshakes, then start the read loop. 0 on success
+	net::awaitable<int> connect(const std::string& path = "/ws/api/v2");
+	// Send `msg`, which carries "id":`id`, and wait for the reply with that id
+	net::awaitable<std::pair<int, std::string>> request(uint64_t id, std::string msg,
+		std::chrono::milliseconds timeout = std::chrono::seconds(10));
+	// Close the connection and wait for the read loop to finish
+	net::awaitable<void> close();
+	bool is_open() const { return m_open; }
+
+	// Subscription notifications, called on the strand
+	void set_notification_handler(std::function<void(const std::string&)> handler);
+private:
+	struct Pending{
+		explicit Pending(const net::strand<net::any_io_executor>& ex) : timer(ex) {}
+		net::steady_timer timer; // doubles as the wake up of the waiting coroutine
+		uint64_t id = 0;
+		bool busy = false;
+		bool done = false;
+		std::string reply;
+	};
+
+	net::awaitable<void> read_loop();
+	net::awaitable<int> write(std::string msg);
+	// Top level "id" of a reply, 0 on success
+	static int reply_id(const std::string& msg, uint64_t& id);
+
+	net::strand<net::any_io_executor> m_strand;
+	websocket::stream<beast::ssl_stream<tcp::socket>> m_ws;
+	std::string m_host;
+	std::string m_port;
+	bool m_open = false;
+	bool m_reading = false;
+	net::steady_timer m_read_done;
+	std::deque<std::string> m_writes;
+	bool m_writing = false;
+	std::vector<Pending> m_pending;
+	std::function<void(const std::string&)> m_on_notification;
+};
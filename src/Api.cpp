@@ -1,8 +1,10 @@
 #include "Api.hpp"
+#include <iostream>
 
 // Destructor
 Api::~Api(){
-	std::cout << "Destroying Api Instance\n";
+	Logger::instance().log(LogId::API_DESTROY);
+	if(m_orders != m_socket) delete m_orders;
 	delete m_socket;
 }
 
@@ -13,39 +15,161 @@ Api::Api(){
 	// Boost Socket Implementation
 	m_socket = new BSocket();
 
-	// WebSocket++ Implementation
+	// WebSocket++ Implementation (WaitStrategy::SPIN_FUTEX etc. to spin for replies)
 	//m_socket = new Socketpp();
 	
 
 	// Custom Implementation
 	// m_socket = new CSocket();
 
+	// io_uring Implementation
+	// m_socket = new USocket();
 
+	// Exchange simulator (backtests, no network)
+	// m_socket = new SimSocket();
+
+	// Order entry (buy / sell / edit / cancel) on its own socket, the rest stays on m_socket
+	m_orders = m_socket;
+	// FIX order entry over Deribit's FIX gateway
+	// m_orders = new FixSocket();
+
+
+
+	// Idempotent public methods and how long their replies stay valid
+	m_cache.set_ttl("public/get_order_book", 100);
+	m_cache.set_ttl("public/ticker", 100);
+	m_cache.set_ttl("public/get_index_price", 100);
+	m_cache.set_ttl("public/get_announcements", 60000);
+	m_cache.set_ttl("public/get_instruments", 600000);
+
+	// Room for the order ids up front, expire_order() then never allocates
+	m_ttl_orders.resize(MAX_TIMERS);
+	for(std::string& order : m_ttl_orders) order.reserve(48);
 
 	// Switch to WebSockets
 	m_socket -> switch_to_ws();
+	if(m_orders != m_socket) m_orders -> switch_to_ws();
 	// Authenticate
 	int status = Authenticate();
+	// The operator sees the outcome on the console, the details are in the log
 	if(status) {
+		Logger::instance().log(LogId::API_AUTH_FAIL);
 		std::cout << "Authentication failed!\n";
 		return;
 	} else{
+		Logger::instance().log(LogId::API_AUTH_OK);
 		std::cout << "Authentication Successful!\n";
 	}
+	if(sync_clock(CLOCK_SAMPLES)){
+		Logger::instance().log(LogId::SOCKET_ERROR, "Api", "exchange clock offset unavailable");
+	}
 }
 
 [[nodiscard]] std::pair<int, std::string> Api::api_public(const std::string& message){
-	auto resp = m_socket -> ws_request(message);
+	int64_t ttl = m_cache.ttl(ResponseCache::method_of(message));
+	if(ttl == 0) return request(message);
+
+	int64_t now = now_ms();
+	std::pair<int, std::string> resp;
+	if(m_cache.get(message, now, resp.second) == 0) return resp;
+	resp = request(message);
+	// Errors are not cached, the next call retries
+	if(resp.first == 0 && resp.second.find("\"error\"") == std::string::npos){
+		m_cache.put(message, resp.second, now, ttl);
+	}
 	return resp;
 }
 
 [[nodiscard]] std::pair<int, std::string> Api::api_private(const std::string& message){
-	auto resp = m_socket -> ws_request(message);
+	auto resp = request(message);
 	return resp;
 }
 
+std::pair<int, std::string> Api::request(const std::string& message){
+	std::string_view method = ResponseCache::method_of(message);
+	Socket* socket = m_orders != m_socket && order_entry(method) ? m_orders : m_socket;
+	int64_t send = now_us();
+	std::pair<int, std::string> resp = socket -> ws_request(message);
+	int64_t recv = now_us();
+	int64_t us_in, us_out;
+	if(resp.first == 0 && LatencyBreakdown::stamps(resp.second, us_in, us_out) == 0){
+		m_latency.record(method, send, recv, us_in, us_out);
+	}
+	poll_timers();
+	return resp;
+}
+
+uint64_t Api::add_timer(int64_t delay_ms, TimingWheel::Callback fn, void* ctx, int64_t period_ms){
+	return m_timers.schedule(mono_ns() + delay_ms * 1000000, fn, ctx, period_ms * 1000000);
+}
+
+int Api::cancel_timer(uint64_t id){
+	return m_timers.cancel(id);
+}
+
+uint64_t Api::expire_order(const std::string& order_id, int64_t ttl_ms){
+	uint64_t id = add_timer(ttl_ms, on_order_ttl, this);
+	if(id) m_ttl_orders[TimingWheel::index_of(id)].assign(order_id);
+	return id;
+}
+
+size_t Api::poll_timers(){
+	if(m_in_timers) return 0;
+	m_in_timers = true;
+	size_t fired = m_timers.advance(mono_ns());
+	m_in_timers = false;
+	return fired;
+}
+
+void Api::on_order_ttl(void* ctx, uint64_t id){
+	Api* api = static_cast<Api*>(ctx);
+	const std::string& order_id = api->m_ttl_orders[TimingWheel::index_of(id)];
+	Logger::instance().log_text(LogId::API_ORDER_EXPIRED, order_id);
+	api->m_cancel_msg.assign(R"({"jsonrpc":"2.0","method":"private/cancel","params":{"order_id":")");
+	api->m_cancel_msg.append(order_id);
+	api->m_cancel_msg.append(R"("},"id":9931})");
+	std::pair<int, std::string> resp = api->api_private(api->m_cancel_msg);
+	if(resp.first) Logger::instance().log_text(LogId::SOCKET_ERROR, resp.second, "Order time to live cancel");
+}
+
+int Api::sync_clock(int samples){
+	int ok = 0;
+	for(int i = 0; i < samples; i++){
+		int64_t send = now_us();
+		std::pair<int, std::string> resp = m_socket -> ws_request(time_msg);
+		int64_t recv = now_us();
+		m_clock_checked_us = recv;
+		int64_t us_in, us_out;
+		if(resp.first || LatencyBreakdown::stamps(resp.second, us_in, us_out)) continue;
+		m_latency.add_offset_sample(send, recv, us_in, us_out);
+		ok++;
+	}
+	return ok ? 0 : 1;
+}
+
 [[nodiscard]] int Api::Authenticate(){
-	std::cout << "Logging in with client credentials\n";
+	Logger::instance().log(LogId::API_LOGIN);
 	std::pair<int, std::string> pr  = api_private(auth_msg);
+	// The order entry socket logs on with the same credentials
+	if(pr.first == 0 && m_orders != m_socket) pr = m_orders -> ws_request(auth_msg);
 	return pr.first;
 }
+
+bool Api::order_entry(std::string_view method){
+	return method == "private/buy" || method == "private/sell" || method == "private/edit" || method == "private/cancel";
+}
+
+void Api::on_notification(std::function<void(const std::string&)> handler){
+	m_socket -> set_notification_handler(std::move(handler));
+}
+
+void Api::poll(){
+	m_socket -> poll();
+	if(m_orders != m_socket) m_orders -> poll();
+	poll_timers();
+}
+
+void Api::idle(){
+	poll();
+	if(now_us() - m_clock_checked_us > CLOCK_RESYNC_US) sync_clock(1);
+}
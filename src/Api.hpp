@@ -2,6 +2,12 @@
 #include "utility.hpp"
 #include "BSocket.hpp"
 #include "Socketpp.hpp"
+#include "SimSocket.hpp"
+#include "fix/FixSocket.hpp"
+#include "Logger.hpp"
+#include "ResponseCache.hpp"
+#include "LatencyBreakdown.hpp"
+#include "TimingWheel.hpp"
 #include <nlohmann/json.hpp>
 
 class Api{
@@ -11,11 +17,56 @@ public:
 	// Destructor
 	~Api();
 	// Methods
+	// Replies to idempotent public methods are served from the cache within their TTL
 	[[nodiscard]] std::pair<int, std::string> api_public(const std::string& msg);
 	[[nodiscard]] std::pair<int, std::string> api_private(const std::string& msg);
 	[[nodiscard]] int Authenticate();
+	// Subscription notifications (book.*, trades.*, ticker.*, user.*)
+	void on_notification(std::function<void(const std::string&)> handler);
+	// Notifications the sockets hold and the timers that are due, never
+	// blocks. Call it while idle and before serving state built from
+	// notifications: sockets without a reader thread only read in requests
+	void poll();
+	// poll() plus upkeep that costs a round trip (a clock offset sample when the
+	// last is older than CLOCK_RESYNC_US). Only while nothing waits on the Api
+	void idle();
+	const ResponseCache::Stats& cache_stats() const { return m_cache.stats(); }
+	// Exchange clock offset from `samples` public/get_time round trips, 0 when any succeeded
+	int sync_clock(int samples);
+	// Per method outbound wire / exchange / inbound wire split of request round trips
+	const LatencyBreakdown& latency() const { return m_latency; }
+
+	// Application timers (order time to live, periodic strategy work). They run
+	// on the thread that owns the Api: from poll_timers() and after each request.
+	// Returns the timer id, 0 when all MAX_TIMERS are pending
+	uint64_t add_timer(int64_t delay_ms, TimingWheel::Callback fn, void* ctx, int64_t period_ms = 0);
+	int cancel_timer(uint64_t id);
+	// Cancels `order_id` at the exchange once `ttl_ms` has passed, unless the timer is cancelled first
+	uint64_t expire_order(const std::string& order_id, int64_t ttl_ms);
+	// Runs the timers that are due, returns how many fired
+	size_t poll_timers();
+	static constexpr uint32_t MAX_TIMERS = 1024;
 private:
+	static void on_order_ttl(void* ctx, uint64_t id);
+	// Methods that go to m_orders
+	static bool order_entry(std::string_view method);
+
+	// Round trip through the socket, attributed in the latency breakdown
+	std::pair<int, std::string> request(const std::string& msg);
+
 	Socket* m_socket;
+	Socket* m_orders; // order entry, m_socket unless it has a socket of its own
+	ResponseCache m_cache;
+	LatencyBreakdown m_latency;
+	int64_t m_clock_checked_us = 0;
+	// The offset drifts, one more sample is taken when the last is older than this
+	static constexpr int64_t CLOCK_RESYNC_US = 10000000;
+	static constexpr int CLOCK_SAMPLES = 8;
+	TimingWheel m_timers{MAX_TIMERS, 1000000, mono_ns()}; // 1 ms ticks
+	std::vector<std::string> m_ttl_orders; // order id of each time to live timer, by pool index
+	std::string m_cancel_msg;
+	bool m_in_timers = false; // a timer's own request must not run the wheel again
+	const std::string time_msg = R"({"jsonrpc":"2.0","method":"public/get_time","id":9930})";
 	const std::string auth_msg = R"({
   	"jsonrpc": "2.0",
 	"id": 9929,
@@ -0,0 +1,105 @@
+#include "AsyncApi.hpp"
+#include <boost/asio/ssl/host_name_verification.hpp>
+#include <charconv>
+
+// Set up before the socket exists: its SSL object copies the context's
+// verify mode when it is created, later changes never reach it
+static ssl::context client_context(const std::string& host, bool verify){
+	ssl::context ctx(ssl::context::tlsv12_client);
+	if(verify){
+		ctx.set_default_verify_paths();
+		ctx.set_verify_mode(ssl::verify_peer);
+		ctx.set_verify_callback(ssl::host_name_verification(host));
+	}
+	return ctx;
+}
+
+// Constructor
+AsyncApi::AsyncApi(net::any_io_executor ex, std::string host, std::string port, bool verify)
+	: m_ctx(client_context(host, verify)), m_socket(ex, m_ctx, host, std::move(port)){
+	Logger::instance().log(LogId::API_CREATE);
+}
+
+// Destructor
+AsyncApi::~AsyncApi(){
+	Logger::instance().log(LogId::API_DESTROY);
+}
+
+net::awaitable<int> AsyncApi::connect(){
+	co_return co_await m_socket.connect();
+}
+
+net::awaitable<int> AsyncApi::authenticate(std::string_view client_id, std::string_view client_secret){
+	Logger::instance().log(LogId::API_LOGIN);
+	std::string params;
+	params.reserve(128);
+	params += R"("grant_type":"client_credentials","client_id":")";
+	params += client_id;
+	params += R"(","client_secret":")";
+	params += client_secret;
+	params += '"';
+	auto [status, reply] = co_await call("public/auth", params);
+	if(status || reply.find("\"error\"") != std::string::npos){
+		Logger::instance().log(LogId::API_AUTH_FAIL);
+		co_return 1;
+	}
+	Logger::instance().log(LogId::API_AUTH_OK);
+	co_return 0;
+}
+
+net::awaitable<void> AsyncApi::close(){
+	co_await m_socket.close();
+}
+
+net::awaitable<std::pair<int, std::string>> AsyncApi::call(std::string_view method, std::string_view params){
+	uint64_t id = m_next_id++;
+	char num[24];
+	char* end = std::to_chars(num, num + sizeof(num), id).ptr;
+	std::string msg;
+	msg.reserve(48 + method.size() + params.size());
+	msg += R"({"jsonrpc":"2.0","method":")";
+	msg += method;
+	msg += R"(","params":{)";
+	msg += params;
+	msg += R"(},"id":)";
+	msg.append(num, end);
+	msg += '}';
+	co_return co_await m_socket.request(id, std::move(msg));
+}
+
+net::awaitable<std::pair<int, std::string>> AsyncApi::place_order(const Instrument& ins, bool buy, Price price, Qty amount){
+	char nums[64];
+	char* p;
+	std::string params;
+	params.reserve(128);
+	params += ins.json_field();
+	params += R"(,"type":"limit","price":)";
+	p = format_decimal(nums, nums + sizeof(nums), ins.snap(price, buy ? Price::DOWN : Price::UP), ins.price_scale);
+	if(!p) co_return std::make_pair(1, std::string("price does not fit"));
+	params.append(nums, p);
+	params += R"(,"amount":)";
+	p = format_decimal(nums, nums + sizeof(nums), amount, ins.qty_scale);
+	if(!p) co_return std::make_pair(1, std::string("amount does not fit"));
+	params.append(nums, p);
+	co_return co_await call(buy ? "private/buy" : "private/sell", params);
+}
+
+net::awaitable<std::pair<int, std::string>> AsyncApi::cancel_order(std::string_view order_id){
+	std::string params = R"("order_id":")";
+	params += order_id;
+	params += '"';
+	co_return co_await call("private/cancel", params);
+}
+
+net::awaitable<std::pair<int, std::string>> AsyncApi::get_order_book(const Instrument& ins, int depth){
+	char nums[24];
+	char* end = std::to_chars(nums, nums + sizeof(nums), depth).ptr;
+	std::string params(ins.json_field());
+	params += R"(,"depth":)";
+	params.append(nums, end);
+	co_return co_await call("public/get_order_book", params);
+}
+
+void AsyncApi::on_notification(std::function<void(const std::string&)> handler){
+	m_socket.set_notification_handler(std::move(handler));
+}
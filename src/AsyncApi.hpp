@@ -0,0 +1,38 @@
+#pragma once
+#include "ASocket.hpp"
+#include "market_data/Instruments.hpp"
+
+// Awaitable counterpart of Api for strategy code that keeps several
+// requests in flight from one thread:
+//
+//   net::co_spawn(api.executor(), [&]() -> net::awaitable<void> {
+//       auto [status, reply] = co_await api.place_order(ins, true, px, qty);
+//   }, net::detached);
+//
+// Requests are numbered here and matched to replies by ASocket, each one
+// costs a coroutine frame (recycled by Asio) and no callback object.
+class AsyncApi{
+public:
+	// Constructor
+	AsyncApi(net::any_io_executor ex, std::string host = "test.deribit.com", std::string port = "443", bool verify = true);
+	// Destructor
+	~AsyncApi();
+
+	net::strand<net::any_io_executor> executor() const { return m_socket.executor(); }
+	[[nodiscard]] net::awaitable<int> connect();
+	[[nodiscard]] net::awaitable<int> authenticate(std::string_view client_id, std::string_view client_secret);
+	net::awaitable<void> close();
+
+	// Any method, `params` is the JSON object body without braces
+	[[nodiscard]] net::awaitable<std::pair<int, std::string>> call(std::string_view method, std::string_view params);
+	// Limit order on the instrument's tick/lot grid
+	[[nodiscard]] net::awaitable<std::pair<int, std::string>> place_order(const Instrument& ins, bool buy, Price price, Qty amount);
+	[[nodiscard]] net::awaitable<std::pair<int, std::string>> cancel_order(std::string_view order_id);
+	[[nodiscard]] net::awaitable<std::pair<int, std::string>> get_order_book(const Instrument& ins, int depth);
+
+	void on_notification(std::function<void(const std::string&)> handler);
+private:
+	ssl::context m_ctx;
+	ASocket m_socket;
+	uint64_t m_next_id = 1;
+};
@@ -4,25 +4,35 @@
 BSocket::~BSocket(){
 	// Close the WebSocket connection
 	try {
-    		m_ws -> close(boost::beast::websocket::close_code::normal);
-		std::cout << "Connection Closed\n";
-		delete m_ws;
+		// Nothing to close cleanly once a timeout cancelled the stream. The
+		// outstanding read ends with the close handshake
+		if(!m_failed){
+			m_ioc.restart();
+			m_ws -> async_close(boost::beast::websocket::close_code::normal, [](beast::error_code){});
+			m_ioc.run_for(std::chrono::seconds(1));
+		}
+		Logger::instance().log(LogId::SOCKET_CLOSED);
 	} catch (const std::exception& e) {
-    		std::cerr << "Error during WebSocket close: " << e.what() << '\n';
+    		Logger::instance().log_text(LogId::SOCKET_ERROR, e.what(), "WebSocket close");
 	}
+	delete m_ws;
 }
 
 // Constructor
 BSocket::BSocket(){
-	// This context is required for all I/O
-	net::io_context ioc;
+	// The io_context and the SSL context (which holds certificates) are
+	// members, every stream uses both for its whole life
+	connect();
+
+	// Replies are read into this one buffer, sized up front
+	m_buffer.reserve(REPLY_BYTES);
+        Logger::instance().log(LogId::SOCKET_INIT, "BSocket");
+}
 
-	// The SSL context is required, and holds certificates
-	ssl::context ctx{ssl::context::tlsv12_client};
-	
+void BSocket::connect(){
 	// These objects perform our I/O
-        tcp::resolver resolver{ioc};
-       	m_ws = new websocket::stream<beast::ssl_stream<tcp::socket>>(ioc, ctx); 
+        tcp::resolver resolver{m_ioc};
+       	m_ws = new websocket::stream<beast::ssl_stream<tcp::socket>>(m_ioc, m_ctx); 
 
         // Look up the domain name
         auto const results = resolver.resolve(host, port);
@@ -31,27 +41,125 @@ BSocket::BSocket(){
 	net::connect(m_ws -> next_layer().next_layer(), results.begin(), results.end());
 
 	m_ws -> next_layer().handshake(ssl::stream_base::client);
+}
 
-        std::cout << "BSocket Intialized!\n";
+int BSocket::reconnect(){
+	int64_t now = mono_ns();
+	if(now - m_reconnect_ns < RECONNECT_MS * 1000000) return 1;
+	m_reconnect_ns = now;
+
+	// What the old stream still has pending completes with operation_aborted
+	if(m_ws){
+		beast::error_code ec;
+		beast::get_lowest_layer(*m_ws).close(ec);
+		m_ioc.restart();
+		m_ioc.run_for(std::chrono::seconds(1));
+		delete m_ws;
+		m_ws = nullptr;
+	}
+	m_buffer.consume(m_buffer.size());
+	m_reading = false;
+	try{
+		connect();
+		switch_to_ws();
+	} catch(const std::exception& e){
+		Logger::instance().log_text(LogId::SOCKET_ERROR, e.what(), "BSocket reconnect");
+		return 1;
+	}
+	m_failed = false;
+	if(!m_auth.empty()){
+		std::pair<int, std::string> resp = round_trip(m_auth);
+		if(resp.first || resp.second.find("\"error\"") != std::string::npos){
+			Logger::instance().log_text(LogId::SOCKET_ERROR, resp.second, "BSocket reconnect auth");
+			m_failed = true;
+			return 1;
+		}
+	}
+	Logger::instance().log(LogId::SOCKET_RECONNECT, "BSocket", m_auth.empty() ? "not authenticated" : "authenticated again");
+	return 0;
 }
 
 [[nodiscard]] std::pair<int, std::string> BSocket::ws_request(const std::string& message){
-	 // Send the message
-        m_ws -> write(net::buffer(message));
+	if(m_failed && reconnect()) return std::make_pair(1, std::string("connection lost, reconnect failed"));
+	std::pair<int, std::string> resp = round_trip(message);
+	if(resp.first == 0 && message.find("\"public/auth\"") != std::string::npos
+		&& resp.second.find("\"error\"") == std::string::npos) m_auth = message;
+	return resp;
+}
+
+std::pair<int, std::string> BSocket::round_trip(const std::string& message){
+	uint64_t deadline = m_timers.schedule(mono_ns() + m_timeout_ms * 1000000, on_deadline, this);
+	m_done = false;
+	m_waiting = true;
+	m_ioc.restart();
+
+	 // Send the message, the outstanding read takes the reply
+	m_ws -> async_write(net::buffer(message), [this](beast::error_code ec, size_t){
+		if(ec && !m_done){
+			m_resp = std::make_pair(1, ec.message());
+			m_done = true;
+		}
+	});
+	if(!m_reading) read_next();
 
-	// This buffer will hold the incoming message
-        beast::flat_buffer buffer;
+	// Run the I/O until the reply, waking for the wheel's next deadline
+	while(!m_done){
+		int64_t next = m_timers.next_deadline();
+		if(next < 0) m_ioc.run_one();
+		else m_ioc.run_one_until(std::chrono::steady_clock::time_point(std::chrono::nanoseconds(next)));
+		m_timers.advance(mono_ns());
+	}
+	m_waiting = false;
+	m_timers.cancel(deadline);
+	return std::move(m_resp);
+}
 
-        // Read a message into our buffer
-        m_ws -> read(buffer);
+void BSocket::poll(){
+	if(m_failed && reconnect()) return;
+	if(!m_reading) read_next();
+	// Only what is already readable, never blocks
+	m_ioc.restart();
+	m_ioc.poll();
+}
 
-	std::string resp = beast::buffers_to_string(buffer.data());
+void BSocket::read_next(){
+	m_reading = true;
+	m_ws -> async_read(m_buffer, [this](beast::error_code ec, size_t){
+		m_reading = false;
+		if(ec){
+			bool timed_out = m_failed;
+			m_failed = true;
+			if(m_waiting && !m_done){
+				m_resp = std::make_pair(1, timed_out ? std::string("request timed out") : ec.message());
+				m_done = true;
+			} else if(ec != websocket::error::closed && ec != net::error::operation_aborted){
+				Logger::instance().log_text(LogId::SOCKET_ERROR, ec.message(), "BSocket read");
+			}
+			return;
+		}
+		std::string resp = beast::buffers_to_string(m_buffer.data());
+		m_buffer.consume(m_buffer.size());
+		if(m_on_notification && is_notification(resp)){
+			m_on_notification(resp);
+		} else if(m_waiting && !m_done){
+			m_resp = std::make_pair(0, std::move(resp));
+			m_done = true;
+		}
+		read_next();
+	});
+}
 
-	return make_pair(0, resp);
+void BSocket::on_deadline(void* ctx, uint64_t /*id*/){
+	BSocket* self = static_cast<BSocket*>(ctx);
+	if(self -> m_done) return;
+	// The pending operations complete with operation_aborted
+	self -> m_failed = true;
+	beast::get_lowest_layer(*self -> m_ws).cancel();
+	Logger::instance().log(LogId::SOCKET_TIMEOUT, "BSocket", self -> m_timeout_ms);
 }
 
 void BSocket::switch_to_ws(){
 	 // Perform the websocket handshake
         m_ws -> handshake(host, "/ws/api/v2");
-	std::cout << "Moved to WebSocket Connection\n";
+	Logger::instance().log(LogId::SOCKET_WS_OPEN);
 }
@@ -12,6 +12,9 @@
 #include <thread>
 #include <memory>
 #include "Socket.hpp"
+#include "Logger.hpp"
+#include "TimingWheel.hpp"
+#include "utility.hpp"
 
 namespace beast = boost::beast;         // from <boost/beast.hpp>
 namespace http = beast::http;           // from <boost/beast/http.hpp>
@@ -21,12 +24,44 @@ namespace ssl = boost::asio::ssl;       // from <boost/asio/ssl.hpp>
 
 using tcp = boost::asio::ip::tcp;       // from <boost/asio/ip/tcp.hpp>
 
+// Requests run the socket's io_context until the reply is in or the
+// request's deadline, kept in a timing wheel, fires and cancels the socket.
+// A cancelled Beast stream can not be read again: after a timeout or a
+// lost connection the next request or poll() opens a new one (at most once
+// per RECONNECT_MS) and repeats the last successful public/auth on it.
+// One read is kept outstanding once connected; it only makes progress while
+// the io_context runs, inside a request or poll(), so notifications wait in
+// the kernel buffer in between.
 class BSocket: public Socket{
 public:
 	BSocket(); // Constructor
 	~BSocket(); // Destructor
 	void switch_to_ws() override;
 	[[nodiscard]] std::pair<int, std::string> ws_request(const std::string& msg) override;
+	void poll() override;
 private:
+	// Reads the next frame: notifications go to the handler, a reply
+	// completes the waiting request. Reads again unless the stream failed
+	void read_next();
+	static void on_deadline(void* ctx, uint64_t id);
+	// TCP, TLS and WebSocket handshakes on a new stream, throws on failure
+	void connect();
+	// Drops the failed stream, connects again and logs back on, 0 when usable
+	int reconnect();
+	std::pair<int, std::string> round_trip(const std::string& msg);
+	static constexpr size_t REPLY_BYTES = 64 * 1024;
+	static constexpr int64_t RECONNECT_MS = 1000;
+
+	net::io_context m_ioc;
+	ssl::context m_ctx{ssl::context::tlsv12_client};
 	websocket::stream<beast::ssl_stream<tcp::socket>>* m_ws;
+	TimingWheel m_timers{16, 1000000, mono_ns()}; // request deadlines, 1 ms ticks
+	beast::flat_buffer m_buffer;
+	std::pair<int, std::string> m_resp;
+	bool m_done = false;
+	bool m_waiting = false; // a request waits for its reply
+	bool m_reading = false; // a read is outstanding
+	bool m_failed = false;
+	std::string m_auth; // last public/auth that succeeded, repeated after a reconnect
+	int64_t m_reconnect_ns = 0; // last attempt
 };
@@ -1,16 +1,155 @@
 #include "CParser.hpp"
+#include <openssl/rand.h>
 
 // Constructor
 CParser::CParser(){
-	std::cout << "New parser instance created\n";
+	// Masking keys only need to be unpredictable to intermediaries, seed a
+	// fast generator once instead of asking OpenSSL for every frame
+	if(RAND_bytes(reinterpret_cast<unsigned char*>(&m_rng), sizeof(m_rng)) != 1 || m_rng == 0){
+		m_rng = 0x9e3779b97f4a7c15ull ^ reinterpret_cast<uintptr_t>(this);
+	}
 }
 
-// String to Frames
-std::vector<std::vector<uint8_t>> CParser::stof(const std::string& str){
+// xorshift64*
+uint32_t CParser::mask_key(){
+	m_rng ^= m_rng >> 12;
+	m_rng ^= m_rng << 25;
+	m_rng ^= m_rng >> 27;
+	return static_cast<uint32_t>((m_rng * 0x2545f4914f6cdd1dull) >> 32);
+}
+
+size_t CParser::encode_header(char* hdr, char* payload, size_t len, Opcode opcode){
+	size_t n = 0;
+	hdr[n++] = static_cast<char>(0x80 | opcode);
+	if(len < 126){
+		hdr[n++] = static_cast<char>(0x80 | len);
+	} else if(len <= 0xffff){
+		hdr[n++] = static_cast<char>(0x80 | 126);
+		hdr[n++] = static_cast<char>(len >> 8);
+		hdr[n++] = static_cast<char>(len);
+	} else {
+		hdr[n++] = static_cast<char>(0x80 | 127);
+		for(int i = 7; i >= 0; i--) hdr[n++] = static_cast<char>(static_cast<uint64_t>(len) >> (8 * i));
+	}
+	uint32_t key = mask_key();
+	unsigned char k[4];
+	std::memcpy(k, &key, 4);
+	std::memcpy(hdr + n, k, 4);
+	n += 4;
+
+	// Eight bytes at a time, the key repeats every four
+	uint64_t k8;
+	std::memcpy(&k8, k, 4);
+	std::memcpy(reinterpret_cast<char*>(&k8) + 4, k, 4);
+	size_t i = 0;
+	for(; i + 8 <= len; i += 8){
+		uint64_t v;
+		std::memcpy(&v, payload + i, 8);
+		v ^= k8;
+		std::memcpy(payload + i, &v, 8);
+	}
+	for(; i < len; i++) payload[i] = static_cast<char>(payload[i] ^ k[i & 3]);
+	return n;
+}
+
+void CParser::encode(const char* data, size_t len, std::string& out, Opcode opcode){
+	size_t at = out.size();
+	out.resize(at + MAX_HEADER + len);
+	char* payload = &out[at + MAX_HEADER];
+	std::memcpy(payload, data, len);
+	char hdr[MAX_HEADER];
+	size_t n = encode_header(hdr, payload, len, opcode);
+	// Close the gap left for the longest header
+	std::memmove(&out[at + n], payload, len);
+	std::memcpy(&out[at], hdr, n);
+	out.resize(at + n + len);
+}
+
+void CParser::feed(const char* data, size_t len, uint64_t mark){
+	// Drop consumed bytes once they dominate the buffer
+	if(m_pos > 4096 && m_pos * 2 > m_buf.size()){
+		m_buf.erase(0, m_pos);
+		m_base += m_pos;
+		m_pos = 0;
+	}
+	m_buf.append(data, len);
+	uint64_t end = m_base + m_buf.size();
+	if(m_fed_count == MARKS){
+		// Full: the newest entry absorbs this feed, frames ending in it get the later mark
+		Fed& last = m_fed[(m_fed_first + MARKS - 1) % MARKS];
+		last.end = end;
+		last.mark = mark;
+		return;
+	}
+	m_fed[(m_fed_first + m_fed_count) % MARKS] = Fed{end, mark};
+	m_fed_count++;
+}
 
+uint64_t CParser::mark_at(uint64_t end){
+	// Feeds wholly before this frame's last byte are no longer needed
+	while(m_fed_count && m_fed[m_fed_first].end < end){
+		m_fed_first = (m_fed_first + 1) % MARKS;
+		m_fed_count--;
+	}
+	return m_fed_count ? m_fed[m_fed_first].mark : 0;
 }
 
-// Frames to String
-std::string CParser::ftos(std::vector<std::vector<uint8_t>>& frames){
+int CParser::next(std::string& msg, Opcode& opcode){
+	while(true){
+		size_t avail = m_buf.size() - m_pos;
+		if(avail < 2) return 1;
+		const unsigned char* p = reinterpret_cast<const unsigned char*>(m_buf.data() + m_pos);
+		bool fin = p[0] & 0x80;
+		uint8_t op = p[0] & 0x0f;
+		bool masked = p[1] & 0x80;
+		uint64_t len = p[1] & 0x7f;
+		size_t hlen = 2;
+		if(len == 126){
+			if(avail < 4) return 1;
+			len = (static_cast<uint64_t>(p[2]) << 8) | p[3];
+			hlen = 4;
+		} else if(len == 127){
+			if(avail < 10) return 1;
+			len = 0;
+			for(int i = 0; i < 8; i++) len = (len << 8) | p[2 + i];
+			hlen = 10;
+		}
+		unsigned char key[4] = {0, 0, 0, 0};
+		if(masked){
+			if(avail < hlen + 4) return 1;
+			std::memcpy(key, p + hlen, 4);
+			hlen += 4;
+		}
+		if(avail < hlen + len) return 1;
 
+		const char* payload = m_buf.data() + m_pos + hlen;
+		m_pos += hlen + len;
+		m_mark = mark_at(m_base + m_pos);
+		std::string* dst = &msg;
+		if(op >= CLOSE){
+			// Control frames may arrive between fragments of a message
+			msg.assign(payload, len);
+			opcode = static_cast<Opcode>(op);
+		} else {
+			if(op != CONTINUATION) m_message_op = op;
+			dst = &m_message;
+			m_message.append(payload, len);
+		}
+		if(masked){
+			char* d = &(*dst)[dst->size() - len];
+			for(uint64_t i = 0; i < len; i++) d[i] = static_cast<char>(d[i] ^ key[i & 3]);
+		}
+		if(op >= CLOSE) return 0;
+		if(fin){
+			msg.swap(m_message);
+			m_message.clear();
+			opcode = static_cast<Opcode>(m_message_op);
+			if(m_pos == m_buf.size()){
+				m_base += m_pos;
+				m_buf.clear();
+				m_pos = 0;
+			}
+			return 0;
+		}
+	}
 }
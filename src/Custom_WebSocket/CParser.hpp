@@ -1,14 +1,57 @@
-#include "utility.h"
-#include <iostream>
-#include <vector>
-#include <string>
+#pragma once
 #include <cstdint>
 #include <cstring>
+#include <string>
 
+// RFC 6455 framing for the custom clients: encodes masked client frames and
+// incrementally decodes the server's (unmasked) frames from a byte stream.
 class CParser{
 public:
-	// String to Frames
-	std::vector<std::vector<uint8_t>> stof(const std::string& str); 
-	// Frames to String
-	std::string ftos(std::vector<std::vector<uint8_t>>& frames);
+	enum Opcode : uint8_t { CONTINUATION = 0x0, TEXT = 0x1, BINARY = 0x2, CLOSE = 0x8, PING = 0x9, PONG = 0xA };
+	static constexpr size_t MAX_HEADER = 14;
+
+	// Constructor
+	CParser();
+
+	// Appends `len` bytes of `data` as one final, masked frame to `out`
+	void encode(const char* data, size_t len, std::string& out, Opcode opcode = TEXT);
+	// Writes the frame header for a `len` byte payload into `hdr` (MAX_HEADER
+	// bytes) and masks `payload` in place; returns the header length
+	size_t encode_header(char* hdr, char* payload, size_t len, Opcode opcode = TEXT);
+	// Length of the header encode_header() writes for a `len` byte payload
+	static size_t header_size(size_t len){
+		return (len < 126 ? 2 : len <= 0xffff ? 4 : 10) + 4;
+	}
+
+	// Bytes received from the server, `mark` tags them (e.g. the receive they came in)
+	void feed(const char* data, size_t len, uint64_t mark = 0);
+	// Next complete message (fragments joined) or control frame,
+	// returns 0 and fills `msg` / `opcode`, 1 when more bytes are needed
+	int next(std::string& msg, Opcode& opcode);
+	// Mark of the feed that completed the frame last returned by next()
+	uint64_t mark() const { return m_mark; }
+	// Buffered bytes not yet consumed by next()
+	size_t pending() const { return m_buf.size() - m_pos; }
+private:
+	uint32_t mask_key();
+	// Mark of the feed holding stream offset `end - 1`
+	uint64_t mark_at(uint64_t end);
+
+	std::string m_buf;     // received, undecoded bytes from m_pos on
+	size_t m_pos = 0;
+	std::string m_message; // fragments of a message in progress
+	uint8_t m_message_op = TEXT;
+	uint64_t m_rng;
+
+	// Stream end offset of each recent feed with its mark, oldest first
+	static constexpr size_t MARKS = 64;
+	struct Fed{
+		uint64_t end;
+		uint64_t mark;
+	};
+	Fed m_fed[MARKS];
+	size_t m_fed_first = 0;
+	size_t m_fed_count = 0;
+	uint64_t m_base = 0;   // stream offset of m_buf[0]
+	uint64_t m_mark = 0;
 };
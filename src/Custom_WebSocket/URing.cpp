@@ -0,0 +1,168 @@
+#include "URing.hpp"
+#include <cerrno>
+#include <cstring>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+// Ring indices are shared with the kernel, tails are published with release
+// and heads/tails of the other side read with acquire
+static unsigned load_acquire(const unsigned* p){ return __atomic_load_n(p, __ATOMIC_ACQUIRE); }
+static void store_release(unsigned* p, unsigned v){ __atomic_store_n(p, v, __ATOMIC_RELEASE); }
+
+// Constructor
+URing::URing() {}
+
+// Destructor
+URing::~URing(){
+	if(m_bufs) munmap(m_bufs, static_cast<size_t>(m_buf_count) * m_buf_size);
+	if(m_buf_ring) munmap(m_buf_ring, m_buf_ring_size);
+	if(m_sqes) munmap(m_sqes, m_sqes_size);
+	if(m_cq_ring && m_cq_ring != m_ring) munmap(m_cq_ring, m_cq_ring_size);
+	if(m_ring) munmap(m_ring, m_ring_size);
+	if(m_fd >= 0) close(m_fd);
+}
+
+int URing::init(unsigned entries, bool sqpoll){
+	io_uring_params p;
+	std::memset(&p, 0, sizeof(p));
+	if(sqpoll){
+		p.flags |= IORING_SETUP_SQPOLL;
+		p.sq_thread_idle = 2000; // ms before the poller sleeps
+	}
+	m_fd = static_cast<int>(syscall(__NR_io_uring_setup, entries, &p));
+	if(m_fd < 0) return 1;
+	m_sqpoll = sqpoll;
+
+	size_t sq_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+	size_t cq_size = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+	bool single = p.features & IORING_FEAT_SINGLE_MMAP;
+	m_ring_size = single && cq_size > sq_size ? cq_size : sq_size;
+	m_ring = mmap(nullptr, m_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_fd, IORING_OFF_SQ_RING);
+	if(m_ring == MAP_FAILED){
+		m_ring = nullptr;
+		return 1;
+	}
+	if(single){
+		m_cq_ring = m_ring;
+	} else {
+		m_cq_ring_size = cq_size;
+		m_cq_ring = mmap(nullptr, cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_fd, IORING_OFF_CQ_RING);
+		if(m_cq_ring == MAP_FAILED){
+			m_cq_ring = nullptr;
+			return 1;
+		}
+	}
+	m_sqes_size = p.sq_entries * sizeof(io_uring_sqe);
+	void* sqes = mmap(nullptr, m_sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_fd, IORING_OFF_SQES);
+	if(sqes == MAP_FAILED) return 1;
+	m_sqes = static_cast<io_uring_sqe*>(sqes);
+
+	char* sq = static_cast<char*>(m_ring);
+	m_sq_head = reinterpret_cast<unsigned*>(sq + p.sq_off.head);
+	m_sq_tail = reinterpret_cast<unsigned*>(sq + p.sq_off.tail);
+	m_sq_flags = reinterpret_cast<unsigned*>(sq + p.sq_off.flags);
+	m_sq_array = reinterpret_cast<unsigned*>(sq + p.sq_off.array);
+	m_sq_mask = *reinterpret_cast<unsigned*>(sq + p.sq_off.ring_mask);
+	m_sq_entries = p.sq_entries;
+	m_sq_local_tail = m_sq_submitted = *m_sq_tail;
+	// SQE slots map one to one onto array entries
+	for(unsigned i = 0; i < m_sq_entries; i++) m_sq_array[i] = i;
+
+	char* cq = static_cast<char*>(m_cq_ring);
+	m_cq_head = reinterpret_cast<unsigned*>(cq + p.cq_off.head);
+	m_cq_tail = reinterpret_cast<unsigned*>(cq + p.cq_off.tail);
+	m_cq_mask = *reinterpret_cast<unsigned*>(cq + p.cq_off.ring_mask);
+	m_cqes = reinterpret_cast<io_uring_cqe*>(cq + p.cq_off.cqes);
+	return 0;
+}
+
+int URing::register_files(const int* fds, unsigned n){
+	return syscall(__NR_io_uring_register, m_fd, IORING_REGISTER_FILES, fds, n) < 0 ? 1 : 0;
+}
+
+int URing::register_buffers(const iovec* iov, unsigned n){
+	return syscall(__NR_io_uring_register, m_fd, IORING_REGISTER_BUFFERS, iov, n) < 0 ? 1 : 0;
+}
+
+int URing::setup_buffer_ring(uint16_t bgid, unsigned count, unsigned size){
+	m_buf_ring_size = count * sizeof(io_uring_buf);
+	void* ring = mmap(nullptr, m_buf_ring_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+	if(ring == MAP_FAILED) return 1;
+	m_buf_ring = static_cast<io_uring_buf_ring*>(ring);
+	void* bufs = mmap(nullptr, static_cast<size_t>(count) * size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+	if(bufs == MAP_FAILED) return 1;
+	m_bufs = static_cast<char*>(bufs);
+	m_buf_count = count;
+	m_buf_size = size;
+
+	io_uring_buf_reg reg;
+	std::memset(&reg, 0, sizeof(reg));
+	reg.ring_addr = reinterpret_cast<uint64_t>(m_buf_ring);
+	reg.ring_entries = count;
+	reg.bgid = bgid;
+	if(syscall(__NR_io_uring_register, m_fd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) return 1;
+	for(unsigned i = 0; i < count; i++) recycle(static_cast<uint16_t>(i));
+	return 0;
+}
+
+void URing::recycle(uint16_t bid){
+	// The entries start at the ring itself; in C++ the header's flexible
+	// array member `bufs` lands at offset 8 instead of 0, so do not use it
+	io_uring_buf& b = reinterpret_cast<io_uring_buf*>(m_buf_ring)[m_buf_tail & (m_buf_count - 1)];
+	b.addr = reinterpret_cast<uint64_t>(buffer(bid));
+	b.len = m_buf_size;
+	b.bid = bid;
+	m_buf_tail++;
+	__atomic_store_n(&m_buf_ring->tail, m_buf_tail, __ATOMIC_RELEASE);
+}
+
+io_uring_sqe* URing::sqe(){
+	if(m_sq_local_tail - load_acquire(m_sq_head) >= m_sq_entries) return nullptr;
+	io_uring_sqe* s = &m_sqes[m_sq_local_tail & m_sq_mask];
+	m_sq_local_tail++;
+	std::memset(s, 0, sizeof(*s));
+	return s;
+}
+
+int URing::enter(unsigned to_submit, unsigned min_complete, unsigned flags){
+	m_enters++;
+	long r = syscall(__NR_io_uring_enter, m_fd, to_submit, min_complete, flags, nullptr, 0);
+	return r < 0 ? -errno : static_cast<int>(r);
+}
+
+int URing::submit(unsigned wait_nr){
+	unsigned to_submit = m_sq_local_tail - m_sq_submitted;
+	if(to_submit){
+		store_release(m_sq_tail, m_sq_local_tail);
+		m_sq_submitted = m_sq_local_tail;
+	}
+	if(m_sqpoll){
+		// The poller picks the SQEs up by itself unless it went to sleep
+		__atomic_thread_fence(__ATOMIC_SEQ_CST);
+		if(to_submit && (__atomic_load_n(m_sq_flags, __ATOMIC_RELAXED) & IORING_SQ_NEED_WAKEUP)){
+			int r = enter(0, 0, IORING_ENTER_SQ_WAKEUP);
+			if(r < 0) return r;
+		}
+		if(wait_nr == 0) return static_cast<int>(to_submit);
+		// Spin on the completion queue before falling back to a blocking wait
+		for(int spin = 0; spin < 100000; spin++){
+			if(load_acquire(m_cq_tail) - *m_cq_head >= wait_nr) return static_cast<int>(to_submit);
+		}
+		int r = enter(0, wait_nr, IORING_ENTER_GETEVENTS);
+		return r < 0 ? r : static_cast<int>(to_submit);
+	}
+	if(to_submit == 0 && wait_nr == 0) return 0;
+	if(wait_nr && load_acquire(m_cq_tail) - *m_cq_head >= wait_nr && to_submit == 0) return 0;
+	return enter(to_submit, wait_nr, wait_nr ? IORING_ENTER_GETEVENTS : 0);
+}
+
+io_uring_cqe* URing::peek(){
+	unsigned head = *m_cq_head;
+	if(head == load_acquire(m_cq_tail)) return nullptr;
+	return &m_cqes[head & m_cq_mask];
+}
+
+void URing::seen(){
+	store_release(m_cq_head, *m_cq_head + 1);
+}
@@ -0,0 +1,73 @@
+#pragma once
+#include <cstdint>
+#include <linux/io_uring.h>
+#include <sys/uio.h>
+
+// Minimal io_uring driver over the raw syscalls (liburing is not required):
+// ring setup with optional SQPOLL, fixed files / buffers, one provided
+// buffer ring for multishot receives, and syscall accounting.
+class URing{
+public:
+	// Constructor
+	URing();
+	// Destructor
+	~URing();
+
+	// Returns 0 on success; with `sqpoll` a kernel thread polls the
+	// submission queue so submitting needs no syscall while it is awake
+	int init(unsigned entries, bool sqpoll);
+	bool sqpoll() const { return m_sqpoll; }
+
+	int register_files(const int* fds, unsigned n);
+	int register_buffers(const iovec* iov, unsigned n);
+	// `count` (power of two) buffers of `size` bytes for IOSQE_BUFFER_SELECT group `bgid`
+	int setup_buffer_ring(uint16_t bgid, unsigned count, unsigned size);
+	char* buffer(uint16_t bid) const { return m_bufs + static_cast<size_t>(bid) * m_buf_size; }
+	// Hands buffer `bid` back to the kernel after its data was consumed
+	void recycle(uint16_t bid);
+
+	// Next free SQE (zeroed), nullptr when the queue is full
+	io_uring_sqe* sqe();
+	// Publishes queued SQEs and waits for at least `wait_nr` completions,
+	// returns the number of SQEs submitted or -errno
+	int submit(unsigned wait_nr);
+	// Next completion or nullptr, seen() releases it
+	io_uring_cqe* peek();
+	void seen();
+
+	uint64_t enters() const { return m_enters; }
+private:
+	int enter(unsigned to_submit, unsigned min_complete, unsigned flags);
+
+	int m_fd = -1;
+	bool m_sqpoll = false;
+	void* m_ring = nullptr;
+	size_t m_ring_size = 0;
+	void* m_cq_ring = nullptr;
+	size_t m_cq_ring_size = 0;
+	io_uring_sqe* m_sqes = nullptr;
+	size_t m_sqes_size = 0;
+
+	unsigned* m_sq_head = nullptr;
+	unsigned* m_sq_tail = nullptr;
+	unsigned* m_sq_flags = nullptr;
+	unsigned* m_sq_array = nullptr;
+	unsigned m_sq_mask = 0;
+	unsigned m_sq_entries = 0;
+	unsigned m_sq_local_tail = 0; // SQEs handed out, published by submit()
+	unsigned m_sq_submitted = 0;  // last published tail
+
+	unsigned* m_cq_head = nullptr;
+	unsigned* m_cq_tail = nullptr;
+	io_uring_cqe* m_cqes = nullptr;
+	unsigned m_cq_mask = 0;
+
+	io_uring_buf_ring* m_buf_ring = nullptr;
+	size_t m_buf_ring_size = 0;
+	char* m_bufs = nullptr;
+	unsigned m_buf_count = 0;
+	unsigned m_buf_size = 0;
+	uint16_t m_buf_tail = 0;
+
+	uint64_t m_enters = 0;
+};
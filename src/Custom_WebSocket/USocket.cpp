@@ -0,0 +1,783 @@
+#include "USocket.hpp"
+#include "../Logger.hpp"
+#include <cstring>
+#include <ctime>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <linux/tls.h>
+#include <openssl/err.h>
+#include <openssl/evp.h>
+#include <openssl/kdf.h>
+#include <openssl/rand.h>
+
+#ifndef TCP_ULP
+#define TCP_ULP 31
+#endif
+
+static int64_t realtime_ns(){
+	timespec ts;
+	clock_gettime(CLOCK_REALTIME, &ts);
+	return ts.tv_sec * 1000000000ll + ts.tv_nsec;
+}
+
+// HKDF-Expand-Label(secret, label, "", len), RFC 8446 section 7.1
+static int expand_label(const EVP_MD* md, const std::string& secret, const char* label, unsigned char* out, size_t len){
+	unsigned char info[32];
+	size_t label_len = std::strlen(label);
+	size_t n = 0;
+	info[n++] = static_cast<unsigned char>(len >> 8);
+	info[n++] = static_cast<unsigned char>(len);
+	info[n++] = static_cast<unsigned char>(6 + label_len);
+	std::memcpy(info + n, "tls13 ", 6);
+	n += 6;
+	std::memcpy(info + n, label, label_len);
+	n += label_len;
+	info[n++] = 0; // empty context
+	EVP_PKEY_CTX* ctx = EVP_PKEY_CTX_new_id(EVP_PKEY_HKDF, nullptr);
+	bool ok = ctx && EVP_PKEY_derive_init(ctx) > 0
+		&& EVP_PKEY_CTX_set_hkdf_mode(ctx, EVP_PKEY_HKDEF_MODE_EXPAND_ONLY) > 0
+		&& EVP_PKEY_CTX_set_hkdf_md(ctx, md) > 0
+		&& EVP_PKEY_CTX_set1_hkdf_key(ctx, reinterpret_cast<const unsigned char*>(secret.data()), static_cast<int>(secret.size())) > 0
+		&& EVP_PKEY_CTX_add1_hkdf_info(ctx, info, static_cast<int>(n)) > 0
+		&& EVP_PKEY_derive(ctx, out, &len) > 0;
+	EVP_PKEY_CTX_free(ctx);
+	return ok ? 0 : 1;
+}
+
+// Kernel crypto state for one direction
+union KtlsInfo{
+	tls12_crypto_info_aes_gcm_128 aes128;
+	tls12_crypto_info_aes_gcm_256 aes256;
+	tls12_crypto_info_chacha20_poly1305 chacha;
+};
+
+int USocket::traffic_keys(uint16_t cipher, const std::string& secret, unsigned char* key, size_t& key_len, unsigned char* iv){
+	if(cipher < 0x1301 || cipher > 0x1303) return 1;
+	const EVP_MD* md = cipher == 0x1302 ? EVP_sha384() : EVP_sha256();
+	key_len = cipher == 0x1301 ? 16 : 32;
+	return expand_label(md, secret, "key", key, key_len) || expand_label(md, secret, "iv", iv, 12) ? 1 : 0;
+}
+
+// Fills `info` for the TLS 1.3 suite `cipher` from a traffic secret, record
+// sequence 0 as the keys are fresh. Returns its size, 0 when not supported.
+static size_t ktls_info(uint16_t cipher, const std::string& secret, KtlsInfo& info){
+	std::memset(&info, 0, sizeof(info));
+	size_t key_len = 0;
+	unsigned char key[32];
+	unsigned char iv[12];
+	if(USocket::traffic_keys(cipher, secret, key, key_len, iv)) return 0;
+	size_t size = 0;
+	// GCM takes the 12 byte IV as a 4 byte salt plus 8 bytes, ChaCha20 whole
+	if(cipher == 0x1301){
+		info.aes128.info.version = TLS_1_3_VERSION;
+		info.aes128.info.cipher_type = TLS_CIPHER_AES_GCM_128;
+		std::memcpy(info.aes128.salt, iv, 4);
+		std::memcpy(info.aes128.iv, iv + 4, 8);
+		std::memcpy(info.aes128.key, key, 16);
+		size = sizeof(info.aes128);
+	} else if(cipher == 0x1302){
+		info.aes256.info.version = TLS_1_3_VERSION;
+		info.aes256.info.cipher_type = TLS_CIPHER_AES_GCM_256;
+		std::memcpy(info.aes256.salt, iv, 4);
+		std::memcpy(info.aes256.iv, iv + 4, 8);
+		std::memcpy(info.aes256.key, key, 32);
+		size = sizeof(info.aes256);
+	} else {
+		info.chacha.info.version = TLS_1_3_VERSION;
+		info.chacha.info.cipher_type = TLS_CIPHER_CHACHA20_POLY1305;
+		std::memcpy(info.chacha.iv, iv, 12);
+		std::memcpy(info.chacha.key, key, 32);
+		size = sizeof(info.chacha);
+	}
+	OPENSSL_cleanse(key, sizeof(key));
+	OPENSSL_cleanse(iv, sizeof(iv));
+	return size;
+}
+
+// Constructor
+USocket::USocket() : USocket(Options()) {}
+
+USocket::USocket(const Options& opt) : m_opt(opt){
+	if(m_opt.host.empty()){
+		m_opt.host = host;
+		m_opt.port = port;
+	}
+	if(connect_tcp() || setup_ring() || (m_opt.tls && handshake_tls())){
+		Logger::instance().log(LogId::SOCKET_ERROR, "USocket", "connection setup failed");
+		return;
+	}
+	m_open = true;
+	Logger::instance().log(LogId::SOCKET_INIT, "USocket");
+}
+
+// Destructor
+USocket::~USocket(){
+	if(m_ssl) SSL_free(m_ssl); // frees both BIOs
+	if(m_ctx) SSL_CTX_free(m_ctx);
+	if(m_sock >= 0) close(m_sock);
+	if(m_send) munmap(m_send, SEND_BYTES);
+	Logger::instance().log(LogId::SOCKET_CLOSED);
+}
+
+int USocket::connect_tcp(){
+	addrinfo hints;
+	std::memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	addrinfo* res = nullptr;
+	if(getaddrinfo(m_opt.host.c_str(), m_opt.port.c_str(), &hints, &res) != 0) return 1;
+	for(addrinfo* a = res; a; a = a->ai_next){
+		m_sock = socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+		if(m_sock < 0) continue;
+		if(connect(m_sock, a->ai_addr, a->ai_addrlen) == 0) break;
+		close(m_sock);
+		m_sock = -1;
+	}
+	freeaddrinfo(res);
+	if(m_sock < 0) return 1;
+	int one = 1;
+	setsockopt(m_sock, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+	if(m_opt.timestamps){
+		// OPT_ID numbers send stamps by byte offset from here, TSONLY skips looping the data back
+		int flags = SOF_TIMESTAMPING_RX_SOFTWARE | SOF_TIMESTAMPING_TX_SOFTWARE | SOF_TIMESTAMPING_SOFTWARE
+			| SOF_TIMESTAMPING_OPT_ID | SOF_TIMESTAMPING_OPT_TSONLY;
+		if(setsockopt(m_sock, SOL_SOCKET, SO_TIMESTAMPING, &flags, sizeof(flags))){
+			Logger::instance().log(LogId::SOCKET_ERROR, "USocket", "SO_TIMESTAMPING not available");
+			m_opt.timestamps = false;
+		} else {
+			m_timings.reset(new Timings());
+		}
+	}
+	return 0;
+}
+
+int USocket::setup_ring(){
+	if(m_ring.init(64, m_opt.sqpoll)) return 1;
+	void* p = mmap(nullptr, SEND_BYTES, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+	if(p == MAP_FAILED) return 1;
+	m_send = static_cast<char*>(p);
+	iovec iov{m_send, SEND_BYTES};
+	if(m_ring.register_files(&m_sock, 1) || m_ring.register_buffers(&iov, 1)) return 1;
+	if(m_ring.setup_buffer_ring(0, RECV_BUFS, RECV_BUF_BYTES)) return 1;
+	m_rx_msg.msg_namelen = 0;
+	m_rx_msg.msg_controllen = CONTROL_BYTES;
+	arm_recv();
+	return m_ring.submit(0) < 0 ? 1 : 0;
+}
+
+void USocket::arm_timer(){
+	int64_t next = m_timers.next_deadline();
+	if(next < 0) return;
+	unsigned slot = TIMER_SLOTS;
+	for(unsigned i = 0; i < TIMER_SLOTS; i++){
+		if(!(m_timer_busy & (1u << i))){
+			if(slot == TIMER_SLOTS) slot = i;
+		} else if(m_timer_at[i] <= next){
+			return; // that one wakes us in time
+		}
+	}
+	if(slot == TIMER_SLOTS) return;
+	io_uring_sqe* s = m_ring.sqe();
+	if(!s) return;
+	m_timer_ts[slot].tv_sec = next / 1000000000;
+	m_timer_ts[slot].tv_nsec = next % 1000000000;
+	m_timer_at[slot] = next;
+	m_timer_busy |= 1u << slot;
+	// No completion count, a plain timer on CLOCK_MONOTONIC (the clock of mono_ns)
+	s->opcode = IORING_OP_TIMEOUT;
+	s->fd = -1;
+	s->addr = reinterpret_cast<uint64_t>(&m_timer_ts[slot]);
+	s->len = 1;
+	s->timeout_flags = IORING_TIMEOUT_ABS;
+	s->user_data = TIMER_TAG | (static_cast<uint64_t>(slot) << 8);
+}
+
+void USocket::on_deadline(void* ctx, uint64_t id){
+	static_cast<USocket*>(ctx)->m_expired = id;
+}
+
+// One receive request keeps producing completions until it runs out of buffers
+void USocket::arm_recv(){
+	io_uring_sqe* s = m_ring.sqe();
+	if(!s) return;
+	s->fd = 0; // fixed file index
+	s->flags = IOSQE_FIXED_FILE | IOSQE_BUFFER_SELECT;
+	s->ioprio = IORING_RECV_MULTISHOT;
+	s->buf_group = 0;
+	if(use_recvmsg()){
+		// recvmsg so the kernel can report timestamps and the type of each record
+		s->opcode = IORING_OP_RECVMSG;
+		s->addr = reinterpret_cast<uint64_t>(&m_rx_msg);
+		s->len = 1;
+		s->user_data = RECVMSG_TAG;
+	} else {
+		s->opcode = IORING_OP_RECV;
+		s->user_data = RECV_TAG;
+	}
+	m_recv_armed = true;
+}
+
+char* USocket::send_space(size_t len){
+	if(len > SEND_BYTES) return nullptr;
+	if(m_send_used + len > SEND_BYTES){
+		// Send the batch so far, wait for the writes in flight, then start over at the front
+		if(!user_tls() && send_batch()) return nullptr;
+		while(m_sends_inflight && !m_failed){
+			if(pump(1)) return nullptr;
+		}
+		m_send_used = 0;
+	}
+	return m_send + m_send_used;
+}
+
+void USocket::queue_send(size_t at, size_t len, bool fresh){
+	io_uring_sqe* s = m_ring.sqe();
+	if(!s){
+		m_ring.submit(0);
+		s = m_ring.sqe();
+		if(!s){
+			m_failed = true;
+			return;
+		}
+	}
+	s->opcode = IORING_OP_WRITE_FIXED;
+	s->fd = 0;
+	s->flags = IOSQE_FIXED_FILE;
+	s->addr = reinterpret_cast<uint64_t>(m_send + at);
+	s->len = static_cast<uint32_t>(len);
+	s->buf_index = 0;
+	s->user_data = SEND_TAG | (static_cast<uint64_t>(at) << 32) | len;
+	m_sends_inflight++;
+	if(at + len > m_send_used) m_send_used = at + len;
+	if(fresh && m_timings){
+		m_tx_bytes += len;
+		m_tx_marks[m_tx_count++ % TX_MARKS] = TxMark{m_tx_bytes - 1, realtime_ns()};
+	}
+}
+
+// Moves whatever OpenSSL produced into the send buffer
+int USocket::flush_tls(){
+	while(size_t pending = BIO_ctrl_pending(m_wbio)){
+		char* dst = send_space(pending);
+		if(!dst) return 1;
+		int n = BIO_read(m_wbio, dst, static_cast<int>(pending));
+		if(n <= 0) return 1;
+		queue_send(static_cast<size_t>(dst - m_send), static_cast<size_t>(n));
+	}
+	return 0;
+}
+
+int USocket::send_bytes(const char* data, size_t len){
+	if(m_opt.tls && !m_ktls_tx){
+		if(SSL_write(m_ssl, data, static_cast<int>(len)) <= 0) return 1;
+		return flush_tls();
+	}
+	char* dst = send_space(len);
+	if(!dst) return 1;
+	std::memcpy(dst, data, len);
+	queue_send(static_cast<size_t>(dst - m_send), len);
+	return 0;
+}
+
+int USocket::send_frame(const char* data, size_t len, CParser::Opcode opcode){
+	if(!m_batch_frames) m_batch_ns = mono_ns();
+	if(user_tls()){
+		// Encrypted as one run of records when the batch is sent
+		m_parser.encode(data, len, m_frame, opcode);
+		m_batch_frames++;
+		return 0;
+	}
+	// Plain or kTLS: mask straight into the registered buffer, frames back to back
+	size_t n = CParser::header_size(len);
+	char* dst = send_space(n + len);
+	if(!dst) return 1;
+	if(!m_batch_frames) m_batch_at = static_cast<size_t>(dst - m_send);
+	std::memcpy(dst + n, data, len);
+	m_parser.encode_header(dst, dst + n, len, opcode);
+	m_send_used = static_cast<size_t>(dst - m_send) + n + len;
+	m_batch_frames++;
+	return 0;
+}
+
+int USocket::send_batch(){
+	if(!m_batch_frames) return 0;
+	size_t bytes = batch_bytes();
+	m_stats.frames += m_batch_frames;
+	// The kernel cuts kTLS records the same way
+	if(m_opt.tls) m_stats.records += (bytes + TLS_RECORD - 1) / TLS_RECORD;
+	m_batch_frames = 0;
+	if(user_tls()){
+		int r = SSL_write(m_ssl, m_frame.data(), static_cast<int>(bytes));
+		m_frame.clear();
+		if(r <= 0) return 1;
+		return flush_tls();
+	}
+	queue_send(m_batch_at, bytes);
+	return 0;
+}
+
+void USocket::on_recv(const char* data, size_t len){
+	m_stats.recv_bytes += len;
+	if(!m_opt.tls){
+		on_plain(data, len);
+		return;
+	}
+	BIO_write(m_rbio, data, static_cast<int>(len));
+	if(!SSL_is_init_finished(m_ssl)) return; // handshake_tls() drives it
+	char plain[RECV_BUF_BYTES];
+	size_t n = 0;
+	while(SSL_read_ex(m_ssl, plain, sizeof(plain), &n) == 1) on_plain(plain, n);
+}
+
+void USocket::on_plain(const char* data, size_t len){
+	if(m_upgraded) m_parser.feed(data, len, m_rx_seq);
+	else m_http.append(data, len);
+}
+
+void USocket::on_record(const char* buf, size_t len){
+	const io_uring_recvmsg_out* out = reinterpret_cast<const io_uring_recvmsg_out*>(buf);
+	size_t skip = sizeof(*out) + m_rx_msg.msg_namelen + m_rx_msg.msg_controllen;
+	if(len < skip) return;
+	const char* payload = buf + skip;
+	size_t n = out->payloadlen < len - skip ? out->payloadlen : len - skip;
+
+	// Application data unless a control message says otherwise
+	unsigned char type = 23;
+	msghdr h{};
+	h.msg_control = const_cast<char*>(buf + sizeof(*out) + m_rx_msg.msg_namelen);
+	h.msg_controllen = out->controllen;
+	for(cmsghdr* c = CMSG_FIRSTHDR(&h); c; c = CMSG_NXTHDR(&h, c)){
+		if(c->cmsg_level == SOL_TLS && c->cmsg_type == TLS_GET_RECORD_TYPE){
+			type = *CMSG_DATA(c);
+		} else if(c->cmsg_level == SOL_SOCKET && c->cmsg_type == SCM_TIMESTAMPING){
+			scm_timestamping ts;
+			std::memcpy(&ts, CMSG_DATA(c), sizeof(ts));
+			m_rx_marks[m_rx_seq % RX_MARKS].kernel_ns = ts.ts[0].tv_sec * 1000000000ll + ts.ts[0].tv_nsec;
+		}
+	}
+	if(!m_ktls_rx){
+		on_recv(payload, n);
+		return;
+	}
+	if(type == 23){
+		m_stats.recv_bytes += n;
+		on_plain(payload, n);
+		return;
+	}
+	if(type == 22){
+		// Session tickets are not used, anything else (a key update) the kernel can not follow
+		for(size_t at = 0; at + 4 <= n; ){
+			if(payload[at] != 4){
+				Logger::instance().log(LogId::SOCKET_ERROR, "USocket", "TLS key update with kTLS");
+				m_failed = true;
+				return;
+			}
+			const unsigned char* p = reinterpret_cast<const unsigned char*>(payload + at);
+			at += 4 + ((static_cast<size_t>(p[1]) << 16) | (p[2] << 8) | p[3]);
+		}
+		return;
+	}
+	// Alert, close_notify included
+	m_failed = true;
+}
+
+int USocket::pump(unsigned wait_nr){
+	int r = m_ring.submit(wait_nr);
+	if(r < 0 && r != -EINTR && r != -EBUSY) return 1;
+	while(io_uring_cqe* c = m_ring.peek()){
+		uint64_t tag = c->user_data;
+		int res = c->res;
+		uint32_t flags = c->flags;
+		m_ring.seen();
+		if(tag == CANCEL_TAG) continue;
+		if(tag & SEND_TAG){
+			size_t at = (tag >> 32) & 0x7fffffff;
+			size_t len = tag & 0xffffffff;
+			m_sends_inflight--;
+			if(res < 0){
+				m_failed = true;
+			} else if(static_cast<size_t>(res) < len){
+				queue_send(at + res, len - res, false); // short write, send the rest
+			} else {
+				m_stats.sends++;
+			}
+			if(m_sends_inflight == 0 && !m_batch_frames) m_send_used = 0;
+			continue;
+		}
+		if((tag & 0xff) == TIMER_TAG){
+			m_timer_busy &= ~(1u << (tag >> 8));
+			m_timers.advance(mono_ns());
+			continue;
+		}
+		// Receive completion
+		if(flags & IORING_CQE_F_BUFFER){
+			uint16_t bid = static_cast<uint16_t>(flags >> IORING_CQE_BUFFER_SHIFT);
+			if(res > 0){
+				m_stats.recvs++;
+				m_rx_seq++;
+				if(m_timings) m_rx_marks[m_rx_seq % RX_MARKS] = RxMark{m_rx_seq, 0, realtime_ns()};
+				if(tag == RECVMSG_TAG) on_record(m_ring.buffer(bid), static_cast<size_t>(res));
+				else on_recv(m_ring.buffer(bid), static_cast<size_t>(res));
+			}
+			m_ring.recycle(bid);
+		}
+		// The plain receive cancelled when kTLS took over
+		if(tag == RECV_TAG && use_recvmsg()) continue;
+		if(res == 0 || (res < 0 && res != -ENOBUFS)) m_failed = true; // peer closed / error
+		if(!(flags & IORING_CQE_F_MORE)) m_recv_armed = false;
+	}
+	if(!m_recv_armed && !m_failed) arm_recv();
+	if(!m_failed) arm_timer();
+	return m_failed ? 1 : 0;
+}
+
+int USocket::handshake_tls(){
+	m_ctx = SSL_CTX_new(TLS_client_method());
+	if(!m_ctx) return 1;
+	SSL_CTX_set_default_verify_paths(m_ctx);
+	SSL_CTX_set_verify(m_ctx, m_opt.verify ? SSL_VERIFY_PEER : SSL_VERIFY_NONE, nullptr);
+	if(m_opt.ktls) SSL_CTX_set_keylog_callback(m_ctx, on_keylog);
+	m_ssl = SSL_new(m_ctx);
+	if(!m_ssl) return 1;
+	SSL_set_app_data(m_ssl, this);
+	SSL_set_tlsext_host_name(m_ssl, m_opt.host.c_str());
+	SSL_set1_host(m_ssl, m_opt.host.c_str());
+	m_rbio = BIO_new(BIO_s_mem());
+	m_wbio = BIO_new(BIO_s_mem());
+	BIO_set_mem_eof_return(m_rbio, -1); // empty means "want read", not EOF
+	SSL_set_bio(m_ssl, m_rbio, m_wbio);
+	SSL_set_connect_state(m_ssl);
+
+	while(true){
+		int r = SSL_do_handshake(m_ssl);
+		// The server sends nothing under the new keys before it has our Finished
+		if(r == 1 && m_opt.ktls) enable_ktls_rx();
+		if(flush_tls()) return 1;
+		if(r == 1) break;
+		int err = SSL_get_error(m_ssl, r);
+		if(err != SSL_ERROR_WANT_READ){
+			Logger::instance().log_text(LogId::SOCKET_ERROR, ERR_error_string(ERR_get_error(), nullptr), "USocket TLS handshake");
+			return 1;
+		}
+		if(pump(1)) return 1;
+	}
+	// Finish sending the last flight before the first request reuses the buffer
+	while(m_sends_inflight){
+		if(pump(1)) return 1;
+	}
+	if(m_opt.ktls) enable_ktls_tx();
+	return 0;
+}
+
+// Collects the application traffic secrets as the handshake derives them
+void USocket::on_keylog(const SSL* ssl, const char* line){
+	USocket* self = static_cast<USocket*>(SSL_get_app_data(ssl));
+	std::string* dst = nullptr;
+	if(std::strncmp(line, "CLIENT_TRAFFIC_SECRET_0 ", 24) == 0) dst = &self->m_client_secret;
+	else if(std::strncmp(line, "SERVER_TRAFFIC_SECRET_0 ", 24) == 0) dst = &self->m_server_secret;
+	if(!dst) return;
+	auto nibble = [](char c){ return c <= '9' ? c - '0' : (c | 0x20) - 'a' + 10; };
+	dst->clear();
+	for(const char* hex = std::strrchr(line, ' ') + 1; hex[0] && hex[1]; hex += 2){
+		dst->push_back(static_cast<char>((nibble(hex[0]) << 4) | nibble(hex[1])));
+	}
+}
+
+void USocket::enable_ktls_rx(){
+	uint16_t cipher = SSL_CIPHER_get_protocol_id(SSL_get_current_cipher(m_ssl));
+	KtlsInfo info;
+	size_t len = 0;
+	const char* why = nullptr;
+	if(SSL_version(m_ssl) != TLS1_3_VERSION) why = "needs TLS 1.3";
+	else if(m_server_secret.empty() || m_client_secret.empty()) why = "traffic secrets not available";
+	else if(BIO_ctrl_pending(m_rbio) || SSL_pending(m_ssl) || m_ring.peek()) why = "records already received";
+	else if(!(len = ktls_info(cipher, m_server_secret, info))) why = "cipher not supported";
+	else if(setsockopt(m_sock, IPPROTO_TCP, TCP_ULP, "tls", 3)) why = "tls ULP not available";
+	else {
+		m_ulp = true;
+		if(setsockopt(m_sock, SOL_TLS, TLS_RX, &info, static_cast<socklen_t>(len))) why = "TLS_RX rejected";
+	}
+	OPENSSL_cleanse(&info, sizeof(info));
+	OPENSSL_cleanse(&m_server_secret[0], m_server_secret.size());
+	m_server_secret.clear();
+	if(why){
+		Logger::instance().log(LogId::SOCKET_KTLS, "not used", why);
+		return;
+	}
+	// With timestamps the receive is a recvmsg already
+	if(m_opt.timestamps){
+		m_ktls_rx = true;
+		return;
+	}
+	m_ktls_rx = true;
+
+	// Swap the plain multishot receive for the recvmsg one
+	io_uring_sqe* s = m_ring.sqe();
+	if(!s){
+		m_failed = true;
+		return;
+	}
+	s->opcode = IORING_OP_ASYNC_CANCEL;
+	s->fd = -1;
+	s->addr = RECV_TAG;
+	s->user_data = CANCEL_TAG;
+	arm_recv();
+}
+
+void USocket::enable_ktls_tx(){
+	if(m_ulp){
+		uint16_t cipher = SSL_CIPHER_get_protocol_id(SSL_get_current_cipher(m_ssl));
+		KtlsInfo info;
+		size_t len = ktls_info(cipher, m_client_secret, info);
+		if(len && setsockopt(m_sock, SOL_TLS, TLS_TX, &info, static_cast<socklen_t>(len)) == 0) m_ktls_tx = true;
+		OPENSSL_cleanse(&info, sizeof(info));
+	}
+	OPENSSL_cleanse(&m_client_secret[0], m_client_secret.size());
+	m_client_secret.clear();
+	if(m_ktls_tx && m_ktls_rx) Logger::instance().log(LogId::SOCKET_KTLS, "enabled", SSL_get_cipher_name(m_ssl));
+	else if(m_ulp) Logger::instance().log(LogId::SOCKET_KTLS, "partly used", m_ktls_tx ? "receive in user space" : "send in user space");
+}
+
+// Send WebSocket upgrade request
+void USocket::switch_to_ws(){
+	if(!m_open) return;
+	unsigned char raw[16];
+	RAND_bytes(raw, sizeof(raw));
+	char key[32];
+	EVP_EncodeBlock(reinterpret_cast<unsigned char*>(key), raw, sizeof(raw));
+
+	std::string request = "GET " + m_opt.path + " HTTP/1.1\r\n"
+		"Host: " + m_opt.host + "\r\n"
+		"Upgrade: websocket\r\n"
+		"Connection: Upgrade\r\n"
+		"Sec-WebSocket-Key: " + std::string(key) + "\r\n"
+		"Sec-WebSocket-Version: 13\r\n\r\n";
+	if(send_bytes(request.data(), request.size())){
+		m_open = false;
+		return;
+	}
+	size_t end;
+	while((end = m_http.find("\r\n\r\n")) == std::string::npos){
+		if(pump(1)){
+			Logger::instance().log(LogId::SOCKET_WS_FAIL, "upgrade response not received");
+			m_open = false;
+			return;
+		}
+	}
+	if(m_http.compare(0, 12, "HTTP/1.1 101") != 0){
+		Logger::instance().log_text(LogId::SOCKET_WS_FAIL, m_http.substr(0, m_http.find("\r\n")));
+		m_open = false;
+		return;
+	}
+	// Frames may follow the upgrade response in the same read
+	m_upgraded = true;
+	m_parser.feed(m_http.data() + end + 4, m_http.size() - end - 4);
+	m_http.clear();
+	Logger::instance().log(LogId::SOCKET_WS_OPEN);
+}
+
+int USocket::next_reply(const char*& why){
+	CParser::Opcode op;
+	while(m_parser.next(m_msg, op) == 0){
+		if(op == CParser::PING){
+			if(send_frame(m_msg.data(), m_msg.size(), CParser::PONG) || send_batch()){
+				why = "send failed";
+				return 1;
+			}
+			continue;
+		}
+		if(op == CParser::CLOSE){
+			m_open = false;
+			Logger::instance().log(LogId::SOCKET_CLOSED);
+			why = "connection closed by peer";
+			return 1;
+		}
+		if(op == CParser::PONG) continue;
+		if(m_timings) stamp_frame();
+		if(m_on_notification && is_notification(m_msg)){
+			m_on_notification(m_msg);
+			continue;
+		}
+		uint64_t tag = reply_tag(m_msg);
+		if(tag && tag == m_wait_tag){
+			m_wait_tag = 0;
+			untag_reply(m_msg, m_caller_id);
+			return 0;
+		}
+		// Owed to a posted request or one that timed out, any other is dropped
+		for(auto it = m_owed.begin(); it != m_owed.end(); ++it){
+			if(it->tag != tag) continue;
+			untag_reply(m_msg, it->id);
+			m_owed.erase(it);
+			if(m_on_reply) m_on_reply(m_msg);
+			break;
+		}
+	}
+	return 1;
+}
+
+// Send a WebSocket Request
+[[nodiscard]] std::pair<int, std::string> USocket::ws_request(const std::string& msg){
+	if(!m_open || !m_upgraded) return std::make_pair(1, std::string("socket not open"));
+	// Armed before the frame so the ring timeout is submitted with it
+	uint64_t deadline = m_timers.schedule(mono_ns() + m_timeout_ms * 1000000, on_deadline, this);
+	arm_timer();
+	uint64_t tag = ++m_next_tag;
+	tag_request(msg, tag, m_tagged, m_caller_id);
+	// Frames posted before it share the write
+	if(send_frame(m_tagged.data(), m_tagged.size(), CParser::TEXT) || send_batch()){
+		m_timers.cancel(deadline);
+		return std::make_pair(1, std::string("send failed"));
+	}
+	m_wait_tag = tag;
+	m_stats.requests++;
+
+	// First wait covers the write and the reply, usually one syscall in all
+	unsigned wait_nr = m_sends_inflight + 1;
+	const char* why = nullptr;
+	while(true){
+		if(next_reply(why) == 0){
+			if(m_timings) read_tx_stamps();
+			m_timers.cancel(deadline);
+			return std::make_pair(0, std::move(m_msg));
+		}
+		if(why) break;
+		if(m_expired == deadline){
+			// Its reply, should it come, goes to the reply handler
+			m_owed.push_back(Owed{tag, m_caller_id});
+			m_wait_tag = 0;
+			Logger::instance().log(LogId::SOCKET_TIMEOUT, "USocket", m_timeout_ms);
+			return std::make_pair(1, std::string("request timed out"));
+		}
+		if(pump(wait_nr)){
+			m_open = false;
+			Logger::instance().log(LogId::SOCKET_ERROR, "USocket", "transport failed");
+			why = "transport failed";
+			break;
+		}
+		wait_nr = 1;
+	}
+	m_wait_tag = 0;
+	m_timers.cancel(deadline);
+	return std::make_pair(1, std::string(why));
+}
+
+void USocket::poll(){
+	if(!m_open || !m_upgraded) return;
+	const char* why = nullptr;
+	// A reply nothing waits for is dropped
+	while(next_reply(why) == 0) {}
+	if(why) return;
+	if(pump(0)){
+		m_open = false;
+		Logger::instance().log(LogId::SOCKET_ERROR, "USocket", "transport failed");
+		return;
+	}
+	while(next_reply(why) == 0) {}
+}
+
+[[nodiscard]] int USocket::post(const std::string& msg){
+	if(!m_open || !m_upgraded) return 1;
+	uint64_t tag = ++m_next_tag;
+	tag_request(msg, tag, m_tagged, m_caller_id);
+	if(send_frame(m_tagged.data(), m_tagged.size(), CParser::TEXT)) return 1;
+	m_stats.requests++;
+	m_owed.push_back(Owed{tag, m_caller_id});
+	if(batch_bytes() >= TLS_RECORD || mono_ns() - m_batch_ns >= m_opt.coalesce_us * 1000) return flush();
+	return 0;
+}
+
+[[nodiscard]] int USocket::flush(){
+	if(!m_open) return 1;
+	// Submits, and takes whatever completions are ready so they do not pile up
+	if(send_batch() || pump(0)){
+		m_open = false;
+		Logger::instance().log(LogId::SOCKET_ERROR, "USocket", "transport failed");
+		return 1;
+	}
+	return 0;
+}
+
+[[nodiscard]] int USocket::wait_replies(){
+	if(!m_open || !m_upgraded) return 1;
+	if(send_batch()) return 1;
+	uint64_t deadline = m_timers.schedule(mono_ns() + m_timeout_ms * 1000000, on_deadline, this);
+	arm_timer();
+	unsigned wait_nr = m_sends_inflight + 1;
+	const char* why = nullptr;
+	while(true){
+		// Nothing is waited on, a reply beyond those owed is dropped
+		while(next_reply(why) == 0) {}
+		if(why) break;
+		if(m_owed.empty()){
+			m_timers.cancel(deadline);
+			return 0;
+		}
+		if(m_expired == deadline){
+			Logger::instance().log(LogId::SOCKET_TIMEOUT, "USocket", m_timeout_ms);
+			return 1;
+		}
+		if(pump(wait_nr)){
+			m_open = false;
+			Logger::instance().log(LogId::SOCKET_ERROR, "USocket", "transport failed");
+			break;
+		}
+		wait_nr = 1;
+	}
+	m_timers.cancel(deadline);
+	return 1;
+}
+
+void USocket::stamp_frame(){
+	m_frame_times = FrameTimes();
+	const RxMark& m = m_rx_marks[m_parser.mark() % RX_MARKS];
+	if(m.seq != m_parser.mark()) return; // completion long gone
+	m_frame_times.kernel_ns = m.kernel_ns;
+	m_frame_times.handler_ns = m.handler_ns;
+	m_frame_times.strategy_ns = realtime_ns();
+	if(m.kernel_ns && m.handler_ns >= m.kernel_ns) m_timings->kernel_to_handler.record(m.handler_ns - m.kernel_ns);
+	m_timings->handler_to_strategy.record(m_frame_times.strategy_ns - m.handler_ns);
+}
+
+void USocket::read_tx_stamps(){
+	// kTLS grows records on the wire, byte offsets no longer match the writes
+	if(m_ktls_tx) return;
+	char control[256];
+	while(m_tx_stamped < m_tx_count){
+		msghdr msg{};
+		msg.msg_control = control;
+		msg.msg_controllen = sizeof(control);
+		if(recvmsg(m_sock, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0) return;
+		int64_t stamp_ns = 0;
+		const sock_extended_err* err = nullptr;
+		for(cmsghdr* c = CMSG_FIRSTHDR(&msg); c; c = CMSG_NXTHDR(&msg, c)){
+			if(c->cmsg_level == SOL_SOCKET && c->cmsg_type == SCM_TIMESTAMPING){
+				scm_timestamping ts;
+				std::memcpy(&ts, CMSG_DATA(c), sizeof(ts));
+				stamp_ns = ts.ts[0].tv_sec * 1000000000ll + ts.ts[0].tv_nsec;
+			} else if((c->cmsg_level == SOL_IP && c->cmsg_type == IP_RECVERR) || (c->cmsg_level == SOL_IPV6 && c->cmsg_type == IPV6_RECVERR)){
+				err = reinterpret_cast<const sock_extended_err*>(CMSG_DATA(c));
+			}
+		}
+		if(!err || !stamp_ns || err->ee_origin != SO_EE_ORIGIN_TIMESTAMPING || err->ee_info != SCM_TSTAMP_SND) continue;
+		// The key counts bytes, 32 bits of it
+		if(m_tx_count - m_tx_stamped > TX_MARKS) m_tx_stamped = m_tx_count - TX_MARKS;
+		for(uint64_t i = m_tx_stamped; i < m_tx_count; i++){
+			const TxMark& t = m_tx_marks[i % TX_MARKS];
+			if(static_cast<uint32_t>(t.key) != err->ee_data) continue;
+			if(stamp_ns >= t.queued_ns) m_timings->send_to_kernel.record(stamp_ns - t.queued_ns);
+			m_tx_stamped = i + 1;
+			break;
+		}
+	}
+}
+
+USocket::Stats USocket::stats() const{
+	Stats s = m_stats;
+	s.enters = m_ring.enters();
+	return s;
+}
@@ -0,0 +1,237 @@
+#pragma once
+#include <ctime>
+#include <deque>
+#include <memory>
+#include <string>
+#include <sys/socket.h>
+#include <linux/errqueue.h>
+#include <linux/net_tstamp.h>
+#include <openssl/ssl.h>
+#include "../Socket.hpp"
+#include "../Histogram.hpp"
+#include "../TimingWheel.hpp"
+#include "../utility.hpp"
+#include "URing.hpp"
+#include "CParser.hpp"
+
+// WebSocket client over io_uring.
+//
+// TLS runs on memory BIOs so OpenSSL never touches the socket: ciphertext
+// is written from a registered buffer (WRITE_FIXED on a fixed file) and a
+// single multishot receive, armed once, fills buffers from a provided
+// buffer ring. A request costs one io_uring_enter for the send and the
+// reply together, none with SQPOLL while the poller is awake.
+//
+// With `ktls` the TLS 1.3 traffic keys are handed to the kernel (TLS_TX /
+// TLS_RX) once the handshake is done: frames are then written straight
+// from the registered buffer and replies arrive decrypted, OpenSSL is only
+// used for the handshake. Falls back to user space TLS when the kernel or
+// the negotiated cipher does not support it.
+//
+// With `timestamps` the kernel stamps (SO_TIMESTAMPING, software) every
+// receive and send. Each decoded frame carries the receive time of its last
+// byte, the time the completion was handled and the time it was handed to
+// the caller; send stamps are read from the error queue after each request
+// (one extra syscall). All stamps are CLOCK_REALTIME nanoseconds.
+//
+// Request deadlines sit in a timing wheel; a ring TIMEOUT armed at its
+// earliest deadline goes out with the send, so a lost reply wakes the wait.
+//
+// Frames are packed back to back into the send buffer and leave as a batch:
+// one write (and, with TLS, one record per 16 KB) for every frame posted
+// since the last one. ws_request() sends its frame at once, together with
+// any posted before it; post() holds frames for up to `coalesce_us` so a
+// burst (cancels, a requote) shares a write.
+//
+// Requests go out under tags of the socket's own (Socket::tag_request), a
+// reply is matched to its request by tag whatever order it comes in.
+class USocket: public Socket{
+public:
+	struct Options{
+		std::string host;    // empty: the exchange
+		std::string port;
+		bool tls = true;
+		bool verify = true;  // check the server certificate (off for local test endpoints)
+		bool sqpoll = false;
+		bool ktls = false;
+		bool timestamps = false;
+		int64_t coalesce_us = 50; // longest a posted frame waits for others to share its write
+		std::string path = "/ws/api/v2";
+	};
+	struct Stats{
+		uint64_t requests = 0;
+		uint64_t enters = 0;      // io_uring_enter syscalls
+		uint64_t sends = 0;       // writes completed, frames / sends is frames per write
+		uint64_t frames = 0;      // request frames sent
+		uint64_t records = 0;     // TLS records written
+		uint64_t recvs = 0;       // receive completions
+		uint64_t recv_bytes = 0;
+	};
+	// Stamps of the frame last delivered, 0 where not known
+	struct FrameTimes{
+		int64_t kernel_ns = 0;   // last byte received by the kernel
+		int64_t handler_ns = 0;  // its completion handled
+		int64_t strategy_ns = 0; // frame handed to ws_request's caller / the notification handler
+	};
+	struct Timings{
+		Histogram kernel_to_handler;
+		Histogram handler_to_strategy;
+		Histogram send_to_kernel;  // write queued -> kernel send stamp
+	};
+
+	USocket(); // Constructor
+	explicit USocket(const Options& opt);
+	~USocket(); // Destructor
+	void switch_to_ws() override;
+	[[nodiscard]] std::pair<int, std::string> ws_request(const std::string& msg) override;
+	// Takes the completions that are ready, notifications and owed replies go to their handlers
+	void poll() override;
+	// Queue a request without waiting for its reply, 0 on success. The frame
+	// goes out once the batch holds a TLS record's worth of bytes or its
+	// first frame is `coalesce_us` old, with the next flush() or ws_request()
+	// otherwise
+	[[nodiscard]] int post(const std::string& msg);
+	// Send the posted frames now
+	[[nodiscard]] int flush();
+	// Send the posted frames and wait for all their replies, 1 on failure or
+	// once the request timeout passes
+	[[nodiscard]] int wait_replies();
+	// Replies to posted requests, and late ones to requests that timed out,
+	// as they arrive and with the caller's id. Dropped without a handler
+	void set_reply_handler(std::function<void(const std::string&)> handler){ m_on_reply = std::move(handler); }
+
+	bool is_open() const { return m_open; }
+	// Both directions are encrypted by the kernel
+	bool ktls() const { return m_ktls_tx && m_ktls_rx; }
+	Stats stats() const;
+	// Valid inside the notification handler and after ws_request returns
+	const FrameTimes& frame_times() const { return m_frame_times; }
+	// nullptr unless the `timestamps` option is on
+	const Timings* timings() const { return m_timings.get(); }
+
+	// Write key (16 or 32 bytes, length in `key_len`) and 12 byte IV of the
+	// TLS 1.3 suite `cipher` from a traffic secret (RFC 8446 section 7.3),
+	// 1 when the suite is not supported
+	static int traffic_keys(uint16_t cipher, const std::string& secret, unsigned char* key, size_t& key_len, unsigned char* iv);
+private:
+	static constexpr uint64_t RECV_TAG = 1;
+	static constexpr uint64_t RECVMSG_TAG = 2; // kTLS receive, carries the record type
+	static constexpr uint64_t CANCEL_TAG = 3;
+	static constexpr uint64_t TIMER_TAG = 4;   // ring timeout, its slot in the bits above
+	static constexpr unsigned TIMER_SLOTS = 4; // ring timeouts outstanding at once
+	static constexpr uint64_t SEND_TAG = 1ull << 63;
+	static constexpr size_t SEND_BYTES = 1 << 20;
+	static constexpr size_t TLS_RECORD = 16384; // largest record payload, a batch is sent once it fills one
+	static constexpr unsigned RECV_BUFS = 16;
+	static constexpr unsigned RECV_BUF_BYTES = 16384;
+	// recvmsg control space: a timestamp and a kTLS record type
+	static constexpr size_t CONTROL_BYTES = CMSG_SPACE(sizeof(scm_timestamping)) + CMSG_SPACE(sizeof(unsigned char));
+	static constexpr size_t RX_MARKS = 256; // at least the completion queue size
+	static constexpr size_t TX_MARKS = 64;
+
+	int connect_tcp();
+	int setup_ring();
+	int handshake_tls();
+	// Called on the first completed handshake step, before the client Finished is sent
+	void enable_ktls_rx();
+	// Called once the handshake flight is on the wire
+	void enable_ktls_tx();
+	static void on_keylog(const SSL* ssl, const char* line);
+	void arm_recv();
+	// Ring timeout at the wheel's next deadline, unless one no later is already out
+	void arm_timer();
+	static void on_deadline(void* ctx, uint64_t id);
+	// Room for `len` bytes in the registered send buffer, nullptr when it can not be made
+	char* send_space(size_t len);
+	// Queue a write of [at, at + len) of the send buffer, `fresh` unless resending the rest of one
+	void queue_send(size_t at, size_t len, bool fresh = true);
+	// Queue `len` raw bytes (TLS encrypted when enabled)
+	int send_bytes(const char* data, size_t len);
+	// Add a frame to the batch
+	int send_frame(const char* data, size_t len, CParser::Opcode opcode);
+	// Queue the write of the batch
+	int send_batch();
+	size_t batch_bytes() const { return user_tls() ? m_frame.size() : m_send_used - m_batch_at; }
+	bool user_tls() const { return m_opt.tls && !m_ktls_tx; }
+	int flush_tls();
+	// Submit queued SQEs, wait for `wait_nr` completions and process all ready ones
+	int pump(unsigned wait_nr);
+	void on_recv(const char* data, size_t len);
+	void on_plain(const char* data, size_t len);
+	// Works through the decoded frames: answers pings, hands notifications
+	// and owed replies to their handlers. 0 with the reply ws_request waits
+	// for in m_msg, 1 once more bytes are needed; `why` is set when the
+	// connection is lost
+	int next_reply(const char*& why);
+	bool use_recvmsg() const { return m_opt.timestamps || m_ktls_rx; }
+	// Stamps the frame about to be delivered
+	void stamp_frame();
+	// Send stamps waiting on the error queue
+	void read_tx_stamps();
+	// One kTLS record, `buf` laid out as io_uring_recvmsg_out + control + payload
+	void on_record(const char* buf, size_t len);
+
+	Options m_opt;
+	int m_sock = -1;
+	bool m_open = false;
+	bool m_upgraded = false;
+	URing m_ring;
+	CParser m_parser;
+	SSL_CTX* m_ctx = nullptr;
+	SSL* m_ssl = nullptr;
+	BIO* m_rbio = nullptr; // network -> OpenSSL
+	BIO* m_wbio = nullptr; // OpenSSL -> network
+	std::string m_client_secret; // TLS 1.3 application traffic secrets, raw bytes
+	std::string m_server_secret;
+	bool m_ulp = false;
+	bool m_ktls_tx = false;
+	bool m_ktls_rx = false;
+	msghdr m_rx_msg{};     // template for the multishot recvmsg
+	char* m_send = nullptr;
+	size_t m_send_used = 0;
+	unsigned m_sends_inflight = 0;
+	bool m_recv_armed = false;
+	bool m_failed = false;
+	std::string m_frame;   // batch of frames for the user space TLS path
+	size_t m_batch_at = 0; // start of the batch in the send buffer otherwise
+	unsigned m_batch_frames = 0;
+	int64_t m_batch_ns = 0; // its first frame queued
+	std::function<void(const std::string&)> m_on_reply;
+	std::string m_http;    // upgrade response until complete
+	std::string m_msg;
+	Stats m_stats;
+
+	struct RxMark{
+		uint64_t seq;
+		int64_t kernel_ns;
+		int64_t handler_ns;
+	};
+	struct TxMark{
+		uint64_t key;        // stream offset of the write's last byte, the kernel's OPT_ID
+		int64_t queued_ns;
+	};
+	std::unique_ptr<Timings> m_timings;
+	RxMark m_rx_marks[RX_MARKS];
+	uint64_t m_rx_seq = 0;   // receive completions so far, the parser mark of their bytes
+	TxMark m_tx_marks[TX_MARKS];
+	uint64_t m_tx_count = 0;
+	uint64_t m_tx_stamped = 0; // writes before this one have their stamp (or lost it)
+	uint64_t m_tx_bytes = 0;
+	FrameTimes m_frame_times;
+
+	TimingWheel m_timers{16, 1000000, mono_ns()}; // request deadlines, 1 ms ticks
+	__kernel_timespec m_timer_ts[TIMER_SLOTS];   // read by the kernel when it takes the SQE
+	int64_t m_timer_at[TIMER_SLOTS];              // deadline of each outstanding ring timeout
+	unsigned m_timer_busy = 0;                    // bit per outstanding ring timeout
+	uint64_t m_expired = 0;                       // id of the deadline that fired last
+	// Replies due to posted requests and those that timed out, by tag
+	struct Owed{
+		uint64_t tag;
+		std::string id; // the caller's
+	};
+	std::deque<Owed> m_owed;
+	uint64_t m_next_tag = 0;
+	uint64_t m_wait_tag = 0;   // ws_request's, 0 when none waits
+	std::string m_tagged;      // the frame as sent
+	std::string m_caller_id;
+};
@@ -0,0 +1,104 @@
+#pragma once
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <iomanip>
+#include <string>
+
+// Log-linear latency histogram (HdrHistogram style).
+// Values are bucketed with SUB_BITS bits of precision (< 1% relative error),
+// record() is a handful of integer ops and never allocates.
+class Histogram{
+public:
+	static constexpr int SUB_BITS = 7;
+	static constexpr uint64_t SUB = 1ull << SUB_BITS;
+	static constexpr int BUCKETS = (64 - SUB_BITS + 1) * SUB;
+
+	// Constructor
+	Histogram() { reset(); }
+
+	void reset(){
+		std::memset(m_counts, 0, sizeof(m_counts));
+		m_total = 0;
+		m_sum = 0;
+		m_min = UINT64_MAX;
+		m_max = 0;
+	}
+
+	void record(uint64_t value){
+		m_counts[index_of(value)]++;
+		m_total++;
+		m_sum += value;
+		if(value < m_min) m_min = value;
+		if(value > m_max) m_max = value;
+	}
+
+	void merge(const Histogram& other){
+		for(int i = 0; i < BUCKETS; i++) m_counts[i] += other.m_counts[i];
+		m_total += other.m_total;
+		m_sum += other.m_sum;
+		if(other.m_min < m_min) m_min = other.m_min;
+		if(other.m_max > m_max) m_max = other.m_max;
+	}
+
+	uint64_t count() const { return m_total; }
+	uint64_t min() const { return m_total ? m_min : 0; }
+	uint64_t max() const { return m_max; }
+	double mean() const { return m_total ? (1.0 * m_sum) / m_total : 0.0; }
+
+	// Value at percentile p in [0, 100], reported as the bucket's upper edge
+	uint64_t percentile(double p) const {
+		if(m_total == 0) return 0;
+		uint64_t target = static_cast<uint64_t>(p / 100.0 * m_total + 0.5);
+		if(target == 0) target = 1;
+		if(target >= m_total) return m_max;
+		uint64_t seen = 0;
+		for(int i = 0; i < BUCKETS; i++){
+			seen += m_counts[i];
+			if(seen >= target){
+				uint64_t upper = value_of(i + 1) - 1;
+				return upper < m_max ? upper : m_max;
+			}
+		}
+		return m_max;
+	}
+
+	// Print the percentile curve, values divided by `scale` (e.g. 1000 for ns -> us)
+	void print(std::ostream& os, const std::string& title, double scale = 1000.0, const char* unit = "us") const {
+		static const double pcts[] = {50.0, 75.0, 90.0, 99.0, 99.9, 99.99, 99.999};
+		os << title << " (" << m_total << " samples)\n";
+		if(m_total == 0) return;
+		os << std::fixed << std::setprecision(2);
+		os << "  min      " << min() / scale << ' ' << unit << '\n';
+		os << "  mean     " << mean() / scale << ' ' << unit << '\n';
+		for(double p : pcts){
+			char label[16];
+			std::snprintf(label, sizeof(label), "p%-8g", p);
+			os << "  " << label << percentile(p) / scale << ' ' << unit << '\n';
+		}
+		os << "  max      " << max() / scale << ' ' << unit << '\n';
+		os << std::defaultfloat;
+	}
+
+private:
+	static int index_of(uint64_t v){
+		if(v < SUB) return static_cast<int>(v);
+		int shift = (63 - __builtin_clzll(v)) - SUB_BITS;
+		return static_cast<int>(shift * SUB + (v >> shift));
+	}
+
+	static uint64_t value_of(int idx){
+		if(idx < static_cast<int>(SUB)) return idx;
+		int shift = idx / static_cast<int>(SUB) - 1;
+		uint64_t top = idx - shift * SUB;
+		if(shift >= 64 - SUB_BITS) return UINT64_MAX;
+		return top << shift;
+	}
+
+	uint64_t m_counts[BUCKETS];
+	uint64_t m_total;
+	uint64_t m_sum;
+	uint64_t m_min;
+	uint64_t m_max;
+};
@@ -0,0 +1,94 @@
+#include "HugeArena.hpp"
+#include "Logger.hpp"
+#include <alloca.h>
+#include <cstdio>
+#include <cstring>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+// Constructor
+HugeArena::HugeArena() {}
+
+// Destructor
+HugeArena::~HugeArena(){
+	if(m_base) munmap(m_base, m_capacity);
+}
+
+// THP set to "never" takes the advice without acting on it
+static bool thp_disabled(){
+	char mode[128] = {};
+	FILE* f = std::fopen("/sys/kernel/mm/transparent_hugepage/enabled", "r");
+	if(!f) return true;
+	size_t n = std::fread(mode, 1, sizeof(mode) - 1, f);
+	std::fclose(f);
+	mode[n] = 0;
+	return std::strstr(mode, "[never]") != nullptr;
+}
+
+const char* HugeArena::name(Backing backing){
+	static const char* const names[] = {"none", "2MB huge pages", "transparent huge pages", "4KB pages"};
+	return names[backing];
+}
+
+int HugeArena::init(size_t bytes, bool lock){
+	if(m_base || bytes == 0) return 1;
+	size_t size = (bytes + HUGE_PAGE - 1) & ~(HUGE_PAGE - 1);
+	Backing backing = HUGETLB;
+	void* p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+	if(p == MAP_FAILED){
+		// No reserved huge pages: over-map to align on 2 MB so THP can back it
+		backing = THP;
+		void* raw = mmap(nullptr, size + HUGE_PAGE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if(raw == MAP_FAILED) return 1;
+		uintptr_t start = (reinterpret_cast<uintptr_t>(raw) + HUGE_PAGE - 1) & ~(HUGE_PAGE - 1);
+		size_t head = start - reinterpret_cast<uintptr_t>(raw);
+		if(head) munmap(raw, head);
+		if(HUGE_PAGE - head) munmap(reinterpret_cast<char*>(start) + size, HUGE_PAGE - head);
+		p = reinterpret_cast<void*>(start);
+		if(madvise(p, size, MADV_HUGEPAGE) || thp_disabled()) backing = PAGES;
+	}
+	m_base = static_cast<char*>(p);
+	m_capacity = size;
+	m_backing = backing;
+	m_locked = lock && mlock(m_base, m_capacity) == 0;
+	return 0;
+}
+
+void HugeArena::prefault(){
+	// A write (a read would map the shared zero page), atomic as parts of
+	// the region may already be in use
+	for(size_t at = 0; at < m_capacity; at += 4096){
+		__atomic_fetch_add(m_base + at, 0, __ATOMIC_RELAXED);
+	}
+}
+
+PageFaults page_faults(){
+	rusage ru;
+	getrusage(RUSAGE_SELF, &ru);
+	PageFaults f;
+	f.minor = ru.ru_minflt;
+	f.major = ru.ru_majflt;
+	return f;
+}
+
+int lock_memory(){
+	return mlockall(MCL_CURRENT | MCL_FUTURE) == 0 ? 0 : 1;
+}
+
+void prefault_stack(size_t bytes){
+	char* p = static_cast<char*>(alloca(bytes));
+	for(size_t at = 0; at < bytes; at += 4096) reinterpret_cast<volatile char*>(p)[at] = 0;
+}
+
+void setup_memory(size_t arena_bytes, size_t stack_bytes){
+	HugeArena& arena = HugeArena::instance();
+	if(arena.init(arena_bytes)){
+		Logger::instance().log(LogId::SOCKET_ERROR, "Memory", "arena could not be mapped, hot path memory comes from the heap");
+	}
+	int locked = lock_memory();
+	arena.prefault();
+	prefault_stack(stack_bytes);
+	Logger::instance().log(LogId::MEMORY_SETUP, arena.capacity() >> 20, HugeArena::name(arena.backing()),
+		locked == 0 ? "all memory locked" : "mlockall failed (RLIMIT_MEMLOCK), memory not locked");
+}
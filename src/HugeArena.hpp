@@ -0,0 +1,134 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+
+// Bump arena for hot path memory (log rings, order book nodes, pools).
+//
+// Backed by explicit 2 MB huge pages (MAP_HUGETLB) when the system has
+// them reserved, otherwise by transparent huge pages (MADV_HUGEPAGE), and
+// normal pages as the last resort. prefault() touches every page up front
+// so no first touch fault lands on a live order; with `lock` the region is
+// also mlock()ed so it is never paged out. Memory is never given back:
+// size it for everything the process sets up, not for churn.
+class HugeArena{
+public:
+	enum Backing : uint8_t { NONE, HUGETLB, THP, PAGES };
+	static constexpr size_t HUGE_PAGE = 2 * 1024 * 1024;
+
+	// Constructor
+	HugeArena();
+	// Destructor
+	~HugeArena();
+	HugeArena(const HugeArena&) = delete;
+	HugeArena& operator=(const HugeArena&) = delete;
+
+	// The process arena, empty (allocate() returns nullptr) until init().
+	// Never unmapped: objects in it may outlive static destruction
+	static HugeArena& instance(){
+		static HugeArena* arena = new HugeArena();
+		return *arena;
+	}
+
+	// Maps `bytes` rounded up to whole huge pages, returns 0 on success
+	int init(size_t bytes, bool lock = true);
+	// `bytes` aligned to `align` (a power of two), nullptr when exhausted.
+	// Thread safe, lock free
+	void* allocate(size_t bytes, size_t align = alignof(std::max_align_t)){
+		if(!m_base) return nullptr;
+		size_t used = m_used.load(std::memory_order_relaxed);
+		size_t at;
+		do{
+			at = (used + align - 1) & ~(align - 1);
+			if(at + bytes > m_capacity) return nullptr;
+		} while(!m_used.compare_exchange_weak(used, at + bytes, std::memory_order_relaxed));
+		return m_base + at;
+	}
+	bool contains(const void* p) const{
+		return p >= m_base && p < m_base + m_capacity;
+	}
+	// Writes one byte per 4 KB page of the whole region
+	void prefault();
+
+	Backing backing() const { return m_backing; }
+	bool locked() const { return m_locked; }
+	size_t capacity() const { return m_capacity; }
+	size_t used() const { return m_used.load(std::memory_order_relaxed); }
+	static const char* name(Backing backing);
+private:
+	char* m_base = nullptr;
+	size_t m_capacity = 0;
+	std::atomic<size_t> m_used{0};
+	Backing m_backing = NONE;
+	bool m_locked = false;
+};
+
+// Allocator for node based containers (std::map, std::list): single nodes
+// come from the process arena and are recycled through a per thread free
+// list; arrays, and everything once the arena is full or was never
+// initialised, go to the heap.
+template<typename T>
+class ArenaAllocator{
+public:
+	using value_type = T;
+
+	ArenaAllocator() = default;
+	template<typename U>
+	ArenaAllocator(const ArenaAllocator<U>&) {}
+
+	T* allocate(size_t n){
+		if(n == 1){
+			if(t_free){
+				Free* f = t_free;
+				t_free = f->next;
+				return reinterpret_cast<T*>(f);
+			}
+			void* p = HugeArena::instance().allocate(NODE, alignof(T) > alignof(Free) ? alignof(T) : alignof(Free));
+			if(p) return static_cast<T*>(p);
+		}
+		return std::allocator<T>().allocate(n);
+	}
+	void deallocate(T* p, size_t n){
+		if(n == 1 && HugeArena::instance().contains(p)){
+			// Onto the freeing thread's list, nodes may move between threads
+			Free* f = reinterpret_cast<Free*>(p);
+			f->next = t_free;
+			t_free = f;
+			return;
+		}
+		std::allocator<T>().deallocate(p, n);
+	}
+
+	template<typename U>
+	bool operator==(const ArenaAllocator<U>&) const { return true; }
+	template<typename U>
+	bool operator!=(const ArenaAllocator<U>&) const { return false; }
+private:
+	struct Free{
+		Free* next;
+	};
+	static constexpr size_t NODE = sizeof(T) > sizeof(Free) ? sizeof(T) : sizeof(Free);
+	inline static thread_local Free* t_free = nullptr;
+};
+
+// Minor / major page faults of the process so far (getrusage)
+struct PageFaults{
+	long minor = 0;
+	long major = 0;
+};
+PageFaults page_faults();
+
+// mlockall(MCL_CURRENT | MCL_FUTURE): everything mapped now or later stays
+// resident and is populated when mapped. Returns 0 on success; fails
+// without CAP_IPC_LOCK when the locked set exceeds RLIMIT_MEMLOCK
+int lock_memory();
+
+// Touches `bytes` of the calling thread's stack below the current frame
+void prefault_stack(size_t bytes);
+
+// Startup of a trading process: the process arena of `arena_bytes`, all
+// memory locked, the arena and `stack_bytes` of this thread's stack
+// prefaulted. Logs what it got, call before anything allocates hot memory
+void setup_memory(size_t arena_bytes, size_t stack_bytes);
@@ -0,0 +1,51 @@
+#include "LatencyBreakdown.hpp"
+#include <charconv>
+
+// Field `key` (with quotes and colon) as an integer, searched from the end
+// where Deribit puts the top level usIn/usOut/usDiff
+static int tail_field(const std::string& reply, std::string_view key, int64_t& value){
+	size_t pos = reply.rfind(key);
+	if(pos == std::string::npos) return 1;
+	const char* first = reply.data() + pos + key.size();
+	return std::from_chars(first, reply.data() + reply.size(), value).ec == std::errc() ? 0 : 1;
+}
+
+int LatencyBreakdown::stamps(const std::string& reply, int64_t& us_in, int64_t& us_out){
+	return (tail_field(reply, "\"usIn\":", us_in) || tail_field(reply, "\"usOut\":", us_out)) ? 1 : 0;
+}
+
+void LatencyBreakdown::add_offset_sample(int64_t send_us, int64_t recv_us, int64_t us_in, int64_t us_out){
+	Sample& s = m_window[m_samples % WINDOW];
+	s.offset_us = ((us_in - send_us) + (us_out - recv_us)) / 2;
+	s.delay_us = (recv_us - send_us) - (us_out - us_in);
+	m_samples++;
+	m_synced_at_us = recv_us;
+
+	// Least delayed sample of the window
+	uint64_t n = m_samples < WINDOW ? m_samples : WINDOW;
+	const Sample* best = &m_window[0];
+	for(uint64_t i = 1; i < n; i++){
+		if(m_window[i].delay_us < best->delay_us) best = &m_window[i];
+	}
+	m_offset_us = best->offset_us;
+	m_delay_us = best->delay_us;
+}
+
+// Negative legs are recorded as 0 and counted
+static void record_leg(Histogram& h, int64_t us, uint64_t& skewed){
+	if(us < 0){
+		skewed++;
+		us = 0;
+	}
+	h.record(static_cast<uint64_t>(us) * 1000);
+}
+
+void LatencyBreakdown::record(std::string_view method, int64_t send_us, int64_t recv_us, int64_t us_in, int64_t us_out){
+	if(!synced()) return;
+	auto it = m_methods.find(method);
+	if(it == m_methods.end()) it = m_methods.emplace(std::string(method), Breakdown()).first;
+	Breakdown& b = it->second;
+	record_leg(b.outbound, us_in - m_offset_us - send_us, b.skewed);
+	record_leg(b.exchange, us_out - us_in, b.skewed);
+	record_leg(b.inbound, recv_us - (us_out - m_offset_us), b.skewed);
+}
@@ -0,0 +1,52 @@
+#pragma once
+#include <cstdint>
+#include <map>
+#include <string>
+#include <string_view>
+#include "Histogram.hpp"
+
+// Splits request round trips into outbound wire, exchange processing and
+// inbound wire time using the usIn/usOut stamps Deribit adds to replies.
+//
+// Local stamps are wall clock microseconds. The exchange clock offset is
+// estimated NTP style from round trips whose reply carries usIn/usOut
+// (public/get_time): offset = ((usIn - send) + (usOut - recv)) / 2, and of
+// the last few samples the one with the least network delay is kept, its
+// error is bounded by half that delay. Histograms hold nanoseconds.
+// Not thread safe, the Api serializes requests.
+class LatencyBreakdown{
+public:
+	struct Breakdown{
+		Histogram outbound;  // send -> usIn
+		Histogram exchange;  // usIn -> usOut (usDiff)
+		Histogram inbound;   // usOut -> receive
+		uint64_t skewed = 0; // legs that came out negative, offset error larger than the leg
+	};
+
+	// usIn/usOut of a reply, 1 when it carries none (cached or notification)
+	static int stamps(const std::string& reply, int64_t& us_in, int64_t& us_out);
+
+	// One clock offset sample from a round trip
+	void add_offset_sample(int64_t send_us, int64_t recv_us, int64_t us_in, int64_t us_out);
+	bool synced() const { return m_samples > 0; }
+	int64_t offset_us() const { return m_offset_us; }     // exchange clock - local clock
+	int64_t offset_delay_us() const { return m_delay_us; } // network delay of the sample in use
+	int64_t synced_at_us() const { return m_synced_at_us; }
+
+	// Attribute one round trip of `method`, ignored until synced
+	void record(std::string_view method, int64_t send_us, int64_t recv_us, int64_t us_in, int64_t us_out);
+	const std::map<std::string, Breakdown, std::less<>>& methods() const { return m_methods; }
+private:
+	static constexpr int WINDOW = 8;
+	struct Sample{
+		int64_t offset_us;
+		int64_t delay_us;
+	};
+
+	Sample m_window[WINDOW];
+	uint64_t m_samples = 0;
+	int64_t m_offset_us = 0;
+	int64_t m_delay_us = 0;
+	int64_t m_synced_at_us = 0;
+	std::map<std::string, Breakdown, std::less<>> m_methods;
+};
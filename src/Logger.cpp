@@ -0,0 +1,173 @@
+#include "Logger.hpp"
+#include <chrono>
+#include <iostream>
+
+// Format table, indexed by LogId
+static const char* const log_formats[] = {
+	"[api] New Api instance created",                       // API_CREATE
+	"[api] Destroying Api instance",                        // API_DESTROY
+	"[api] Logging in with client credentials",             // API_LOGIN
+	"[api] Authentication successful",                      // API_AUTH_OK
+	"[api] Authentication failed",                          // API_AUTH_FAIL
+	"[socket] {} initialized",                              // SOCKET_INIT
+	"[socket] Waiting for connection",                      // SOCKET_CONNECTING
+	"[socket] Moved to WebSocket connection",               // SOCKET_WS_OPEN
+	"[socket] Connection failed: {}",                       // SOCKET_WS_FAIL
+	"[socket] Connection closed",                           // SOCKET_CLOSED
+	"[socket] {} error: {}",                                // SOCKET_ERROR
+	"[socket] Error sending message: {}",                   // SOCKET_SEND_FAIL
+	"[socket] Message written, {} bytes in {} us",          // SOCKET_WRITE_DONE
+	"[socket] Response: {}",                                // SOCKET_RESPONSE
+	"[trader] Response: {}",                                // TRADER_RESPONSE
+	"[trader] Error: {}",                                   // TRADER_ERROR
+	"[trader] Local position of {} drifted, reconciled",    // POSITION_DRIFT
+	"[trader] {} instruments loaded from {}",               // INSTRUMENTS_LOADED
+	"[socket] Kernel TLS {}: {}",                           // SOCKET_KTLS
+	"[socket] {} request timed out after {} ms",            // SOCKET_TIMEOUT
+	"[api] Time to live over, cancelling order {}",         // API_ORDER_EXPIRED
+	"[memory] Arena of {} MB on {}, {}",                    // MEMORY_SETUP
+	"[memory] {}: {} minor, {} major page faults",          // MEMORY_FAULTS
+	"[state] {} orders, {} positions recovered in {} us",   // STATE_RECOVERED
+	"[state] Open orders: {} found on the exchange, {} gone", // STATE_RECONCILED
+	"[fix] {} logged on, next sequence numbers in {} out {}", // FIX_LOGON
+	"[fix] Session ended: {}",                              // FIX_LOGOUT
+	"[fix] Sequence gap: expected {} got {}, resend requested", // FIX_GAP
+	"[fix] Reject of our message {}: {}",                   // FIX_REJECT
+	"[socket] {} reconnected, {}",                          // SOCKET_RECONNECT
+};
+static_assert(sizeof(log_formats) / sizeof(log_formats[0]) == static_cast<size_t>(LogId::COUNT),
+	"every LogId needs a format");
+
+Logger& Logger::instance(){
+	static Logger logger;
+	return logger;
+}
+
+// Constructor
+Logger::Logger() {}
+
+// Destructor
+Logger::~Logger(){
+	stop();
+}
+
+int Logger::start(const std::string& path){
+	if(m_running) return 0;
+	m_file = std::fopen(path.c_str(), "a");
+	if(!m_file){
+		std::cerr << "Failed to open log file " << path << '\n';
+		return 1;
+	}
+	m_running = true;
+	m_thread = std::thread(&Logger::run, this);
+	return 0;
+}
+
+void Logger::stop(){
+	if(!m_running) return;
+	m_running = false;
+	if(m_thread.joinable()) m_thread.join();
+	std::fclose(m_file);
+	m_file = nullptr;
+}
+
+uint64_t Logger::dropped(){
+	std::lock_guard<std::mutex> lock(m_rings_mutex);
+	uint64_t total = 0;
+	for(auto& r : m_rings) total += r->m_dropped.load(std::memory_order_relaxed);
+	return total;
+}
+
+// Each thread gets its own ring on first use, rings live as long as the logger
+LogRing* Logger::ring(){
+	thread_local LogRing* t_ring = nullptr;
+	if(t_ring) return t_ring;
+	std::lock_guard<std::mutex> lock(m_rings_mutex);
+	m_rings.push_back(std::make_unique<LogRing>());
+	t_ring = m_rings.back().get();
+	return t_ring;
+}
+
+// Background writer: drain every ring, sleep briefly when idle
+void Logger::run(){
+	while(true){
+		bool running = m_running.load();
+		uint64_t n = 0;
+		{
+			std::lock_guard<std::mutex> lock(m_rings_mutex);
+			for(auto& r : m_rings) n += drain(*r);
+		}
+		if(n == 0){
+			if(!running) break;
+			std::fflush(m_file);
+			std::this_thread::sleep_for(std::chrono::microseconds(200));
+		}
+	}
+	uint64_t lost = dropped();
+	if(lost) std::fprintf(m_file, "[logger] %llu records dropped\n", static_cast<unsigned long long>(lost));
+	std::fflush(m_file);
+}
+
+uint64_t Logger::drain(LogRing& r){
+	uint64_t avail = r.available();
+	uint64_t done = 0;
+	std::string text;
+	while(done < avail){
+		const LogRecord& rec = r.front(done);
+		if(rec.id >= static_cast<uint16_t>(LogId::COUNT)){ // wrap padding
+			done++;
+			continue;
+		}
+		// Gather continuation records of the same message
+		uint64_t n = 1;
+		text.assign(rec.text, rec.text_len);
+		while((r.front(done + n - 1).flags & LogRecord::CONTINUED) && done + n < avail){
+			const LogRecord& more = r.front(done + n);
+			text.append(more.text, more.text_len);
+			n++;
+		}
+		write_record(rec, text);
+		done += n;
+	}
+	r.pop(done);
+	return done;
+}
+
+void Logger::write_record(const LogRecord& rec, const std::string& text){
+	m_line.clear();
+
+	char stamp[40];
+	time_t secs = rec.ts_ns / 1000000000;
+	tm parts;
+	gmtime_r(&secs, &parts);
+	size_t len = std::strftime(stamp, sizeof(stamp), "%Y-%m-%dT%H:%M:%S", &parts);
+	std::snprintf(stamp + len, sizeof(stamp) - len, ".%09lldZ ", static_cast<long long>(rec.ts_ns % 1000000000));
+	m_line += stamp;
+
+	const char* fmt = log_formats[rec.id];
+	int arg = 0;
+	bool text_used = false;
+	char num[32];
+	for(const char* p = fmt; *p; p++){
+		if(p[0] != '{' || p[1] != '}'){
+			m_line += *p;
+			continue;
+		}
+		p++;
+		if(arg < rec.nargs){
+			uint64_t v = rec.args[arg];
+			switch((rec.types >> (2 * arg)) & 3){
+				case I64: std::snprintf(num, sizeof(num), "%lld", static_cast<long long>(v)); m_line += num; break;
+				case U64: std::snprintf(num, sizeof(num), "%llu", static_cast<unsigned long long>(v)); m_line += num; break;
+				case F64: { double d; std::memcpy(&d, &v, sizeof(d)); std::snprintf(num, sizeof(num), "%.6g", d); m_line += num; break; }
+				default: m_line += reinterpret_cast<const char*>(v); break;
+			}
+			arg++;
+		} else if(!text_used){
+			m_line += text;
+			text_used = true;
+		}
+	}
+	m_line += '\n';
+	std::fwrite(m_line.data(), 1, m_line.size(), m_file);
+}
@@ -0,0 +1,216 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <vector>
+#include "HugeArena.hpp"
+
+// Format ids, the format text for each lives in the table in Logger.cpp.
+// "{}" placeholders are filled with the numeric/static string args in order,
+// the last "{}" of a log_text() format receives the copied text.
+enum class LogId : uint16_t {
+	API_CREATE,
+	API_DESTROY,
+	API_LOGIN,
+	API_AUTH_OK,
+	API_AUTH_FAIL,
+	SOCKET_INIT,
+	SOCKET_CONNECTING,
+	SOCKET_WS_OPEN,
+	SOCKET_WS_FAIL,
+	SOCKET_CLOSED,
+	SOCKET_ERROR,
+	SOCKET_SEND_FAIL,
+	SOCKET_WRITE_DONE,
+	SOCKET_RESPONSE,
+	TRADER_RESPONSE,
+	TRADER_ERROR,
+	POSITION_DRIFT,
+	INSTRUMENTS_LOADED,
+	SOCKET_KTLS,
+	SOCKET_TIMEOUT,
+	API_ORDER_EXPIRED,
+	MEMORY_SETUP,
+	MEMORY_FAULTS,
+	STATE_RECOVERED,
+	STATE_RECONCILED,
+	FIX_LOGON,
+	FIX_LOGOUT,
+	FIX_GAP,
+	FIX_REJECT,
+	SOCKET_RECONNECT,
+	COUNT
+};
+
+// Fixed size binary record, two per cache line pair
+struct LogRecord{
+	static constexpr int MAX_ARGS = 4;
+	static constexpr int TEXT_BYTES = 80;
+	static constexpr uint16_t CONTINUED = 1; // next record carries more text
+
+	int64_t ts_ns;
+	uint16_t id;
+	uint8_t types;     // 2 bits per arg, see Logger::ArgType
+	uint8_t nargs;
+	uint16_t text_len;
+	uint16_t flags;
+	uint64_t args[MAX_ARGS];
+	char text[TEXT_BYTES];
+};
+static_assert(sizeof(LogRecord) == 128, "LogRecord should stay two cache lines");
+
+// Single producer / single consumer ring, one per logging thread
+class LogRing{
+public:
+	static constexpr uint64_t CAPACITY = 4096; // power of two
+
+	// Rings come from the process arena while it has room
+	static void* operator new(size_t n, std::align_val_t align){
+		void* p = HugeArena::instance().allocate(n, static_cast<size_t>(align));
+		return p ? p : ::operator new(n, align);
+	}
+	static void operator delete(void* p, std::align_val_t align){
+		if(!HugeArena::instance().contains(p)) ::operator delete(p, align);
+	}
+
+	// Producer side: reserve n consecutive slots, nullptr when full
+	LogRecord* claim(uint64_t n){
+		uint64_t head = m_head.load(std::memory_order_relaxed);
+		if(head + n - m_tail_cache > CAPACITY){
+			m_tail_cache = m_tail.load(std::memory_order_acquire);
+			if(head + n - m_tail_cache > CAPACITY) return nullptr;
+		}
+		// Records of one message must not wrap, pad with empty records if needed
+		uint64_t idx = head & (CAPACITY - 1);
+		if(idx + n > CAPACITY){
+			uint64_t pad = CAPACITY - idx;
+			if(head + pad + n - m_tail_cache > CAPACITY) return nullptr;
+			for(uint64_t i = 0; i < pad; i++) m_slots[idx + i].id = static_cast<uint16_t>(LogId::COUNT);
+			m_head.store(head + pad, std::memory_order_release);
+			idx = 0;
+		}
+		return &m_slots[idx];
+	}
+	void publish(uint64_t n){
+		m_head.store(m_head.load(std::memory_order_relaxed) + n, std::memory_order_release);
+	}
+
+	// Consumer side
+	uint64_t available() const { return m_head.load(std::memory_order_acquire) - m_tail.load(std::memory_order_relaxed); }
+	const LogRecord& front(uint64_t offset = 0) const { return m_slots[(m_tail.load(std::memory_order_relaxed) + offset) & (CAPACITY - 1)]; }
+	void pop(uint64_t n){ m_tail.store(m_tail.load(std::memory_order_relaxed) + n, std::memory_order_release); }
+
+	std::atomic<uint64_t> m_dropped{0};
+private:
+	alignas(64) std::atomic<uint64_t> m_head{0};
+	uint64_t m_tail_cache = 0;
+	alignas(64) std::atomic<uint64_t> m_tail{0};
+	alignas(64) LogRecord m_slots[CAPACITY];
+};
+
+// Asynchronous binary logger.
+// Hot path call sites only copy a fixed size record into their thread's ring
+// (tens of nanoseconds, never blocks, drops and counts when the ring is full).
+// A background thread formats the records and writes them to the log file.
+class Logger{
+public:
+	enum ArgType : uint8_t { I64 = 0, U64 = 1, F64 = 2, STR = 3 };
+
+	static Logger& instance();
+
+	// Start the background writer, records logged before start are kept
+	int start(const std::string& path);
+	void stop();
+
+	template<typename... Args>
+	void log(LogId id, Args... args){
+		static_assert(sizeof...(Args) <= LogRecord::MAX_ARGS, "too many log arguments");
+		LogRing* r = ring();
+		LogRecord* rec = r->claim(1);
+		if(!rec){ r->m_dropped.fetch_add(1, std::memory_order_relaxed); return; }
+		fill(rec, id, args...);
+		rec->text_len = 0;
+		rec->flags = 0;
+		r->publish(1);
+	}
+
+	// Same as log() but also copies `text`, spilling into extra records if long
+	template<typename... Args>
+	void log_text(LogId id, std::string_view text, Args... args){
+		static_assert(sizeof...(Args) <= LogRecord::MAX_ARGS, "too many log arguments");
+		uint64_t n = text.empty() ? 1 : (text.size() + LogRecord::TEXT_BYTES - 1) / LogRecord::TEXT_BYTES;
+		if(n > LogRing::CAPACITY / 4) n = LogRing::CAPACITY / 4; // truncate huge dumps
+		LogRing* r = ring();
+		LogRecord* rec = r->claim(n);
+		if(!rec){ r->m_dropped.fetch_add(1, std::memory_order_relaxed); return; }
+		fill(rec, id, args...);
+		size_t off = 0;
+		for(uint64_t i = 0; i < n; i++){
+			size_t len = std::min<size_t>(text.size() - off, LogRecord::TEXT_BYTES);
+			std::memcpy(rec[i].text, text.data() + off, len);
+			rec[i].text_len = static_cast<uint16_t>(len);
+			rec[i].flags = (i + 1 < n) ? LogRecord::CONTINUED : 0;
+			off += len;
+		}
+		r->publish(n);
+	}
+
+	uint64_t dropped();
+private:
+	Logger(); // Constructor
+	~Logger(); // Destructor
+	LogRing* ring();
+	void run();
+	uint64_t drain(LogRing& r);
+	void write_record(const LogRecord& rec, const std::string& text);
+
+	static int64_t now_ns(){
+		timespec ts;
+		clock_gettime(CLOCK_REALTIME, &ts);
+		return ts.tv_sec * 1000000000ll + ts.tv_nsec;
+	}
+
+	template<typename T>
+	static void put_arg(LogRecord* rec, int i, T v){
+		if constexpr (std::is_floating_point<T>::value){
+			double d = v;
+			std::memcpy(&rec->args[i], &d, sizeof(d));
+			rec->types |= F64 << (2 * i);
+		} else if constexpr (std::is_pointer<T>::value){
+			// Only static strings (literals), the pointer is read later
+			rec->args[i] = reinterpret_cast<uint64_t>(static_cast<const char*>(v));
+			rec->types |= STR << (2 * i);
+		} else if constexpr (std::is_signed<T>::value){
+			rec->args[i] = static_cast<uint64_t>(static_cast<int64_t>(v));
+			rec->types |= I64 << (2 * i);
+		} else {
+			rec->args[i] = static_cast<uint64_t>(v);
+			rec->types |= U64 << (2 * i);
+		}
+	}
+
+	template<typename... Args>
+	static void fill(LogRecord* rec, LogId id, Args... args){
+		rec->ts_ns = now_ns();
+		rec->id = static_cast<uint16_t>(id);
+		rec->types = 0;
+		rec->nargs = sizeof...(Args);
+		[[maybe_unused]] int i = 0;
+		(put_arg(rec, i++, args), ...);
+	}
+
+	std::vector<std::unique_ptr<LogRing>> m_rings;
+	std::mutex m_rings_mutex;
+	std::thread m_thread;
+	std::atomic<bool> m_running{false};
+	FILE* m_file = nullptr;
+	std::string m_line;
+};
@@ -0,0 +1,141 @@
+#pragma once
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+// Decimal step of an instrument (tick size / lot size) as mantissa * 10^-decimals,
+// eg. 0.5 -> {5, 1}, 0.0005 -> {5, 4}, 2.5 -> {25, 1}, 10 -> {10, 0}
+struct Scale{
+	int64_t mantissa = 1;
+	uint8_t decimals = 0;
+
+	static Scale from_double(double step){
+		Scale s;
+		if(!(step > 0)) return s;
+		double p = 1;
+		for(uint8_t d = 0; d <= 12; d++, p *= 10){
+			double m = std::round(step * p);
+			if(m >= 1 && std::fabs(step * p - m) < 1e-6 * m){
+				s.mantissa = static_cast<int64_t>(m);
+				s.decimals = d;
+				return s;
+			}
+		}
+		return s;
+	}
+	double step() const { return static_cast<double>(mantissa) / pow10(decimals); }
+	static double pow10(int d){
+		static constexpr double p[] = {1, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12};
+		return p[d];
+	}
+};
+
+// Integer multiples of a Scale step. Price counts ticks and Qty counts lots,
+// distinct types so one can not be passed for the other.
+template<typename Tag>
+struct Steps{
+	int64_t n = 0;
+
+	constexpr Steps() = default;
+	constexpr explicit Steps(int64_t v) : n(v) {}
+
+	enum Round { NEAREST, DOWN, UP };
+	// `v` rounded onto the grid of `s`
+	static Steps from_double(double v, Scale s, Round r = NEAREST){
+		double x = v * Scale::pow10(s.decimals) / static_cast<double>(s.mantissa);
+		// Absorb representation error before directed rounding, 0.3 / 0.1 = 2.9999999999999996
+		double nearest = std::round(x);
+		if(std::fabs(x - nearest) < 1e-9 * (1 + std::fabs(x))) x = nearest;
+		return Steps(static_cast<int64_t>(r == NEAREST ? nearest : (r == DOWN ? std::floor(x) : std::ceil(x))));
+	}
+	double to_double(Scale s) const { return static_cast<double>(n * s.mantissa) / Scale::pow10(s.decimals); }
+
+	constexpr Steps operator+(Steps o) const { return Steps(n + o.n); }
+	constexpr Steps operator-(Steps o) const { return Steps(n - o.n); }
+	constexpr Steps operator-() const { return Steps(-n); }
+	constexpr Steps operator*(int64_t k) const { return Steps(n * k); }
+	Steps& operator+=(Steps o){ n += o.n; return *this; }
+	Steps& operator-=(Steps o){ n -= o.n; return *this; }
+	constexpr bool operator==(Steps o) const { return n == o.n; }
+	constexpr bool operator!=(Steps o) const { return n != o.n; }
+	constexpr bool operator<(Steps o) const { return n < o.n; }
+	constexpr bool operator<=(Steps o) const { return n <= o.n; }
+	constexpr bool operator>(Steps o) const { return n > o.n; }
+	constexpr bool operator>=(Steps o) const { return n >= o.n; }
+};
+using Price = Steps<struct PriceTag>;
+using Qty = Steps<struct QtyTag>;
+
+// Writes `n` steps of `s` as a plain decimal ("65432.5", "0.0015", "-10") into
+// [first, last), to_chars style: returns one past the last char, nullptr when
+// it does not fit. Trailing fractional zeros are dropped.
+inline char* format_decimal(char* first, char* last, int64_t n, Scale s){
+	char buf[32];
+	char* end = buf + sizeof(buf);
+	char* p = end;
+	bool neg = n < 0;
+	uint64_t v = neg ? 0 - static_cast<uint64_t>(n) : static_cast<uint64_t>(n);
+	v *= static_cast<uint64_t>(s.mantissa);
+
+	int decimals = s.decimals;
+	while(decimals > 0 && v % 10 == 0){
+		v /= 10;
+		decimals--;
+	}
+	for(int i = 0; i < decimals; i++){
+		*--p = static_cast<char>('0' + v % 10);
+		v /= 10;
+	}
+	if(decimals > 0) *--p = '.';
+	do {
+		*--p = static_cast<char>('0' + v % 10);
+		v /= 10;
+	} while(v);
+	if(neg) *--p = '-';
+
+	size_t len = static_cast<size_t>(end - p);
+	if(static_cast<size_t>(last - first) < len) return nullptr;
+	std::memcpy(first, p, len);
+	return first + len;
+}
+template<typename Tag>
+inline char* format_decimal(char* first, char* last, Steps<Tag> v, Scale s){
+	return format_decimal(first, last, v.n, s);
+}
+
+// Exact parse of a plain decimal in [first, last) into steps of `s`.
+// Returns 0 on success, 1 on malformed input or a value off the step grid.
+inline int parse_decimal(const char* first, const char* last, Scale s, int64_t& out){
+	const char* p = first;
+	bool neg = p != last && *p == '-';
+	if(neg || (p != last && *p == '+')) p++;
+	uint64_t units = 0;
+	int frac = -1, digits = 0, significant = 0;
+	for(; p != last; p++){
+		if(*p == '.' && frac < 0){
+			frac = 0;
+			continue;
+		}
+		if(*p < '0' || *p > '9') return 1;
+		if(frac >= 0){
+			// Zeros past the scale do not change the value, anything else is off grid
+			if(frac >= s.decimals){
+				if(*p != '0') return 1;
+				continue;
+			}
+			frac++;
+		}
+		digits++;
+		if((units || *p != '0') && ++significant > 18) return 1;
+		units = units * 10 + static_cast<uint64_t>(*p - '0');
+	}
+	if(digits == 0) return 1;
+	// Scaled up to the grid the value still has to fit 18 digits
+	int pad = s.decimals - (frac < 0 ? 0 : frac);
+	if(units && significant + pad > 18) return 1;
+	for(int i = 0; i < pad; i++) units *= 10;
+	if(units % static_cast<uint64_t>(s.mantissa)) return 1;
+	int64_t steps = static_cast<int64_t>(units / static_cast<uint64_t>(s.mantissa));
+	out = neg ? -steps : steps;
+	return 0;
+}
@@ -0,0 +1,73 @@
+#include "ResponseCache.hpp"
+
+// Constructor
+ResponseCache::ResponseCache(size_t capacity) : m_capacity(capacity ? capacity : 1) {}
+
+void ResponseCache::set_ttl(const std::string& method, int64_t ttl_ms){
+	m_ttl[method] = ttl_ms;
+}
+
+[[nodiscard]] int64_t ResponseCache::ttl(std::string_view method) const{
+	if(method.empty()) return 0;
+	auto it = m_ttl.find(std::string(method));
+	return it == m_ttl.end() ? 0 : it->second;
+}
+
+// Handles both compact and pretty printed requests: "method": "public/..."
+std::string_view ResponseCache::method_of(const std::string& request){
+	size_t at = request.find("\"method\"");
+	if(at == std::string::npos) return {};
+	size_t begin = request.find('"', request.find(':', at) + 1);
+	if(begin == std::string::npos) return {};
+	size_t end = request.find('"', begin + 1);
+	if(end == std::string::npos) return {};
+	return std::string_view(request).substr(begin + 1, end - begin - 1);
+}
+
+int ResponseCache::get(const std::string& request, int64_t now_ms, std::string& out){
+	auto it = m_index.find(request);
+	if(it == m_index.end()){
+		m_stats.misses++;
+		return 1;
+	}
+	List::iterator e = it->second;
+	if(now_ms >= e->expires_ms){
+		m_stats.misses++;
+		m_stats.expired++;
+		m_index.erase(it);
+		m_entries.erase(e);
+		return 1;
+	}
+	m_entries.splice(m_entries.begin(), m_entries, e);
+	int64_t age = now_ms - e->stored_ms;
+	m_stats.hits++;
+	m_stats.total_age_ms += age;
+	if(age > m_stats.max_age_ms) m_stats.max_age_ms = age;
+	out = e->reply;
+	return 0;
+}
+
+void ResponseCache::put(const std::string& request, const std::string& reply, int64_t now_ms, int64_t ttl_ms){
+	if(ttl_ms <= 0) return;
+	auto it = m_index.find(request);
+	if(it != m_index.end()){
+		List::iterator e = it->second;
+		e->reply = reply;
+		e->stored_ms = now_ms;
+		e->expires_ms = now_ms + ttl_ms;
+		m_entries.splice(m_entries.begin(), m_entries, e);
+		return;
+	}
+	if(m_entries.size() >= m_capacity){
+		m_index.erase(m_entries.back().request);
+		m_entries.pop_back();
+		m_stats.evictions++;
+	}
+	m_entries.push_front(Entry{request, reply, now_ms, now_ms + ttl_ms});
+	m_index.emplace(m_entries.front().request, m_entries.begin());
+}
+
+void ResponseCache::clear(){
+	m_index.clear();
+	m_entries.clear();
+}
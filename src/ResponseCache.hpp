@@ -0,0 +1,55 @@
+#pragma once
+#include <cstdint>
+#include <list>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+
+// LRU cache of replies to idempotent public requests, each entry expiring
+// after the TTL of its method. Keyed on the full request text, so equal
+// requests (same method, params and id) share an entry.
+// Not thread safe, the Api serializes requests.
+class ResponseCache{
+public:
+	struct Stats{
+		uint64_t hits = 0;
+		uint64_t misses = 0;
+		uint64_t expired = 0;   // misses on an entry past its TTL
+		uint64_t evictions = 0; // entries dropped for capacity
+		int64_t max_age_ms = 0; // oldest reply served from the cache
+		int64_t total_age_ms = 0;
+	};
+
+	// Constructor
+	explicit ResponseCache(size_t capacity = 256);
+
+	// TTL of replies to `method`, 0 (the default) disables caching it
+	void set_ttl(const std::string& method, int64_t ttl_ms);
+	[[nodiscard]] int64_t ttl(std::string_view method) const;
+
+	// Copies the cached reply to `out`, returns 0 on a fresh hit
+	int get(const std::string& request, int64_t now_ms, std::string& out);
+	void put(const std::string& request, const std::string& reply, int64_t now_ms, int64_t ttl_ms);
+	void clear();
+
+	const Stats& stats() const { return m_stats; }
+	size_t size() const { return m_entries.size(); }
+
+	// "method" of a JSON-RPC request, empty when not found
+	static std::string_view method_of(const std::string& request);
+private:
+	struct Entry{
+		std::string request;
+		std::string reply;
+		int64_t stored_ms;
+		int64_t expires_ms;
+	};
+	using List = std::list<Entry>;
+
+	size_t m_capacity;
+	List m_entries; // most recently used first
+	std::unordered_map<std::string_view, List::iterator> m_index; // views into Entry::request
+	std::unordered_map<std::string, int64_t> m_ttl;
+	Stats m_stats;
+};
@@ -0,0 +1,84 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+// Single producer / single consumer ring of variable length messages, laid
+// out for shared memory (no pointers, fixed size, lock free positions).
+//
+// Messages take whole 64 byte cells: a 16 byte header then the payload.
+// A message never wraps; when it does not fit before the end the producer
+// writes a padding header and starts again at cell 0.
+template<size_t BYTES>
+struct ShmRing{
+	static constexpr size_t CELL = 64;
+	static constexpr uint64_t CELLS = BYTES / CELL;
+	static_assert(BYTES % CELL == 0 && (CELLS & (CELLS - 1)) == 0, "ring size must be a power of two number of cells");
+	static constexpr uint32_t PAD = UINT32_MAX;
+
+	struct Header{
+		uint32_t len;
+		uint32_t flags;
+		uint64_t tag;
+	};
+	static constexpr size_t MAX_PAYLOAD = BYTES / 2 - sizeof(Header);
+
+	alignas(64) std::atomic<uint64_t> head; // cells written, producer only
+	alignas(64) std::atomic<uint64_t> tail; // cells consumed, consumer only
+	alignas(64) char data[BYTES];
+
+	void reset(){
+		head.store(0, std::memory_order_relaxed);
+		tail.store(0, std::memory_order_relaxed);
+	}
+
+	static uint64_t cells(size_t len){ return (sizeof(Header) + len + CELL - 1) / CELL; }
+
+	// Producer, returns 1 when the ring is too full (or the message too large)
+	int write(uint64_t tag, uint32_t flags, const char* msg, size_t len){
+		if(len > MAX_PAYLOAD) return 1;
+		uint64_t h = head.load(std::memory_order_relaxed);
+		uint64_t n = cells(len);
+		uint64_t at = h & (CELLS - 1);
+		uint64_t pad = (at + n > CELLS) ? CELLS - at : 0;
+		if(h + pad + n - tail.load(std::memory_order_acquire) > CELLS) return 1;
+		if(pad){
+			Header* p = reinterpret_cast<Header*>(data + at * CELL);
+			p->len = PAD;
+			h += pad;
+			at = 0;
+		}
+		Header* hd = reinterpret_cast<Header*>(data + at * CELL);
+		hd->len = static_cast<uint32_t>(len);
+		hd->flags = flags;
+		hd->tag = tag;
+		std::memcpy(hd + 1, msg, len);
+		head.store(h + n, std::memory_order_release);
+		return 0;
+	}
+
+	// Consumer, returns 1 when empty
+	int read(uint64_t& tag, uint32_t& flags, std::string& out){
+		uint64_t t = tail.load(std::memory_order_relaxed);
+		uint64_t h = head.load(std::memory_order_acquire);
+		while(t != h){
+			uint64_t at = t & (CELLS - 1);
+			const Header* hd = reinterpret_cast<const Header*>(data + at * CELL);
+			if(hd->len == PAD){
+				t += CELLS - at;
+				continue;
+			}
+			tag = hd->tag;
+			flags = hd->flags;
+			out.assign(reinterpret_cast<const char*>(hd + 1), hd->len);
+			tail.store(t + cells(hd->len), std::memory_order_release);
+			return 0;
+		}
+		return 1;
+	}
+
+	bool empty() const{
+		return head.load(std::memory_order_acquire) == tail.load(std::memory_order_relaxed);
+	}
+};
@@ -0,0 +1,306 @@
+#include "SimSocket.hpp"
+#include "utility.hpp"
+#include <algorithm>
+#include <charconv>
+#include <thread>
+
+// Constructor
+SimSocket::SimSocket() : SimSocket(Options()) {}
+
+SimSocket::SimSocket(Options options) : m_options(options) {
+	m_fills.reserve(256);
+}
+
+// Destructor
+SimSocket::~SimSocket() {}
+
+uint32_t SimSocket::add_instrument(const std::string& name, double tick_size, double contract_size){
+	auto it = m_names.find(name);
+	if(it != m_names.end()) return it->second;
+	uint32_t index = static_cast<uint32_t>(m_books.size());
+	m_books.emplace_back(new Book(m_options.queue));
+	Book& b = *m_books.back();
+	b.name = name;
+	b.price_scale = Scale::from_double(tick_size);
+	b.qty_scale = Scale::from_double(contract_size);
+	b.engine.on_fill([this, index](const MatchingEngine::Fill& f){ m_fills.push_back(Pending{index, f}); });
+	m_names[name] = index;
+	return index;
+}
+
+void SimSocket::set_feed(Feed feed){
+	m_feed = std::move(feed);
+	m_has_next = false;
+	m_virtual = true;
+}
+
+int64_t SimSocket::now_ns() const{
+	return m_virtual ? m_clock_ns : now_us() * 1000;
+}
+
+size_t SimSocket::run_until(int64_t ts_ns){
+	size_t n = 0;
+	while(m_feed){
+		if(!m_has_next){
+			if(m_feed(m_next)){
+				m_feed = nullptr;
+				break;
+			}
+			m_has_next = true;
+		}
+		if(m_next.ts_ns > ts_ns) break;
+		m_clock_ns = std::max(m_clock_ns, m_next.ts_ns);
+		m_has_next = false;
+		apply(m_next);
+		n++;
+	}
+	m_clock_ns = std::max(m_clock_ns, ts_ns);
+	return n;
+}
+
+void SimSocket::travel(){
+	if(m_virtual) run_until(m_clock_ns + m_options.latency_us * 1000);
+	else if(m_options.latency_us > 0) std::this_thread::sleep_for(std::chrono::microseconds(m_options.latency_us));
+}
+
+void SimSocket::apply(const MarketEvent& e){
+	if(e.instrument >= m_books.size()) return;
+	Book& b = *m_books[e.instrument];
+	int64_t price = Price::from_double(e.price, b.price_scale).n;
+	int64_t qty = Qty::from_double(e.amount, b.qty_scale).n;
+	if(e.type == MarketEvent::LEVEL) b.engine.set_level(e.side, price, qty);
+	else b.engine.trade(e.side, price, qty);
+	settle(nullptr, "");
+}
+
+std::string SimSocket::order_id(uint32_t instrument, uint64_t id) const{
+	return "SIM" + std::to_string(instrument) + "-" + std::to_string(id);
+}
+
+int SimSocket::parse_order_id(const std::string& order_id, uint32_t& instrument, uint64_t& id) const{
+	if(order_id.rfind("SIM", 0) != 0) return 1;
+	const char* end = order_id.data() + order_id.size();
+	auto [dash, ec] = std::from_chars(order_id.data() + 3, end, instrument);
+	if(ec != std::errc() || dash == end || *dash != '-' || instrument >= m_books.size()) return 1;
+	auto [last, ec2] = std::from_chars(dash + 1, end, id);
+	return ec2 != std::errc() || last != end ? 1 : 0;
+}
+
+nlohmann::json SimSocket::order_json(const std::string& order_id, const Live& o) const{
+	const Book& b = *m_books[o.instrument];
+	bool market = o.price == MatchingEngine::MARKET_BUY || o.price == MatchingEngine::MARKET_SELL;
+	nlohmann::json out;
+	out["order_id"] = order_id;
+	out["instrument_name"] = b.name;
+	out["direction"] = o.side == MatchingEngine::BUY ? "buy" : "sell";
+	if(market) out["price"] = "market_price";
+	else out["price"] = Price(o.price).to_double(b.price_scale);
+	out["amount"] = Qty(o.amount).to_double(b.qty_scale);
+	out["filled_amount"] = Qty(o.filled).to_double(b.qty_scale);
+	out["order_state"] = o.state;
+	out["order_type"] = market ? "market" : "limit";
+	out["post_only"] = o.post_only;
+	out["label"] = o.label;
+	out["creation_timestamp"] = o.created_ms;
+	out["last_update_timestamp"] = o.updated_ms;
+	return out;
+}
+
+void SimSocket::settle(nlohmann::json* trades, const std::string& keep){
+	if(m_fills.empty()) return;
+	int64_t now = time_ms();
+	nlohmann::json data = nlohmann::json::array();
+	for(const Pending& p : m_fills){
+		const MatchingEngine::Fill& f = p.fill;
+		Book& b = *m_books[p.instrument];
+		for(int taker = 0; taker < 2; taker++){
+			if((taker ? f.taker_owner : f.maker_owner) != OWNER) continue;
+			std::string oid = order_id(p.instrument, taker ? f.taker : f.maker);
+			auto it = m_live.find(oid);
+			if(it == m_live.end()) continue;
+			Live& o = it->second;
+			o.filled += f.qty;
+			o.updated_ms = now;
+			if(o.filled >= o.amount) o.state = "filled";
+			MatchingEngine::Side side = taker ? f.taker_side : (f.taker_side == MatchingEngine::BUY ? MatchingEngine::SELL : MatchingEngine::BUY);
+			nlohmann::json t;
+			t["trade_seq"] = ++b.trade_seq;
+			t["trade_id"] = "SIM-" + std::to_string(++m_trade_id);
+			t["timestamp"] = now;
+			t["instrument_name"] = b.name;
+			t["order_id"] = oid;
+			t["direction"] = side == MatchingEngine::BUY ? "buy" : "sell";
+			t["price"] = Price(f.price).to_double(b.price_scale);
+			t["amount"] = Qty(f.qty).to_double(b.qty_scale);
+			t["fee"] = 0.0;
+			t["liquidity"] = taker ? "T" : "M";
+			t["state"] = o.state;
+			t["label"] = o.label;
+			if(taker && trades) trades->push_back(t);
+			data.push_back(std::move(t));
+			// The order being answered is dropped by its caller once the reply is built
+			if(o.filled >= o.amount && oid != keep) m_live.erase(it);
+		}
+	}
+	m_fills.clear();
+	if(!data.empty() && m_on_notification){
+		nlohmann::json n;
+		n["jsonrpc"] = "2.0";
+		n["method"] = "subscription";
+		n["params"]["channel"] = "user.trades.any.any.raw";
+		n["params"]["data"] = std::move(data);
+		m_on_notification(n.dump());
+	}
+}
+
+static nlohmann::json error_json(int code, const char* message){
+	return nlohmann::json{{"code", code}, {"message", message}};
+}
+
+nlohmann::json SimSocket::place(const nlohmann::json& params, MatchingEngine::Side side, nlohmann::json& error){
+	auto name = params.find("instrument_name");
+	auto amount = params.find("amount");
+	auto found = name != params.end() && name->is_string() ? m_names.find(name->get<std::string>()) : m_names.end();
+	if(found == m_names.end() || amount == params.end() || !amount->is_number()){
+		error = error_json(-32602, "Invalid params");
+		return nullptr;
+	}
+	uint32_t instrument = found->second;
+	Book& b = *m_books[instrument];
+	int64_t lots = Qty::from_double(amount->get<double>(), b.qty_scale).n;
+	if(lots <= 0 || std::fabs(Qty(lots).to_double(b.qty_scale) - amount->get<double>()) > 1e-9 * amount->get<double>()){
+		error = error_json(-32602, "Invalid params");
+		return nullptr;
+	}
+	uint8_t flags = 0;
+	int64_t price;
+	if(params.value("type", "limit") == "market"){
+		price = side == MatchingEngine::BUY ? MatchingEngine::MARKET_BUY : MatchingEngine::MARKET_SELL;
+		flags |= MatchingEngine::IOC;
+	} else {
+		auto p = params.find("price");
+		if(p == params.end() || !p->is_number()){
+			error = error_json(-32602, "Invalid params");
+			return nullptr;
+		}
+		price = Price::from_double(p->get<double>(), b.price_scale).n;
+	}
+	bool post_only = params.value("post_only", false);
+	if(post_only) flags |= MatchingEngine::POST_ONLY;
+	if(params.value("reject_post_only", false)) flags |= MatchingEngine::REJECT_POST_ONLY;
+	if(params.value("time_in_force", "") == "immediate_or_cancel") flags |= MatchingEngine::IOC;
+
+	MatchingEngine::Result r = b.engine.submit(side, price, lots, OWNER, flags);
+	if(r.status == MatchingEngine::REJECTED_POST_ONLY){
+		error = error_json(11054, "post_only_reject");
+		return nullptr;
+	}
+	int64_t now = time_ms();
+	std::string oid = order_id(instrument, r.id);
+	Live live{instrument, side, r.open ? r.price : price, lots, 0, now, now, post_only, params.value("label", "")};
+	Live& o = m_live.emplace(oid, std::move(live)).first->second;
+	nlohmann::json trades = nlohmann::json::array();
+	settle(&trades, oid);
+	if(o.filled < o.amount && (flags & MatchingEngine::IOC)) o.state = "cancelled";
+	nlohmann::json result;
+	result["order"] = order_json(oid, o);
+	result["trades"] = std::move(trades);
+	if(o.filled >= o.amount || (flags & MatchingEngine::IOC)) m_live.erase(oid);
+	return result;
+}
+
+nlohmann::json SimSocket::edit(const nlohmann::json& params, nlohmann::json& error){
+	std::string oid = params.value("order_id", "");
+	uint32_t instrument;
+	uint64_t id;
+	auto it = m_live.find(oid);
+	if(it == m_live.end() || parse_order_id(oid, instrument, id)){
+		error = error_json(11044, "not_open_order");
+		return nullptr;
+	}
+	Book& b = *m_books[instrument];
+	Live& o = it->second;
+	auto amount = params.find("amount");
+	auto p = params.find("price");
+	int64_t lots = amount != params.end() && amount->is_number() ? Qty::from_double(amount->get<double>(), b.qty_scale).n : o.amount;
+	int64_t price = p != params.end() && p->is_number() ? Price::from_double(p->get<double>(), b.price_scale).n : o.price;
+	MatchingEngine::Result r = b.engine.edit(id, price, lots);
+	if(r.status == MatchingEngine::REJECTED_POST_ONLY){
+		error = error_json(11054, "post_only_reject");
+		return nullptr;
+	}
+	if(r.status != MatchingEngine::OK){
+		error = error_json(-32602, "Invalid params");
+		return nullptr;
+	}
+	o.amount = lots;
+	o.price = r.open ? r.price : price;
+	o.updated_ms = time_ms();
+	nlohmann::json trades = nlohmann::json::array();
+	settle(&trades, oid);
+	nlohmann::json result;
+	result["order"] = order_json(oid, o);
+	result["trades"] = std::move(trades);
+	if(o.filled >= o.amount) m_live.erase(oid);
+	return result;
+}
+
+nlohmann::json SimSocket::cancel(const nlohmann::json& params, nlohmann::json& error){
+	std::string oid = params.value("order_id", "");
+	uint32_t instrument;
+	uint64_t id;
+	auto it = m_live.find(oid);
+	if(it == m_live.end() || parse_order_id(oid, instrument, id)){
+		error = error_json(11044, "not_open_order");
+		return nullptr;
+	}
+	m_books[instrument]->engine.cancel(id);
+	it->second.state = "cancelled";
+	it->second.updated_ms = time_ms();
+	nlohmann::json result = order_json(oid, it->second);
+	m_live.erase(it);
+	return result;
+}
+
+[[nodiscard]] std::pair<int, std::string> SimSocket::ws_request(const std::string& msg){
+	nlohmann::json obj = nlohmann::json::parse(msg, nullptr, false);
+	if(!obj.is_object()) return std::make_pair(1, std::string("invalid request"));
+	const std::string method = obj.value("method", "");
+	nlohmann::json params = obj.value("params", nlohmann::json::object());
+	nlohmann::json result, error;
+
+	// On its way to the exchange
+	travel();
+	if(method == "public/auth"){
+		result = {{"access_token", "sim"}, {"refresh_token", "sim"}, {"expires_in", 31536000},
+			{"scope", "session:sim"}, {"token_type", "bearer"}};
+	} else if(method == "public/get_time"){
+		result = time_ms();
+	} else if(method == "private/buy" || method == "private/sell"){
+		result = place(params, method == "private/buy" ? MatchingEngine::BUY : MatchingEngine::SELL, error);
+	} else if(method == "private/edit"){
+		result = edit(params, error);
+	} else if(method == "private/cancel"){
+		result = cancel(params, error);
+	} else if(method == "private/get_open_orders" || method == "private/get_open_orders_by_instrument"){
+		std::string name = params.value("instrument_name", "");
+		result = nlohmann::json::array();
+		for(const auto& [oid, o] : m_live){
+			if(name.empty() || m_books[o.instrument]->name == name) result.push_back(order_json(oid, o));
+		}
+	} else if(method.ends_with("/subscribe") || method.ends_with("/unsubscribe")){
+		result = params.value("channels", nlohmann::json::array());
+	} else {
+		error = error_json(-32601, "Method not found");
+	}
+	// and back
+	travel();
+
+	nlohmann::json reply;
+	reply["jsonrpc"] = "2.0";
+	reply["id"] = obj.value("id", nlohmann::json());
+	if(!error.is_null()) reply["error"] = std::move(error);
+	else reply["result"] = std::move(result);
+	reply["testnet"] = true;
+	return std::make_pair(0, reply.dump());
+}
@@ -0,0 +1,113 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <nlohmann/json.hpp>
+#include "Socket.hpp"
+#include "Price.hpp"
+#include "oms/MatchingEngine.hpp"
+
+// Exchange simulator behind the Socket interface, for backtests and for
+// running the order path without test.deribit.com.
+//
+// private/buy, sell, edit, cancel and get_open_orders run against a
+// MatchingEngine per instrument, public/auth, public/get_time and the
+// subscribe methods answer like the exchange. Every fill of ours is pushed
+// as a user.trades.any.any.raw notification, taker fills also come back in
+// the reply. Market data is pulled from a feed: with one set the clock is
+// virtual and moves with the feed, a request reaches the engine
+// `latency_us` after it was sent, after every market event up to then, and
+// its reply arrives `latency_us` later. Without a feed the clock is the
+// host's and a request waits out the latency both ways.
+class SimSocket: public Socket{
+public:
+	struct Options{
+		int64_t latency_us = 0; // one way
+		MatchingEngine::QueueModel queue = MatchingEngine::BACK;
+	};
+	struct MarketEvent{
+		enum Type : uint8_t { LEVEL, TRADE };
+		int64_t ts_ns = 0;
+		uint32_t instrument = 0;  // from add_instrument()
+		Type type = LEVEL;
+		MatchingEngine::Side side = MatchingEngine::BUY; // book side, or the aggressor of a trade
+		double price = 0;
+		double amount = 0;        // depth now at the price, or traded
+	};
+	// 0 and fills the next event, 1 at the end of the data
+	using Feed = std::function<int(MarketEvent&)>;
+
+	// Constructor
+	SimSocket();
+	explicit SimSocket(Options options);
+	~SimSocket(); // Destructor
+
+	// Returns the index market events refer to the instrument by
+	uint32_t add_instrument(const std::string& name, double tick_size, double contract_size);
+	MatchingEngine& engine(uint32_t instrument){ return m_books[instrument]->engine; }
+	void set_feed(Feed feed);
+	// Applies the feed's events up to `ts_ns` and moves the clock there, returns how many
+	size_t run_until(int64_t ts_ns);
+	int64_t now_ns() const;
+
+	void switch_to_ws() override {}
+	[[nodiscard]] std::pair<int, std::string> ws_request(const std::string& msg) override;
+private:
+	static constexpr uint32_t OWNER = 1; // our orders in the engines, the market is 0
+	struct Book{
+		std::string name;
+		Scale price_scale;
+		Scale qty_scale;
+		MatchingEngine engine;
+		uint64_t trade_seq = 0;
+		Book(MatchingEngine::QueueModel queue) : engine(queue) {}
+	};
+	// One of our orders, open or filled by the request being answered
+	struct Live{
+		uint32_t instrument;
+		MatchingEngine::Side side;
+		int64_t price;            // ticks
+		int64_t amount;           // lots, in total
+		int64_t filled = 0;
+		int64_t created_ms;
+		int64_t updated_ms;
+		bool post_only;
+		std::string label;
+		const char* state = "open";
+	};
+	struct Pending{
+		uint32_t instrument;
+		MatchingEngine::Fill fill;
+	};
+
+	// Moves the clock by a one way latency
+	void travel();
+	void apply(const MarketEvent& e);
+	// Turns the fills the engines reported into our orders' state and
+	// notifications, taker trades also into `trades`. Filled orders are
+	// dropped, but for `keep` which the reply still has to show
+	void settle(nlohmann::json* trades, const std::string& keep);
+	nlohmann::json order_json(const std::string& order_id, const Live& o) const;
+	std::string order_id(uint32_t instrument, uint64_t id) const;
+	// 0 and the engine order id of "SIM<instrument>-<id>"
+	int parse_order_id(const std::string& order_id, uint32_t& instrument, uint64_t& id) const;
+	nlohmann::json place(const nlohmann::json& params, MatchingEngine::Side side, nlohmann::json& error);
+	nlohmann::json edit(const nlohmann::json& params, nlohmann::json& error);
+	nlohmann::json cancel(const nlohmann::json& params, nlohmann::json& error);
+	int64_t time_ms() const { return now_ns() / 1000000; }
+
+	Options m_options;
+	std::vector<std::unique_ptr<Book>> m_books;
+	std::unordered_map<std::string, uint32_t> m_names;
+	std::unordered_map<std::string, Live> m_live; // by order id
+	std::vector<Pending> m_fills;
+	Feed m_feed;
+	MarketEvent m_next;
+	bool m_has_next = false;
+	bool m_virtual = false;   // a feed was set, the clock stays virtual after it ran out
+	int64_t m_clock_ns = 0;
+	uint64_t m_trade_id = 0;
+};
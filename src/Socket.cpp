@@ -1,3 +1,78 @@
 #include "Socket.hpp"
+#include <charconv>
 
 Socket::~Socket() {}
+
+void Socket::set_notification_handler(std::function<void(const std::string&)> handler){
+	m_on_notification = std::move(handler);
+}
+
+static bool blank(char c){
+	return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+// Offset and length of the first "id" key's value, npos when there is none.
+// Deribit puts it ahead of the result, requests carry no other "id" key
+static size_t id_value(std::string_view msg, size_t& len){
+	size_t pos = 0;
+	while((pos = msg.find("\"id\"", pos)) != std::string_view::npos){
+		pos += 4;
+		while(pos < msg.size() && blank(msg[pos])) pos++;
+		if(pos == msg.size() || msg[pos] != ':') continue;
+		pos++;
+		while(pos < msg.size() && blank(msg[pos])) pos++;
+		size_t end = pos;
+		if(end < msg.size() && msg[end] == '"'){
+			end = msg.find('"', end + 1);
+			if(end == std::string_view::npos) return end;
+			end++;
+		} else{
+			while(end < msg.size() && msg[end] != ',' && msg[end] != '}' && !blank(msg[end])) end++;
+		}
+		len = end - pos;
+		return pos;
+	}
+	return std::string_view::npos;
+}
+
+void Socket::tag_request(const std::string& msg, uint64_t tag, std::string& out, std::string& id){
+	char digits[24];
+	char* last = std::to_chars(digits, digits + sizeof(digits), tag).ptr;
+	size_t len = 0;
+	size_t pos = id_value(msg, len);
+	if(pos == std::string::npos){
+		// Goes in right after the opening brace
+		id.assign("null");
+		pos = msg.find('{');
+		if(pos == std::string::npos){
+			out.assign(msg);
+			return;
+		}
+		out.assign(msg, 0, pos + 1);
+		out.append("\"id\":");
+		out.append(digits, last);
+		out.push_back(',');
+		out.append(msg, pos + 1, std::string::npos);
+		return;
+	}
+	id.assign(msg, pos, len);
+	out.assign(msg, 0, pos);
+	out.append(digits, last);
+	out.append(msg, pos + len, std::string::npos);
+}
+
+uint64_t Socket::reply_tag(std::string_view reply){
+	size_t len = 0;
+	size_t pos = id_value(reply, len);
+	uint64_t tag = 0;
+	if(pos == std::string_view::npos) return 0;
+	const char* last = reply.data() + pos + len;
+	std::from_chars_result r = std::from_chars(reply.data() + pos, last, tag);
+	return r.ec == std::errc() && r.ptr == last ? tag : 0;
+}
+
+void Socket::untag_reply(std::string& reply, const std::string& id){
+	size_t len = 0;
+	size_t pos = id_value(reply, len);
+	if(pos != std::string::npos) reply.replace(pos, len, id);
+}
@@ -1,14 +1,44 @@
 #pragma once
+#include <cstdint>
 #include <utility>
 #include <memory>
 #include <string>
+#include <string_view>
+#include <functional>
 
 class Socket{
 public:
 	virtual ~Socket();
 	virtual void switch_to_ws() = 0;
 	[[nodiscard]] virtual std::pair<int, std::string> ws_request(const std::string& msg) = 0;
+	// Subscription notifications are handed to this handler instead of being
+	// returned as the reply of the next ws_request. Set it before subscribing.
+	virtual void set_notification_handler(std::function<void(const std::string&)> handler);
+	// Hands notifications that arrived since the last request to the handler
+	// without blocking. Sockets with a reader thread deliver on their own and
+	// do nothing here; those that only read inside ws_request (BSocket,
+	// USocket) need it called while no request is made
+	virtual void poll() {}
+	// A ws_request without a reply after this long returns [1, "request timed out"]
+	void set_request_timeout(int64_t ms){ m_timeout_ms = ms; }
+
+	// Deribit pushes {"jsonrpc":"2.0","method":"subscription",...}, replies carry no method
+	static bool is_notification(const std::string& msg){
+		return std::string_view(msg).substr(0, 64).find("\"method\":\"subscription\"") != std::string_view::npos;
+	}
+
+	// Callers reuse ids, so a socket that can be left with replies of
+	// requests it gave up on sends each request under a tag of its own.
+	// `out` is `msg` with the top level "id" set to `tag`, `id` the caller's
+	// id as written ("null" when there was none)
+	static void tag_request(const std::string& msg, uint64_t tag, std::string& out, std::string& id);
+	// Tag of a reply, 0 when its id is not one
+	static uint64_t reply_tag(std::string_view reply);
+	// Puts the caller's id back in place of the tag
+	static void untag_reply(std::string& reply, const std::string& id);
 protected:
 	const std::string host = "test.deribit.com";
 	const std::string port = "443";
+	std::function<void(const std::string&)> m_on_notification;
+	int64_t m_timeout_ms = 10000;
 };
@@ -10,7 +10,7 @@ static context_ptr on_tls_init() {
                          boost::asio::ssl::context::no_sslv3 |
                          boost::asio::ssl::context::single_dh_use);
     } catch (std::exception &e) {
-        std::cout << "Error in context pointer: " << e.what() << std::endl;
+        Logger::instance().log_text(LogId::SOCKET_ERROR, e.what(), "TLS context");
     }
     return ctx;
 }
@@ -22,19 +22,24 @@ Socketpp::~Socketpp(){
 		websocketpp::lib::error_code ec;
     		auto metadata = con_metadata;
     		m_endpoint.stop_perpetual();
+		// A pending tick would keep the client thread running
+		boost::asio::post(m_endpoint.get_io_service(), [this](){
+			m_stopping = true;
+			m_tick -> cancel();
+		});
 		m_ws -> join();
 		m_endpoint.close(metadata -> m_hdl, websocketpp::close::status::normal, "", ec);
     		if (ec) {
-        		std::cout << "> Error initiating close: " << ec.message() << '\n';
+        		Logger::instance().log_text(LogId::SOCKET_ERROR, ec.message(), "Initiating close");
     			return;
 		}
 	} catch (const std::exception& e) {
-    		std::cerr << "Error during WebSocket close: " << e.what() << '\n';
+    		Logger::instance().log_text(LogId::SOCKET_ERROR, e.what(), "WebSocket close");
 	}
 }
 
 // Constructor
-Socketpp::Socketpp(){
+Socketpp::Socketpp(WaitStrategy::Mode wait) : m_wait_mode(wait) {
         m_endpoint.clear_access_channels(websocketpp::log::alevel::all);
         m_endpoint.clear_error_channels(websocketpp::log::elevel::all);
  	m_endpoint.clear_access_channels(websocketpp::log::alevel::frame_payload);
@@ -42,33 +47,109 @@ Socketpp::Socketpp(){
 	m_endpoint.init_asio();
  	m_endpoint.set_tls_init_handler(bind(&on_tls_init));
         m_endpoint.start_perpetual();
+	m_tick.reset(new boost::asio::steady_timer(m_endpoint.get_io_service()));
  
         m_ws.reset(new websocketpp::lib::thread(&client::run, &m_endpoint));
-        std::cout << "Socketpp Intialized!\n";
+        Logger::instance().log(LogId::SOCKET_INIT, "Socketpp");
 }
 
 [[nodiscard]] std::pair<int, std::string> Socketpp::ws_request(const std::string& message){
+    	auto metadata = con_metadata;
+	uint64_t deadline;
+	bool arm;
+	{
+		std::lock_guard<std::mutex> lock(m_timers_mutex);
+		int64_t at = mono_ns() + m_timeout_ms * 1000000;
+		deadline = m_timers.schedule(at, on_deadline, metadata.get());
+		// Only when the tick is idle or due after this deadline, usually not
+		arm = m_armed_ns < 0 || at < m_armed_ns;
+		if(arm) m_armed_ns = at;
+	}
+	if(arm) boost::asio::post(m_endpoint.get_io_service(), [this](){ arm_tick(); });
+
+	// Only the reply carrying this tag is queued
+	uint64_t tag = ++m_next_tag;
+	tag_request(message, tag, m_tagged, m_caller_id);
+	{
+		std::lock_guard<std::mutex> lock(metadata -> m_mutex);
+		metadata -> m_tag = tag;
+	}
+
 	 // Send the message
         websocketpp::lib::error_code ec;
-    	auto metadata = con_metadata;
-    
-    	m_endpoint.send(metadata -> m_hdl, message, websocketpp::frame::opcode::text, ec);
+    	m_endpoint.send(metadata -> m_hdl, m_tagged, websocketpp::frame::opcode::text, ec);
     	if (ec) {
-		std::cout << con_metadata -> m_status << '\n'; 
-        	std::cout << "> Error sending message: " << ec.message() << std::endl;
+		{
+			std::lock_guard<std::mutex> lock(metadata -> m_mutex);
+			metadata -> m_tag = 0;
+		}
+		std::lock_guard<std::mutex> lock(m_timers_mutex);
+		m_timers.cancel(deadline);
+        	Logger::instance().log_text(LogId::SOCKET_SEND_FAIL, ec.message());
         	return std::make_pair(1, ec.message());
     	}
 	
-	std::unique_lock<std::mutex> lock(con_metadata -> m_mutex);
-	// Wait until the queue is not empty
-    	con_metadata->m_cv.wait(lock, [&]() { return !con_metadata->msg_queue.empty(); });
-
-    	// Safely retrieve the message
-    	std::string resp = con_metadata->msg_queue.back();
-    	con_metadata->msg_queue.pop_back();
+	// Wait until the queue is not empty or the deadline passes
+	std::string resp;
+	while(true){
+		uint32_t seen = metadata->m_wait.epoch();
+		{
+			std::lock_guard<std::mutex> lock(metadata -> m_mutex);
+			if(!metadata->msg_queue.empty()){
+    				// Safely retrieve the message
+    				resp = std::move(metadata->msg_queue.back());
+    				metadata->msg_queue.pop_back();
+				metadata->m_tag = 0;
+				break;
+			}
+			if(metadata->m_expired == deadline){
+				metadata->m_tag = 0;
+				Logger::instance().log(LogId::SOCKET_TIMEOUT, "Socketpp", m_timeout_ms);
+				return std::make_pair(1, std::string("request timed out"));
+			}
+		}
+		metadata->m_wait.wait(seen);
+	}
+	{
+		std::lock_guard<std::mutex> timers_lock(m_timers_mutex);
+		m_timers.cancel(deadline);
+	}
+	untag_reply(resp, m_caller_id);
     	return std::make_pair(0, resp);
 }
 
+void Socketpp::arm_tick(){
+	int64_t next;
+	{
+		std::lock_guard<std::mutex> lock(m_timers_mutex);
+		next = m_timers.next_deadline();
+		m_armed_ns = next;
+	}
+	if(next < 0 || m_stopping) return;
+	// Moving the expiry aborts the previous wait
+	m_tick -> expires_at(std::chrono::steady_clock::time_point(std::chrono::nanoseconds(next)));
+	m_tick -> async_wait([this](const boost::system::error_code& ec){
+		if(!ec) on_tick();
+	});
+}
+
+void Socketpp::on_tick(){
+	{
+		std::lock_guard<std::mutex> lock(m_timers_mutex);
+		m_timers.advance(mono_ns());
+	}
+	arm_tick();
+}
+
+void Socketpp::on_deadline(void* ctx, uint64_t id){
+	connection_metadata* metadata = static_cast<connection_metadata*>(ctx);
+	{
+		std::lock_guard<std::mutex> lock(metadata -> m_mutex);
+		metadata -> m_expired = id;
+	}
+	metadata -> m_wait.notify();
+}
+
 void Socketpp::switch_to_ws(){
 	 // Perform the websocket handshake
 	websocketpp::lib::error_code ec;
@@ -78,11 +159,12 @@ void Socketpp::switch_to_ws(){
         client::connection_ptr con = m_endpoint.get_connection(uri, ec);
  
         if (ec) {
-            std::cout << "> Connect initialization error: " << ec.message() << '\n';
-	    std::cout << uri << '\n';
+            Logger::instance().log_text(LogId::SOCKET_ERROR, ec.message(), "Connect initialization");
 	    return;
         }
-	connection_metadata::ptr metadata_ptr(new connection_metadata(1, con->get_handle(), uri));
+	connection_metadata::ptr metadata_ptr(new connection_metadata(1, con->get_handle(), uri, m_wait_mode));
+	metadata_ptr -> m_on_notification = m_on_notification;
+	metadata_ptr -> msg_queue.reserve(16);
         con_metadata = metadata_ptr;
 	
 	con->set_open_handler(websocketpp::lib::bind(
@@ -106,8 +188,13 @@ void Socketpp::switch_to_ws(){
          ));
 
 	m_endpoint.connect(con);
-	std::cout << "Waiting for connection\n";
+	Logger::instance().log(LogId::SOCKET_CONNECTING);
 	while(con_metadata -> m_status == "Connecting") sleep(1);
-	std::cout << "Moved to WebSocket Connection\n";
+	Logger::instance().log(LogId::SOCKET_WS_OPEN);
 }
 
+void Socketpp::set_notification_handler(std::function<void(const std::string&)> handler){
+	Socket::set_notification_handler(handler);
+	// Set before subscribing, on_message reads it without locking
+	if(con_metadata) con_metadata -> m_on_notification = std::move(handler);
+}
@@ -9,7 +9,13 @@
 #include <websocketpp/common/thread.hpp>
 #include <websocketpp/common/memory.hpp>
 #include <websocketpp/config/asio_client.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/asio/steady_timer.hpp>
 #include "Socket.hpp"
+#include "Logger.hpp"
+#include "TimingWheel.hpp"
+#include "WaitStrategy.hpp"
+#include "utility.hpp"
 #include <condition_variable>
 
 typedef websocketpp::client<websocketpp::config::asio_tls_client> client;
@@ -17,16 +23,17 @@ typedef std::shared_ptr<boost::asio::ssl::context> context_ptr;
 class connection_metadata {
 public:
 	typedef websocketpp::lib::shared_ptr<connection_metadata> ptr;
-	connection_metadata(int id, websocketpp::connection_hdl hdl, std::string uri) : m_id(id)
+	connection_metadata(int id, websocketpp::connection_hdl hdl, std::string uri, WaitStrategy::Mode wait = WaitStrategy::BLOCK) : m_id(id)
       	, m_hdl(hdl)
       	, m_status("Connecting")
       	, m_uri(uri)
-      	, m_server("N/A") {}
+      	, m_server("N/A")
+      	, m_wait(wait) {}
 	connection_metadata() {}
     
 	void on_open(client * c, websocketpp::connection_hdl hdl) {
         	m_status = "Open";
-		std::cout << "Connection opened!\n";
+		Logger::instance().log(LogId::SOCKET_WS_OPEN);
         	client::connection_ptr con = c->get_con_from_hdl(hdl);
         	m_server = con->get_response_header("Server");
     	}
@@ -36,15 +43,23 @@ public:
  	       	client::connection_ptr con = c->get_con_from_hdl(hdl);
         	m_server = con->get_response_header("Server");
         	m_error_reason = con->get_ec().message();
- 		std::cout << "Connection failed: " << m_error_reason << "\n"; // Log failure reason
+ 		Logger::instance().log_text(LogId::SOCKET_WS_FAIL, m_error_reason); // Log failure reason
     	}
 
 	void on_message(websocketpp::connection_hdl /*hdl*/, client::message_ptr msg){
+		// Subscription pushes go straight to the handler, only replies are queued
+		if(m_on_notification && Socket::is_notification(msg->get_payload())){
+			m_on_notification(msg->get_payload());
+			return;
+		}
+		uint64_t tag = Socket::reply_tag(msg->get_payload());
 		{
         		std::lock_guard<std::mutex> lock(m_mutex);
+			// The reply of a request that already gave up on it
+			if(tag == 0 || tag != m_tag) return;
         		msg_queue.push_back(msg->get_payload());
     		}
-    		m_cv.notify_one(); // Notify one waiting thread
+    		m_wait.notify(); // Wake the waiting thread
 	}
 public:
     	int m_id;
@@ -55,17 +70,42 @@ public:
     	std::string m_error_reason;
     	std::vector<std::string> msg_queue;
 	std::mutex m_mutex;
-	std::condition_variable m_cv;
+	WaitStrategy m_wait; // how ws_request waits for the queue
+	std::function<void(const std::string&)> m_on_notification;
+	uint64_t m_expired = 0; // id of the request deadline that fired last
+	uint64_t m_tag = 0;     // tag of the request waiting for its reply, 0 when none
 };
 
 class Socketpp: public Socket{
 public:
-	Socketpp(); // Constructor
+	// Constructor, `wait` picks how ws_request waits for replies: spinning
+	// trades a core for wakeup latency
+	explicit Socketpp(WaitStrategy::Mode wait = WaitStrategy::BLOCK);
 	~Socketpp(); // Destructor
 	void switch_to_ws() override;
 	[[nodiscard]] std::pair<int, std::string> ws_request(const std::string& msg) override;
+	void set_notification_handler(std::function<void(const std::string&)> handler) override;
 private:
+	// Re-arm m_tick at the wheel's next deadline, on the client thread
+	void arm_tick();
+	void on_tick();
+	static void on_deadline(void* ctx, uint64_t id);
+
 	client m_endpoint;
 	connection_metadata::ptr con_metadata;
 	websocketpp::lib::shared_ptr<websocketpp::lib::thread> m_ws;
+	WaitStrategy::Mode m_wait_mode;
+
+	// Request deadlines, run by the client thread. Taken before a
+	// connection's mutex, never while holding it
+	std::mutex m_timers_mutex;
+	TimingWheel m_timers{256, 1000000, mono_ns()}; // 1 ms ticks
+	int64_t m_armed_ns = -1; // when m_tick fires next, -1 when idle
+	std::unique_ptr<boost::asio::steady_timer> m_tick;
+	bool m_stopping = false; // client thread only
+
+	// Requests go out tagged, see Socket::tag_request
+	uint64_t m_next_tag = 0;
+	std::string m_tagged;
+	std::string m_caller_id;
 };
@@ -0,0 +1,203 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <climits>
+#include <vector>
+
+// Hierarchical timing wheel (Varghese & Lauck, the scheme of the old Linux
+// timer code): LEVELS wheels of SLOTS slots, level k slots span SLOTS^k ticks.
+// A timer sits in the coarsest slot that still separates it from now and
+// moves down a level each time its slot comes round (cascade).
+//
+// Timers live in a node pool sized at construction, linked into their slot
+// through indices, so schedule() and cancel() are O(1) and never allocate.
+// Ids carry a generation, a stale id (fired or cancelled) cancels nothing.
+//
+// Not thread safe, it belongs to the loop that calls advance(). Callbacks
+// run inside advance() and may schedule or cancel timers, themselves included.
+class TimingWheel{
+public:
+	using Callback = void (*)(void* ctx, uint64_t id);
+	static constexpr int LEVELS = 4;
+	static constexpr int SLOT_BITS = 6;
+	static constexpr uint32_t SLOTS = 1u << SLOT_BITS; // one occupancy bit each in a uint64_t
+	static constexpr int64_t RANGE = int64_t(1) << (LEVELS * SLOT_BITS); // ticks, later deadlines wait at the top
+
+	// Constructor, room for `capacity` pending timers, time in ns from `now_ns`
+	TimingWheel(uint32_t capacity, int64_t tick_ns, int64_t now_ns)
+		: m_nodes(capacity), m_tick_ns(tick_ns), m_now(now_ns / tick_ns) {
+		for(uint32_t& h : m_heads) h = NIL;
+		for(uint32_t i = 0; i < capacity; i++) m_nodes[i].next = i + 1 < capacity ? i + 1 : NIL;
+		m_free = capacity ? 0 : NIL;
+	}
+
+	// Calls fn(ctx, id) from the first advance() at or after `deadline_ns`, then
+	// every `period_ns` when that is non zero. Returns the id, 0 when the pool is full
+	uint64_t schedule(int64_t deadline_ns, Callback fn, void* ctx, int64_t period_ns = 0){
+		if(m_free == NIL) return 0;
+		uint32_t i = m_free;
+		Node& n = m_nodes[i];
+		m_free = n.next;
+		// Rounded up, a timer never fires early; and never into a tick already run
+		int64_t tick = (deadline_ns + m_tick_ns - 1) / m_tick_ns;
+		n.expiry = tick > m_now ? tick : m_now + 1;
+		n.period = period_ns > 0 ? (period_ns + m_tick_ns - 1) / m_tick_ns : 0;
+		n.fn = fn;
+		n.ctx = ctx;
+		m_size++;
+		link(i);
+		return id_of(i);
+	}
+
+	// 0 when the timer was pending and will not fire, 1 otherwise
+	int cancel(uint64_t id){
+		uint32_t i = static_cast<uint32_t>(id) - 1;
+		if(id == 0 || i >= m_nodes.size() || m_nodes[i].gen != (id >> 32) || m_nodes[i].slot == NIL) return 1;
+		unlink(i);
+		release(i);
+		return 0;
+	}
+
+	// Runs every timer due at `now_ns`, returns how many fired
+	size_t advance(int64_t now_ns){
+		int64_t target = now_ns / m_tick_ns;
+		size_t fired = 0;
+		while(m_now < target){
+			if(m_size == 0){
+				m_now = target;
+				break;
+			}
+			// Nothing left in this turn of level 0, go straight to the next cascade
+			uint32_t from = static_cast<uint32_t>(m_now + 1) & (SLOTS - 1);
+			uint64_t ahead = from ? m_used[0] >> from : 0;
+			int64_t next = ahead ? m_now + 1 + __builtin_ctzll(ahead) : (m_now | (SLOTS - 1)) + 1;
+			m_now = next < target ? next : target;
+			if((m_now & (SLOTS - 1)) == 0) cascade();
+			fired += expire(static_cast<uint32_t>(m_now) & (SLOTS - 1));
+		}
+		return fired;
+	}
+
+	// Earliest time the next timer can be due (exact for level 0, the start of
+	// the slot otherwise), -1 when none is pending. What a loop sleeps until
+	int64_t next_deadline() const{
+		if(m_size == 0) return -1;
+		int64_t best = INT64_MAX;
+		for(int level = 0; level < LEVELS; level++){
+			if(!m_used[level]) continue;
+			int shift = level * SLOT_BITS;
+			uint32_t cur = static_cast<uint32_t>(m_now >> shift) & (SLOTS - 1);
+			// Slots ahead of the current one, then the ones past the wrap. The
+			// current slot is empty on level 0 and a whole turn away above it
+			uint64_t rot = (m_used[level] >> cur) | (cur ? m_used[level] << (SLOTS - cur) : 0);
+			int64_t ahead = (rot & ~uint64_t(1)) ? __builtin_ctzll(rot & ~uint64_t(1)) : SLOTS;
+			int64_t start = ((m_now >> shift) + ahead) << shift;
+			if(start <= m_now) start = m_now + 1;
+			if(start < best) best = start;
+		}
+		return best * m_tick_ns;
+	}
+
+	size_t size() const { return m_size; }
+	uint32_t capacity() const { return static_cast<uint32_t>(m_nodes.size()); }
+	int64_t tick_ns() const { return m_tick_ns; }
+	// Pool index of a pending timer, in [0, capacity()): lets callers keep
+	// per timer state in a flat array without allocating
+	static uint32_t index_of(uint64_t id){ return static_cast<uint32_t>(id) - 1; }
+private:
+	static constexpr uint32_t NIL = UINT32_MAX;
+	struct Node{
+		int64_t expiry = 0; // tick
+		int64_t period = 0; // ticks, 0 for one shot
+		Callback fn = nullptr;
+		void* ctx = nullptr;
+		uint32_t prev = NIL;
+		uint32_t next = NIL;
+		uint32_t slot = NIL; // level * SLOTS + slot while pending
+		uint32_t gen = 1;
+	};
+
+	uint64_t id_of(uint32_t i) const { return (uint64_t(m_nodes[i].gen) << 32) | (i + 1); }
+
+	void link(uint32_t i){
+		Node& n = m_nodes[i];
+		int64_t delta = n.expiry - m_now;
+		int64_t at = delta < RANGE ? n.expiry : m_now + RANGE - 1; // re-placed when it cascades
+		int level = 0;
+		while(level < LEVELS - 1 && (at >> (level * SLOT_BITS)) - (m_now >> (level * SLOT_BITS)) >= SLOTS) level++;
+		uint32_t s = static_cast<uint32_t>(at >> (level * SLOT_BITS)) & (SLOTS - 1);
+		n.slot = level * SLOTS + s;
+		n.prev = NIL;
+		n.next = m_heads[n.slot];
+		if(n.next != NIL) m_nodes[n.next].prev = i;
+		m_heads[n.slot] = i;
+		m_used[level] |= uint64_t(1) << s;
+	}
+
+	void unlink(uint32_t i){
+		Node& n = m_nodes[i];
+		if(n.prev != NIL) m_nodes[n.prev].next = n.next;
+		else m_heads[n.slot] = n.next;
+		if(n.next != NIL) m_nodes[n.next].prev = n.prev;
+		if(m_heads[n.slot] == NIL) m_used[n.slot / SLOTS] &= ~(uint64_t(1) << (n.slot % SLOTS));
+		n.slot = NIL;
+	}
+
+	void release(uint32_t i){
+		Node& n = m_nodes[i];
+		n.gen++;
+		if(n.gen == 0) n.gen = 1;
+		n.next = m_free;
+		m_free = i;
+		m_size--;
+	}
+
+	// On a level 0 wrap, move the slots of coarser levels that have come due
+	// down towards level 0, coarsest first
+	void cascade(){
+		int top = 1;
+		while(top < LEVELS - 1 && ((m_now >> (top * SLOT_BITS)) & (SLOTS - 1)) == 0) top++;
+		for(int level = top; level >= 1; level--){
+			uint32_t slot = level * SLOTS + (static_cast<uint32_t>(m_now >> (level * SLOT_BITS)) & (SLOTS - 1));
+			uint32_t i = m_heads[slot];
+			m_heads[slot] = NIL;
+			m_used[level] &= ~(uint64_t(1) << (slot % SLOTS));
+			while(i != NIL){
+				uint32_t next = m_nodes[i].next;
+				link(i);
+				i = next;
+			}
+		}
+	}
+
+	size_t expire(uint32_t s){
+		size_t fired = 0;
+		// Pop one at a time, a callback may cancel the timers still in the slot
+		while(m_heads[s] != NIL){
+			uint32_t i = m_heads[s];
+			Node& n = m_nodes[i];
+			uint64_t id = id_of(i);
+			Callback fn = n.fn;
+			void* ctx = n.ctx;
+			unlink(i);
+			if(n.period){
+				n.expiry += n.period;
+				if(n.expiry <= m_now) n.expiry = m_now + 1; // missed turns are dropped
+				link(i);
+			} else {
+				release(i);
+			}
+			fn(ctx, id);
+			fired++;
+		}
+		return fired;
+	}
+
+	std::vector<Node> m_nodes;
+	uint32_t m_heads[LEVELS * SLOTS];
+	uint64_t m_used[LEVELS] = {}; // non empty slots per level
+	uint32_t m_free;
+	size_t m_size = 0;
+	int64_t m_tick_ns;
+	int64_t m_now; // last tick run
+};
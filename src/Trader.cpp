@@ -1,13 +1,21 @@
 #include "Trader.hpp"
+#include <cctype>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <poll.h>
+#include <unistd.h>
 
 int Trader::show_resp(const std::string& resp){
 	nlohmann::json obj = nlohmann::json::parse(resp);
 
 	if(obj.contains("error")){
+		Logger::instance().log_text(LogId::TRADER_ERROR, resp);
 		std::cout << "Error encounterd\n";
 		std::cout << obj["error"].dump(4) << '\n';
 		return 1;
 	}
+	Logger::instance().log_text(LogId::TRADER_RESPONSE, resp);
 
 	std::cout << obj.dump(4) << '\n';
 	return 0;
@@ -133,9 +141,13 @@ int Trader::handleMarketData(const std::function<std::pair<int, std::string>(std
 		std::cout << "[1] Subscribe to symbol\n";
 		std::cout << "[2] Unsubscribe to symbol\n";
 		std::cout << "[3] Orderbook of symbols\n";
-		std::cout << "[4] Back\n";
+		std::cout << "[4] Trade statistics of symbol\n";
+		std::cout << "[5] Option greeks of symbol\n";
+		std::cout << "[6] Cache statistics\n";
+		std::cout << "[7] Latency breakdown\n";
+		std::cout << "[8] Back\n";
 		int opt; std::cin >> opt;
-		if(opt > 4){
+		if(opt > 8){
 			throw "Invalid Input\n";
 		}
 		
@@ -166,6 +178,36 @@ int Trader::handleMarketData(const std::function<std::pair<int, std::string>(std
 			std::string resp = result.second;
 			int valid = show_resp(resp);
 			return status | valid;
+		} else if(opt == 4){
+			std::string inst;
+			std::cout << "Enter Instrument name (subscribe to trades.<instrument>.raw first): (eg. BTC-PERPETUAL) ";
+			std::cin >> inst;
+			std::pair<int, std::string> result = action(inst, 4);
+			int status = result.first;
+			std::string resp = result.second;
+			int valid = show_resp(resp);
+			return status | valid;
+		} else if(opt == 5){
+			std::string inst;
+			std::cout << "Enter Option name (subscribe to ticker.<option>.100ms first): (eg. BTC-27DEC24-60000-C) ";
+			std::cin >> inst;
+			std::pair<int, std::string> result = action(inst, 5);
+			int status = result.first;
+			std::string resp = result.second;
+			int valid = show_resp(resp);
+			return status | valid;
+		} else if(opt == 6){
+			std::pair<int, std::string> result = action("", 6);
+			int status = result.first;
+			std::string resp = result.second;
+			int valid = show_resp(resp);
+			return status | valid;
+		} else if(opt == 7){
+			std::pair<int, std::string> result = action("", 7);
+			int status = result.first;
+			std::string resp = result.second;
+			int valid = show_resp(resp);
+			return status | valid;
 		} else{
 			return 1;
 		}		
@@ -178,27 +220,267 @@ int Trader::handleMarketData(const std::function<std::pair<int, std::string>(std
 
 // Constructor
 Trader::Trader(){
-	std::cout << "New Api Instance Created\n";
+	Logger::instance().log(LogId::API_CREATE);
 	m_api = new Api();
+	m_api -> on_notification([this](const std::string& msg) { on_notification(msg); });
+	if(load_instruments("instruments.bin")){
+		Logger::instance().log(LogId::TRADER_ERROR, "instrument registry unavailable");
+	} else {
+		if(m_md_bus.open(MD_BUS_NAME, static_cast<uint32_t>(m_instruments.size()))){
+			Logger::instance().log(LogId::TRADER_ERROR, "market data bus unavailable");
+		}
+		m_fanout.init(m_instruments.size());
+	}
+	if(m_books.start(m_instruments, [this](InstrumentId id, const OrderBook& book){ publish_book(id, book); })){
+		Logger::instance().log(LogId::TRADER_ERROR, "book shards unavailable");
+	}
+	recover_state();
+	// Our own fills keep the local positions current
+	std::pair<int, std::string> sub = get_marketdata("user.trades.any.any.raw", 1);
+	if(sub.first){
+		Logger::instance().log_text(LogId::TRADER_ERROR, sub.second);
+	}
+}
+
+// Warm start from the snapshot, otherwise fetch every active instrument once
+int Trader::load_instruments(const std::string& path){
+	int64_t now = now_ms();
+	if(m_instruments.load_snapshot(path, now, INSTRUMENTS_MAX_AGE_MS) == 0){
+		Logger::instance().log(LogId::INSTRUMENTS_LOADED, m_instruments.size(), "snapshot");
+		return 0;
+	}
+	std::pair<int, std::string> resp = m_api -> api_public(Instruments::request());
+	if(resp.first || m_instruments.load_json(resp.second)) return 1;
+	Logger::instance().log(LogId::INSTRUMENTS_LOADED, m_instruments.size(), "exchange");
+	if(m_instruments.save(path, now)){
+		Logger::instance().log(LogId::TRADER_ERROR, "failed to write instrument snapshot");
+	}
+	return 0;
+}
+
+void Trader::recover_state(){
+	if(m_journal.open(STATE_PATH)){
+		Logger::instance().log(LogId::TRADER_ERROR, "state journal unavailable");
+		return;
+	}
+	std::unordered_map<std::string, StateJournal::Order> orders = m_journal.orders();
+	std::unordered_map<std::string, Position> positions = m_journal.positions();
+	{
+		std::lock_guard<std::mutex> lock(m_md_mutex);
+		for(const auto& [inst, p] : positions) m_positions.restore(inst, p);
+		for(const auto& [order_id, o] : orders){
+			InstrumentId id = m_instruments.id(o.instrument);
+			if(id != INVALID_INSTRUMENT) m_order_instruments[order_id] = id;
+		}
+	}
+	Logger::instance().log(LogId::STATE_RECOVERED, orders.size(), positions.size(), m_journal.stats().recover_us);
+
+	// Only what changed while we were down goes through the journal
+	std::pair<int, std::string> resp = get_openorders("null");
+	nlohmann::json obj = resp.first ? nlohmann::json() : nlohmann::json::parse(resp.second, nullptr, false);
+	if(!obj.is_object() || !obj.contains("result") || !obj["result"].is_array()){
+		Logger::instance().log(LogId::TRADER_ERROR, "open orders unavailable, recovered orders not reconciled");
+		return;
+	}
+	auto number = [](const nlohmann::json& o, const char* key){
+		auto it = o.find(key);
+		return it != o.end() && it->is_number() ? it->get<double>() : 0.0;
+	};
+	int64_t now = now_ms();
+	size_t found = 0, gone = 0;
+	std::unordered_set<std::string> live;
+	for(const nlohmann::json& o : obj["result"]){
+		std::string order_id = o.value("order_id", "");
+		std::string inst = o.value("instrument_name", "");
+		live.insert(order_id);
+		if(orders.count(order_id)) continue;
+		m_journal.order_open(order_id, inst, number(o, "price"), number(o, "amount"), now);
+		InstrumentId id = m_instruments.id(inst);
+		std::lock_guard<std::mutex> lock(m_md_mutex);
+		if(id != INVALID_INSTRUMENT) m_order_instruments[order_id] = id;
+		found++;
+	}
+	for(const auto& [order_id, o] : orders){
+		if(live.count(order_id)) continue;
+		// Filled or cancelled while we were down, the position may have moved: ask the exchange next time
+		m_journal.order_closed(order_id);
+		std::lock_guard<std::mutex> lock(m_md_mutex);
+		m_order_instruments.erase(order_id);
+		auto it = positions.find(o.instrument);
+		if(it != positions.end()){
+			Position p = it->second;
+			p.reconciled_ms = 0;
+			m_positions.restore(o.instrument, p);
+		}
+		gone++;
+	}
+	Logger::instance().log(LogId::STATE_RECONCILED, found, gone);
+}
+
+// Called under m_md_mutex, after the fills were applied
+void Trader::journal_trades(const nlohmann::json& data){
+	for(const nlohmann::json& t : data){
+		std::string inst = t.value("instrument_name", "");
+		const Position* p = m_positions.find(inst);
+		if(p) m_journal.position(inst, *p);
+		if(t.value("state", "") == "filled"){
+			std::string order_id = t.value("order_id", "");
+			m_journal.order_closed(order_id);
+			m_order_instruments.erase(order_id);
+		}
+	}
+}
+
+// Top of a local book onto the shared memory bus, slots are instrument ids
+void Trader::publish_book(InstrumentId id, const OrderBook& book){
+	if(!m_md_bus.is_open()) return;
+	BookSnapshot snap;
+	std::string_view name = m_instruments.get(id).name_view();
+	std::memset(snap.instrument, 0, sizeof(snap.instrument));
+	name.copy(snap.instrument, sizeof(snap.instrument) - 1);
+	snap.exchange_ts_ms = book.timestamp();
+	snap.publish_ns = 0;
+	snap.change_id = book.change_id();
+	snap.bid_levels = book.levels(true, BookSnapshot::DEPTH, snap.bid_price, snap.bid_amount);
+	snap.ask_levels = book.levels(false, BookSnapshot::DEPTH, snap.ask_price, snap.ask_amount);
+	m_md_bus.publish(id, snap);
+}
+
+std::string_view Trader::notification_channel(std::string_view msg){
+	static constexpr std::string_view key = R"("channel":")";
+	size_t from = msg.find(key);
+	if(from == std::string_view::npos) return {};
+	from += key.size();
+	size_t to = msg.find('"', from);
+	if(to == std::string_view::npos) return {};
+	return msg.substr(from, to - from);
+}
+
+// Route subscription pushes to the local market data state. Book frames go
+// to their instrument's shard unparsed, the rest is handled here
+void Trader::on_notification(const std::string& msg){
+	std::string_view channel = notification_channel(msg);
+	MarketDataFanout::Channel fan = MarketDataFanout::channel_of(channel);
+	if(fan != MarketDataFanout::CHANNELS){
+		// "book.BTC-PERPETUAL.100ms": the instrument is the second part
+		size_t from = channel.find('.') + 1;
+		size_t to = channel.find('.', from);
+		InstrumentId id = m_instruments.id(channel.substr(from, to - from));
+		if(m_fanout.consumers()) m_fanout.publish(id, fan, msg);
+		if(fan == MarketDataFanout::BOOK){
+			if(id != INVALID_INSTRUMENT && m_books.route(id, msg)){
+				Logger::instance().log(LogId::TRADER_ERROR, "book update dropped, no book shards");
+			}
+			return;
+		}
+	}
+	try {
+		nlohmann::json obj = nlohmann::json::parse(msg);
+		const nlohmann::json& params = obj["params"];
+		std::lock_guard<std::mutex> lock(m_md_mutex);
+		if(channel.rfind("trades.", 0) == 0){
+			m_trades.on_trades(params["data"]);
+		} else if(channel.rfind("user.trades.", 0) == 0){
+			m_positions.on_trades(params["data"]);
+			journal_trades(params["data"]);
+		} else if(channel.rfind("ticker.", 0) == 0){
+			const nlohmann::json& data = params["data"];
+			m_trades.on_ticker(data);
+			m_positions.on_ticker(data);
+			if(OptionChain::is_option(data["instrument_name"].get_ref<const std::string&>())){
+				// Only the block holding this option is repriced
+				m_options.on_ticker(data);
+				m_options.reprice(now_ms());
+			}
+		}
+	}
+	catch (const std::exception& e) {
+		Logger::instance().log_text(LogId::TRADER_ERROR, e.what());
+	}
+}
+
+// Order payloads are built around a quoted target field (instrument name or
+// order id) and the already formatted price/amount
+std::string Trader::order_payload(std::string_view method, std::string_view target, std::string_view price, std::string_view amount, char id){
+	std::string payload;
+	payload.reserve(160);
+	payload += R"({"jsonrpc":"2.0","method":")";
+	payload += method;
+	payload += R"(","params":{)";
+	payload += target;
+	if(method == "private/buy") payload += R"(,"type":"limit")";
+	payload += R"(,"price":)";
+	payload += price;
+	payload += R"(,"amount":)";
+	payload += amount;
+	payload += R"(},"id":")";
+	payload += id;
+	payload += R"("})";
+	return payload;
+}
+
+std::string Trader::orderbook_payload(std::string_view field, int depth){
+	char nums[48];
+	std::snprintf(nums, sizeof(nums), R"(,"depth":%d},"id":"4"})", depth);
+	std::string payload;
+	payload.reserve(128);
+	payload += R"({"jsonrpc":"2.0","method":"public/get_order_book","params":{)";
+	payload += field;
+	payload += nums;
+	return payload;
+}
+
+// Amount entered as a number of coins/USD, 1 when it is not a whole number of lots
+static int to_qty(const Instrument& ins, double amount, Qty& qty){
+	qty = Qty::from_double(amount, ins.qty_scale);
+	return (qty.n <= 0 || std::fabs(qty.to_double(ins.qty_scale) - amount) > 1e-9 * amount) ? 1 : 0;
+}
+
+static std::pair<int, std::string> bad_amount(const Instrument& ins){
+	char step[32];
+	char* end = format_decimal(step, step + sizeof(step), 1, ins.qty_scale);
+	return {1, "Amount must be a positive multiple of " + std::string(step, end)};
 }
 
 // Function responsible for placing order
 std::pair<int, std::string> Trader::place_order(const std::string &inst, double price, int quant){
-	std::ostringstream payload;
-    	payload << R"({
-        	"jsonrpc": "2.0",
-        	"method": "private/buy",
-        	"params": {
-            		"instrument_name": ")" << inst << R"(",
-            		"type": "limit",
-            		"price": )" << price << R"(,
-            		"amount": )" << quant << R"(
-        	},
-        	"id": "1"
-    	})";
+	InstrumentId id = m_instruments.id(inst);
+	if(id != INVALID_INSTRUMENT){
+		const Instrument& ins = m_instruments.get(id);
+		Qty qty;
+		if(to_qty(ins, quant, qty)) return bad_amount(ins);
+		// A buy never pays more than asked
+		return place_order(id, Price::from_double(price, ins.price_scale, Price::DOWN), qty);
+	}
+	// Not in the registry, let the exchange judge the name and grid
+	char px[32], amt[16];
+	char* px_end = std::to_chars(px, px + sizeof(px), price).ptr;
+	char* amt_end = std::to_chars(amt, amt + sizeof(amt), quant).ptr;
+	return m_api -> api_private(order_payload("private/buy", R"("instrument_name":")" + inst + '"',
+		std::string_view(px, px_end - px), std::string_view(amt, amt_end - amt), '1'));
+}
 
-    	std::string payload_str = payload.str();
-	return m_api -> api_private(payload_str);
+std::pair<int, std::string> Trader::place_order(InstrumentId id, Price price, Qty qty){
+	const Instrument& ins = m_instruments.get(id);
+	price = ins.snap(price, Price::DOWN);
+	char px[32], amt[32];
+	char* px_end = format_decimal(px, px + sizeof(px), price, ins.price_scale);
+	char* amt_end = format_decimal(amt, amt + sizeof(amt), qty, ins.qty_scale);
+	std::pair<int, std::string> resp = m_api -> api_private(order_payload("private/buy", ins.json_field(),
+		std::string_view(px, px_end - px), std::string_view(amt, amt_end - amt), '1'));
+	// Remember the instrument so edits can be put on its grid
+	size_t at = resp.first ? std::string::npos : resp.second.find(R"("order_id":")");
+	if(at != std::string::npos){
+		at += 12;
+		size_t end = resp.second.find('"', at);
+		if(end != std::string::npos){
+			std::string order_id = resp.second.substr(at, end - at);
+			std::lock_guard<std::mutex> lock(m_md_mutex);
+			m_order_instruments[order_id] = id;
+			m_journal.order_open(order_id, ins.name_view(), price.to_double(ins.price_scale), qty.to_double(ins.qty_scale), now_ms());
+		}
+	}
+	return resp;
 }
 
 // Function responsible for canclling order
@@ -214,46 +496,116 @@ std::pair<int, std::string> Trader::cancel_order(const std::string &order_id){
     	})";
 
     	std::string payload_str = payload.str();
-	return m_api -> api_private(payload_str);
+	std::pair<int, std::string> resp = m_api -> api_private(payload_str);
+	if(resp.first == 0){
+		m_journal.order_closed(order_id);
+		std::lock_guard<std::mutex> lock(m_md_mutex);
+		m_order_instruments.erase(order_id);
+	}
+	return resp;
 }
 
 // Function responsible for modifing order
 std::pair<int, std::string> Trader::modify_order(const std::string &order_id, double price, int quant){
-	std::ostringstream payload;
-    	payload << R"({
-        	"jsonrpc": "2.0",
-        	"method": "private/edit",
-        	"params": {
-            		"order_id": ")" << order_id << R"(",
-            		"price": )" << price << R"(,
-            		"amount": )" << quant << R"(
-        	},
-        	"id": "3"
-    	})";
+	InstrumentId id = INVALID_INSTRUMENT;
+	{
+		std::lock_guard<std::mutex> lock(m_md_mutex);
+		auto it = m_order_instruments.find(order_id);
+		if(it != m_order_instruments.end()) id = it->second;
+	}
+	if(id != INVALID_INSTRUMENT){
+		const Instrument& ins = m_instruments.get(id);
+		Qty qty;
+		if(to_qty(ins, quant, qty)) return bad_amount(ins);
+		return modify_order(order_id, id, Price::from_double(price, ins.price_scale), qty);
+	}
+	// Order placed elsewhere, the grid is unknown
+	char px[32], amt[16];
+	char* px_end = std::to_chars(px, px + sizeof(px), price).ptr;
+	char* amt_end = std::to_chars(amt, amt + sizeof(amt), quant).ptr;
+	return m_api -> api_private(order_payload("private/edit", R"("order_id":")" + order_id + '"',
+		std::string_view(px, px_end - px), std::string_view(amt, amt_end - amt), '3'));
+}
 
-    	std::string payload_str = payload.str();
-	return m_api -> api_private(payload_str);
+std::pair<int, std::string> Trader::modify_order(const std::string &order_id, InstrumentId id, Price price, Qty qty){
+	const Instrument& ins = m_instruments.get(id);
+	price = ins.snap(price);
+	char px[32], amt[32];
+	char* px_end = format_decimal(px, px + sizeof(px), price, ins.price_scale);
+	char* amt_end = format_decimal(amt, amt + sizeof(amt), qty, ins.qty_scale);
+	std::pair<int, std::string> resp = m_api -> api_private(order_payload("private/edit", R"("order_id":")" + order_id + '"',
+		std::string_view(px, px_end - px), std::string_view(amt, amt_end - amt), '3'));
+	if(resp.first == 0) m_journal.order_open(order_id, ins.name_view(), price.to_double(ins.price_scale), qty.to_double(ins.qty_scale), now_ms());
+	return resp;
 }
 
 // Function responsible for fetching order book
 std::pair<int, std::string> Trader::get_orderbook(const std::string &inst, int depth){
-	std::ostringstream payload;
-    	payload << R"({
-        	"jsonrpc": "2.0",
-        	"method": "public/get_order_book",
-        	"params": {
-            		"instrument_name": ")" << inst << R"(",
-			"depth": )" << depth << R"(
-        	},
-        	"id": "4"
-    	})";
+	InstrumentId id = m_instruments.id(inst);
+	if(id != INVALID_INSTRUMENT) return get_orderbook(id, depth);
+	return m_api -> api_public(orderbook_payload(R"("instrument_name":")" + inst + '"', depth));
+}
 
-    	std::string payload_str = payload.str();
-	return m_api -> api_public(payload_str);
+// Served from the local book while its book.* subscription is live and
+// recent, otherwise from the exchange (through the Api's response cache)
+std::pair<int, std::string> Trader::get_orderbook(InstrumentId id, int depth){
+	m_api -> poll();
+	std::string resync;
+	nlohmann::json local;
+	int64_t age = 0;
+	bool stale = false;
+	m_books.visit(id, [&](const OrderBook* book){
+		if(book && book->valid()){
+			age = now_ms() - book->updated_ms();
+			stale = age > BOOK_MAX_AGE_MS;
+			if(!stale) local = book->snapshot(depth);
+		} else if(book){
+			resync = book->channel();
+		}
+	});
+	{
+		std::lock_guard<std::mutex> lock(m_md_mutex);
+		if(!local.is_null()){
+			m_book_hits++;
+			if(age > m_book_max_age_ms) m_book_max_age_ms = age;
+		} else {
+			m_book_misses++;
+			if(stale) m_book_stale++;
+		}
+	}
+	if(!local.is_null()){
+		nlohmann::json resp;
+		resp["result"] = std::move(local);
+		return std::make_pair(0, resp.dump());
+	}
+	if(!resync.empty()){
+		// The change chain broke, subscribing again starts with a fresh snapshot
+		std::pair<int, std::string> unsub = get_marketdata(resync, 2);
+		std::pair<int, std::string> sub = get_marketdata(resync, 1);
+		if(unsub.first || sub.first){
+			Logger::instance().log_text(LogId::TRADER_ERROR, unsub.first ? unsub.second : sub.second);
+		}
+	}
+	return m_api -> api_public(orderbook_payload(m_instruments.get(id).json_field(), depth));
 }
 
 // Function to View our current position
+// Served from the local position keeper, private/get_position is only used
+// when the instrument is unknown or the last reconciliation is too old
 std::pair<int, std::string> Trader::view_position(const std::string &inst){
+	// Fills that arrived since the last request first
+	m_api -> poll();
+	int64_t now = now_ms();
+	{
+		std::lock_guard<std::mutex> lock(m_md_mutex);
+		const Position* pos = m_positions.find(inst);
+		if(pos && now - pos -> reconciled_ms < RECONCILE_MS){
+			nlohmann::json resp;
+			resp["result"] = m_positions.summary(inst);
+			return std::make_pair(0, resp.dump());
+		}
+	}
+
 	std::ostringstream payload;
     	payload << R"({
         	"jsonrpc": "2.0",
@@ -265,7 +617,19 @@ std::pair<int, std::string> Trader::view_position(const std::string &inst){
     	})";
 
     	std::string payload_str = payload.str();
-	return m_api -> api_private(payload_str);
+	std::pair<int, std::string> result = m_api -> api_private(payload_str);
+	if(result.first == 0){
+		nlohmann::json obj = nlohmann::json::parse(result.second, nullptr, false);
+		if(!obj.is_discarded() && obj.contains("result")){
+			std::lock_guard<std::mutex> lock(m_md_mutex);
+			if(m_positions.reconcile(obj["result"], now)){
+				Logger::instance().log_text(LogId::POSITION_DRIFT, inst);
+			}
+			const Position* pos = m_positions.find(inst);
+			if(pos) m_journal.position(inst, *pos);
+		}
+	}
+	return result;
 }
 
 // Function to View open orders
@@ -297,6 +661,77 @@ std::pair<int, std::string> Trader::get_openorders(const std::string &kind){
 
 // Function to View Market data
 std::pair<int, std::string> Trader::get_marketdata(const std::string &channel, int type){
+	if(type == 4 || type == 5) m_api -> poll();
+	if(type == 4){
+		// Served from the local trade aggregation, no round trip
+		std::lock_guard<std::mutex> lock(m_md_mutex);
+		nlohmann::json summary = m_trades.summary(channel);
+		if(summary.is_null()){
+			return std::make_pair(1, R"({"error":{"message":"no trades received for instrument"}})");
+		}
+		nlohmann::json resp;
+		resp["result"] = summary;
+		return std::make_pair(0, resp.dump());
+	} else if(type == 6){
+		// Hit rates of the local books and the Api response cache
+		const ResponseCache::Stats& cache = m_api -> cache_stats();
+		nlohmann::json resp;
+		resp["result"]["response_cache"] = {
+			{"hits", cache.hits}, {"misses", cache.misses}, {"expired", cache.expired},
+			{"evictions", cache.evictions}, {"max_age_ms", cache.max_age_ms},
+			{"avg_age_ms", cache.hits ? static_cast<double>(cache.total_age_ms) / cache.hits : 0.0}};
+		uint64_t gaps = 0;
+		size_t books = 0;
+		m_books.for_each([&](InstrumentId, const OrderBook& book){ gaps += book.gaps(); books++; });
+		for(size_t i = 0; i < m_books.shards(); i++){
+			BookShards::Stats shard = m_books.stats(i);
+			resp["result"]["book_shards"].push_back({
+				{"books", shard.books}, {"updates", shard.updates}, {"rejected", shard.rejected},
+				{"full_waits", shard.full_waits}, {"depth_max", shard.depth_max}});
+		}
+		std::lock_guard<std::mutex> lock(m_md_mutex);
+		resp["result"]["local_books"] = {
+			{"books", books}, {"hits", m_book_hits}, {"misses", m_book_misses}, {"stale", m_book_stale},
+			{"max_age_ms", m_book_max_age_ms}, {"gaps", gaps}};
+		return std::make_pair(0, resp.dump());
+	} else if(type == 7){
+		// Where request time goes: wire out, matching engine, wire back
+		const LatencyBreakdown& lat = m_api -> latency();
+		auto legs = [](const Histogram& h){
+			return nlohmann::json{{"p50", h.percentile(50) / 1000}, {"p99", h.percentile(99) / 1000}, {"max", h.max() / 1000}};
+		};
+		nlohmann::json resp;
+		resp["result"]["clock"] = {
+			{"synced", lat.synced()}, {"offset_us", lat.offset_us()},
+			{"max_error_us", lat.offset_delay_us() / 2}, {"age_ms", (now_us() - lat.synced_at_us()) / 1000}};
+		for(const auto& [method, b] : lat.methods()){
+			resp["result"]["methods"][method] = {
+				{"count", b.exchange.count()}, {"outbound_us", legs(b.outbound)},
+				{"exchange_us", legs(b.exchange)}, {"inbound_us", legs(b.inbound)}, {"skewed", b.skewed}};
+		}
+		return std::make_pair(0, resp.dump());
+	} else if(type == 5){
+		// Greeks from the local option chain
+		std::lock_guard<std::mutex> lock(m_md_mutex);
+		nlohmann::json summary = m_options.summary(channel);
+		if(summary.is_null()){
+			return std::make_pair(1, R"({"error":{"message":"no ticker received for option"}})");
+		}
+		nlohmann::json resp;
+		resp["result"] = summary;
+		return std::make_pair(0, resp.dump());
+	}
+	// book.<instrument>.* subscriptions feed a local book
+	InstrumentId book_id = INVALID_INSTRUMENT;
+	if((type == 1 || type == 2) && channel.rfind("book.", 0) == 0){
+		size_t dot = channel.find('.', 5);
+		InstrumentId id = m_instruments.id(std::string_view(channel).substr(5, dot == std::string::npos ? std::string::npos : dot - 5));
+		if(id != INVALID_INSTRUMENT){
+			// Added before subscribing so the first snapshot finds its book
+			if(type == 1) book_id = id, m_books.add(id, OrderBook(m_instruments.get(id).price_scale, channel));
+			else m_books.remove(id);
+		}
+	}
 	std::ostringstream payload;
 	if(type == 1){
     		payload << R"({
@@ -325,9 +760,27 @@ std::pair<int, std::string> Trader::get_marketdata(const std::string &channel, i
         		},
         		"id": "9"
     		})";
+		return m_api -> api_public(payload.str());
 	}
     	std::string payload_str = payload.str();
-	return m_api -> api_private(payload_str);
+	std::pair<int, std::string> resp = m_api -> api_private(payload_str);
+	// Nothing will feed a book whose subscription failed or was refused
+	if(book_id != INVALID_INSTRUMENT && (resp.first || resp.second.find(R"("error":)") != std::string::npos)){
+		m_books.remove(book_id);
+	}
+	return resp;
+}
+
+void Trader::wait_input(){
+	std::streambuf* in = std::cin.rdbuf();
+	while(true){
+		// A line end left after the last choice is not input
+		while(in -> in_avail() > 0 && std::isspace(in -> sgetc())) in -> sbumpc();
+		if(in -> in_avail() != 0) return; // input, or the end of it
+		pollfd fd{STDIN_FILENO, POLLIN, 0};
+		if(::poll(&fd, 1, IDLE_POLL_MS) != 0) return;
+		m_api -> idle();
+	}
 }
 
 // The holy run loop!
@@ -344,6 +797,7 @@ void Trader::Run() {
         	std::cout << "[6] Market Streaming\n";
 		std::cout << "[7] Open Orders\n";
 		std::cout << "[8] Exit\n";
+		wait_input();
         	int inp; std::cin >> inp;
 
         	switch (inp) {
@@ -1,7 +1,19 @@
 #pragma once
 #include "utility.hpp"
 #include "Api.hpp"
+#include "market_data/TradeAggregator.hpp"
+#include "risk_management/OptionChain.hpp"
+#include "oms/PositionKeeper.hpp"
+#include "oms/StateJournal.hpp"
+#include "market_data/Instruments.hpp"
+#include "market_data/OrderBook.hpp"
+#include "market_data/MarketDataBus.hpp"
+#include "market_data/MarketDataFanout.hpp"
+#include "market_data/BookShards.hpp"
 #include <nlohmann/json.hpp>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
 
 class Trader{
 public:
@@ -14,6 +26,10 @@ public:
 	std::pair<int, std::string> cancel_order(const std::string&);
 	std::pair<int, std::string> modify_order(const std::string&, double, int);
 	std::pair<int, std::string> get_orderbook(const std::string&, int);
+	// Interned instrument with price in ticks and amount in lots, formatted exactly
+	std::pair<int, std::string> place_order(InstrumentId, Price, Qty);
+	std::pair<int, std::string> modify_order(const std::string&, InstrumentId, Price, Qty);
+	std::pair<int, std::string> get_orderbook(InstrumentId, int);
 	std::pair<int, std::string> view_position(const std::string&);
 	std::pair<int, std::string> get_openorders(const std::string&);
 	std::pair<int, std::string> get_marketdata(const std::string&, int);
@@ -27,6 +43,52 @@ public:
 	int handleViewPosition(const std::function<std::pair<int, std::string> (std::string)>& action);
 	int handleOpenOrders(const std::function<std::pair<int, std::string> (std::string)>& action);
 	int handleMarketData(const std::function<std::pair<int, std::string>(std::string, int)>& action); 
+
+	// Subscription notifications, called on the socket's reader thread or,
+	// for sockets without one (BSocket, USocket), inside Api requests and
+	// Api::poll() on the thread running the menu
+	void on_notification(const std::string& msg);
+	// Book, ticker and trades notifications for consumer threads (analytics,
+	// recording): subscribe() and read at their own pace, a lagging consumer
+	// gets the latest ticker per instrument and book / trades messages
+	// flagged where it missed some (MarketDataFanout::Update::gap)
+	MarketDataFanout& market_data(){ return m_fanout; }
 private:
+	// Waits for the next menu choice, keeping subscriptions flowing meanwhile
+	void wait_input();
+	// Snapshot of the instrument registry, refreshed when older than a day
+	int load_instruments(const std::string& path);
+	// Orders and positions of the previous run, reconciled with the exchange's open orders
+	void recover_state();
+	// Positions and orders a user.trades.* notification changed, into the journal
+	void journal_trades(const nlohmann::json& data);
+	static std::string order_payload(std::string_view method, std::string_view target, std::string_view price, std::string_view amount, char id);
+	static std::string orderbook_payload(std::string_view field, int depth);
+	// "channel" of a subscription notification without parsing it, empty when there is none
+	static std::string_view notification_channel(std::string_view msg);
+	void publish_book(InstrumentId id, const OrderBook& book);
+
 	Api *m_api;
+	Instruments m_instruments;
+	std::mutex m_md_mutex; // guards the market data state below
+	std::unordered_map<std::string, InstrumentId> m_order_instruments; // our open orders, dropped when filled or cancelled
+	TradeAggregator m_trades;
+	OptionChain m_options;
+	PositionKeeper m_positions;
+	uint64_t m_book_hits = 0;
+	uint64_t m_book_misses = 0;
+	uint64_t m_book_stale = 0;     // misses of a local book older than BOOK_MAX_AGE_MS
+	int64_t m_book_max_age_ms = 0; // time since the last update of a book served locally
+	MarketDataPublisher m_md_bus; // local books for other processes on the host
+	MarketDataFanout m_fanout;    // notifications for threads of this process
+	BookShards m_books;           // books with a live book.* subscription, updated on their shard's thread
+	StateJournal m_journal;       // open orders and positions, survives restarts
+	static constexpr const char* MD_BUS_NAME = "/hft_md";
+	static constexpr const char* STATE_PATH = "trader.state";
+	// Local positions are trusted for this long before asking the exchange again
+	static constexpr int64_t RECONCILE_MS = 60000;
+	static constexpr int64_t INSTRUMENTS_MAX_AGE_MS = 24 * 3600 * 1000;
+	// A local book this long without an update may have lost its feed, the exchange answers instead
+	static constexpr int64_t BOOK_MAX_AGE_MS = 2000;
+	static constexpr int IDLE_POLL_MS = 50;
 };
@@ -0,0 +1,98 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+// How a thread waits for something another thread hands it (a reply from
+// the I/O thread). The producer calls notify() after publishing; the
+// consumer reads epoch(), checks its condition and, when not met, calls
+// wait(epoch) which returns once notify() has been called since.
+//
+//   SPIN        pause loop, no syscalls, burns the core while waiting
+//   SPIN_YIELD  spins, then yields the core between checks
+//   SPIN_FUTEX  spins, then sleeps on a futex; notify() only enters the
+//               kernel when someone sleeps
+//   BLOCK       mutex + condition variable, every reply pays a wakeup
+//
+// Spinning modes need a core of their own to pay off: sharing one with the
+// producer, the spinner delays the very notify() it waits for.
+class WaitStrategy{
+public:
+	enum Mode : uint8_t { SPIN, SPIN_YIELD, SPIN_FUTEX, BLOCK };
+
+	// Constructor, `spins` pause iterations before yielding / sleeping
+	explicit WaitStrategy(Mode mode = BLOCK, uint32_t spins = 20000) : m_mode(mode), m_spins(spins) {}
+
+	Mode mode() const { return m_mode; }
+	static const char* name(Mode mode){
+		static const char* const names[] = {"spin", "spin-yield", "spin-futex", "block"};
+		return names[mode];
+	}
+
+	uint32_t epoch() const { return m_epoch.load(std::memory_order_acquire); }
+
+	// Producer side, after the data is published
+	void notify(){
+		if(m_mode == BLOCK){
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				m_epoch.fetch_add(1, std::memory_order_release);
+			}
+			m_cv.notify_all();
+			return;
+		}
+		// seq_cst pairs with the sleeper's registration, a wake can not be lost
+		m_epoch.fetch_add(1, std::memory_order_seq_cst);
+		if(m_mode == SPIN_FUTEX && m_sleepers.load(std::memory_order_seq_cst)){
+			syscall(SYS_futex, futex_word(), FUTEX_WAKE_PRIVATE, INT32_MAX, nullptr, nullptr, 0);
+		}
+	}
+
+	// Consumer side, returns once the epoch has moved past `seen`
+	void wait(uint32_t seen){
+		if(m_mode == BLOCK){
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_cv.wait(lock, [&]() { return m_epoch.load(std::memory_order_relaxed) != seen; });
+			return;
+		}
+		for(uint32_t i = 0; m_mode == SPIN || i < m_spins; i++){
+			if(m_epoch.load(std::memory_order_acquire) != seen) return;
+			cpu_relax();
+		}
+		while(m_epoch.load(std::memory_order_acquire) == seen){
+			if(m_mode == SPIN_YIELD){
+				std::this_thread::yield();
+				continue;
+			}
+			m_sleepers.fetch_add(1, std::memory_order_seq_cst);
+			// The kernel rechecks the word, a notify() since the load returns at once
+			if(m_epoch.load(std::memory_order_seq_cst) == seen){
+				syscall(SYS_futex, futex_word(), FUTEX_WAIT_PRIVATE, seen, nullptr, nullptr, 0);
+			}
+			m_sleepers.fetch_sub(1, std::memory_order_relaxed);
+		}
+	}
+
+	static void cpu_relax(){
+#if defined(__x86_64__) || defined(__i386__)
+		__builtin_ia32_pause();
+#elif defined(__aarch64__)
+		asm volatile("yield");
+#endif
+	}
+private:
+	uint32_t* futex_word(){ return reinterpret_cast<uint32_t*>(&m_epoch); }
+
+	Mode m_mode;
+	uint32_t m_spins;
+	alignas(64) std::atomic<uint32_t> m_epoch{0};
+	std::atomic<uint32_t> m_sleepers{0};
+	std::mutex m_mutex;
+	std::condition_variable m_cv;
+};
+static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t), "the futex word is the atomic itself");
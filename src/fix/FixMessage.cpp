@@ -0,0 +1,201 @@
+#include "FixMessage.hpp"
+#include "../Price.hpp"
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+
+static constexpr std::string_view BEGIN = "8=FIX.4.4\x01" "9=";
+
+// Eight bytes at a time into four 16 bit lanes, emptied before one can
+// overflow; only the sum mod 256 is wanted so the lanes fold with a multiply
+static uint32_t checksum(const char* p, size_t n){
+	constexpr uint64_t EVEN = 0x00ff00ff00ff00ffull;
+	uint32_t sum = 0;
+	size_t i = 0;
+	while(i + 8 <= n){
+		uint64_t lanes = 0;
+		size_t end = std::min(n & ~size_t(7), i + 8 * 128);
+		for(; i < end; i += 8){
+			uint64_t w;
+			std::memcpy(&w, p + i, 8);
+			lanes += (w & EVEN) + ((w >> 8) & EVEN);
+		}
+		sum += static_cast<uint32_t>((lanes * 0x0001000100010001ull) >> 48);
+	}
+	for(; i < n; i++) sum += static_cast<unsigned char>(p[i]);
+	return sum & 0xff;
+}
+
+int64_t FixMessage::frame(std::string_view buf){
+	size_t n = std::min(buf.size(), BEGIN.size());
+	if(buf.compare(0, n, BEGIN.substr(0, n)) != 0) return -1;
+	if(buf.size() <= BEGIN.size()) return 0;
+	// BodyLength counts from after its own field up to the CheckSum field
+	size_t length = 0, i = BEGIN.size();
+	for(; i < buf.size() && buf[i] != SOH; i++){
+		if(buf[i] < '0' || buf[i] > '9' || i - BEGIN.size() > 6) return -1;
+		length = length * 10 + static_cast<size_t>(buf[i] - '0');
+	}
+	if(i == buf.size()) return 0;
+	if(i == BEGIN.size()) return -1;
+	size_t total = i + 1 + length + 7;
+	if(buf.size() < total) return 0;
+	if(buf.compare(total - 7, 3, "10=") != 0 || buf[total - 1] != SOH) return -1;
+	return static_cast<int64_t>(total);
+}
+
+[[nodiscard]] int FixMessage::parse(std::string_view msg){
+	m_raw = msg;
+	m_type = std::string_view();
+	m_seq = 0;
+	m_count = 0;
+	const char* p = msg.data();
+	const char* end = p + msg.size();
+	const char* trailer = nullptr;
+	while(p < end){
+		uint32_t tag = 0;
+		const char* start = p;
+		for(; p < end && *p >= '0' && *p <= '9'; p++) tag = tag * 10 + static_cast<uint32_t>(*p - '0');
+		if(p == start || p == end || *p != '=') return 1;
+		const char* value = ++p;
+		p = static_cast<const char*>(std::memchr(p, SOH, static_cast<size_t>(end - p)));
+		if(!p) return 1;
+		if(m_count == MAX_FIELDS) return 1;
+		m_fields[m_count++] = Field{tag, std::string_view(value, static_cast<size_t>(p - value))};
+		if(tag == CHECKSUM) trailer = start;
+		else if(tag == MSG_TYPE && m_type.empty()) m_type = m_fields[m_count - 1].value;
+		p++;
+	}
+	// BeginString, BodyLength, MsgType lead, CheckSum closes
+	if(m_count < 4 || m_fields[0].tag != BEGIN_STRING || m_fields[1].tag != BODY_LENGTH || m_fields[2].tag != MSG_TYPE) return 1;
+	if(!trailer || m_fields[m_count - 1].tag != CHECKSUM) return 1;
+	if(static_cast<int64_t>(checksum(msg.data(), static_cast<size_t>(trailer - msg.data()))) != get_int(CHECKSUM, -1)) return 1;
+	m_seq = static_cast<uint64_t>(get_int(MSG_SEQ_NUM));
+	return m_seq ? 0 : 1;
+}
+
+bool FixMessage::has(uint32_t tag) const{
+	for(uint32_t i = 0; i < m_count; i++){
+		if(m_fields[i].tag == tag) return true;
+	}
+	return false;
+}
+
+int64_t FixMessage::get_int(uint32_t tag, int64_t def) const{
+	std::string_view v = get(tag);
+	int64_t out;
+	auto [end, ec] = std::from_chars(v.data(), v.data() + v.size(), out);
+	return ec == std::errc() && end == v.data() + v.size() && !v.empty() ? out : def;
+}
+
+double FixMessage::get_double(uint32_t tag, double def) const{
+	std::string_view v = get(tag);
+	double out;
+	auto [end, ec] = std::from_chars(v.data(), v.data() + v.size(), out);
+	return ec == std::errc() && end == v.data() + v.size() && !v.empty() ? out : def;
+}
+
+void FixWriter::start(std::string_view prefix){
+	m_len = HEADROOM;
+	m_overflow = false;
+	append(prefix);
+}
+
+void FixWriter::append(std::string_view fields){
+	if(!fits(fields.size())) return;
+	std::memcpy(m_buf + m_len, fields.data(), fields.size());
+	m_len += fields.size();
+}
+
+void FixWriter::put_tag(uint32_t tag){
+	m_len = static_cast<size_t>(std::to_chars(m_buf + m_len, m_buf + CAPACITY, tag).ptr - m_buf);
+	m_buf[m_len++] = '=';
+}
+
+void FixWriter::add(uint32_t tag, std::string_view value){
+	if(!fits(value.size() + 12)) return;
+	put_tag(tag);
+	std::memcpy(m_buf + m_len, value.data(), value.size());
+	m_len += value.size();
+	m_buf[m_len++] = FixMessage::SOH;
+}
+
+void FixWriter::add_int(uint32_t tag, int64_t value){
+	if(!fits(32)) return;
+	put_tag(tag);
+	m_len = static_cast<size_t>(std::to_chars(m_buf + m_len, m_buf + CAPACITY, value).ptr - m_buf);
+	m_buf[m_len++] = FixMessage::SOH;
+}
+
+void FixWriter::add_double(uint32_t tag, double value){
+	if(!fits(40)) return;
+	put_tag(tag);
+	// Prices and amounts are on a decimal grid: the first power of ten that
+	// makes the value whole gives its digits without a shortest search
+	double p = 1;
+	for(uint8_t d = 0; d <= 8; d++, p *= 10){
+		double m = value * p;
+		if(std::fabs(m) >= 1e15) break;
+		if(m == std::floor(m)){
+			m_len = static_cast<size_t>(format_decimal(m_buf + m_len, m_buf + CAPACITY, static_cast<int64_t>(m), Scale{1, d}) - m_buf);
+			m_buf[m_len++] = FixMessage::SOH;
+			return;
+		}
+	}
+	// Shortest round trip notation; FIX floats have no exponent
+	auto [end, ec] = std::to_chars(m_buf + m_len, m_buf + CAPACITY, value, std::chars_format::fixed);
+	if(ec != std::errc()){
+		m_overflow = true;
+		return;
+	}
+	m_len = static_cast<size_t>(end - m_buf);
+	m_buf[m_len++] = FixMessage::SOH;
+}
+
+void FixWriter::add_time(uint32_t tag, int64_t ns){
+	if(!fits(32)) return;
+	int64_t second = ns / 1000000000;
+	if(second != m_second){
+		time_t t = static_cast<time_t>(second);
+		tm utc;
+		gmtime_r(&t, &utc);
+		char text[64];
+		std::snprintf(text, sizeof(text), "%04d%02d%02d-%02d:%02d:%02d", utc.tm_year + 1900, utc.tm_mon + 1, utc.tm_mday,
+			utc.tm_hour, utc.tm_min, utc.tm_sec);
+		std::memcpy(m_second_text, text, sizeof(m_second_text));
+		m_second = second;
+	}
+	put_tag(tag);
+	std::memcpy(m_buf + m_len, m_second_text, sizeof(m_second_text));
+	m_len += sizeof(m_second_text);
+	int ms = static_cast<int>(ns / 1000000 % 1000);
+	m_buf[m_len++] = '.';
+	m_buf[m_len++] = static_cast<char>('0' + ms / 100);
+	m_buf[m_len++] = static_cast<char>('0' + ms / 10 % 10);
+	m_buf[m_len++] = static_cast<char>('0' + ms % 10);
+	m_buf[m_len++] = FixMessage::SOH;
+}
+
+std::string_view FixWriter::finish(){
+	if(m_overflow) return std::string_view();
+	char length[16];
+	char* end = std::to_chars(length, length + sizeof(length), m_len - HEADROOM).ptr;
+	size_t digits = static_cast<size_t>(end - length);
+	size_t start = HEADROOM - BEGIN.size() - digits - 1;
+	std::memcpy(m_buf + start, BEGIN.data(), BEGIN.size());
+	std::memcpy(m_buf + start + BEGIN.size(), length, digits);
+	m_buf[HEADROOM - 1] = FixMessage::SOH;
+	uint32_t sum = checksum(m_buf + start, m_len - start);
+	char* p = m_buf + m_len;
+	p[0] = '1';
+	p[1] = '0';
+	p[2] = '=';
+	p[3] = static_cast<char>('0' + sum / 100);
+	p[4] = static_cast<char>('0' + sum / 10 % 10);
+	p[5] = static_cast<char>('0' + sum % 10);
+	p[6] = FixMessage::SOH;
+	return std::string_view(m_buf + start, m_len + TRAILER - start);
+}
@@ -0,0 +1,152 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+// FIX 4.4 tag=value messages.
+//
+// FixMessage is a view of one received message: parse() records where each
+// field's value sits in the caller's buffer and copies nothing, so it is
+// only valid as long as that buffer is. FixWriter builds an outgoing message
+// in a fixed buffer: a preformatted prefix (MsgType and the CompIDs, which
+// never change within a session), the fields that do, then BeginString and
+// BodyLength are put in front and CheckSum at the end.
+class FixMessage{
+public:
+	static constexpr char SOH = '\x01';
+	static constexpr size_t MAX_FIELDS = 128;
+	enum Tag : uint32_t {
+		AVG_PX = 6,
+		BEGIN_SEQ_NO = 7,
+		BEGIN_STRING = 8,
+		BODY_LENGTH = 9,
+		CHECKSUM = 10,
+		CL_ORD_ID = 11,
+		CUM_QTY = 14,
+		END_SEQ_NO = 16,
+		EXEC_ID = 17,
+		EXEC_INST = 18,
+		LAST_PX = 31,
+		LAST_QTY = 32,
+		MSG_SEQ_NUM = 34,
+		MSG_TYPE = 35,
+		NEW_SEQ_NO = 36,
+		ORDER_ID = 37,
+		ORDER_QTY = 38,
+		ORD_STATUS = 39,
+		ORD_TYPE = 40,
+		ORIG_CL_ORD_ID = 41,
+		POSS_DUP_FLAG = 43,
+		PRICE = 44,
+		REF_SEQ_NUM = 45,
+		SENDER_COMP_ID = 49,
+		SENDING_TIME = 52,
+		SIDE = 54,
+		SYMBOL = 55,
+		TARGET_COMP_ID = 56,
+		TEXT = 58,
+		TIME_IN_FORCE = 59,
+		TRANSACT_TIME = 60,
+		RAW_DATA_LENGTH = 95,
+		RAW_DATA = 96,
+		ENCRYPT_METHOD = 98,
+		CXL_REJ_REASON = 102,
+		ORD_REJ_REASON = 103,
+		HEART_BT_INT = 108,
+		TEST_REQ_ID = 112,
+		ORIG_SENDING_TIME = 122,
+		GAP_FILL_FLAG = 123,
+		RESET_SEQ_NUM_FLAG = 141,
+		EXEC_TYPE = 150,
+		LEAVES_QTY = 151,
+		SESSION_REJECT_REASON = 373,
+		CXL_REJ_RESPONSE_TO = 434,
+		USERNAME = 553,
+		PASSWORD = 554,
+	};
+	struct Field{
+		uint32_t tag;
+		std::string_view value;
+	};
+
+	// Length of the message at the start of `buf`: 0 while more bytes are
+	// needed, -1 when `buf` does not start with a FIX 4.4 header
+	static int64_t frame(std::string_view buf);
+	// Indexes the fields of one framed message, 0 when it is well formed and
+	// its checksum matches
+	[[nodiscard]] int parse(std::string_view msg);
+
+	// Value of the first `tag` field, empty when there is none
+	std::string_view get(uint32_t tag) const{
+		for(uint32_t i = 0; i < m_count; i++){
+			if(m_fields[i].tag == tag) return m_fields[i].value;
+		}
+		return std::string_view();
+	}
+	bool has(uint32_t tag) const;
+	int64_t get_int(uint32_t tag, int64_t def = 0) const;
+	double get_double(uint32_t tag, double def = 0) const;
+	// First character of a char field, 0 when absent
+	char get_char(uint32_t tag) const{
+		std::string_view v = get(tag);
+		return v.empty() ? 0 : v[0];
+	}
+
+	std::string_view type() const { return m_type; }
+	uint64_t seq() const { return m_seq; }
+	std::string_view raw() const { return m_raw; }
+	size_t size() const { return m_count; }
+	const Field& field(size_t i) const { return m_fields[i]; }
+	// Admin (session level) message types: 0 1 2 3 4 5 A
+	static bool is_admin(std::string_view type){
+		return type.size() == 1 && (type[0] == 'A' || (type[0] >= '0' && type[0] <= '5'));
+	}
+private:
+	std::string_view m_raw;
+	std::string_view m_type;
+	uint64_t m_seq = 0;
+	uint32_t m_count = 0;
+	Field m_fields[MAX_FIELDS];
+};
+
+class FixWriter{
+public:
+	static constexpr size_t CAPACITY = 2048;
+
+	// Starts a message with the preformatted `prefix` ("35=D\x0149=...\x0156=...\x01")
+	void start(std::string_view prefix);
+	void add(uint32_t tag, std::string_view value);
+	void add(uint32_t tag, const char* value){ add(tag, std::string_view(value)); }
+	void add(uint32_t tag, char value){ add(tag, std::string_view(&value, 1)); }
+	void add_int(uint32_t tag, int64_t value);
+	// Shortest decimal that reads back as `value`
+	void add_double(uint32_t tag, double value);
+	// UTCTimestamp with milliseconds, YYYYMMDD-HH:MM:SS.sss
+	void add_time(uint32_t tag, int64_t ns);
+	// Fields already formatted as tag=value\x01..., copied as they are
+	void append(std::string_view fields);
+
+	// Bytes written since start(), the body so far
+	size_t size() const { return m_len - HEADROOM; }
+	std::string_view body(size_t from) const { return std::string_view(m_buf + HEADROOM + from, m_len - HEADROOM - from); }
+	// The complete message, empty when the fields did not fit
+	std::string_view finish();
+private:
+	// Room for "8=FIX.4.4\x019=<length>\x01" in front of the body
+	static constexpr size_t HEADROOM = 24;
+	// And for "10=nnn\x01" behind it
+	static constexpr size_t TRAILER = 7;
+	bool fits(size_t n){
+		if(m_len + n + TRAILER <= CAPACITY) return true;
+		m_overflow = true;
+		return false;
+	}
+	void put_tag(uint32_t tag);
+
+	char m_buf[CAPACITY];
+	size_t m_len = HEADROOM;
+	bool m_overflow = false;
+	// YYYYMMDD-HH:MM:SS of the second last formatted, most messages share it
+	int64_t m_second = -1;
+	char m_second_text[17];
+};
@@ -0,0 +1,330 @@
+#include "FixSession.hpp"
+#include "../Logger.hpp"
+#include "../utility.hpp"
+#include <openssl/evp.h>
+#include <openssl/rand.h>
+
+// Constructor
+FixSession::FixSession(Role role, Options options, Send send) : m_role(role), m_options(std::move(options)), m_send(std::move(send)) {
+	size_t store = 1;
+	while(store < m_options.store) store <<= 1;
+	m_store.resize(store);
+	for(Stored& s : m_store) s.body.reserve(256);
+}
+
+std::string_view FixSession::prefix(char type){
+	std::string& p = m_prefix[static_cast<unsigned char>(type) & 127];
+	if(p.empty()){
+		p = std::string("35=") + type + FixMessage::SOH
+			+ "49=" + m_options.sender_comp_id + FixMessage::SOH
+			+ "56=" + m_options.target_comp_id + FixMessage::SOH;
+	}
+	return p;
+}
+
+FixWriter& FixSession::begin(char type, int64_t now_ns){
+	m_writer.start(prefix(type));
+	m_writer.add_int(FixMessage::MSG_SEQ_NUM, static_cast<int64_t>(m_out_seq));
+	m_writer.add_time(FixMessage::SENDING_TIME, now_ns);
+	m_type = type;
+	m_body = m_writer.size();
+	m_time_ns = now_ns;
+	return m_writer;
+}
+
+int FixSession::send(){
+	std::string_view msg = m_writer.finish();
+	if(msg.empty()) return 1;
+	// Application messages are kept to be sent again, admin ones are gap filled
+	if(!FixMessage::is_admin(std::string_view(&m_type, 1))){
+		Stored& s = m_store[m_out_seq & (m_store.size() - 1)];
+		s.seq = m_out_seq;
+		s.type = m_type;
+		s.time_ns = m_time_ns;
+		s.body.assign(m_writer.body(m_body));
+	}
+	m_out_seq++;
+	return transmit(msg);
+}
+
+// Numbers start over, messages of the last session are never sent again
+void FixSession::reset_out(){
+	m_out_seq = 1;
+	for(Stored& s : m_store) s.seq = 0;
+}
+
+int FixSession::transmit(std::string_view msg){
+	m_stats.sent++;
+	m_last_sent_ns = mono_ns();
+	return m_send(msg);
+}
+
+static std::string base64(const unsigned char* data, size_t len){
+	std::string out(4 * ((len + 2) / 3), '\0');
+	int n = EVP_EncodeBlock(reinterpret_cast<unsigned char*>(out.data()), data, static_cast<int>(len));
+	out.resize(n > 0 ? static_cast<size_t>(n) : 0);
+	return out;
+}
+
+int FixSession::send_logon(bool reset, int64_t now_ns){
+	FixWriter& w = begin('A', now_ns);
+	w.add_int(FixMessage::ENCRYPT_METHOD, 0);
+	w.add_int(FixMessage::HEART_BT_INT, m_options.heartbeat_s);
+	if(reset) w.add(FixMessage::RESET_SEQ_NUM_FLAG, 'Y');
+	if(m_role == INITIATOR && !m_options.username.empty()){
+		unsigned char nonce[32];
+		if(RAND_bytes(nonce, sizeof(nonce)) != 1) return 1;
+		std::string raw = std::to_string(now_ns / 1000000) + "." + base64(nonce, sizeof(nonce));
+		std::string signed_data = raw + m_options.secret;
+		unsigned char digest[EVP_MAX_MD_SIZE];
+		unsigned int digest_len = 0;
+		if(EVP_Digest(signed_data.data(), signed_data.size(), digest, &digest_len, EVP_sha256(), nullptr) != 1) return 1;
+		w.add_int(FixMessage::RAW_DATA_LENGTH, static_cast<int64_t>(raw.size()));
+		w.add(FixMessage::RAW_DATA, raw);
+		w.add(FixMessage::USERNAME, m_options.username);
+		w.add(FixMessage::PASSWORD, base64(digest, digest_len));
+	}
+	return send();
+}
+
+[[nodiscard]] int FixSession::logon(int64_t now_ns, bool resume){
+	if(m_role != INITIATOR) return 1;
+	bool reset = m_options.reset_seq && !resume;
+	if(reset) reset_out();
+	if(reset) m_in_seq = 1;
+	m_resend_until = 0;
+	m_test_sent_ns = 0;
+	m_last_recv_ns = mono_ns();
+	m_state = LOGON_SENT;
+	return send_logon(reset, now_ns);
+}
+
+[[nodiscard]] int FixSession::logout(std::string_view text, int64_t now_ns){
+	if(m_state == DISCONNECTED) return 1;
+	FixWriter& w = begin('5', now_ns);
+	if(!text.empty()) w.add(FixMessage::TEXT, text);
+	m_state = LOGOUT_SENT;
+	return send();
+}
+
+int FixSession::heartbeat(std::string_view test_req_id, int64_t now_ns){
+	FixWriter& w = begin('0', now_ns);
+	if(!test_req_id.empty()) w.add(FixMessage::TEST_REQ_ID, test_req_id);
+	return send();
+}
+
+int64_t FixSession::on_data(std::string_view data, int64_t now_ns){
+	size_t consumed = 0;
+	while(consumed < data.size()){
+		std::string_view rest = data.substr(consumed);
+		int64_t n = FixMessage::frame(rest);
+		if(n < 0) return -1;
+		if(n == 0) break;
+		consumed += static_cast<size_t>(n);
+		m_last_recv_ns = mono_ns();
+		m_test_sent_ns = 0;
+		// A garbled message is ignored, its sequence number is not taken
+		if(m_msg.parse(rest.substr(0, static_cast<size_t>(n)))){
+			m_stats.garbled++;
+			continue;
+		}
+		m_stats.received++;
+		handle(m_msg, now_ns);
+	}
+	return static_cast<int64_t>(consumed);
+}
+
+void FixSession::handle(const FixMessage& msg, int64_t now_ns){
+	std::string_view type = msg.type();
+	char t = type.size() == 1 ? type[0] : 0;
+	uint64_t seq = msg.seq();
+
+	if(t == 'A'){
+		bool reset = msg.get_char(FixMessage::RESET_SEQ_NUM_FLAG) == 'Y';
+		if(reset) m_in_seq = seq;
+		if(m_role == ACCEPTOR){
+			if(reset) reset_out();
+			m_options.heartbeat_s = static_cast<int>(msg.get_int(FixMessage::HEART_BT_INT, m_options.heartbeat_s));
+			m_options.reset_seq = reset;
+			if(send_logon(reset, now_ns)) return;
+		}
+		m_state = ACTIVE;
+	} else if(t == '4' && msg.get_char(FixMessage::GAP_FILL_FLAG) != 'Y'){
+		// SequenceReset-Reset: the number is taken whatever this message's own is
+		m_in_seq = static_cast<uint64_t>(msg.get_int(FixMessage::NEW_SEQ_NO, static_cast<int64_t>(m_in_seq)));
+		return;
+	}
+
+	if(seq > m_in_seq){
+		// Everything from the gap on is sent again, one request at a time;
+		// asked again when the answer did not close the gap in an interval
+		int64_t interval = static_cast<int64_t>(m_options.heartbeat_s) * 1000000000;
+		int64_t mono = mono_ns();
+		if(m_resend_until < m_in_seq || mono - m_resend_ns >= interval){
+			FixWriter& w = begin('2', now_ns);
+			w.add_int(FixMessage::BEGIN_SEQ_NO, static_cast<int64_t>(m_in_seq));
+			w.add_int(FixMessage::END_SEQ_NO, 0);
+			if(send() == 0){
+				m_resend_until = seq;
+				m_resend_ns = mono;
+			}
+			m_stats.gaps++;
+			Logger::instance().log(LogId::FIX_GAP, m_in_seq, seq);
+		}
+		if(t == '5'){
+			m_state = DISCONNECTED;
+			Logger::instance().log_text(LogId::FIX_LOGOUT, msg.get(FixMessage::TEXT));
+		}
+		return;
+	}
+	if(seq < m_in_seq){
+		if(msg.get_char(FixMessage::POSS_DUP_FLAG) == 'Y') return;
+		// Messages were lost for good, the session can not go on
+		Logger::instance().log_text(LogId::FIX_LOGOUT, "MsgSeqNum too low");
+		FixWriter& w = begin('5', now_ns);
+		w.add(FixMessage::TEXT, "MsgSeqNum too low");
+		m_state = DISCONNECTED;
+		send();
+		return;
+	}
+	m_in_seq++;
+	if(m_resend_until && m_in_seq > m_resend_until) m_resend_until = 0;
+
+	switch(t){
+		case 'A':
+			Logger::instance().log(LogId::FIX_LOGON, m_role == INITIATOR ? "initiator" : "acceptor", m_in_seq, m_out_seq);
+			break;
+		case '0':
+			break;
+		case '1':
+			heartbeat(msg.get(FixMessage::TEST_REQ_ID), now_ns);
+			break;
+		case '2':
+			resend(static_cast<uint64_t>(msg.get_int(FixMessage::BEGIN_SEQ_NO)), static_cast<uint64_t>(msg.get_int(FixMessage::END_SEQ_NO)), now_ns);
+			break;
+		case '3':
+			m_stats.rejects++;
+			Logger::instance().log_text(LogId::FIX_REJECT, msg.get(FixMessage::TEXT), msg.get_int(FixMessage::REF_SEQ_NUM));
+			break;
+		case '4':
+			m_in_seq = std::max(m_in_seq, static_cast<uint64_t>(msg.get_int(FixMessage::NEW_SEQ_NO)));
+			break;
+		case '5':
+			// Answered unless it answers ours
+			if(m_state != LOGOUT_SENT){
+				begin('5', now_ns);
+				send();
+			}
+			m_state = DISCONNECTED;
+			Logger::instance().log_text(LogId::FIX_LOGOUT, msg.get(FixMessage::TEXT));
+			break;
+		default:
+			if(m_state == ACTIVE && m_on_message) m_on_message(msg);
+			break;
+	}
+}
+
+void FixSession::gap_fill(uint64_t seq, uint64_t next, int64_t now_ns){
+	m_writer.start(prefix('4'));
+	m_writer.add_int(FixMessage::MSG_SEQ_NUM, static_cast<int64_t>(seq));
+	m_writer.add(FixMessage::POSS_DUP_FLAG, 'Y');
+	m_writer.add_time(FixMessage::SENDING_TIME, now_ns);
+	m_writer.add_time(FixMessage::ORIG_SENDING_TIME, now_ns);
+	m_writer.add(FixMessage::GAP_FILL_FLAG, 'Y');
+	m_writer.add_int(FixMessage::NEW_SEQ_NO, static_cast<int64_t>(next));
+	transmit(m_writer.finish());
+}
+
+// Stored application messages go out again as possible duplicates, runs
+// of admin messages and ones no longer stored become one gap fill
+void FixSession::resend(uint64_t from, uint64_t to, int64_t now_ns){
+	if(to == 0 || to >= m_out_seq) to = m_out_seq - 1;
+	if(from == 0) from = 1;
+	uint64_t gap = 0;
+	for(uint64_t seq = from; seq <= to; seq++){
+		const Stored& s = m_store[seq & (m_store.size() - 1)];
+		if(s.seq != seq){
+			if(!gap) gap = seq;
+			continue;
+		}
+		if(gap){
+			gap_fill(gap, seq, now_ns);
+			gap = 0;
+		}
+		m_writer.start(prefix(s.type));
+		m_writer.add_int(FixMessage::MSG_SEQ_NUM, static_cast<int64_t>(seq));
+		m_writer.add(FixMessage::POSS_DUP_FLAG, 'Y');
+		m_writer.add_time(FixMessage::SENDING_TIME, now_ns);
+		m_writer.add_time(FixMessage::ORIG_SENDING_TIME, s.time_ns);
+		m_writer.append(s.body);
+		transmit(m_writer.finish());
+		m_stats.resent++;
+	}
+	if(gap) gap_fill(gap, to + 1, now_ns);
+}
+
+void FixSession::poll(int64_t now_ns){
+	if(m_state == DISCONNECTED) return;
+	int64_t interval = static_cast<int64_t>(m_options.heartbeat_s) * 1000000000;
+	// Intervals on the monotonic clock, a wall clock step neither hurries nor holds them
+	int64_t mono = mono_ns();
+	if(m_state == LOGON_SENT){
+		if(mono - m_last_sent_ns >= interval){
+			m_state = DISCONNECTED;
+			Logger::instance().log_text(LogId::FIX_LOGOUT, "no Logon reply");
+		}
+		return;
+	}
+	if(mono - m_last_sent_ns >= interval) heartbeat(std::string_view(), now_ns);
+	if(!m_test_sent_ns && mono - m_last_recv_ns >= interval + interval / 5){
+		FixWriter& w = begin('1', now_ns);
+		w.add_int(FixMessage::TEST_REQ_ID, static_cast<int64_t>(++m_test_id));
+		if(send() == 0) m_test_sent_ns = mono;
+	} else if(m_test_sent_ns && mono - m_test_sent_ns >= interval){
+		m_state = DISCONNECTED;
+		Logger::instance().log_text(LogId::FIX_LOGOUT, "no answer to a TestRequest");
+	}
+}
+
+[[nodiscard]] int FixSession::new_order(std::string_view cl_ord_id, std::string_view symbol, bool buy, double qty, double price, uint8_t flags, int64_t now_ns){
+	if(m_state != ACTIVE) return 1;
+	FixWriter& w = begin('D', now_ns);
+	w.add(FixMessage::CL_ORD_ID, cl_ord_id);
+	w.add(FixMessage::SYMBOL, symbol);
+	w.add(FixMessage::SIDE, buy ? '1' : '2');
+	w.add_double(FixMessage::ORDER_QTY, qty);
+	if(flags & MARKET){
+		w.add(FixMessage::ORD_TYPE, '1');
+	} else {
+		w.add(FixMessage::ORD_TYPE, '2');
+		w.add_double(FixMessage::PRICE, price);
+	}
+	w.add(FixMessage::TIME_IN_FORCE, flags & IOC ? '3' : '1');
+	if(flags & POST_ONLY) w.add(FixMessage::EXEC_INST, '6');
+	w.add_time(FixMessage::TRANSACT_TIME, now_ns);
+	return send();
+}
+
+[[nodiscard]] int FixSession::cancel_order(std::string_view cl_ord_id, std::string_view order_id, std::string_view symbol, int64_t now_ns){
+	if(m_state != ACTIVE) return 1;
+	FixWriter& w = begin('F', now_ns);
+	w.add(FixMessage::CL_ORD_ID, cl_ord_id);
+	w.add(FixMessage::ORIG_CL_ORD_ID, order_id);
+	if(!symbol.empty()) w.add(FixMessage::SYMBOL, symbol);
+	w.add_time(FixMessage::TRANSACT_TIME, now_ns);
+	return send();
+}
+
+[[nodiscard]] int FixSession::replace_order(std::string_view cl_ord_id, std::string_view order_id, std::string_view symbol, bool buy, double qty, double price, int64_t now_ns){
+	if(m_state != ACTIVE) return 1;
+	FixWriter& w = begin('G', now_ns);
+	w.add(FixMessage::CL_ORD_ID, cl_ord_id);
+	w.add(FixMessage::ORIG_CL_ORD_ID, order_id);
+	if(!symbol.empty()) w.add(FixMessage::SYMBOL, symbol);
+	w.add(FixMessage::SIDE, buy ? '1' : '2');
+	w.add_double(FixMessage::ORDER_QTY, qty);
+	w.add(FixMessage::ORD_TYPE, '2');
+	w.add_double(FixMessage::PRICE, price);
+	w.add_time(FixMessage::TRANSACT_TIME, now_ns);
+	return send();
+}
@@ -0,0 +1,133 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "FixMessage.hpp"
+
+// FIX 4.4 session layer: logon, heartbeats and test requests, sequence
+// numbers both ways, resend on request and gap detection.
+//
+// It does no I/O. Outgoing messages go to the `Send` callback whole, bytes
+// received are passed to on_data(), and poll() keeps the heartbeats going.
+// The `now_ns` passed in is wall clock time for SendingTime and the Logon
+// signature; heartbeat and TestRequest intervals run on the monotonic clock.
+// Application messages come out of the OnMessage callback in sequence; one
+// that arrives after a gap is dropped and a ResendRequest sent, the peer
+// then sends it again. Sent application messages are kept for a
+// ResendRequest of ours, admin messages are gap filled.
+//
+// The initiator signs its Logon for Deribit (RawData = timestamp.nonce,
+// Password = base64(sha256(RawData + secret))) when a username is set.
+// Not thread safe.
+class FixSession{
+public:
+	enum Role : uint8_t { INITIATOR, ACCEPTOR };
+	enum State : uint8_t { DISCONNECTED, LOGON_SENT, ACTIVE, LOGOUT_SENT };
+	enum OrderFlags : uint8_t {
+		POST_ONLY = 1,  // ExecInst 6, participate don't initiate
+		IOC = 2,        // TimeInForce 3
+		MARKET = 4,     // OrdType 1, the price is ignored
+	};
+	struct Options{
+		std::string sender_comp_id = "CLIENT";
+		std::string target_comp_id = "DERIBITSERVER";
+		std::string username;        // Deribit client id, empty: no credentials in the Logon
+		std::string secret;          // client secret, signs the Logon
+		int heartbeat_s = 30;
+		bool reset_seq = true;       // ResetSeqNumFlag on Logon, both sides start at 1
+		size_t store = 4096;         // sent messages kept for resend, a power of two
+	};
+	struct Stats{
+		uint64_t sent = 0;
+		uint64_t received = 0;
+		uint64_t resent = 0;         // messages sent again on a ResendRequest
+		uint64_t gaps = 0;           // ResendRequests of ours
+		uint64_t rejects = 0;        // session level Rejects received
+		uint64_t garbled = 0;        // dropped for a bad checksum or format
+	};
+	// Writes one message to the transport, 0 when it was sent
+	using Send = std::function<int(std::string_view)>;
+	using OnMessage = std::function<void(const FixMessage&)>;
+
+	// Constructor
+	FixSession(Role role, Options options, Send send);
+
+	void on_message(OnMessage fn){ m_on_message = std::move(fn); }
+	// Signs the next Logon with these
+	void set_credentials(std::string username, std::string secret){
+		m_options.username = std::move(username);
+		m_options.secret = std::move(secret);
+	}
+
+	// `resume`: no ResetSeqNumFlag whatever the options, the numbers go on
+	// from where they are (see set_next), e.g. after a reconnect
+	[[nodiscard]] int logon(int64_t now_ns, bool resume = false);
+	[[nodiscard]] int logout(std::string_view text, int64_t now_ns);
+	// Bytes from the transport, returns how many were consumed: the rest is
+	// an incomplete message to pass again with more appended. -1 when the
+	// stream is not FIX, the connection can only be dropped
+	int64_t on_data(std::string_view data, int64_t now_ns);
+	// Heartbeat after a quiet interval, TestRequest when the peer went
+	// quiet, DISCONNECTED when it did not answer. Call at least once a second
+	void poll(int64_t now_ns);
+
+	// Order entry, `cl_ord_id` comes back in the ExecutionReports
+	[[nodiscard]] int new_order(std::string_view cl_ord_id, std::string_view symbol, bool buy, double qty, double price, uint8_t flags, int64_t now_ns);
+	[[nodiscard]] int cancel_order(std::string_view cl_ord_id, std::string_view order_id, std::string_view symbol, int64_t now_ns);
+	// OrderCancelReplaceRequest, `qty` is the new total
+	[[nodiscard]] int replace_order(std::string_view cl_ord_id, std::string_view order_id, std::string_view symbol, bool buy, double qty, double price, int64_t now_ns);
+
+	// Any message: begin() writes the header, the caller adds the body
+	// fields to the writer it returns, send() finishes and sends it
+	FixWriter& begin(char type, int64_t now_ns);
+	int send();
+
+	State state() const { return m_state; }
+	uint64_t next_out() const { return m_out_seq; }
+	uint64_t next_in() const { return m_in_seq; }
+	const Stats& stats() const { return m_stats; }
+	// Sequence numbers to continue from, e.g. after a reconnect without reset
+	void set_next(uint64_t out, uint64_t in){ m_out_seq = out; m_in_seq = in; }
+private:
+	// A sent message, enough of it to send again
+	struct Stored{
+		uint64_t seq = 0;
+		char type = 0;
+		int64_t time_ns = 0;     // its SendingTime
+		std::string body;        // the fields after the header
+	};
+
+	void handle(const FixMessage& msg, int64_t now_ns);
+	void resend(uint64_t from, uint64_t to, int64_t now_ns);
+	void gap_fill(uint64_t seq, uint64_t next, int64_t now_ns);
+	int send_logon(bool reset, int64_t now_ns);
+	int heartbeat(std::string_view test_req_id, int64_t now_ns);
+	// "35=<type>\x0149=<sender>\x0156=<target>\x01", built once per type
+	std::string_view prefix(char type);
+	int transmit(std::string_view msg);
+	void reset_out();
+
+	Role m_role;
+	Options m_options;
+	Send m_send;
+	OnMessage m_on_message;
+	State m_state = DISCONNECTED;
+	uint64_t m_out_seq = 1;      // next to send
+	uint64_t m_in_seq = 1;       // next expected
+	uint64_t m_resend_until = 0; // a ResendRequest of ours is open up to this seq
+	int64_t m_resend_ns = 0;     // when it was sent
+	int64_t m_last_sent_ns = 0;
+	int64_t m_last_recv_ns = 0;
+	int64_t m_test_sent_ns = 0;  // 0 when no TestRequest is open
+	uint64_t m_test_id = 0;
+	std::string m_prefix[128];
+	FixWriter m_writer;
+	char m_type = 0;             // of the message being written
+	size_t m_body = 0;           // its body's offset in the writer
+	int64_t m_time_ns = 0;       // its SendingTime
+	std::vector<Stored> m_store;
+	FixMessage m_msg;
+	Stats m_stats;
+};
@@ -0,0 +1,414 @@
+#include "FixSocket.hpp"
+#include "../Logger.hpp"
+#include "../utility.hpp"
+#include <cstring>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <nlohmann/json.hpp>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+// Constructor
+FixSocket::FixSocket() : FixSocket(Options()) {}
+
+FixSocket::FixSocket(Options options)
+	: m_options(std::move(options)),
+	  m_session(FixSession::INITIATOR, m_options.session, [this](std::string_view msg){ return write_all(msg); }),
+	  m_wait(m_options.wait) {
+	m_session.on_message([this](const FixMessage& msg){ on_fix(msg); });
+	m_reply.reserve(1024);
+	Logger::instance().log(LogId::SOCKET_INIT, "FixSocket");
+}
+
+// Destructor
+FixSocket::~FixSocket(){
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if(m_session.state() == FixSession::ACTIVE && m_session.logout(std::string_view(), wall_ns())){
+			Logger::instance().log_text(LogId::SOCKET_ERROR, "Logout not sent", "FixSocket");
+		}
+		m_stop = true;
+		if(m_fd >= 0) shutdown(m_fd, SHUT_RDWR);
+	}
+	if(m_reader.joinable()) m_reader.join();
+	if(m_fd >= 0) close(m_fd);
+}
+
+// SendingTime is UTC
+int64_t FixSocket::wall_ns(){
+	return now_us() * 1000;
+}
+
+// A connected socket, -1 when there is none
+int FixSocket::connect_tcp(){
+	addrinfo hints{};
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	addrinfo* res = nullptr;
+	const std::string& to = m_options.host.empty() ? host : m_options.host;
+	int rc = getaddrinfo(to.c_str(), m_options.port.c_str(), &hints, &res);
+	if(rc){
+		Logger::instance().log_text(LogId::SOCKET_WS_FAIL, gai_strerror(rc));
+		return -1;
+	}
+	int fd = -1;
+	for(addrinfo* a = res; a; a = a->ai_next){
+		fd = socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+		if(fd < 0) continue;
+		if(connect(fd, a->ai_addr, a->ai_addrlen) == 0) break;
+		close(fd);
+		fd = -1;
+	}
+	freeaddrinfo(res);
+	if(fd < 0){
+		Logger::instance().log_text(LogId::SOCKET_WS_FAIL, std::strerror(errno));
+		return -1;
+	}
+	int one = 1;
+	setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+	return fd;
+}
+
+void FixSocket::switch_to_ws(){
+	int fd = connect_tcp();
+	if(fd < 0) return;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_fd = fd;
+		m_connected = true;
+	}
+	m_reader = std::thread(&FixSocket::run, this);
+}
+
+// On the reader thread, under m_mutex: the connection is closed, the
+// session's sequence numbers are kept to resume it
+void FixSocket::drop(){
+	m_connected = false;
+	close(m_fd);
+	m_fd = -1;
+	m_resume_out = m_session.next_out();
+	m_resume_in = m_session.next_in();
+	Logger::instance().log(LogId::SOCKET_CLOSED);
+}
+
+// On the reader thread: connects again and logs a session that was logged on
+// back on where it left off
+int FixSocket::reconnect(){
+	int fd = connect_tcp();
+	if(fd < 0) return 1;
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if(m_stop.load(std::memory_order_relaxed)){
+		close(fd);
+		return 1;
+	}
+	m_fd = fd;
+	m_connected = true;
+	if(!m_logged_on){
+		Logger::instance().log(LogId::SOCKET_RECONNECT, "FixSocket", "not logged on");
+		return 0;
+	}
+	m_session.set_next(m_resume_out, m_resume_in);
+	if(m_session.logon(wall_ns(), true)){
+		Logger::instance().log_text(LogId::SOCKET_ERROR, "Logon not sent", "FixSocket");
+		drop();
+		return 1;
+	}
+	Logger::instance().log(LogId::SOCKET_RECONNECT, "FixSocket", "session resumed");
+	return 0;
+}
+
+void FixSocket::set_execution_handler(std::function<void(const FixMessage&)> handler){
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_on_execution = std::move(handler);
+}
+
+FixSession::Stats FixSocket::stats(){
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_session.stats();
+}
+
+// Under m_mutex, from either thread
+int FixSocket::write_all(std::string_view msg){
+	if(!m_connected) return 1;
+	while(!msg.empty()){
+		ssize_t n = ::send(m_fd, msg.data(), msg.size(), MSG_NOSIGNAL);
+		if(n < 0){
+			if(errno == EINTR) continue;
+			Logger::instance().log_text(LogId::SOCKET_SEND_FAIL, std::strerror(errno));
+			return 1;
+		}
+		msg.remove_prefix(static_cast<size_t>(n));
+	}
+	return 0;
+}
+
+void FixSocket::run(){
+	std::vector<char> buf(64 * 1024);
+	size_t len = 0;
+	int64_t retry_ns = 0;
+	while(!m_stop.load(std::memory_order_relaxed)){
+		if(m_fd < 0){
+			// Once a second, the first try right away
+			if(mono_ns() < retry_ns){
+				std::this_thread::sleep_for(std::chrono::milliseconds(100));
+				continue;
+			}
+			retry_ns = mono_ns() + RECONNECT_MS * 1000000;
+			if(reconnect()) continue;
+			len = 0;
+		}
+		pollfd p{m_fd, POLLIN, 0};
+		// Wakes at least every 100 ms for heartbeats and request deadlines
+		int ready = ::poll(&p, 1, 100);
+		int64_t now = wall_ns();
+		bool down = false;
+		std::unique_lock<std::mutex> lock(m_mutex);
+		if(ready > 0){
+			lock.unlock();
+			ssize_t n = recv(m_fd, buf.data() + len, buf.size() - len, 0);
+			lock.lock();
+			if(n <= 0){
+				down = true;
+			} else {
+				len += static_cast<size_t>(n);
+				int64_t used = m_session.on_data(std::string_view(buf.data(), len), now);
+				// Not FIX, or one message larger than the buffer
+				if(used < 0 || (used == 0 && len == buf.size())){
+					down = true;
+				} else {
+					std::memmove(buf.data(), buf.data() + used, len - static_cast<size_t>(used));
+					len -= static_cast<size_t>(used);
+				}
+			}
+		}
+		if(!down) m_session.poll(now);
+		if(m_session.state() == FixSession::ACTIVE) m_logged_on = true;
+		// A logged on session that went quiet is as good as a dropped connection
+		if(!down && m_logged_on && m_session.state() == FixSession::DISCONNECTED) down = true;
+		if(down && !m_stop.load(std::memory_order_relaxed)){
+			drop();
+			retry_ns = 0;
+		}
+		if(m_pending == LOGON && !m_replied && m_session.state() == FixSession::ACTIVE){
+			m_reply.assign(R"({"jsonrpc":"2.0","id":)");
+			m_reply.append(m_request_id);
+			m_reply.append(R"(,"result":{"access_token":"fix","refresh_token":"fix","expires_in":31536000,"scope":"session:fix","token_type":"bearer"}})");
+			m_replied = true;
+		}
+		// A waiting request checks its reply, the connection and its deadline
+		bool wake = m_pending != NONE;
+		lock.unlock();
+		if(wake) m_wait.notify();
+	}
+}
+
+static void json_string(std::string& out, std::string_view v){
+	out.push_back('"');
+	for(char c : v){
+		if(c == '"' || c == '\\') out.push_back('\\');
+		if(static_cast<unsigned char>(c) >= 0x20) out.push_back(c);
+	}
+	out.push_back('"');
+}
+
+// FIX numbers are JSON numbers as they are, absent ones are 0
+static void json_number(std::string& out, std::string_view v){
+	if(v.empty()) out.push_back('0');
+	else out.append(v);
+}
+
+static const char* order_state(char ord_status){
+	switch(ord_status){
+		case '2': return "filled";
+		case '3':
+		case '4':
+		case 'C': return "cancelled";
+		case '8': return "rejected";
+		default: return "open";
+	}
+}
+
+// Under m_mutex, on the reader thread
+void FixSocket::on_fix(const FixMessage& msg){
+	std::string_view type = msg.type();
+	if(type == "8"){
+		std::string_view order_id = msg.get(FixMessage::ORDER_ID);
+		char status = msg.get_char(FixMessage::ORD_STATUS);
+		char exec = msg.get_char(FixMessage::EXEC_TYPE);
+		if(!order_id.empty()){
+			const char* state = order_state(status);
+			if(std::strcmp(state, "open") == 0){
+				Order& o = m_orders[std::string(order_id)];
+				if(o.symbol.empty()) o.symbol.assign(msg.get(FixMessage::SYMBOL));
+				o.buy = msg.get_char(FixMessage::SIDE) == '1';
+			} else {
+				m_orders.erase(std::string(order_id));
+			}
+		}
+		bool answer = false;
+		if(!m_replied){
+			if(m_pending == ORDER) answer = msg.get(FixMessage::CL_ORD_ID) == m_pending_id;
+			else if(m_pending == EDIT) answer = order_id == m_pending_id && (exec == '5' || exec == '8' || status == '8');
+			else if(m_pending == CANCEL) answer = order_id == m_pending_id && (exec == '4' || exec == '8' || status == '4');
+		}
+		if(answer) reply_order(msg);
+		else if(m_on_execution) m_on_execution(msg);
+	} else if(type == "9"){
+		bool answer = !m_replied && (m_pending == EDIT || m_pending == CANCEL)
+			&& (msg.get(FixMessage::ORDER_ID) == m_pending_id || msg.get(FixMessage::ORIG_CL_ORD_ID) == m_pending_id);
+		if(!answer) return;
+		// Too late to cancel and unknown order: what the JSON-RPC api reports as not_open_order
+		int64_t reason = msg.get_int(FixMessage::CXL_REJ_REASON, -1);
+		if(reason == 0 || reason == 1) reply_error(11044, "not_open_order");
+		else reply_error(reason, msg.has(FixMessage::TEXT) ? msg.get(FixMessage::TEXT) : std::string_view("cancel_rejected"));
+	}
+}
+
+void FixSocket::reply_error(int64_t code, std::string_view message){
+	m_reply.assign(R"({"jsonrpc":"2.0","id":)");
+	m_reply.append(m_request_id);
+	m_reply.append(R"(,"error":{"code":)");
+	m_reply.append(std::to_string(code));
+	m_reply.append(R"(,"message":)");
+	json_string(m_reply, message);
+	m_reply.append("}}");
+	m_replied = true;
+}
+
+void FixSocket::reply_order(const FixMessage& msg){
+	char status = msg.get_char(FixMessage::ORD_STATUS);
+	if(status == '8' || msg.get_char(FixMessage::EXEC_TYPE) == '8'){
+		reply_error(msg.get_int(FixMessage::ORD_REJ_REASON, 0), msg.has(FixMessage::TEXT) ? msg.get(FixMessage::TEXT) : std::string_view("rejected"));
+		return;
+	}
+	std::string& out = m_reply;
+	out.assign(R"({"jsonrpc":"2.0","id":)");
+	out.append(m_request_id);
+	out.append(m_pending == CANCEL ? R"(,"result":)" : R"(,"result":{"order":)");
+
+	bool market = msg.get_char(FixMessage::ORD_TYPE) == '1';
+	const char* state = order_state(status);
+	out.append(R"({"order_id":)");
+	json_string(out, msg.get(FixMessage::ORDER_ID));
+	out.append(R"(,"instrument_name":)");
+	json_string(out, msg.get(FixMessage::SYMBOL));
+	out.append(msg.get_char(FixMessage::SIDE) == '1' ? R"(,"direction":"buy")" : R"(,"direction":"sell")");
+	out.append(R"(,"price":)");
+	if(market) out.append(R"("market_price")");
+	else json_number(out, msg.get(FixMessage::PRICE));
+	out.append(R"(,"amount":)");
+	json_number(out, msg.get(FixMessage::ORDER_QTY));
+	out.append(R"(,"filled_amount":)");
+	json_number(out, msg.get(FixMessage::CUM_QTY));
+	out.append(R"(,"average_price":)");
+	json_number(out, msg.get(FixMessage::AVG_PX));
+	out.append(R"(,"order_state":")");
+	out.append(state);
+	out.append(market ? R"(","order_type":"market")" : R"(","order_type":"limit")");
+	out.append(msg.get(FixMessage::EXEC_INST).find('6') != std::string_view::npos ? R"(,"post_only":true)" : R"(,"post_only":false)");
+	out.append(R"(,"label":)");
+	json_string(out, msg.get(FixMessage::CL_ORD_ID));
+	out.push_back('}');
+
+	if(m_pending != CANCEL){
+		out.append(R"(,"trades":[)");
+		if(msg.get_char(FixMessage::EXEC_TYPE) == 'F' && msg.get_double(FixMessage::LAST_QTY) > 0){
+			out.append(R"({"trade_id":)");
+			json_string(out, msg.get(FixMessage::EXEC_ID));
+			out.append(R"(,"order_id":)");
+			json_string(out, msg.get(FixMessage::ORDER_ID));
+			out.append(R"(,"instrument_name":)");
+			json_string(out, msg.get(FixMessage::SYMBOL));
+			out.append(msg.get_char(FixMessage::SIDE) == '1' ? R"(,"direction":"buy")" : R"(,"direction":"sell")");
+			out.append(R"(,"price":)");
+			json_number(out, msg.get(FixMessage::LAST_PX));
+			out.append(R"(,"amount":)");
+			json_number(out, msg.get(FixMessage::LAST_QTY));
+			out.append(R"(,"state":")");
+			out.append(state);
+			out.append(R"("})");
+		}
+		out.append("]}");
+	}
+	out.push_back('}');
+	m_replied = true;
+}
+
+std::pair<int, std::string> FixSocket::wait_reply(int64_t deadline_ns){
+	while(true){
+		uint32_t seen = m_wait.epoch();
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			if(m_replied){
+				m_pending = NONE;
+				return std::make_pair(0, m_reply);
+			}
+			if(!m_connected || m_session.state() == FixSession::DISCONNECTED){
+				m_pending = NONE;
+				return std::make_pair(1, std::string("FIX session down"));
+			}
+			if(mono_ns() >= deadline_ns){
+				m_pending = NONE;
+				Logger::instance().log(LogId::SOCKET_TIMEOUT, "FixSocket", m_timeout_ms);
+				return std::make_pair(1, std::string("request timed out"));
+			}
+		}
+		m_wait.wait(seen);
+	}
+}
+
+[[nodiscard]] std::pair<int, std::string> FixSocket::ws_request(const std::string& msg){
+	nlohmann::json obj = nlohmann::json::parse(msg, nullptr, false);
+	if(!obj.is_object()) return std::make_pair(1, std::string("invalid request"));
+	const std::string method = obj.value("method", "");
+	const nlohmann::json params = obj.value("params", nlohmann::json::object());
+	int64_t deadline = mono_ns() + m_timeout_ms * 1000000;
+	int64_t now = wall_ns();
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_request_id = obj.contains("id") ? obj["id"].dump() : "null";
+	m_replied = false;
+	int status = 0;
+	if(method == "public/auth"){
+		if(params.contains("client_id")) m_session.set_credentials(params.value("client_id", ""), params.value("client_secret", ""));
+		m_pending = LOGON;
+		status = m_session.logon(now);
+	} else if(method == "private/buy" || method == "private/sell"){
+		std::string label = params.value("label", "");
+		m_pending_id = label.empty() ? "fix-" + std::to_string(++m_next_cl) : label;
+		uint8_t flags = 0;
+		if(params.value("type", "limit") == "market") flags |= FixSession::MARKET;
+		if(params.value("post_only", false)) flags |= FixSession::POST_ONLY;
+		if(params.value("time_in_force", "") == "immediate_or_cancel") flags |= FixSession::IOC;
+		m_pending = ORDER;
+		status = m_session.new_order(m_pending_id, params.value("instrument_name", ""), method == "private/buy",
+			params.value("amount", 0.0), params.value("price", 0.0), flags, now);
+	} else if(method == "private/edit" || method == "private/cancel"){
+		m_pending_id = params.value("order_id", "");
+		auto it = m_orders.find(m_pending_id);
+		std::string cl = "fix-" + std::to_string(++m_next_cl);
+		if(method == "private/cancel"){
+			m_pending = CANCEL;
+			status = m_session.cancel_order(cl, m_pending_id, it == m_orders.end() ? std::string_view() : std::string_view(it->second.symbol), now);
+		} else if(it == m_orders.end()){
+			// An order replace needs the side, known for orders placed through this socket
+			reply_error(11044, "not_open_order");
+			return std::make_pair(0, m_reply);
+		} else {
+			m_pending = EDIT;
+			status = m_session.replace_order(cl, m_pending_id, it->second.symbol, it->second.buy,
+				params.value("amount", 0.0), params.value("price", 0.0), now);
+		}
+	} else {
+		reply_error(-32601, "Method not found");
+		return std::make_pair(0, m_reply);
+	}
+	if(status){
+		m_pending = NONE;
+		return std::make_pair(1, std::string("FIX send failed"));
+	}
+	lock.unlock();
+	return wait_reply(deadline);
+}
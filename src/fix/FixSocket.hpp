@@ -0,0 +1,93 @@
+#pragma once
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "../Socket.hpp"
+#include "../WaitStrategy.hpp"
+#include "FixSession.hpp"
+
+// Order entry over Deribit's FIX gateway behind the Socket interface.
+//
+// private/buy and sell go out as NewOrderSingle, private/edit as
+// OrderCancelReplaceRequest and private/cancel as OrderCancelRequest; the
+// reply is built from the ExecutionReport (or OrderCancelReject) answering
+// it, in the shape of the JSON-RPC one, straight from the FIX fields.
+// public/auth logs the session on, signed with the request's client
+// credentials. Nothing else is served: the socket is meant to be Api's
+// order entry socket next to a WebSocket one that has the rest.
+//
+// A reader thread receives, runs the session (heartbeats, resends) and
+// hands replies to the waiting request. ExecutionReports no request waits
+// for, fills of resting orders among them, go to the execution handler on
+// that thread. Plain TCP, the gateway's 9881.
+//
+// A dropped connection, or a session that stopped answering, is connected
+// again once a second; a session that was logged on logs on again without
+// resetting, so both sides go on with their sequence numbers and resend
+// what the other missed. Requests fail with "FIX session down" meanwhile.
+class FixSocket: public Socket{
+public:
+	struct Options{
+		std::string host;            // empty: the exchange
+		std::string port = "9881";
+		FixSession::Options session;
+		WaitStrategy::Mode wait = WaitStrategy::BLOCK;
+	};
+
+	// Constructor
+	FixSocket();
+	explicit FixSocket(Options options);
+	~FixSocket(); // Destructor
+
+	// Connects, the Logon goes out with public/auth
+	void switch_to_ws() override;
+	[[nodiscard]] std::pair<int, std::string> ws_request(const std::string& msg) override;
+	// Called on the reader thread with the session locked, must not call back into the socket
+	void set_execution_handler(std::function<void(const FixMessage&)> handler);
+	FixSession::Stats stats();
+private:
+	enum Pending : uint8_t { NONE, LOGON, ORDER, EDIT, CANCEL };
+	// What edits and cancels need that Api's requests do not carry
+	struct Order{
+		std::string symbol;
+		bool buy;
+	};
+
+	void run();
+	int connect_tcp();
+	int reconnect();
+	void drop();
+	int write_all(std::string_view msg);
+	void on_fix(const FixMessage& msg);
+	void reply_order(const FixMessage& msg);
+	void reply_error(int64_t code, std::string_view message);
+	std::pair<int, std::string> wait_reply(int64_t deadline_ns);
+	static int64_t wall_ns();
+
+	static constexpr int64_t RECONNECT_MS = 1000;
+
+	Options m_options;
+	int m_fd = -1;              // set on the reader thread under m_mutex
+	std::thread m_reader;
+	std::atomic<bool> m_stop{false};
+	// The session, the open orders and the request in flight
+	std::mutex m_mutex;
+	FixSession m_session;
+	WaitStrategy m_wait;
+	std::function<void(const FixMessage&)> m_on_execution;
+	std::unordered_map<std::string, Order> m_orders; // by order id
+	Pending m_pending = NONE;
+	std::string m_pending_id;   // ClOrdID of a new order, order id of an edit or cancel
+	std::string m_request_id;   // JSON-RPC id of the request, as it was written
+	std::string m_reply;
+	bool m_replied = false;
+	bool m_connected = false;
+	bool m_logged_on = false;   // the session was ACTIVE, a reconnect resumes it
+	uint64_t m_resume_out = 0;  // its sequence numbers when the connection dropped
+	uint64_t m_resume_in = 0;
+	uint64_t m_next_cl = 0;
+};
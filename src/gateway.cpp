@@ -0,0 +1,44 @@
+#include <atomic>
+#include <csignal>
+#include <iostream>
+#include "Api.hpp"
+#include "oms/OrderGateway.hpp"
+
+// Order gateway: owns the authenticated exchange session and forwards the
+// requests of local strategy processes (OrderClient) over shared memory
+static std::atomic<bool> running{true};
+static constexpr size_t ARENA_BYTES = 64 * 1024 * 1024;
+static constexpr size_t STACK_PREFAULT = 512 * 1024;
+
+static void on_signal(int){
+	running = false;
+}
+
+int main(int argc, char** argv){
+	const std::string name = argc > 1 ? argv[1] : "/hft_gateway";
+	PageFaults start = page_faults();
+	setup_memory(ARENA_BYTES, STACK_PREFAULT);
+	Logger::instance().start("gateway.log");
+	std::signal(SIGINT, on_signal);
+	std::signal(SIGTERM, on_signal);
+
+	Api api;
+	OrderGateway gateway;
+	if(gateway.open(name)){
+		std::cerr << "Failed to create gateway region " << name << '\n';
+		Logger::instance().stop();
+		return 1;
+	}
+	PageFaults warm = page_faults();
+	Logger::instance().log(LogId::MEMORY_FAULTS, "startup and warm up", warm.minor - start.minor, warm.major - start.major);
+	std::cout << "Gateway serving on " << name << '\n';
+	gateway.run([&api](const std::string& request) {
+		return ResponseCache::method_of(request).rfind("public/", 0) == 0 ? api.api_public(request) : api.api_private(request);
+	}, running, [&api]() { api.poll_timers(); });
+
+	PageFaults end = page_faults();
+	Logger::instance().log(LogId::MEMORY_FAULTS, "while serving", end.minor - warm.minor, end.major - warm.major);
+	std::cout << "Exiting...\n";
+	Logger::instance().stop();
+	return 0;
+}
@@ -2,8 +2,23 @@
 #include <memory>
 #include "Trader.hpp"
 
+// Hot path memory: log rings and book levels, set up and touched before trading
+static constexpr size_t ARENA_BYTES = 64 * 1024 * 1024;
+static constexpr size_t STACK_PREFAULT = 512 * 1024;
+
 int main(){
+	// std::cin on its own buffer, the menu checks it for pending input
+	std::ios::sync_with_stdio(false);
+	PageFaults start = page_faults();
+	setup_memory(ARENA_BYTES, STACK_PREFAULT);
+	Logger::instance().start("algo.log");
 	Trader trader = Trader();
+	// Faults from here on hit live requests
+	PageFaults warm = page_faults();
+	Logger::instance().log(LogId::MEMORY_FAULTS, "startup and warm up", warm.minor - start.minor, warm.major - start.major);
 	trader.Run();
+	PageFaults end = page_faults();
+	Logger::instance().log(LogId::MEMORY_FAULTS, "while trading", end.minor - warm.minor, end.major - warm.major);
         std::cout << "Exiting...\n";
+	Logger::instance().stop();
 } 
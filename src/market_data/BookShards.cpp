@@ -0,0 +1,136 @@
+#include "BookShards.hpp"
+#include "../Logger.hpp"
+#include "../utility.hpp"
+#include <pthread.h>
+#include <sched.h>
+
+// Constructor
+BookShards::BookShards() {}
+
+// Destructor
+BookShards::~BookShards(){
+	stop();
+}
+
+int BookShards::start(const Instruments& instruments, OnBook on_book, size_t shards, int first_cpu){
+	if(shards == 0){
+		unsigned cores = std::thread::hardware_concurrency();
+		shards = cores > 1 ? cores - 1 : 1;
+	}
+	if(!m_shards.empty() || shards > UINT16_MAX) return 1;
+	m_on_book = std::move(on_book);
+	// Round robin, futures and perpetuals first so no shard gets two of them before every shard has one
+	m_shard_of.assign(instruments.size(), 0);
+	size_t next = 0;
+	for(int pass = 0; pass < 2; pass++){
+		for(InstrumentId id = 0; id < instruments.size(); id++){
+			bool option = instruments.get(id).kind == Instrument::OPTION || instruments.get(id).kind == Instrument::OPTION_COMBO;
+			if(option != (pass == 1)) continue;
+			m_shard_of[id] = static_cast<uint16_t>(next++ % shards);
+		}
+	}
+	m_running = true;
+	for(size_t i = 0; i < shards; i++){
+		m_shards.emplace_back(new Shard());
+		m_shards.back()->ring.resize(QUEUE);
+		for(Frame& f : m_shards.back()->ring) f.msg.reserve(4096);
+	}
+	for(size_t i = 0; i < shards; i++){
+		int cpu = first_cpu >= 0 ? first_cpu + static_cast<int>(i) : -1;
+		m_shards[i]->thread = std::thread(&BookShards::run, this, std::ref(*m_shards[i]), cpu);
+	}
+	return 0;
+}
+
+void BookShards::stop(){
+	if(!m_running.exchange(false)) return;
+	for(auto& s : m_shards){
+		s->wait.notify();
+		s->thread.join();
+	}
+}
+
+void BookShards::add(InstrumentId id, OrderBook book){
+	if(m_shards.empty()) return;
+	Shard& s = *m_shards[shard_of(id)];
+	std::lock_guard<std::mutex> lock(s.mutex);
+	s.books.insert_or_assign(id, std::move(book));
+}
+
+void BookShards::remove(InstrumentId id){
+	if(m_shards.empty()) return;
+	Shard& s = *m_shards[shard_of(id)];
+	std::lock_guard<std::mutex> lock(s.mutex);
+	s.books.erase(id);
+}
+
+int BookShards::route(InstrumentId id, std::string_view msg){
+	if(m_shards.empty()) return 1;
+	Shard& s = *m_shards[shard_of(id)];
+	size_t tail = s.tail.load(std::memory_order_relaxed);
+	if(tail - s.head.load(std::memory_order_acquire) == QUEUE){
+		// Dropping a frame would break the book's change chain, wait for the worker instead
+		s.full_waits.fetch_add(1, std::memory_order_relaxed);
+		while(tail - s.head.load(std::memory_order_acquire) == QUEUE) std::this_thread::yield();
+	}
+	Frame& f = s.ring[tail & (QUEUE - 1)];
+	f.id = id;
+	f.msg.assign(msg.data(), msg.size());
+	s.tail.store(tail + 1, std::memory_order_release);
+	size_t depth = tail + 1 - s.head.load(std::memory_order_relaxed);
+	if(depth > s.depth_max.load(std::memory_order_relaxed)) s.depth_max.store(depth, std::memory_order_relaxed);
+	s.wait.notify();
+	return 0;
+}
+
+void BookShards::run(Shard& s, int cpu){
+	if(cpu >= 0){
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		CPU_SET(cpu, &set);
+		if(pthread_setaffinity_np(pthread_self(), sizeof(set), &set)){
+			Logger::instance().log(LogId::TRADER_ERROR, "book shard could not be pinned");
+		}
+	}
+	while(m_running.load(std::memory_order_relaxed)){
+		uint32_t seen = s.wait.epoch();
+		size_t head = s.head.load(std::memory_order_relaxed);
+		if(head == s.tail.load(std::memory_order_acquire)){
+			s.wait.wait(seen);
+			continue;
+		}
+		Frame& f = s.ring[head & (QUEUE - 1)];
+		InstrumentId id = f.id;
+		nlohmann::json obj = nlohmann::json::parse(f.msg, nullptr, false);
+		// Parsed, the frame can be reused
+		s.head.store(head + 1, std::memory_order_release);
+
+		int status = 1;
+		if(!obj.is_discarded()){
+			auto params = obj.find("params");
+			auto data = params != obj.end() ? params->find("data") : obj.end();
+			if(params != obj.end() && data != params->end()){
+				std::lock_guard<std::mutex> lock(s.mutex);
+				auto it = s.books.find(id);
+				if(it != s.books.end() && it->second.on_book(*data, now_ms()) == 0){
+					status = 0;
+					if(m_on_book) m_on_book(id, it->second);
+				}
+			}
+		}
+		if(status) s.rejected.fetch_add(1, std::memory_order_relaxed);
+		s.updates.fetch_add(1, std::memory_order_relaxed);
+	}
+}
+
+BookShards::Stats BookShards::stats(size_t shard) const{
+	Shard& s = *m_shards[shard];
+	Stats out;
+	out.updates = s.updates.load(std::memory_order_relaxed);
+	out.rejected = s.rejected.load(std::memory_order_relaxed);
+	out.full_waits = s.full_waits.load(std::memory_order_relaxed);
+	out.depth_max = s.depth_max.load(std::memory_order_relaxed);
+	std::lock_guard<std::mutex> lock(s.mutex);
+	out.books = s.books.size();
+	return out;
+}
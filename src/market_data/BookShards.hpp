@@ -0,0 +1,103 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "Instruments.hpp"
+#include "OrderBook.hpp"
+#include "../WaitStrategy.hpp"
+
+// Order books sharded by instrument over worker threads.
+//
+// Every instrument belongs to one shard, from a table computed at start()
+// (futures and perpetuals, the busiest books, are spread first, options
+// after them). The I/O thread only routes: it copies a book.* frame into
+// the owning shard's queue without parsing it. Each shard's thread parses
+// its frames and applies them to the books it owns, so book work scales
+// with the shards and books of one instrument stay in order. Readers take
+// the shard's lock, which the worker holds only while applying one update.
+class BookShards{
+public:
+	// After an update was applied, on the shard's thread under its lock
+	using OnBook = std::function<void(InstrumentId, const OrderBook&)>;
+	static constexpr size_t QUEUE = 1024; // frames per shard waiting to be applied
+
+	struct Stats{
+		uint64_t updates = 0;     // frames applied
+		uint64_t rejected = 0;    // frames not applied (no book, broken chain, bad json)
+		uint64_t full_waits = 0;  // route() calls that found the queue full
+		size_t depth_max = 0;
+		size_t books = 0;
+	};
+
+	// Constructor
+	BookShards();
+	// Destructor, stops the workers
+	~BookShards();
+
+	// `shards` workers (0: a core each, one left to the I/O thread) for the
+	// instruments of `instruments`; with `first_cpu` >= 0 worker i is pinned
+	// to cpu first_cpu + i. Returns 0 on success
+	int start(const Instruments& instruments, OnBook on_book, size_t shards = 0, int first_cpu = -1);
+	void stop();
+	size_t shards() const { return m_shards.size(); }
+	size_t shard_of(InstrumentId id) const {
+		return id < m_shard_of.size() ? m_shard_of[id] : id % m_shards.size();
+	}
+
+	// The local book of `id`, replacing any, or none. Any thread
+	void add(InstrumentId id, OrderBook book);
+	void remove(InstrumentId id);
+
+	// I/O thread: queues the book.* notification `msg` of `id` to its shard,
+	// waiting while the queue is full. 1 when not started
+	int route(InstrumentId id, std::string_view msg);
+
+	// fn(const OrderBook*) on the book of `id`, nullptr when there is none, under its shard's lock
+	template<typename F>
+	auto visit(InstrumentId id, F&& fn){
+		Shard& s = *m_shards[shard_of(id)];
+		std::lock_guard<std::mutex> lock(s.mutex);
+		auto it = s.books.find(id);
+		return fn(it == s.books.end() ? static_cast<const OrderBook*>(nullptr) : &it->second);
+	}
+	// fn(InstrumentId, const OrderBook&) on every book, a shard at a time
+	template<typename F>
+	void for_each(F&& fn){
+		for(auto& s : m_shards){
+			std::lock_guard<std::mutex> lock(s->mutex);
+			for(const auto& b : s->books) fn(b.first, b.second);
+		}
+	}
+	Stats stats(size_t shard) const;
+private:
+	struct Frame{
+		InstrumentId id;
+		std::string msg;  // keeps its capacity, frames are copied in without allocating
+	};
+	struct Shard{
+		std::mutex mutex; // books
+		std::unordered_map<InstrumentId, OrderBook> books;
+		std::vector<Frame> ring;
+		alignas(64) std::atomic<size_t> tail{0}; // the I/O thread
+		alignas(64) std::atomic<size_t> head{0}; // the worker
+		WaitStrategy wait{WaitStrategy::SPIN_FUTEX, 2000};
+		std::thread thread;
+		std::atomic<uint64_t> updates{0};
+		std::atomic<uint64_t> rejected{0};
+		std::atomic<uint64_t> full_waits{0};
+		std::atomic<size_t> depth_max{0};
+	};
+	void run(Shard& s, int cpu);
+
+	std::vector<std::unique_ptr<Shard>> m_shards;
+	std::vector<uint16_t> m_shard_of; // by instrument id
+	OnBook m_on_book;
+	std::atomic<bool> m_running{false};
+};
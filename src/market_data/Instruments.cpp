@@ -0,0 +1,204 @@
+#include "Instruments.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <nlohmann/json.hpp>
+
+// Snapshot layout: header followed by `count` Instrument records
+struct SnapshotHeader{
+	char magic[4];
+	uint32_t version;
+	uint32_t record_size;
+	uint32_t count;
+	int64_t saved_ms;
+};
+static const char SNAPSHOT_MAGIC[4] = {'D', 'I', 'N', 'S'};
+static constexpr uint32_t SNAPSHOT_VERSION = 3;
+
+std::string Instruments::request(const std::string& currency){
+	return R"({"jsonrpc":"2.0","method":"public/get_instruments","params":{"currency":")" + currency
+		+ R"(","expired":false},"id":"10"})";
+}
+
+// FNV-1a
+uint64_t Instruments::hash(std::string_view name){
+	uint64_t h = 1469598103934665603ull;
+	for(char c : name){
+		h ^= static_cast<uint8_t>(c);
+		h *= 1099511628211ull;
+	}
+	return h;
+}
+
+[[nodiscard]] InstrumentId Instruments::id(std::string_view name) const{
+	if(m_slots.empty()) return INVALID_INSTRUMENT;
+	size_t mask = m_slots.size() - 1;
+	for(size_t i = hash(name) & mask;; i = (i + 1) & mask){
+		InstrumentId id = m_slots[i];
+		if(id == INVALID_INSTRUMENT) return INVALID_INSTRUMENT;
+		if(m_instruments[id].name_view() == name) return id;
+	}
+}
+
+void Instruments::rebuild_index(){
+	size_t cap = 16;
+	while(cap < 2 * m_instruments.size()) cap <<= 1;
+	m_slots.assign(cap, INVALID_INSTRUMENT);
+	for(const Instrument& ins : m_instruments){
+		size_t i = hash(ins.name_view()) & (cap - 1);
+		while(m_slots[i] != INVALID_INSTRUMENT) i = (i + 1) & (cap - 1);
+		m_slots[i] = ins.id;
+	}
+}
+
+InstrumentId Instruments::add(std::string_view name, Instrument::Kind kind, double tick_size, double contract_size){
+	InstrumentId existing = id(name);
+	if(existing != INVALID_INSTRUMENT) return existing;
+	if(name.size() >= Instrument::NAME_BYTES) return INVALID_INSTRUMENT;
+
+	Instrument ins{};
+	ins.id = static_cast<InstrumentId>(m_instruments.size());
+	ins.kind = kind;
+	ins.name_len = static_cast<uint8_t>(name.size());
+	std::memcpy(ins.name, name.data(), name.size());
+	int n = std::snprintf(ins.field, sizeof(ins.field), R"("instrument_name":"%.*s")",
+		static_cast<int>(name.size()), name.data());
+	ins.field_len = static_cast<uint8_t>(n);
+	ins.tick_size = tick_size;
+	ins.contract_size = contract_size;
+	ins.price_scale = Scale::from_double(tick_size);
+	ins.qty_scale = Scale::from_double(contract_size);
+	// Options and linear (_USDC) instruments are not inverse
+	ins.inverse = (kind == Instrument::FUTURE || kind == Instrument::FUTURE_COMBO) && name.find('_') == std::string_view::npos;
+	ins.is_put = kind == Instrument::OPTION && name.back() == 'P';
+	m_instruments.push_back(ins);
+
+	// Keep the load factor under one half
+	if(2 * m_instruments.size() > m_slots.size()) rebuild_index();
+	else {
+		size_t i = hash(name) & (m_slots.size() - 1);
+		while(m_slots[i] != INVALID_INSTRUMENT) i = (i + 1) & (m_slots.size() - 1);
+		m_slots[i] = ins.id;
+	}
+	return ins.id;
+}
+
+Price Instrument::snap(Price p, Price::Round r) const{
+	for(;;){
+		int64_t step = 1;
+		for(uint8_t i = 0; i < tick_step_count && p.n > tick_steps[i].above; i++) step = tick_steps[i].ticks;
+		int64_t rem = p.n % step;
+		if(rem == 0) return p;
+		int64_t down = p.n - rem;
+		bool up = r == Price::UP || (r == Price::NEAREST && 2 * rem >= step);
+		// Rounding up can cross into a coarser band, go on in the same direction
+		p = Price(up ? down + step : down);
+		r = up ? Price::UP : Price::DOWN;
+	}
+}
+
+int Instruments::load_json(const std::string& resp){
+	nlohmann::json obj = nlohmann::json::parse(resp, nullptr, false);
+	if(obj.is_discarded() || !obj.contains("result") || !obj["result"].is_array()) return 1;
+
+	for(const auto& r : obj["result"]){
+		const std::string kind = r.value("kind", "");
+		Instrument::Kind k = kind == "future" ? Instrument::FUTURE
+			: kind == "option" ? Instrument::OPTION
+			: kind == "spot" ? Instrument::SPOT
+			: kind == "future_combo" ? Instrument::FUTURE_COMBO
+			: kind == "option_combo" ? Instrument::OPTION_COMBO : Instrument::OTHER;
+		InstrumentId id = add(r["instrument_name"].get<std::string>(), k,
+			r.value("tick_size", 0.0), r.value("contract_size", 0.0));
+		if(id == INVALID_INSTRUMENT) continue;
+
+		Instrument& ins = m_instruments[id];
+		ins.min_trade_amount = r.value("min_trade_amount", 0.0);
+		if(ins.min_trade_amount > 0) ins.qty_scale = Scale::from_double(ins.min_trade_amount);
+		ins.expiration_ms = r.value("expiration_timestamp", static_cast<int64_t>(0));
+		if(r.contains("strike") && r["strike"].is_number()) ins.strike = r["strike"].get<double>();
+		if(r.contains("instrument_type")) ins.inverse = r["instrument_type"] == "reversed";
+		ins.tick_step_count = 0;
+		auto steps = r.find("tick_size_steps");
+		if(steps == r.end() || !steps->is_array()) continue;
+		for(const auto& st : *steps){
+			if(ins.tick_step_count == Instrument::TICK_STEPS) break;
+			double above = st.value("above_price", 0.0), tick = st.value("tick_size", 0.0);
+			// Only steps that are whole multiples of the base tick can be kept in ticks
+			Price ticks = Price::from_double(tick, ins.price_scale);
+			if(!(above > 0) || ticks.n < 1 || std::fabs(ticks.to_double(ins.price_scale) - tick) > 1e-9 * tick) continue;
+			ins.tick_steps[ins.tick_step_count++] = {Price::from_double(above, ins.price_scale).n, ticks.n};
+		}
+		std::sort(ins.tick_steps, ins.tick_steps + ins.tick_step_count,
+			[](const Instrument::TickStep& a, const Instrument::TickStep& b){ return a.above < b.above; });
+	}
+	return 0;
+}
+
+int Instruments::save(const std::string& path, int64_t now_ms) const{
+	std::string tmp = path + ".tmp";
+	FILE* f = std::fopen(tmp.c_str(), "wb");
+	if(!f) return 1;
+	SnapshotHeader h;
+	std::memcpy(h.magic, SNAPSHOT_MAGIC, 4);
+	h.version = SNAPSHOT_VERSION;
+	h.record_size = sizeof(Instrument);
+	h.count = static_cast<uint32_t>(m_instruments.size());
+	h.saved_ms = now_ms;
+	bool ok = std::fwrite(&h, sizeof(h), 1, f) == 1
+		&& std::fwrite(m_instruments.data(), sizeof(Instrument), m_instruments.size(), f) == m_instruments.size();
+	ok = (std::fclose(f) == 0) && ok;
+	// Rename so a crash never leaves a half written snapshot behind
+	if(!ok || std::rename(tmp.c_str(), path.c_str()) != 0){
+		std::remove(tmp.c_str());
+		return 1;
+	}
+	return 0;
+}
+
+static bool valid_scale(Scale s){
+	return s.mantissa > 0 && s.decimals <= 12;
+}
+
+// A record read back from disk is trusted only once every length and index
+// in it is in range, hot path code uses them without checks
+static bool valid_record(const Instrument& ins, InstrumentId id){
+	if(ins.id != id || ins.kind > Instrument::OTHER) return false;
+	if(ins.name_len == 0 || ins.name_len >= Instrument::NAME_BYTES || ins.field_len > Instrument::FIELD_BYTES) return false;
+	if(std::memchr(ins.name, '\0', ins.name_len)) return false;
+	// The field must be the one add() renders for the name
+	char field[Instrument::FIELD_BYTES + 1];
+	int n = std::snprintf(field, sizeof(field), R"("instrument_name":"%.*s")", static_cast<int>(ins.name_len), ins.name);
+	if(n != ins.field_len || std::memcmp(field, ins.field, ins.field_len) != 0) return false;
+	if(ins.tick_step_count > Instrument::TICK_STEPS) return false;
+	for(uint8_t i = 0; i < ins.tick_step_count; i++){
+		if(ins.tick_steps[i].ticks < 1 || (i && ins.tick_steps[i].above < ins.tick_steps[i - 1].above)) return false;
+	}
+	return valid_scale(ins.price_scale) && valid_scale(ins.qty_scale);
+}
+
+int Instruments::load_snapshot(const std::string& path, int64_t now_ms, int64_t max_age_ms){
+	FILE* f = std::fopen(path.c_str(), "rb");
+	if(!f) return 1;
+	// The records must fill the rest of the file exactly, a truncated or
+	// corrupt count fails before anything is allocated
+	long size = std::fseek(f, 0, SEEK_END) == 0 ? std::ftell(f) : -1;
+	SnapshotHeader h;
+	bool ok = size >= static_cast<long>(sizeof(h)) && std::fseek(f, 0, SEEK_SET) == 0
+		&& std::fread(&h, sizeof(h), 1, f) == 1
+		&& std::memcmp(h.magic, SNAPSHOT_MAGIC, 4) == 0
+		&& h.version == SNAPSHOT_VERSION
+		&& h.record_size == sizeof(Instrument)
+		&& static_cast<uint64_t>(size) - sizeof(h) == static_cast<uint64_t>(h.count) * sizeof(Instrument)
+		&& now_ms - h.saved_ms <= max_age_ms;
+	if(ok){
+		std::vector<Instrument> records(h.count);
+		ok = std::fread(records.data(), sizeof(Instrument), h.count, f) == h.count;
+		for(uint32_t i = 0; ok && i < h.count; i++) ok = valid_record(records[i], i);
+		if(ok) m_instruments.swap(records);
+	}
+	std::fclose(f);
+	if(!ok) return 1;
+	rebuild_index();
+	return 0;
+}
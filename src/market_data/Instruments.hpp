@@ -0,0 +1,82 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "../Price.hpp"
+
+using InstrumentId = uint32_t;
+constexpr InstrumentId INVALID_INSTRUMENT = UINT32_MAX;
+
+// Static metadata of one instrument, plain data so the registry can be
+// written to / read from disk as a flat array
+struct Instrument{
+	enum Kind : uint8_t { FUTURE, OPTION, SPOT, FUTURE_COMBO, OPTION_COMBO, OTHER };
+	static constexpr size_t NAME_BYTES = 48;
+	static constexpr size_t FIELD_BYTES = 80;
+	static constexpr size_t TICK_STEPS = 4;
+
+	// Coarser tick above a price level (Deribit tick_size_steps), both in
+	// ticks of price_scale
+	struct TickStep{
+		int64_t above;
+		int64_t ticks;
+	};
+
+	InstrumentId id;
+	Kind kind;
+	bool inverse;        // sized in USD, PnL in coin
+	bool is_put;
+	uint8_t name_len;
+	uint8_t field_len;
+	uint8_t tick_step_count;
+	char name[NAME_BYTES];
+	// Precomputed `"instrument_name":"BTC-PERPETUAL"` for request payloads
+	char field[FIELD_BYTES];
+	double tick_size;
+	double contract_size;
+	double min_trade_amount;
+	double strike;
+	int64_t expiration_ms;
+	Scale price_scale;   // tick size
+	Scale qty_scale;     // amount step (min trade amount)
+	TickStep tick_steps[TICK_STEPS]; // ascending `above`
+
+	std::string_view name_view() const { return std::string_view(name, name_len); }
+	std::string_view json_field() const { return std::string_view(field, field_len); }
+	// `p` (ticks of price_scale) moved onto the tick that applies at its level
+	Price snap(Price p, Price::Round r = Price::NEAREST) const;
+	Price to_price(double v, Price::Round r = Price::NEAREST) const { return snap(Price::from_double(v, price_scale, r), r); }
+};
+
+// Registry interning instrument names to dense integer ids.
+//
+// Loaded from public/get_instruments and persisted to a compact binary
+// snapshot so a restart can skip the (multi-megabyte) request. Names are
+// resolved to ids once at the edges; hot path code indexes the flat array
+// by id and appends the precomputed JSON field instead of re-quoting names.
+class Instruments{
+public:
+	// Request for every active instrument of `currency` ("any" for all)
+	static std::string request(const std::string& currency = "any");
+	// Load the reply of request(), returns 0 on success
+	int load_json(const std::string& resp);
+
+	// Binary snapshot, load fails (1) when missing, corrupt or older than max_age_ms
+	int save(const std::string& path, int64_t now_ms) const;
+	int load_snapshot(const std::string& path, int64_t now_ms, int64_t max_age_ms);
+
+	// Name -> id, INVALID_INSTRUMENT when unknown
+	[[nodiscard]] InstrumentId id(std::string_view name) const;
+	const Instrument& get(InstrumentId id) const { return m_instruments[id]; }
+	size_t size() const { return m_instruments.size(); }
+
+	// Adds an instrument that is not in the registry (eg. listed after the snapshot)
+	InstrumentId add(std::string_view name, Instrument::Kind kind, double tick_size, double contract_size);
+private:
+	void rebuild_index();
+	static uint64_t hash(std::string_view name);
+
+	std::vector<Instrument> m_instruments;
+	std::vector<InstrumentId> m_slots; // open addressing, power of two
+};
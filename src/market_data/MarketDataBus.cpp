@@ -0,0 +1,153 @@
+#include "MarketDataBus.hpp"
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "seqlock needs lock free atomics in shared memory");
+
+static size_t region_size(uint32_t capacity){
+	return sizeof(BusHeader) + static_cast<size_t>(capacity) * sizeof(BookSlot);
+}
+
+static int64_t realtime_ns(){
+	timespec ts;
+	clock_gettime(CLOCK_REALTIME, &ts);
+	return ts.tv_sec * 1000000000ll + ts.tv_nsec;
+}
+
+// Constructor
+MarketDataPublisher::MarketDataPublisher() {}
+
+// Destructor
+// The region is left in place so readers keep the last books across restarts
+MarketDataPublisher::~MarketDataPublisher(){
+	if(m_header) munmap(m_header, m_size);
+}
+
+int MarketDataPublisher::open(const std::string& name, uint32_t capacity){
+	if(m_header || capacity == 0) return 1;
+	int fd = shm_open(name.c_str(), O_CREAT | O_RDWR, 0644);
+	if(fd < 0) return 1;
+	// Never shrink a region left by a previous run: readers still mapping
+	// its old size would fault (SIGBUS) on pages past the new end
+	struct stat st;
+	size_t size = region_size(capacity);
+	if(fstat(fd, &st) != 0){
+		close(fd);
+		return 1;
+	}
+	if(static_cast<size_t>(st.st_size) > size) size = static_cast<size_t>(st.st_size);
+	else if(ftruncate(fd, static_cast<off_t>(size)) != 0){
+		close(fd);
+		return 1;
+	}
+	void* p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if(p == MAP_FAILED) return 1;
+
+	m_header = static_cast<BusHeader*>(p);
+	m_slots = reinterpret_cast<BookSlot*>(static_cast<char*>(p) + sizeof(BusHeader));
+	m_capacity = capacity;
+	m_size = size;
+
+	// Slots from a previous run may describe other instruments (ids are
+	// assigned per registry), start from empty ones, those past our
+	// capacity included. Magic goes last.
+	m_header->magic = 0;
+	std::atomic_thread_fence(std::memory_order_release);
+	std::memset(static_cast<void*>(m_slots), 0, size - sizeof(BusHeader));
+	m_header->slot_size = sizeof(BookSlot);
+	m_header->capacity = capacity;
+	m_header->depth = BookSnapshot::DEPTH;
+	m_header->heartbeat_ns.store(realtime_ns(), std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	m_header->magic = BusHeader::MAGIC;
+	return 0;
+}
+
+int MarketDataPublisher::publish(uint32_t id, const BookSnapshot& snap){
+	if(!m_header || id >= m_capacity) return 1;
+	BookSlot& slot = m_slots[id];
+	uint64_t seq = slot.seq.load(std::memory_order_relaxed);
+	slot.seq.store(seq + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	std::memcpy(&slot.data, &snap, sizeof(snap));
+	slot.data.publish_ns = realtime_ns();
+	slot.seq.store(seq + 2, std::memory_order_release);
+	m_header->heartbeat_ns.store(slot.data.publish_ns, std::memory_order_relaxed);
+	return 0;
+}
+
+// Constructor
+MarketDataReader::MarketDataReader() {}
+
+// Destructor
+MarketDataReader::~MarketDataReader(){
+	if(m_header) munmap(const_cast<BusHeader*>(m_header), m_size);
+}
+
+int MarketDataReader::open(const std::string& name){
+	if(m_header) return 1;
+	int fd = shm_open(name.c_str(), O_RDONLY, 0);
+	if(fd < 0) return 1;
+	struct stat st;
+	if(fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(BusHeader)){
+		close(fd);
+		return 1;
+	}
+	size_t size = static_cast<size_t>(st.st_size);
+	void* p = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if(p == MAP_FAILED) return 1;
+
+	const BusHeader* h = static_cast<const BusHeader*>(p);
+	std::atomic_thread_fence(std::memory_order_acquire);
+	if(h->magic != BusHeader::MAGIC || h->slot_size != sizeof(BookSlot) || region_size(h->capacity) > size){
+		munmap(p, size);
+		return 1;
+	}
+	m_header = h;
+	m_slots = reinterpret_cast<const BookSlot*>(static_cast<const char*>(p) + sizeof(BusHeader));
+	m_capacity = h->capacity;
+	m_size = size;
+	return 0;
+}
+
+int MarketDataReader::read(uint32_t id, BookSnapshot& out) const{
+	if(!m_header || id >= m_capacity) return 1;
+	const BookSlot& slot = m_slots[id];
+	// A copy takes well under a microsecond; a sequence odd for longer than
+	// the retries belongs to a writer that was preempted or died mid-publish
+	for(int i = 0; i < READ_RETRIES; i++){
+		uint64_t before = slot.seq.load(std::memory_order_acquire);
+		if(before == 0) return 1;
+		if(before & 1){
+			__builtin_ia32_pause();
+			continue;
+		}
+		std::memcpy(&out, &slot.data, sizeof(out));
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if(slot.seq.load(std::memory_order_relaxed) == before) return 0;
+	}
+	return 2;
+}
+
+uint64_t MarketDataReader::version(uint32_t id) const{
+	if(!m_header || id >= m_capacity) return 0;
+	return m_slots[id].seq.load(std::memory_order_acquire);
+}
+
+uint32_t MarketDataReader::find(const std::string& instrument) const{
+	BookSnapshot snap;
+	for(uint32_t id = 0; id < m_capacity; id++){
+		if(read(id, snap) == 0 && instrument == snap.instrument) return id;
+	}
+	return UINT32_MAX;
+}
+
+int64_t MarketDataReader::heartbeat_ns() const{
+	return m_header ? m_header->heartbeat_ns.load(std::memory_order_relaxed) : 0;
+}
@@ -0,0 +1,99 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+// Shared memory market data bus: one writer (the Trader) publishes the top
+// of every book it maintains, any number of processes on the host read them.
+// Threads of the writer may publish concurrently as long as each slot has
+// only one of them (the Trader's book shards).
+//
+// The region is a header followed by one slot per instrument id. Every slot
+// is guarded by a seqlock: the writer makes the sequence odd, updates the
+// data and makes it even again; readers copy the data and retry if the
+// sequence moved meanwhile. Readers never write to the region, so a slow or
+// crashed reader can not hold up the writer.
+
+// Plain copy of one book as published on the bus
+struct BookSnapshot{
+	static constexpr int DEPTH = 10;
+	static constexpr size_t NAME_BYTES = 48;
+
+	char instrument[NAME_BYTES];
+	int64_t exchange_ts_ms; // exchange timestamp of the last update
+	int64_t publish_ns;     // CLOCK_REALTIME at publish
+	int64_t change_id;
+	uint32_t bid_levels;
+	uint32_t ask_levels;
+	double bid_price[DEPTH];
+	double bid_amount[DEPTH];
+	double ask_price[DEPTH];
+	double ask_amount[DEPTH];
+
+	double best_bid() const { return bid_levels ? bid_price[0] : 0; }
+	double best_ask() const { return ask_levels ? ask_price[0] : 0; }
+};
+
+struct alignas(64) BookSlot{
+	std::atomic<uint64_t> seq; // odd while being written, 0 before the first publish
+	BookSnapshot data;
+};
+
+struct alignas(64) BusHeader{
+	static constexpr uint32_t MAGIC = 0x4d444231; // "MDB1"
+	uint32_t magic;
+	uint32_t slot_size;
+	uint32_t capacity;
+	uint32_t depth;
+	std::atomic<int64_t> heartbeat_ns; // last publish, readers can detect a dead writer
+};
+
+// Writer side, creates (or takes over) the region
+class MarketDataPublisher{
+public:
+	// Constructor
+	MarketDataPublisher();
+	// Destructor
+	~MarketDataPublisher();
+
+	// Returns 0 when the region `name` (eg. "/hft_md") with room for `capacity` instruments is mapped
+	int open(const std::string& name, uint32_t capacity);
+	bool is_open() const { return m_header != nullptr; }
+	uint32_t capacity() const { return m_capacity; }
+
+	// Publish `snap` as the book of instrument `id`, returns 1 when out of range
+	int publish(uint32_t id, const BookSnapshot& snap);
+private:
+	BusHeader* m_header = nullptr;
+	BookSlot* m_slots = nullptr;
+	uint32_t m_capacity = 0;
+	size_t m_size = 0;
+};
+
+// Reader side, maps the region read only
+class MarketDataReader{
+public:
+	// Constructor
+	MarketDataReader();
+	// Destructor
+	~MarketDataReader();
+
+	int open(const std::string& name);
+	bool is_open() const { return m_header != nullptr; }
+	uint32_t capacity() const { return m_capacity; }
+
+	// Consistent copy of the book of `id`, returns 1 when never published / out of range,
+	// 2 when the slot stayed busy (check heartbeat_ns() for a dead writer)
+	int read(uint32_t id, BookSnapshot& out) const;
+	// Sequence of the slot, changes on every publish; cheap polling for updates
+	uint64_t version(uint32_t id) const;
+	// Slot of `instrument`, UINT32_MAX when not published yet; resolve once and keep the id
+	uint32_t find(const std::string& instrument) const;
+	int64_t heartbeat_ns() const;
+private:
+	const BusHeader* m_header = nullptr;
+	const BookSlot* m_slots = nullptr;
+	uint32_t m_capacity = 0;
+	size_t m_size = 0;
+	static constexpr int READ_RETRIES = 4096;
+};
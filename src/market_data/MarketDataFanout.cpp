@@ -0,0 +1,141 @@
+#include "MarketDataFanout.hpp"
+#include "../utility.hpp"
+
+// Constructor
+MarketDataFanout::MarketDataFanout() {}
+
+// Destructor
+MarketDataFanout::~MarketDataFanout() {}
+
+int MarketDataFanout::init(size_t instruments){
+	if(!m_slots.empty() || instruments == 0 || instruments * CHANNELS > UINT32_MAX) return 1;
+	m_slots = std::vector<Slot>(instruments * CHANNELS);
+	return 0;
+}
+
+MarketDataFanout::Channel MarketDataFanout::channel_of(std::string_view channel){
+	if(channel.rfind("book.", 0) == 0) return BOOK;
+	if(channel.rfind("ticker.", 0) == 0) return TICKER;
+	if(channel.rfind("trades.", 0) == 0) return TRADES;
+	return CHANNELS;
+}
+
+int MarketDataFanout::subscribe(const char* name){
+	std::lock_guard<std::mutex> guard(m_subscribe_mutex);
+	size_t n = m_count.load(std::memory_order_relaxed);
+	if(n == MAX_CONSUMERS || m_slots.empty()) return -1;
+	std::unique_ptr<Consumer> c(new Consumer());
+	c->name = name;
+	// Every key fits at once, the ring never fills
+	size_t size = 1;
+	while(size < m_slots.size()) size <<= 1;
+	c->ring.resize(size);
+	c->mask = size - 1;
+	c->pending.reset(new std::atomic<uint8_t>[m_slots.size()]);
+	for(size_t i = 0; i < m_slots.size(); i++) c->pending[i].store(0, std::memory_order_relaxed);
+	c->queued_ns.resize(m_slots.size());
+	c->seen.resize(m_slots.size());
+	m_consumers[n] = std::move(c);
+	// publish() picks it up from its next update on
+	m_count.store(n + 1, std::memory_order_release);
+	return static_cast<int>(n);
+}
+
+void MarketDataFanout::lock(Slot& s){
+	while(s.busy.exchange(true, std::memory_order_acquire)){
+		while(s.busy.load(std::memory_order_relaxed)) WaitStrategy::cpu_relax();
+	}
+}
+
+int MarketDataFanout::publish(InstrumentId id, Channel channel, std::string_view msg){
+	size_t key = static_cast<size_t>(id) * CHANNELS + channel;
+	if(channel >= CHANNELS || key >= m_slots.size()) return 1;
+	int64_t now = mono_ns();
+	Slot& s = m_slots[key];
+	lock(s);
+	s.msg.assign(msg.data(), msg.size());
+	s.version++;
+	s.publish_ns = now;
+	unlock(s);
+
+	size_t n = m_count.load(std::memory_order_acquire);
+	for(size_t i = 0; i < n; i++){
+		Consumer& c = *m_consumers[i];
+		// Queued and not yet taken: the consumer will read this message instead
+		if(c.pending[key].exchange(1, std::memory_order_acq_rel)){
+			c.conflated.fetch_add(1, std::memory_order_relaxed);
+			continue;
+		}
+		c.queued_ns[key] = now;
+		size_t tail = c.tail.load(std::memory_order_relaxed);
+		c.ring[tail & c.mask] = static_cast<uint32_t>(key);
+		c.tail.store(tail + 1, std::memory_order_release);
+		c.queued.fetch_add(1, std::memory_order_relaxed);
+		size_t depth = tail + 1 - c.head.load(std::memory_order_relaxed);
+		if(depth > c.depth_max.load(std::memory_order_relaxed)) c.depth_max.store(depth, std::memory_order_relaxed);
+		c.wait.notify();
+	}
+	return 0;
+}
+
+int MarketDataFanout::poll(int consumer, Update& out){
+	Consumer& c = *m_consumers[consumer];
+	size_t head = c.head.load(std::memory_order_relaxed);
+	if(head == c.tail.load(std::memory_order_acquire)) return 1;
+	uint32_t key = c.ring[head & c.mask];
+	int64_t queued = c.queued_ns[key];
+	c.head.store(head + 1, std::memory_order_release);
+	// Cleared before the copy: a publish from here on queues the key again
+	c.pending[key].store(0, std::memory_order_seq_cst);
+
+	Slot& s = m_slots[key];
+	lock(s);
+	out.msg.assign(s.msg);
+	uint64_t version = s.version;
+	out.publish_ns = s.publish_ns;
+	unlock(s);
+
+	out.instrument = static_cast<InstrumentId>(key / CHANNELS);
+	out.channel = static_cast<Channel>(key % CHANNELS);
+	uint64_t& seen = c.seen[key];
+	out.skipped = seen && version > seen + 1 ? version - seen - 1 : 0;
+	// A change or a batch of trades does not stand on its own
+	out.gap = out.channel != TICKER && version > seen + 1;
+	if(out.gap) c.gaps.fetch_add(1, std::memory_order_relaxed);
+	seen = version;
+
+	int64_t lag = mono_ns() - queued;
+	c.lag_ns.store(lag, std::memory_order_relaxed);
+	if(lag > c.lag_max_ns.load(std::memory_order_relaxed)) c.lag_max_ns.store(lag, std::memory_order_relaxed);
+	c.delivered.fetch_add(1, std::memory_order_relaxed);
+	return 0;
+}
+
+int MarketDataFanout::next(int consumer, Update& out, const std::atomic<bool>& running){
+	Consumer& c = *m_consumers[consumer];
+	while(running.load(std::memory_order_relaxed)){
+		uint32_t seen = c.wait.epoch();
+		if(poll(consumer, out) == 0) return 0;
+		c.wait.wait(seen);
+	}
+	return 1;
+}
+
+void MarketDataFanout::wake(int consumer){
+	m_consumers[consumer]->wait.notify();
+}
+
+MarketDataFanout::Stats MarketDataFanout::stats(int consumer) const{
+	const Consumer& c = *m_consumers[consumer];
+	Stats s;
+	s.name = c.name;
+	s.queued = c.queued.load(std::memory_order_relaxed);
+	s.conflated = c.conflated.load(std::memory_order_relaxed);
+	s.delivered = c.delivered.load(std::memory_order_relaxed);
+	s.gaps = c.gaps.load(std::memory_order_relaxed);
+	s.depth = c.tail.load(std::memory_order_relaxed) - c.head.load(std::memory_order_relaxed);
+	s.depth_max = c.depth_max.load(std::memory_order_relaxed);
+	s.lag_ns = c.lag_ns.load(std::memory_order_relaxed);
+	s.lag_max_ns = c.lag_max_ns.load(std::memory_order_relaxed);
+	return s;
+}
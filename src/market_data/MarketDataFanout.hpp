@@ -0,0 +1,118 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "Instruments.hpp"
+#include "../WaitStrategy.hpp"
+
+// In process distribution of market data notifications to consumer threads
+// that may not keep up (analytics, recorders, a GUI).
+//
+// The producer (the socket's I/O thread) stores the latest message of every
+// instrument and channel in a slot and queues the slot's key to each
+// consumer, unless the key is already queued for it: a consumer that keeps
+// up gets every update, one that lags gets the latest state of each key
+// once, whatever it missed is counted as conflated. A consumer's queue
+// holds each key at most once, so memory is bounded by the number of keys
+// and publish() never waits on a consumer.
+//
+// Only TICKER messages are state, the latest one replaces those before it.
+// BOOK changes and TRADES batches are a stream: one taken after others of
+// its key were missed (or first taken mid stream) has `gap` set, and the
+// consumer resyncs before using it (a book from a snapshot, e.g.
+// Trader::get_orderbook, trades from public/get_last_trades_by_instrument).
+// A consumer that keeps up gets every message and never sees a gap.
+class MarketDataFanout{
+public:
+	enum Channel : uint8_t { BOOK, TICKER, TRADES, CHANNELS };
+	static constexpr size_t MAX_CONSUMERS = 8;
+
+	struct Update{
+		InstrumentId instrument = INVALID_INSTRUMENT;
+		Channel channel = BOOK;
+		std::string msg;          // the notification as received
+		int64_t publish_ns = 0;   // mono_ns() when published
+		uint64_t skipped = 0;     // updates of this key conflated away since its last delivery
+		bool gap = false;         // BOOK / TRADES only: messages of this key were missed, resync
+	};
+	// Snapshot of one consumer's counters
+	struct Stats{
+		const char* name = "";
+		uint64_t queued = 0;      // keys queued (one per update while keeping up)
+		uint64_t conflated = 0;   // updates folded into one already queued
+		uint64_t delivered = 0;
+		uint64_t gaps = 0;        // BOOK / TRADES deliveries with `gap` set
+		size_t depth = 0;         // keys waiting now
+		size_t depth_max = 0;
+		int64_t lag_ns = 0;       // queued -> taken, last delivery
+		int64_t lag_max_ns = 0;
+	};
+
+	// Constructor
+	MarketDataFanout();
+	// Destructor
+	~MarketDataFanout();
+
+	// Slots for instrument ids [0, instruments), returns 0 on success. Call once, before publishing
+	int init(size_t instruments);
+	bool is_open() const { return !m_slots.empty(); }
+	// Channel of a notification ("book.BTC-PERPETUAL.100ms" -> BOOK), CHANNELS for the others
+	static Channel channel_of(std::string_view channel);
+
+	// Registers a consumer, returns its index or -1 when MAX_CONSUMERS are in. Thread safe
+	int subscribe(const char* name);
+
+	// Producer side, one thread. Returns 1 when `id` is out of range
+	int publish(InstrumentId id, Channel channel, std::string_view msg);
+
+	// Consumer side, one thread per consumer. 0 and fills `out` with the next
+	// update, 1 when there is none
+	int poll(int consumer, Update& out);
+	// Like poll(), waiting for an update; 1 once `running` turns false
+	int next(int consumer, Update& out, const std::atomic<bool>& running);
+	// Wakes next() so it sees `running` turned false
+	void wake(int consumer);
+
+	Stats stats(int consumer) const;
+	size_t consumers() const { return m_count.load(std::memory_order_acquire); }
+private:
+	struct Slot{
+		std::atomic<bool> busy{false}; // held while the message is written or copied
+		uint64_t version = 0;
+		int64_t publish_ns = 0;
+		std::string msg;
+	};
+	struct Consumer{
+		const char* name;
+		// Ring of keys, the producer moves tail, the consumer head
+		std::vector<uint32_t> ring;
+		size_t mask;
+		alignas(64) std::atomic<size_t> tail{0};
+		alignas(64) std::atomic<size_t> head{0};
+		std::unique_ptr<std::atomic<uint8_t>[]> pending; // key queued and not yet taken
+		std::vector<int64_t> queued_ns;                  // when each pending key was queued
+		std::vector<uint64_t> seen;                      // version last delivered, consumer owned
+		WaitStrategy wait{WaitStrategy::SPIN_FUTEX, 2000};
+		// Producer side counters
+		std::atomic<uint64_t> queued{0};
+		std::atomic<uint64_t> conflated{0};
+		std::atomic<size_t> depth_max{0};
+		// Consumer side counters
+		std::atomic<uint64_t> delivered{0};
+		std::atomic<uint64_t> gaps{0};
+		std::atomic<int64_t> lag_ns{0};
+		std::atomic<int64_t> lag_max_ns{0};
+	};
+
+	static void lock(Slot& s);
+	static void unlock(Slot& s){ s.busy.store(false, std::memory_order_release); }
+
+	std::vector<Slot> m_slots;   // by instrument * CHANNELS + channel
+	std::unique_ptr<Consumer> m_consumers[MAX_CONSUMERS];
+	std::atomic<size_t> m_count{0};
+	std::mutex m_subscribe_mutex;
+};
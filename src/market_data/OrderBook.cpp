@@ -0,0 +1,77 @@
+#include "OrderBook.hpp"
+
+// Constructor
+OrderBook::OrderBook(Scale price_scale, const std::string& channel) : m_scale(price_scale), m_channel(channel) {}
+
+// Levels are ["new"|"change"|"delete", price, amount] in incremental
+// channels and [price, amount] in the grouped ones
+template<typename Side>
+void OrderBook::apply(Side& side, const nlohmann::json& levels){
+	for(const auto& l : levels){
+		bool action = l.size() == 3;
+		int64_t ticks = Price::from_double(l[action ? 1 : 0].template get<double>(), m_scale).n;
+		double amount = l[action ? 2 : 1].template get<double>();
+		if((action && l[0] == "delete") || amount == 0) side.erase(ticks);
+		else side[ticks] = amount;
+	}
+}
+
+int OrderBook::on_book(const nlohmann::json& data, int64_t now_ms){
+	int64_t change_id = data.value("change_id", static_cast<int64_t>(0));
+	bool full = !data.contains("type") || data["type"] == "snapshot";
+
+	if(full){
+		m_bids.clear();
+		m_asks.clear();
+	} else {
+		int64_t prev = data.value("prev_change_id", static_cast<int64_t>(0));
+		if(!m_valid || prev != m_change_id){
+			if(m_valid) m_gaps++;
+			m_valid = false;
+			return 1;
+		}
+	}
+	apply(m_bids, data["bids"]);
+	apply(m_asks, data["asks"]);
+	if(m_instrument.empty()) m_instrument = data.value("instrument_name", "");
+	m_change_id = change_id;
+	m_timestamp = data.value("timestamp", static_cast<int64_t>(0));
+	m_updated_ms = now_ms;
+	m_valid = true;
+	return 0;
+}
+
+int OrderBook::levels(bool bids, int depth, double* price, double* amount) const{
+	int n = 0;
+	auto copy = [&](const auto& side){
+		for(auto it = side.begin(); it != side.end() && n < depth; ++it, ++n){
+			price[n] = Price(it->first).to_double(m_scale);
+			amount[n] = it->second;
+		}
+	};
+	if(bids) copy(m_bids);
+	else copy(m_asks);
+	return n;
+}
+
+[[nodiscard]] nlohmann::json OrderBook::snapshot(int depth) const{
+	nlohmann::json out;
+	out["instrument_name"] = m_instrument;
+	out["timestamp"] = m_timestamp;
+	out["change_id"] = m_change_id;
+	nlohmann::json bids = nlohmann::json::array(), asks = nlohmann::json::array();
+	for(auto it = m_bids.begin(); it != m_bids.end() && static_cast<int>(bids.size()) < depth; ++it){
+		bids.push_back({Price(it->first).to_double(m_scale), it->second});
+	}
+	for(auto it = m_asks.begin(); it != m_asks.end() && static_cast<int>(asks.size()) < depth; ++it){
+		asks.push_back({Price(it->first).to_double(m_scale), it->second});
+	}
+	out["best_bid_price"] = m_bids.empty() ? nlohmann::json(nullptr) : nlohmann::json(Price(m_bids.begin()->first).to_double(m_scale));
+	out["best_bid_amount"] = m_bids.empty() ? 0.0 : m_bids.begin()->second;
+	out["best_ask_price"] = m_asks.empty() ? nlohmann::json(nullptr) : nlohmann::json(Price(m_asks.begin()->first).to_double(m_scale));
+	out["best_ask_amount"] = m_asks.empty() ? 0.0 : m_asks.begin()->second;
+	out["bids"] = std::move(bids);
+	out["asks"] = std::move(asks);
+	out["source"] = "local";
+	return out;
+}
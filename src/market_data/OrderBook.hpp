@@ -0,0 +1,53 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <string>
+#include <nlohmann/json.hpp>
+#include "../Price.hpp"
+#include "../HugeArena.hpp"
+
+// Local book of one instrument maintained from book.* notifications.
+//
+// book.<instrument>.<interval> sends a snapshot followed by changes chained
+// by change_id / prev_change_id; a break in the chain invalidates the book
+// until the next snapshot. book.<instrument>.<group>.<depth>.<interval>
+// sends the whole (grouped) book every time. Levels are keyed on integer
+// ticks of the instrument's tick size. Level nodes come from the process
+// arena (prefaulted, huge pages) and are recycled as levels come and go.
+class OrderBook{
+public:
+	// Constructor
+	explicit OrderBook(Scale price_scale = Scale(), const std::string& channel = "");
+
+	// `data` of a book.* notification, returns 1 when the update could not be applied
+	int on_book(const nlohmann::json& data, int64_t now_ms);
+
+	bool valid() const { return m_valid; }
+	// Local time of the last applied update
+	int64_t updated_ms() const { return m_updated_ms; }
+	const std::string& channel() const { return m_channel; }
+	uint64_t gaps() const { return m_gaps; }
+
+	// Copies the top `depth` bid (or ask) levels, returns how many were copied
+	int levels(bool bids, int depth, double* price, double* amount) const;
+	int64_t change_id() const { return m_change_id; }
+	int64_t timestamp() const { return m_timestamp; }
+	// Same shape as the result of public/get_order_book, top `depth` levels
+	[[nodiscard]] nlohmann::json snapshot(int depth) const;
+private:
+	template<typename Side>
+	void apply(Side& side, const nlohmann::json& levels);
+
+	Scale m_scale;
+	std::string m_channel;
+	using Level = std::pair<const int64_t, double>;
+	std::map<int64_t, double, std::greater<int64_t>, ArenaAllocator<Level>> m_bids;
+	std::map<int64_t, double, std::less<int64_t>, ArenaAllocator<Level>> m_asks;
+	std::string m_instrument;
+	int64_t m_change_id = 0;
+	int64_t m_timestamp = 0; // exchange time of the last update
+	int64_t m_updated_ms = 0;
+	uint64_t m_gaps = 0;
+	bool m_valid = false;
+};
@@ -0,0 +1,30 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+// Fixed capacity ring, push overwrites the oldest element.
+// at(0) is the newest element, at(size() - 1) the oldest still held.
+template<typename T, size_t N>
+class RingBuffer{
+public:
+	static_assert(N > 0 && (N & (N - 1)) == 0, "capacity must be a power of two");
+
+	void push(const T& v){
+		m_data[m_head & (N - 1)] = v;
+		m_head++;
+	}
+
+	T& back() { return m_data[(m_head - 1) & (N - 1)]; }
+	const T& back() const { return m_data[(m_head - 1) & (N - 1)]; }
+	const T& at(size_t i) const { return m_data[(m_head - 1 - i) & (N - 1)]; }
+
+	size_t size() const { return m_head < N ? static_cast<size_t>(m_head) : N; }
+	bool empty() const { return m_head == 0; }
+	uint64_t pushed() const { return m_head; }
+	void clear() { m_head = 0; }
+	static constexpr size_t capacity() { return N; }
+private:
+	std::array<T, N> m_data{};
+	uint64_t m_head = 0;
+};
@@ -0,0 +1,143 @@
+#include "TradeAggregator.hpp"
+
+// Constructor
+TradeAggregator::TradeAggregator(int64_t bar_ms, size_t window)
+	: m_bar_ms(bar_ms > 0 ? bar_ms : 1000),
+	  m_window(window > 0 && window < InstrumentStats::BARS ? window : InstrumentStats::BARS - 1) {}
+
+void TradeAggregator::on_trade(const std::string& inst, int64_t ts_ms, double price, double amount, bool is_buy){
+	InstrumentStats& s = m_stats[inst];
+	int64_t start = ts_ms - ts_ms % m_bar_ms;
+
+	if(s.bars.empty()){
+		Bar bar;
+		bar.start_ms = start;
+		bar.open = bar.high = bar.low = bar.close = price;
+		s.bars.push(bar);
+	} else if(start > s.bars.back().start_ms){
+		int64_t gap = (start - s.bars.back().start_ms) / m_bar_ms - 1;
+		close_bar(s);
+		// Quiet intervals become flat bars, more than a window of them is the same as a window
+		if(gap > static_cast<int64_t>(m_window)) gap = m_window;
+		double close = s.bars.back().close;
+		for(int64_t i = gap; i > 0; i--){
+			Bar flat;
+			flat.start_ms = start - i * m_bar_ms;
+			flat.open = flat.high = flat.low = flat.close = close;
+			s.bars.push(flat);
+			close_bar(s);
+		}
+		Bar bar;
+		bar.start_ms = start;
+		bar.open = bar.high = bar.low = bar.close = price;
+		s.bars.push(bar);
+	}
+	// Late trades (older than the bar in progress) are folded into it
+
+	Bar& bar = s.bars.back();
+	if(price > bar.high) bar.high = price;
+	if(price < bar.low) bar.low = price;
+	bar.close = price;
+	bar.volume += amount;
+	bar.notional += price * amount;
+	if(is_buy) bar.buy_volume += amount;
+	bar.trades++;
+
+	s.cum_volume += amount;
+	s.cum_notional += price * amount;
+	s.last_price = price;
+	s.last_trade_ms = ts_ms;
+}
+
+void TradeAggregator::on_trades(const nlohmann::json& data){
+	for(const auto& t : data){
+		on_trade(t["instrument_name"].get<std::string>(), t["timestamp"].get<int64_t>(),
+			t["price"].get<double>(), t["amount"].get<double>(), t["direction"] == "buy");
+	}
+}
+
+void TradeAggregator::on_ticker(const nlohmann::json& data){
+	InstrumentStats& s = m_stats[data["instrument_name"].get<std::string>()];
+	s.mark_price = data.value("mark_price", s.mark_price);
+	s.index_price = data.value("index_price", s.index_price);
+	// Empty sides come as null
+	if(data.contains("best_bid_price") && data["best_bid_price"].is_number()) s.best_bid = data["best_bid_price"].get<double>();
+	if(data.contains("best_ask_price") && data["best_ask_price"].is_number()) s.best_ask = data["best_ask_price"].get<double>();
+	s.ticker_ms = data.value("timestamp", s.ticker_ms);
+}
+
+[[nodiscard]] const InstrumentStats* TradeAggregator::find(const std::string& inst) const{
+	auto it = m_stats.find(inst);
+	return it == m_stats.end() ? nullptr : &it->second;
+}
+
+// Move the bar in progress into the rolling window
+void TradeAggregator::close_bar(InstrumentStats& s){
+	const Bar& bar = s.bars.back();
+	double prev = s.closed ? s.bars.at(1).close : bar.open;
+	double r = (prev > 0 && bar.close > 0) ? std::log(bar.close / prev) : 0.0;
+
+	s.returns.push(r);
+	s.roll_ret_sum += r;
+	s.roll_ret_sq += r * r;
+	s.roll_volume += bar.volume;
+	s.roll_buy_volume += bar.buy_volume;
+	s.roll_notional += bar.notional;
+	s.closed++;
+	evict(s);
+}
+
+// Drop the bar that just left the window from the sums
+void TradeAggregator::evict(InstrumentStats& s){
+	if(s.closed <= m_window) return;
+	const Bar& old = s.bars.at(m_window);
+	double r = s.returns.at(m_window);
+	s.roll_ret_sum -= r;
+	s.roll_ret_sq -= r * r;
+	s.roll_volume -= old.volume;
+	s.roll_buy_volume -= old.buy_volume;
+	s.roll_notional -= old.notional;
+}
+
+double TradeAggregator::rolling_volume(const InstrumentStats& s) const{
+	return s.roll_volume + (s.bars.empty() ? 0 : s.bars.back().volume);
+}
+
+double TradeAggregator::rolling_vwap(const InstrumentStats& s) const{
+	if(s.bars.empty()) return 0;
+	double vol = s.roll_volume + s.bars.back().volume;
+	return vol > 0 ? (s.roll_notional + s.bars.back().notional) / vol : s.last_price;
+}
+
+double TradeAggregator::realized_vol(const InstrumentStats& s) const{
+	double n = static_cast<double>(s.closed < m_window ? s.closed : m_window);
+	if(n < 2) return 0;
+	double mean = s.roll_ret_sum / n;
+	double var = (s.roll_ret_sq - n * mean * mean) / (n - 1);
+	if(var < 0) var = 0; // rounding after many add/subtract
+	const double bars_per_year = 365.0 * 24 * 3600 * 1000 / m_bar_ms;
+	return std::sqrt(var * bars_per_year);
+}
+
+[[nodiscard]] nlohmann::json TradeAggregator::summary(const std::string& inst) const{
+	const InstrumentStats* s = find(inst);
+	if(!s) return nullptr;
+	nlohmann::json out;
+	out["instrument_name"] = inst;
+	out["last_price"] = s->last_price;
+	out["vwap"] = s->vwap();
+	out["rolling_vwap"] = rolling_vwap(*s);
+	out["rolling_volume"] = rolling_volume(*s);
+	out["rolling_buy_volume"] = s->roll_buy_volume + (s->bars.empty() ? 0 : s->bars.back().buy_volume);
+	out["realized_vol"] = realized_vol(*s);
+	out["window_ms"] = static_cast<int64_t>(m_window) * m_bar_ms;
+	out["mark_price"] = s->mark_price;
+	out["best_bid_price"] = s->best_bid;
+	out["best_ask_price"] = s->best_ask;
+	if(!s->bars.empty()){
+		const Bar& b = s->bars.back();
+		out["bar"] = {{"start", b.start_ms}, {"open", b.open}, {"high", b.high}, {"low", b.low},
+			{"close", b.close}, {"volume", b.volume}, {"vwap", b.vwap()}, {"trades", b.trades}};
+	}
+	return out;
+}
@@ -0,0 +1,83 @@
+#pragma once
+#include "RingBuffer.hpp"
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <nlohmann/json.hpp>
+
+// One time bar of trades
+struct Bar{
+	int64_t start_ms = 0;
+	double open = 0, high = 0, low = 0, close = 0;
+	double volume = 0;
+	double buy_volume = 0;
+	double notional = 0; // sum(price * amount)
+	uint32_t trades = 0;
+
+	double vwap() const { return volume > 0 ? notional / volume : close; }
+};
+
+// Derived features of one instrument, all maintained incrementally
+struct InstrumentStats{
+	static constexpr size_t BARS = 1024;
+
+	RingBuffer<Bar, BARS> bars;        // back() is the bar in progress
+	RingBuffer<double, BARS> returns;  // log return of each closed bar
+	uint64_t closed = 0;
+
+	// Since first trade
+	double cum_volume = 0;
+	double cum_notional = 0;
+	double last_price = 0;
+	int64_t last_trade_ms = 0;
+
+	// Sums over the last `window` closed bars
+	double roll_volume = 0;
+	double roll_buy_volume = 0;
+	double roll_notional = 0;
+	double roll_ret_sum = 0;
+	double roll_ret_sq = 0;
+
+	// Latest ticker.* values
+	double mark_price = 0;
+	double index_price = 0;
+	double best_bid = 0;
+	double best_ask = 0;
+	int64_t ticker_ms = 0;
+
+	double vwap() const { return cum_volume > 0 ? cum_notional / cum_volume : 0; }
+};
+
+// Incremental trade aggregation fed from trades.* and ticker.* notifications.
+// Every trade is O(1): it updates the bar in progress and, when a bar closes,
+// adds it to the rolling window sums and subtracts the bar leaving the window.
+// Not thread safe, the owner serializes updates and reads.
+class TradeAggregator{
+public:
+	// Constructor: bar length and rolling window length (in bars)
+	TradeAggregator(int64_t bar_ms = 1000, size_t window = 60);
+
+	void on_trade(const std::string& inst, int64_t ts_ms, double price, double amount, bool is_buy);
+	// `data` of a trades.{instrument}.{interval} notification
+	void on_trades(const nlohmann::json& data);
+	// `data` of a ticker.{instrument}.{interval} notification
+	void on_ticker(const nlohmann::json& data);
+
+	[[nodiscard]] const InstrumentStats* find(const std::string& inst) const;
+
+	// Features, including the bar in progress
+	double rolling_volume(const InstrumentStats& s) const;
+	double rolling_vwap(const InstrumentStats& s) const;
+	// Standard deviation of bar log returns over the window, annualized
+	double realized_vol(const InstrumentStats& s) const;
+
+	[[nodiscard]] nlohmann::json summary(const std::string& inst) const;
+private:
+	void close_bar(InstrumentStats& s);
+	void evict(InstrumentStats& s);
+
+	int64_t m_bar_ms;
+	size_t m_window;
+	std::unordered_map<std::string, InstrumentStats> m_stats;
+};
@@ -0,0 +1,308 @@
+#include "MatchingEngine.hpp"
+#include <algorithm>
+
+// Constructor
+MatchingEngine::MatchingEngine(QueueModel model) : m_model(model) {
+	m_pool.reserve(1 << 16);
+	m_free.reserve(1 << 16);
+}
+
+// Ids are the pool index and a sequence number, a stale id never finds a reused slot
+uint32_t MatchingEngine::alloc(){
+	uint32_t index;
+	if(!m_free.empty()){
+		index = m_free.back();
+		m_free.pop_back();
+	} else {
+		index = static_cast<uint32_t>(m_pool.size());
+		m_pool.emplace_back();
+	}
+	Order& o = m_pool[index];
+	o = Order();
+	if(++m_seq == 0) m_seq = 1;
+	o.id = (static_cast<uint64_t>(m_seq) << 32) | index;
+	return index;
+}
+
+void MatchingEngine::release(uint32_t index){
+	m_pool[index].id = 0;
+	m_free.push_back(index);
+}
+
+MatchingEngine::Order* MatchingEngine::lookup(uint64_t id){
+	uint32_t index = static_cast<uint32_t>(id);
+	if(index >= m_pool.size() || m_pool[index].id != id || id == 0) return nullptr;
+	return &m_pool[index];
+}
+
+[[nodiscard]] const MatchingEngine::Order* MatchingEngine::find(uint64_t id) const{
+	return const_cast<MatchingEngine*>(this)->lookup(id);
+}
+
+// Takes from the front of the best levels while they cross the taker's limit
+template<typename Book>
+int64_t MatchingEngine::match(Book& book, Order& taker, uint32_t taker_index){
+	int64_t done = 0;
+	while(taker.qty > 0 && !book.empty()){
+		auto it = book.begin();
+		int64_t price = it->first;
+		if(taker.side == BUY ? price > taker.price : price < taker.price) break;
+		Level& level = it->second;
+		while(taker.qty > 0 && level.head != NIL){
+			uint32_t index = level.head;
+			Order& maker = m_pool[index];
+			int64_t qty = std::min(taker.qty, maker.qty);
+			maker.qty -= qty;
+			maker.filled += qty;
+			taker.qty -= qty;
+			taker.filled += qty;
+			level.qty -= qty;
+			if(maker.owner == 0) level.market -= qty;
+			done += qty;
+			m_stats.fills++;
+			if(m_on_fill){
+				m_on_fill(Fill{maker.id, m_pool[taker_index].id, maker.owner, taker.owner, taker.side, price, qty});
+			}
+			if(maker.qty == 0){
+				level.head = maker.next;
+				if(level.head != NIL) m_pool[level.head].prev = NIL;
+				else level.tail = NIL;
+				release(index);
+			}
+		}
+		if(level.head == NIL) book.erase(it);
+	}
+	return done;
+}
+
+template<typename Book>
+void MatchingEngine::rest(Book& book, uint32_t index){
+	Order& o = m_pool[index];
+	Level& level = book[o.price];
+	o.prev = level.tail;
+	o.next = NIL;
+	if(level.tail != NIL) m_pool[level.tail].next = index;
+	else level.head = index;
+	level.tail = index;
+	level.qty += o.qty;
+	if(o.owner == 0) level.market += o.qty;
+}
+
+template<typename Book>
+void MatchingEngine::unlink(Book& book, uint32_t index){
+	Order& o = m_pool[index];
+	auto it = book.find(o.price);
+	Level& level = it->second;
+	if(o.prev != NIL) m_pool[o.prev].next = o.next;
+	else level.head = o.next;
+	if(o.next != NIL) m_pool[o.next].prev = o.prev;
+	else level.tail = o.prev;
+	level.qty -= o.qty;
+	if(o.owner == 0) level.market -= o.qty;
+	if(level.head == NIL) book.erase(it);
+	o.prev = o.next = NIL;
+}
+
+bool MatchingEngine::crosses(Side side, int64_t price, int64_t& best_price) const{
+	int64_t qty;
+	if(!best(side == BUY ? SELL : BUY, best_price, qty)) return false;
+	return side == BUY ? price >= best_price : price <= best_price;
+}
+
+// Matches the order in the pool slot, then rests what is left
+MatchingEngine::Result MatchingEngine::place(uint32_t index){
+	Order& o = m_pool[index];
+	Result r;
+	r.id = o.id;
+	int64_t best_price;
+	if((o.flags & POST_ONLY) && crosses(o.side, o.price, best_price)){
+		if(o.flags & REJECT_POST_ONLY){
+			r.status = REJECTED_POST_ONLY;
+			release(index);
+			return r;
+		}
+		o.price = o.side == BUY ? best_price - 1 : best_price + 1;
+	}
+	int64_t before = o.filled;
+	if(o.side == BUY) match(m_asks, o, index);
+	else match(m_bids, o, index);
+	r.filled = o.filled - before;
+	if(o.qty == 0 || (o.flags & IOC)){
+		release(index);
+		return r;
+	}
+	if(o.side == BUY) rest(m_bids, index);
+	else rest(m_asks, index);
+	r.open = o.qty;
+	r.price = o.price;
+	return r;
+}
+
+MatchingEngine::Result MatchingEngine::submit(Side side, int64_t price, int64_t qty, uint32_t owner, uint8_t flags){
+	if(qty <= 0){
+		Result r;
+		r.status = BAD_QTY;
+		return r;
+	}
+	uint32_t index = alloc();
+	Order& o = m_pool[index];
+	o.side = side;
+	o.price = price;
+	o.qty = qty;
+	o.owner = owner;
+	o.flags = flags;
+	if(owner) m_stats.orders++;
+	return place(index);
+}
+
+MatchingEngine::Result MatchingEngine::cancel(uint64_t id){
+	Result r;
+	r.id = id;
+	Order* o = lookup(id);
+	if(!o){
+		r.status = UNKNOWN_ORDER;
+		return r;
+	}
+	uint32_t index = static_cast<uint32_t>(id);
+	r.price = o->price;
+	if(o->side == BUY) unlink(m_bids, index);
+	else unlink(m_asks, index);
+	release(index);
+	m_stats.cancels++;
+	return r;
+}
+
+MatchingEngine::Result MatchingEngine::edit(uint64_t id, int64_t price, int64_t qty){
+	Result r;
+	r.id = id;
+	Order* o = lookup(id);
+	if(!o){
+		r.status = UNKNOWN_ORDER;
+		return r;
+	}
+	int64_t open = qty - o->filled;
+	if(open <= 0){
+		r.status = BAD_QTY;
+		return r;
+	}
+	// A rejected edit leaves the order as it was
+	int64_t best_price;
+	if((o->flags & POST_ONLY) && (o->flags & REJECT_POST_ONLY) && crosses(o->side, price, best_price)){
+		r.status = REJECTED_POST_ONLY;
+		return r;
+	}
+	m_stats.edits++;
+	uint32_t index = static_cast<uint32_t>(id);
+	if(price == o->price && open <= o->qty){
+		// Smaller at the same price: keeps its place in the queue
+		Level& level = o->side == BUY ? m_bids.find(price)->second : m_asks.find(price)->second;
+		level.qty -= o->qty - open;
+		o->qty = open;
+		r.open = open;
+		r.price = price;
+		return r;
+	}
+	if(o->side == BUY) unlink(m_bids, index);
+	else unlink(m_asks, index);
+	o->price = price;
+	o->qty = open;
+	return place(index);
+}
+
+// Takes `lots` of the market's depth out of a level, orders of ours stay
+template<typename Book>
+void MatchingEngine::shrink(Book& book, int64_t price, int64_t lots){
+	auto it = book.find(price);
+	if(it == book.end()) return;
+	Level& level = it->second;
+	lots = std::min(lots, level.market);
+	int64_t market = level.market;
+	auto take = [&](uint32_t index, int64_t qty){
+		Order& o = m_pool[index];
+		o.qty -= qty;
+		level.qty -= qty;
+		level.market -= qty;
+		lots -= qty;
+		if(o.qty == 0){
+			if(o.prev != NIL) m_pool[o.prev].next = o.next;
+			else level.head = o.next;
+			if(o.next != NIL) m_pool[o.next].prev = o.prev;
+			else level.tail = o.prev;
+			release(index);
+		}
+	};
+	if(m_model == PRO_RATA){
+		int64_t total = lots;
+		for(uint32_t index = level.head; index != NIL && lots > 0;){
+			uint32_t next = m_pool[index].next;
+			if(m_pool[index].owner == 0){
+				int64_t share = m_pool[index].qty * total / market;
+				if(share > 0) take(index, std::min(share, lots));
+			}
+			index = next;
+		}
+	}
+	// FRONT from the head; BACK, and what pro rata rounding left, from the tail
+	if(m_model == FRONT){
+		for(uint32_t index = level.head; index != NIL && lots > 0;){
+			uint32_t next = m_pool[index].next;
+			if(m_pool[index].owner == 0) take(index, std::min(m_pool[index].qty, lots));
+			index = next;
+		}
+	} else {
+		for(uint32_t index = level.tail; index != NIL && lots > 0;){
+			uint32_t prev = m_pool[index].prev;
+			if(m_pool[index].owner == 0) take(index, std::min(m_pool[index].qty, lots));
+			index = prev;
+		}
+	}
+	if(level.head == NIL) book.erase(it);
+}
+
+void MatchingEngine::set_level(Side side, int64_t price, int64_t qty){
+	int64_t market = 0;
+	if(side == BUY){
+		auto it = m_bids.find(price);
+		if(it != m_bids.end()) market = it->second.market;
+	} else {
+		auto it = m_asks.find(price);
+		if(it != m_asks.end()) market = it->second.market;
+	}
+	if(qty > market){
+		submit(side, price, qty - market, 0);
+	} else if(qty < market){
+		if(side == BUY) shrink(m_bids, price, market - qty);
+		else shrink(m_asks, price, market - qty);
+	}
+}
+
+void MatchingEngine::trade(Side side, int64_t price, int64_t qty){
+	submit(side, price, qty, 0, IOC);
+}
+
+int64_t MatchingEngine::queue_ahead(uint64_t id) const{
+	const Order* o = find(id);
+	if(!o) return -1;
+	int64_t ahead = 0;
+	for(uint32_t index = o->prev; index != NIL; index = m_pool[index].prev) ahead += m_pool[index].qty;
+	return ahead;
+}
+
+MatchingEngine::Stats MatchingEngine::stats() const{
+	Stats s = m_stats;
+	s.resting = m_pool.size() - m_free.size();
+	return s;
+}
+
+bool MatchingEngine::best(Side side, int64_t& price, int64_t& qty) const{
+	if(side == BUY){
+		if(m_bids.empty()) return false;
+		price = m_bids.begin()->first;
+		qty = m_bids.begin()->second.qty;
+	} else {
+		if(m_asks.empty()) return false;
+		price = m_asks.begin()->first;
+		qty = m_asks.begin()->second.qty;
+	}
+	return true;
+}
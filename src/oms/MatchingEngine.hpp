@@ -0,0 +1,133 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <vector>
+#include "../HugeArena.hpp"
+
+// Price-time priority matching of one instrument, for simulation.
+//
+// Prices are integer ticks and quantities integer lots. Orders live in a
+// pool and are chained per price level in arrival order, so a new order,
+// a cancel and each fill are O(1) past finding the level. Owner 0 is the
+// outside market: its depth is set from market data with set_level() and
+// its prints replayed with trade(). Our orders queue behind the depth that
+// was there when they arrived; where the market's cancels come out of a
+// level (QueueModel) decides how fast they move up.
+// Not thread safe.
+class MatchingEngine{
+public:
+	enum Side : uint8_t { BUY, SELL };
+	// Which part of a level shrinks when the market's depth there drops without a trade
+	enum QueueModel : uint8_t {
+		BACK,      // orders behind ours first: our queue position only improves by trades
+		PRO_RATA,  // every market order in the level alike
+		FRONT,     // orders ahead of ours first
+	};
+	enum Flags : uint8_t {
+		POST_ONLY = 1,         // never takes: moved one tick away from the opposite side
+		REJECT_POST_ONLY = 2,  // with POST_ONLY, rejected instead of moved
+		IOC = 4,               // what does not fill at once is cancelled
+	};
+	enum Status : uint8_t { OK, REJECTED_POST_ONLY, UNKNOWN_ORDER, BAD_QTY };
+	static constexpr int64_t MARKET_BUY = INT64_MAX;  // limit of a market buy
+	static constexpr int64_t MARKET_SELL = INT64_MIN; // limit of a market sell
+
+	struct Fill{
+		uint64_t maker;
+		uint64_t taker;
+		uint32_t maker_owner;
+		uint32_t taker_owner;
+		Side taker_side;
+		int64_t price;
+		int64_t qty;
+	};
+	using OnFill = std::function<void(const Fill&)>;
+
+	struct Order{
+		uint64_t id = 0;      // 0 while the slot is free
+		int64_t price = 0;
+		int64_t qty = 0;      // open
+		int64_t filled = 0;
+		uint32_t owner = 0;
+		uint32_t prev = NIL;  // in the level, towards the front
+		uint32_t next = NIL;
+		Side side = BUY;
+		uint8_t flags = 0;
+	};
+	struct Result{
+		Status status = OK;
+		uint64_t id = 0;
+		int64_t filled = 0;   // by this call
+		int64_t open = 0;     // left resting
+		int64_t price = 0;    // resting price, post only orders may have moved
+	};
+	struct Stats{
+		uint64_t orders = 0;
+		uint64_t cancels = 0;
+		uint64_t edits = 0;
+		uint64_t fills = 0;
+		size_t resting = 0;   // orders of every owner
+	};
+
+	// Constructor
+	explicit MatchingEngine(QueueModel model = BACK);
+
+	// Called for every fill as it happens, must not call back into the engine
+	void on_fill(OnFill fn){ m_on_fill = std::move(fn); }
+
+	Result submit(Side side, int64_t price, int64_t qty, uint32_t owner, uint8_t flags = 0);
+	// Deribit edit: `qty` is the new total including what filled. A lower
+	// quantity at the same price keeps the order's place, anything else
+	// sends it to the back of its (new) level
+	Result edit(uint64_t id, int64_t price, int64_t qty);
+	Result cancel(uint64_t id);
+
+	// The market's depth at `price` is now `qty` lots. Depth that crosses
+	// the other side trades against it
+	void set_level(Side side, int64_t price, int64_t qty);
+	// A print of the market: `qty` taken by a `side` aggressor down to `price`
+	void trade(Side side, int64_t price, int64_t qty);
+
+	[[nodiscard]] const Order* find(uint64_t id) const;
+	// Lots ahead of the order in its level, -1 when it is not resting
+	int64_t queue_ahead(uint64_t id) const;
+	// Best price of a side, false when the side is empty
+	bool best(Side side, int64_t& price, int64_t& qty) const;
+	Stats stats() const;
+private:
+	static constexpr uint32_t NIL = UINT32_MAX;
+	struct Level{
+		int64_t qty = 0;      // all orders
+		int64_t market = 0;   // owner 0's share
+		uint32_t head = NIL;
+		uint32_t tail = NIL;
+	};
+	using LevelNode = std::pair<const int64_t, Level>;
+	using Bids = std::map<int64_t, Level, std::greater<int64_t>, ArenaAllocator<LevelNode>>;
+	using Asks = std::map<int64_t, Level, std::less<int64_t>, ArenaAllocator<LevelNode>>;
+
+	uint32_t alloc();
+	void release(uint32_t index);
+	Order* lookup(uint64_t id);
+	// Whether a `side` order at `price` would take, with the opposite best
+	bool crosses(Side side, int64_t price, int64_t& best_price) const;
+	template<typename Book>
+	int64_t match(Book& book, Order& taker, uint32_t taker_index);
+	template<typename Book>
+	void rest(Book& book, uint32_t index);
+	template<typename Book>
+	void unlink(Book& book, uint32_t index);
+	template<typename Book>
+	void shrink(Book& book, int64_t price, int64_t lots);
+	Result place(uint32_t index);
+
+	QueueModel m_model;
+	OnFill m_on_fill;
+	Bids m_bids;
+	Asks m_asks;
+	std::vector<Order> m_pool;
+	std::vector<uint32_t> m_free;
+	uint32_t m_seq = 0;
+	Stats m_stats;
+};
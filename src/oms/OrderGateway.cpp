@@ -0,0 +1,249 @@
+#include "OrderGateway.hpp"
+#include <cerrno>
+#include <csignal>
+#include <ctime>
+#include <thread>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+static_assert(std::atomic<uint32_t>::is_always_lock_free && std::atomic<uint64_t>::is_always_lock_free,
+	"gateway rings need lock free atomics in shared memory");
+
+static constexpr int64_t GATEWAY_TIMEOUT_NS = 10000000000ll;
+
+static int64_t monotonic_ns(){
+	timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ll + ts.tv_nsec;
+}
+
+// Constructor
+// Deribit's default credit budget: matching engine requests ~5/s with bursts
+// of 20, everything else ~20/s with bursts of 100
+OrderGateway::OrderGateway() : m_matching(5, 20), m_other(20, 100), m_backlog(GatewayHeader::MAX_CLIENTS) {}
+
+// Destructor
+OrderGateway::~OrderGateway(){
+	if(!m_header) return;
+	munmap(m_header, sizeof(GatewayHeader));
+	shm_unlink(m_name.c_str());
+}
+
+int OrderGateway::open(const std::string& name){
+	if(m_header) return 1;
+	// Slots of a previous gateway belong to sessions that are gone
+	shm_unlink(name.c_str());
+	int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+	if(fd < 0) return 1;
+	if(ftruncate(fd, sizeof(GatewayHeader)) != 0){
+		close(fd);
+		shm_unlink(name.c_str());
+		return 1;
+	}
+	void* p = mmap(nullptr, sizeof(GatewayHeader), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if(p == MAP_FAILED){
+		shm_unlink(name.c_str());
+		return 1;
+	}
+	m_name = name;
+	m_header = static_cast<GatewayHeader*>(p);
+	for(GatewayClient& c : m_header->clients){
+		c.state.store(GatewayClient::FREE, std::memory_order_relaxed);
+		c.pid = 0;
+		c.generation.store(0, std::memory_order_relaxed);
+		c.requests.reset();
+		c.responses.reset();
+	}
+	m_header->client_size = sizeof(GatewayClient);
+	m_header->gateway_pid = getpid();
+	m_header->heartbeat_ns.store(monotonic_ns(), std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	m_header->magic = GatewayHeader::MAGIC;
+	return 0;
+}
+
+bool OrderGateway::is_matching(const std::string& request){
+	for(const char* m : {"private/buy", "private/sell", "private/edit", "private/cancel"}){
+		if(request.find(m) != std::string::npos) return true;
+	}
+	return false;
+}
+
+// Replies go out in order, whatever does not fit waits for the client to read
+void OrderGateway::flush(GatewayClient& c, Backlog& b){
+	while(!b.replies.empty()){
+		Message& m = b.replies.front();
+		if(c.responses.write(m.tag, m.flags, m.text.data(), m.text.size())) return;
+		b.replies.pop_front();
+	}
+}
+
+int OrderGateway::poll(const Handler& handler){
+	if(!m_header) return 0;
+	int64_t now = monotonic_ns();
+	m_header->heartbeat_ns.store(now, std::memory_order_relaxed);
+	if(now - m_last_reclaim_ns > 1000000000ll){
+		reclaim_dead();
+		m_last_reclaim_ns = now;
+	}
+
+	int forwarded = 0;
+	for(uint32_t i = 0; i < GatewayHeader::MAX_CLIENTS; i++){
+		GatewayClient& c = m_header->clients[i];
+		Backlog& b = m_backlog[i];
+		if(c.state.load(std::memory_order_acquire) != GatewayClient::ACTIVE){
+			if(b.held || !b.replies.empty()) b = Backlog();
+			continue;
+		}
+		// Released and claimed again since the last pass: whatever is queued
+		// belongs to the old client, whose tags the new one reuses
+		uint32_t generation = c.generation.load(std::memory_order_acquire);
+		if(b.generation != generation){
+			b = Backlog();
+			b.generation = generation;
+		}
+		flush(c, b);
+
+		// A few requests per client per pass keeps one busy client from starving the rest
+		for(int k = 0; k < 8; k++){
+			if(!b.held){
+				if(c.requests.read(b.request.tag, b.request.flags, b.request.text)) break;
+				b.held = true;
+			}
+			RateLimiter& limit = is_matching(b.request.text) ? m_matching : m_other;
+			if(limit.acquire(now)) break; // stays held until a token frees up
+
+			std::pair<int, std::string> resp = handler(b.request.text);
+			b.held = false;
+			forwarded++;
+			// The client may have left (and the slot been claimed again) meanwhile
+			if(c.state.load(std::memory_order_acquire) != GatewayClient::ACTIVE
+				|| c.generation.load(std::memory_order_acquire) != generation) break;
+
+			Message reply{b.request.tag, resp.first ? GW_FAILED : GW_OK, std::move(resp.second)};
+			if(reply.text.size() > ResponseRing::MAX_PAYLOAD){
+				reply.flags = GW_REJECTED;
+				reply.text = R"({"error":{"message":"reply too large for the gateway ring"}})";
+			}
+			b.replies.push_back(std::move(reply));
+			flush(c, b);
+		}
+	}
+	return forwarded;
+}
+
+void OrderGateway::run(const Handler& handler, const std::atomic<bool>& running, const std::function<void()>& each_pass){
+	int idle = 0;
+	while(running.load(std::memory_order_relaxed)){
+		int forwarded = poll(handler);
+		if(each_pass) each_pass();
+		if(forwarded){
+			idle = 0;
+		} else if(++idle > 4096){
+			// Nothing for a while, give the core back between passes
+			std::this_thread::yield();
+		}
+	}
+}
+
+// Slots of processes that exited without releasing them
+void OrderGateway::reclaim_dead(){
+	for(uint32_t i = 0; i < GatewayHeader::MAX_CLIENTS; i++){
+		GatewayClient& c = m_header->clients[i];
+		if(c.state.load(std::memory_order_acquire) == GatewayClient::FREE) continue;
+		if(c.pid > 0 && kill(c.pid, 0) != 0 && errno == ESRCH){
+			m_backlog[i] = Backlog();
+			c.requests.reset();
+			c.responses.reset();
+			c.pid = 0;
+			c.state.store(GatewayClient::FREE, std::memory_order_release);
+		}
+	}
+}
+
+// Constructor
+OrderClient::OrderClient() {}
+
+// Destructor
+OrderClient::~OrderClient(){
+	if(m_slot){
+		m_slot->pid = 0;
+		m_slot->state.store(GatewayClient::FREE, std::memory_order_release);
+	}
+	if(m_header) munmap(m_header, sizeof(GatewayHeader));
+}
+
+int OrderClient::connect(const std::string& name){
+	if(m_header) return 1;
+	int fd = shm_open(name.c_str(), O_RDWR, 0);
+	if(fd < 0) return 1;
+	void* p = mmap(nullptr, sizeof(GatewayHeader), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if(p == MAP_FAILED) return 1;
+	GatewayHeader* h = static_cast<GatewayHeader*>(p);
+	std::atomic_thread_fence(std::memory_order_acquire);
+	if(h->magic != GatewayHeader::MAGIC || h->client_size != sizeof(GatewayClient)){
+		munmap(p, sizeof(GatewayHeader));
+		return 1;
+	}
+	for(GatewayClient& c : h->clients){
+		uint32_t expected = GatewayClient::FREE;
+		if(!c.state.compare_exchange_strong(expected, GatewayClient::CLAIMED, std::memory_order_acq_rel)) continue;
+		c.requests.reset();
+		c.responses.reset();
+		c.pid = getpid();
+		c.generation.fetch_add(1, std::memory_order_relaxed);
+		c.state.store(GatewayClient::ACTIVE, std::memory_order_release);
+		m_header = h;
+		m_slot = &c;
+		return 0;
+	}
+	munmap(p, sizeof(GatewayHeader)); // every slot taken
+	return 1;
+}
+
+uint64_t OrderClient::submit(const std::string& request){
+	if(!m_slot) return 0;
+	uint64_t tag = m_next_tag;
+	if(m_slot->requests.write(tag, 0, request.data(), request.size())) return 0;
+	m_next_tag++;
+	return tag;
+}
+
+int OrderClient::poll(uint64_t& tag, int& status, std::string& reply){
+	if(!m_early.empty()){
+		Reply& r = m_early.front();
+		tag = r.tag;
+		status = r.status;
+		reply = std::move(r.text);
+		m_early.pop_front();
+		return 0;
+	}
+	if(!m_slot) return 1;
+	uint32_t flags;
+	if(m_slot->responses.read(tag, flags, reply)) return 1;
+	status = flags == GW_OK ? 0 : 1;
+	return 0;
+}
+
+[[nodiscard]] std::pair<int, std::string> OrderClient::request(const std::string& request){
+	uint64_t want = submit(request);
+	if(want == 0) return std::make_pair(1, std::string(R"({"error":{"message":"gateway request ring full"}})"));
+	std::string reply;
+	uint32_t flags;
+	uint64_t tag;
+	for(uint64_t spins = 1;; spins++){
+		if(m_slot->responses.read(tag, flags, reply)){
+			// A gateway blocked on one slow exchange reply still beats within seconds
+			if((spins & 0xffff) == 0 && monotonic_ns() - m_header->heartbeat_ns.load(std::memory_order_relaxed) > GATEWAY_TIMEOUT_NS){
+				return std::make_pair(1, std::string(R"({"error":{"message":"gateway not responding"}})"));
+			}
+			if(spins > 4096) std::this_thread::yield(); // the gateway may share our core
+			continue;
+		}
+		if(tag == want) return std::make_pair(flags == GW_OK ? 0 : 1, std::move(reply));
+		m_early.push_back(Reply{tag, flags == GW_OK ? 0 : 1, std::move(reply)});
+	}
+}
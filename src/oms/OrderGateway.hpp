@@ -0,0 +1,138 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+#include "../ShmRing.hpp"
+
+// Shared memory order gateway.
+//
+// One gateway process owns the authenticated exchange session; strategy
+// processes on the same host claim a client slot in the region and send
+// JSON-RPC requests through their own request ring. The gateway forwards
+// them (rate limited) and routes each reply back, tagged with the client's
+// request tag, through that client's response ring.
+
+using RequestRing = ShmRing<64 * 1024>;
+using ResponseRing = ShmRing<1024 * 1024>;
+
+struct alignas(64) GatewayClient{
+	enum State : uint32_t { FREE, CLAIMED, ACTIVE };
+	std::atomic<uint32_t> state;
+	int32_t pid;
+	// Bumped by every connect(), tells the gateway the slot changed hands
+	std::atomic<uint32_t> generation;
+	RequestRing requests;
+	ResponseRing responses;
+};
+
+struct alignas(64) GatewayHeader{
+	static constexpr uint32_t MAGIC = 0x4f475732; // "OGW2"
+	static constexpr uint32_t MAX_CLIENTS = 16;
+	uint32_t magic;
+	uint32_t client_size;
+	int32_t gateway_pid;
+	std::atomic<int64_t> heartbeat_ns;
+	GatewayClient clients[MAX_CLIENTS];
+};
+
+// Flags on ring messages
+enum GatewayFlags : uint32_t { GW_OK = 0, GW_FAILED = 1, GW_REJECTED = 2 };
+
+// Token bucket, `rate` requests per second with bursts of `burst`
+class RateLimiter{
+public:
+	// Constructor
+	RateLimiter(double rate, double burst) : m_rate(rate), m_burst(burst), m_tokens(burst) {}
+	// Returns 0 and takes a token when one is available at `now_ns`
+	int acquire(int64_t now_ns){
+		if(m_last_ns) m_tokens = std::min(m_burst, m_tokens + (now_ns - m_last_ns) * 1e-9 * m_rate);
+		m_last_ns = now_ns;
+		if(m_tokens < 1) return 1;
+		m_tokens -= 1;
+		return 0;
+	}
+private:
+	double m_rate;
+	double m_burst;
+	double m_tokens;
+	int64_t m_last_ns = 0;
+};
+
+// Gateway side
+class OrderGateway{
+public:
+	// [status, reply] of one forwarded request
+	using Handler = std::function<std::pair<int, std::string>(const std::string&)>;
+
+	// Constructor
+	OrderGateway();
+	// Destructor
+	~OrderGateway();
+
+	// Creates the region `name` (eg. "/hft_gateway"), returns 0 on success
+	int open(const std::string& name);
+	// One pass over every client, returns the number of requests forwarded
+	int poll(const Handler& handler);
+	// Poll until `running` turns false, spinning while there is work; `each_pass`
+	// runs after every pass (e.g. the session's timers)
+	void run(const Handler& handler, const std::atomic<bool>& running, const std::function<void()>& each_pass = {});
+
+	// Matching engine methods (buy/sell/edit/cancel) have a tighter budget at the exchange
+	static bool is_matching(const std::string& request);
+private:
+	struct Message{
+		uint64_t tag;
+		uint32_t flags;
+		std::string text;
+	};
+	// Per client: a request waiting for a rate limit token, replies waiting
+	// for room in the response ring, both of the slot's `generation`
+	struct Backlog{
+		uint32_t generation = 0;
+		bool held = false;
+		Message request;
+		std::deque<Message> replies;
+	};
+	void reclaim_dead();
+	void flush(GatewayClient& c, Backlog& b);
+
+	std::string m_name;
+	GatewayHeader* m_header = nullptr;
+	RateLimiter m_matching;
+	RateLimiter m_other;
+	std::vector<Backlog> m_backlog;
+	int64_t m_last_reclaim_ns = 0;
+};
+
+// Strategy side
+class OrderClient{
+public:
+	// Constructor
+	OrderClient();
+	// Destructor, releases the slot
+	~OrderClient();
+
+	// Claims a free slot in the gateway region `name`, returns 0 on success
+	int connect(const std::string& name);
+	// Queues `request`, returns its tag (0 when the request ring is full)
+	uint64_t submit(const std::string& request);
+	// Next reply if any, returns 0 and fills `tag` / `reply`; status 1 on failure
+	int poll(uint64_t& tag, int& status, std::string& reply);
+	// Submit and spin until the reply arrives, same contract as Api::api_private
+	[[nodiscard]] std::pair<int, std::string> request(const std::string& request);
+private:
+	struct Reply{
+		uint64_t tag;
+		int status;
+		std::string text;
+	};
+	GatewayHeader* m_header = nullptr;
+	GatewayClient* m_slot = nullptr;
+	uint64_t m_next_tag = 1;
+	std::deque<Reply> m_early; // replies request() read while waiting for another tag
+};
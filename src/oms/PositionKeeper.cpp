@@ -0,0 +1,130 @@
+#include "PositionKeeper.hpp"
+#include <cmath>
+
+// Options and USDC linear instruments are not inverse
+bool PositionKeeper::is_inverse(const std::string& inst){
+	if(inst.find('_') != std::string::npos) return false;
+	bool option = inst.size() > 2 && inst[inst.size() - 2] == '-' && (inst.back() == 'C' || inst.back() == 'P');
+	return !option;
+}
+
+Position& PositionKeeper::get(const std::string& inst){
+	auto it = m_positions.find(inst);
+	if(it != m_positions.end()) return it->second;
+	Position& p = m_positions[inst];
+	p.inverse = is_inverse(inst);
+	return p;
+}
+
+// PnL of `qty` (signed) held from `entry` to `exit`
+static double pnl(bool inverse, double qty, double entry, double exit){
+	if(entry <= 0 || exit <= 0) return 0;
+	return inverse ? qty * (1.0 / entry - 1.0 / exit) : qty * (exit - entry);
+}
+
+void PositionKeeper::mark(Position& p){
+	p.unrealized_pnl = (p.size != 0 && p.mark_price > 0) ? pnl(p.inverse, p.size, p.avg_price, p.mark_price) : 0;
+}
+
+void PositionKeeper::apply_fill(const std::string& inst, bool is_buy, double price, double amount, double fee, uint64_t trade_seq, int64_t ts_ms){
+	Position& p = get(inst);
+	if(trade_seq && trade_seq <= p.last_trade_seq) return; // replayed fill
+	if(trade_seq) p.last_trade_seq = trade_seq;
+
+	double qty = is_buy ? amount : -amount;
+	p.fees += fee;
+	p.realized_pnl -= fee;
+
+	if(p.size == 0 || (p.size > 0) == (qty > 0)){
+		// Opening / adding: average entry, harmonic for inverse contracts
+		double total = std::fabs(p.size) + amount;
+		if(p.inverse){
+			p.avg_price = total / (std::fabs(p.size) / (p.avg_price > 0 ? p.avg_price : price) + amount / price);
+		} else {
+			p.avg_price = (p.avg_price * std::fabs(p.size) + price * amount) / total;
+		}
+		p.size += qty;
+	} else {
+		// Reducing, possibly flipping: close at most the current size
+		double closed = std::fmin(amount, std::fabs(p.size));
+		double closed_signed = p.size > 0 ? closed : -closed;
+		p.realized_pnl += pnl(p.inverse, closed_signed, p.avg_price, price);
+		p.size += qty;
+		if(std::fabs(p.size) < 1e-12){
+			p.size = 0;
+			p.avg_price = 0;
+		} else if(amount > closed){
+			p.avg_price = price; // the remainder opened a new position
+		}
+	}
+	p.updated_ms = ts_ms;
+	mark(p);
+}
+
+void PositionKeeper::apply_mark(const std::string& inst, double mark_price){
+	auto it = m_positions.find(inst);
+	if(it == m_positions.end()) return; // only instruments we hold
+	it->second.mark_price = mark_price;
+	mark(it->second);
+}
+
+void PositionKeeper::on_trades(const nlohmann::json& data){
+	for(const auto& t : data){
+		apply_fill(t["instrument_name"].get<std::string>(), t["direction"] == "buy",
+			t["price"].get<double>(), t["amount"].get<double>(), t.value("fee", 0.0),
+			t.value("trade_seq", static_cast<uint64_t>(0)), t.value("timestamp", static_cast<int64_t>(0)));
+	}
+}
+
+void PositionKeeper::on_ticker(const nlohmann::json& data){
+	if(data.contains("mark_price") && data["mark_price"].is_number()){
+		apply_mark(data["instrument_name"].get<std::string>(), data["mark_price"].get<double>());
+	}
+}
+
+void PositionKeeper::restore(const std::string& inst, const Position& p){
+	Position& local = m_positions[inst];
+	local = p;
+	mark(local);
+}
+
+int PositionKeeper::reconcile(const nlohmann::json& result, int64_t now_ms){
+	Position& p = get(result["instrument_name"].get<std::string>());
+	double size = result.value("size", 0.0);
+	double avg = result.value("average_price", 0.0);
+	int drift = (std::fabs(size - p.size) > 1e-9 || (size != 0 && std::fabs(avg - p.avg_price) > 1e-9 * avg)) ? 1 : 0;
+
+	// The exchange is the source of truth
+	p.size = size;
+	p.avg_price = size != 0 ? avg : 0;
+	p.realized_pnl = result.value("realized_profit_loss", p.realized_pnl);
+	p.mark_price = result.value("mark_price", p.mark_price);
+	p.reconciled_ms = now_ms;
+	p.updated_ms = now_ms;
+	mark(p);
+	return drift;
+}
+
+[[nodiscard]] const Position* PositionKeeper::find(const std::string& inst) const{
+	auto it = m_positions.find(inst);
+	return it == m_positions.end() ? nullptr : &it->second;
+}
+
+[[nodiscard]] nlohmann::json PositionKeeper::summary(const std::string& inst) const{
+	const Position* p = find(inst);
+	if(!p) return nullptr;
+	nlohmann::json out;
+	out["instrument_name"] = inst;
+	out["size"] = p->size;
+	out["direction"] = p->size > 0 ? "buy" : (p->size < 0 ? "sell" : "zero");
+	out["average_price"] = p->avg_price;
+	out["mark_price"] = p->mark_price;
+	out["realized_profit_loss"] = p->realized_pnl;
+	out["floating_profit_loss"] = p->unrealized_pnl;
+	out["total_profit_loss"] = p->realized_pnl + p->unrealized_pnl;
+	out["fees"] = p->fees;
+	out["updated"] = p->updated_ms;
+	out["reconciled"] = p->reconciled_ms;
+	out["source"] = "local";
+	return out;
+}
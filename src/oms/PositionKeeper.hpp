@@ -0,0 +1,51 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <nlohmann/json.hpp>
+
+// Local position of one instrument
+struct Position{
+	// Inverse contracts (BTC-PERPETUAL, ETH futures) are sized in USD and
+	// settle PnL in the coin, linear ones (options, *_USDC) in price units
+	bool inverse = false;
+	double size = 0;           // signed, + long / - short
+	double avg_price = 0;
+	double realized_pnl = 0;
+	double unrealized_pnl = 0;
+	double fees = 0;
+	double mark_price = 0;
+	uint64_t last_trade_seq = 0;
+	int64_t updated_ms = 0;
+	int64_t reconciled_ms = 0;
+};
+
+// Position and PnL keeper fed from user.trades.* fills and ticker.* marks.
+// Every fill/mark is an O(1) update so readers get position and PnL without
+// a round trip, private/get_position is only used to reconcile.
+// Not thread safe, the owner serializes updates and reads.
+class PositionKeeper{
+public:
+	// Fill of our own order; fills with a trade_seq already applied are ignored
+	void apply_fill(const std::string& inst, bool is_buy, double price, double amount, double fee, uint64_t trade_seq, int64_t ts_ms);
+	void apply_mark(const std::string& inst, double mark_price);
+
+	// `data` of a user.trades.* notification
+	void on_trades(const nlohmann::json& data);
+	// `data` of a ticker.* notification
+	void on_ticker(const nlohmann::json& data);
+	// Position saved by a previous run, replaces the local one
+	void restore(const std::string& inst, const Position& p);
+	// `result` of private/get_position, returns 1 when the local state had drifted
+	int reconcile(const nlohmann::json& result, int64_t now_ms);
+
+	[[nodiscard]] const Position* find(const std::string& inst) const;
+	[[nodiscard]] nlohmann::json summary(const std::string& inst) const;
+
+	static bool is_inverse(const std::string& inst);
+private:
+	Position& get(const std::string& inst);
+	static void mark(Position& p);
+
+	std::unordered_map<std::string, Position> m_positions;
+};
@@ -0,0 +1,217 @@
+#include "QuoteManager.hpp"
+#include "../Logger.hpp"
+#include <charconv>
+#include <cstdlib>
+
+// Constructor
+QuoteManager::QuoteManager(const Instruments& instruments, Send send) : m_instruments(instruments), m_send(std::move(send)) {}
+
+QuoteManager::Quotes& QuoteManager::quotes(InstrumentId id){
+	if(id >= m_quotes.size()) m_quotes.resize(id + 1);
+	return m_quotes[id];
+}
+
+void QuoteManager::set_threshold(InstrumentId id, int64_t ticks, int64_t lots){
+	Quotes& q = quotes(id);
+	q.min_ticks = ticks > 0 ? ticks : 1;
+	q.min_lots = lots > 0 ? lots : 1;
+}
+
+int QuoteManager::quote(InstrumentId id, Side side, Price price, Qty qty){
+	m_stats.updates++;
+	Leg& leg = quotes(id).legs[side];
+	if(qty.n < 0) qty = Qty(0);
+	// Never improve on the asked price when a coarser tick applies
+	price = m_instruments.get(id).snap(price, side == BID ? Price::DOWN : Price::UP);
+	if(leg.want_price == price && leg.want_qty == qty && !leg.stale) return 0;
+	leg.want_price = price;
+	leg.want_qty = qty;
+	if(leg.op != NONE){
+		// Goes out with the reply, an earlier change not yet sent is dropped
+		if(leg.stale) m_stats.conflated++;
+		leg.stale = true;
+		return 0;
+	}
+	return work(id, side);
+}
+
+int QuoteManager::pull(InstrumentId id){
+	int bid = quote(id, BID, Price(0), Qty(0));
+	int ask = quote(id, ASK, Price(0), Qty(0));
+	return bid | ask;
+}
+
+int QuoteManager::work(InstrumentId id, Side side){
+	Quotes& q = m_quotes[id];
+	Leg& leg = q.legs[side];
+	leg.stale = false;
+	const Instrument& ins = m_instruments.get(id);
+	std::string request;
+	Op op = NONE;
+	uint64_t rpc_id = m_next_id;
+	if(leg.want_qty.n == 0){
+		if(leg.live.order_id.empty()) return 0;
+		request = cancel_request(leg.live.order_id, rpc_id);
+		op = CANCEL;
+	} else if(leg.live.order_id.empty()){
+		request = order_request(side == BID ? "private/buy" : "private/sell", ins.json_field(), ins, leg.want_price, leg.want_qty, rpc_id);
+		op = NEW;
+	} else {
+		int64_t ticks = std::llabs((leg.want_price - leg.live.price).n);
+		int64_t lots = std::llabs((leg.want_qty - leg.live.qty).n);
+		if(ticks == 0 && lots == 0) return 0;
+		if(ticks < q.min_ticks && lots < q.min_lots){
+			m_stats.below_threshold++;
+			return 0;
+		}
+		std::string target = R"("order_id":")" + leg.live.order_id + '"';
+		request = order_request("private/edit", target, ins, leg.want_price, leg.want_qty, rpc_id);
+		op = EDIT;
+	}
+	if(request.empty()){
+		Logger::instance().log(LogId::TRADER_ERROR, "quote price or amount does not fit");
+		leg.stale = true;
+		return 1;
+	}
+	m_next_id++;
+	uint64_t tag = m_send(rpc_id, request);
+	if(!tag){
+		// Tried again on the next change
+		leg.stale = true;
+		return 1;
+	}
+	leg.op = op;
+	leg.tag = tag;
+	leg.sent_price = leg.want_price;
+	leg.sent_qty = leg.want_qty;
+	leg.live.pending = true;
+	m_tags[tag] = (static_cast<uint64_t>(id) << 1) | side;
+	if(op == NEW) m_stats.sent_new++;
+	else if(op == EDIT) m_stats.sent_edit++;
+	else m_stats.sent_cancel++;
+	return 0;
+}
+
+int QuoteManager::on_reply(uint64_t tag, int status, const std::string& reply){
+	auto it = m_tags.find(tag);
+	if(it == m_tags.end()) return 1;
+	InstrumentId id = static_cast<InstrumentId>(it->second >> 1);
+	Side side = static_cast<Side>(it->second & 1);
+	m_tags.erase(it);
+	Leg& leg = m_quotes[id].legs[side];
+	const Instrument& ins = m_instruments.get(id);
+	Op op = leg.op;
+	leg.op = NONE;
+	leg.tag = 0;
+	leg.live.pending = false;
+
+	nlohmann::json obj = nlohmann::json::parse(reply, nullptr, false);
+	const nlohmann::json* result = nullptr;
+	if(status == 0 && obj.is_object()){
+		auto r = obj.find("result");
+		if(r != obj.end() && r->is_object()) result = &*r;
+	}
+	if(!result){
+		m_stats.rejected++;
+		Logger::instance().log_text(LogId::TRADER_ERROR, reply.substr(0, 200));
+		if(op == NEW || reply.find("not_open_order") == std::string::npos){
+			// Not retried before the strategy quotes again, a rejected quote would come straight back
+			leg.stale = true;
+			return 0;
+		}
+		// The order is gone (filled or cancelled), place a new one
+		forget(leg);
+	} else if(op == CANCEL){
+		forget(leg);
+	} else {
+		// private/buy, sell and edit reply {"order":{...},"trades":[...]}
+		auto it_order = result->find("order");
+		const nlohmann::json* order = it_order != result->end() && it_order->is_object() ? &*it_order : nullptr;
+		if(op == NEW && order){
+			auto oid = order->find("order_id");
+			if(oid != order->end() && oid->is_string()){
+				leg.live.order_id = oid->get<std::string>();
+				m_orders[leg.live.order_id] = (static_cast<uint64_t>(id) << 1) | side;
+			}
+		}
+		leg.live.price = leg.sent_price;
+		leg.live.qty = leg.sent_qty;
+		if(order) apply_order(leg, ins, *order);
+	}
+	// Catch up with the quote wanted now
+	return work(id, side);
+}
+
+void QuoteManager::apply_order(Leg& leg, const Instrument& ins, const nlohmann::json& order){
+	auto state = order.find("order_state");
+	if(state != order.end() && state->is_string()){
+		const std::string& s = state->get_ref<const std::string&>();
+		if(s == "filled" || s == "cancelled" || s == "rejected"){
+			forget(leg);
+			return;
+		}
+	}
+	// Post only orders may be repriced by the exchange
+	auto price = order.find("price");
+	if(price != order.end() && price->is_number()) leg.live.price = Price::from_double(price->get<double>(), ins.price_scale);
+	auto amount = order.find("amount");
+	if(amount != order.end() && amount->is_number()) leg.live.qty = Qty::from_double(amount->get<double>(), ins.qty_scale);
+}
+
+void QuoteManager::forget(Leg& leg){
+	if(!leg.live.order_id.empty()) m_orders.erase(leg.live.order_id);
+	leg.live.order_id.clear();
+	leg.live.price = Price(0);
+	leg.live.qty = Qty(0);
+}
+
+void QuoteManager::on_order(const nlohmann::json& data){
+	if(data.is_array()){
+		for(const nlohmann::json& order : data) on_order(order);
+		return;
+	}
+	auto oid = data.find("order_id");
+	if(oid == data.end() || !oid->is_string()) return;
+	auto it = m_orders.find(oid->get_ref<const std::string&>());
+	if(it == m_orders.end()) return;
+	InstrumentId id = static_cast<InstrumentId>(it->second >> 1);
+	Side side = static_cast<Side>(it->second & 1);
+	Leg& leg = m_quotes[id].legs[side];
+	// The reply of a request in flight carries a newer state
+	if(leg.op != NONE) return;
+	apply_order(leg, m_instruments.get(id), data);
+	// Filled or cancelled away: quote again
+	if(leg.live.order_id.empty()) work(id, side);
+}
+
+const QuoteManager::Live* QuoteManager::live(InstrumentId id, Side side) const{
+	if(id >= m_quotes.size()) return nullptr;
+	return &m_quotes[id].legs[side].live;
+}
+
+// Quotes rest on the book, they never take liquidity
+std::string QuoteManager::order_request(const char* method, std::string_view target, const Instrument& ins, Price price, Qty qty, uint64_t id) const{
+	char px[32], amt[32], num[24];
+	char* px_end = format_decimal(px, px + sizeof(px), price, ins.price_scale);
+	char* amt_end = format_decimal(amt, amt + sizeof(amt), qty, ins.qty_scale);
+	if(!px_end || !amt_end) return std::string();
+	char* num_end = std::to_chars(num, num + sizeof(num), id).ptr;
+	std::string payload;
+	payload.reserve(192);
+	payload += R"({"jsonrpc":"2.0","method":")";
+	payload += method;
+	payload += R"(","params":{)";
+	payload += target;
+	payload += R"(,"price":)";
+	payload.append(px, px_end - px);
+	payload += R"(,"amount":)";
+	payload.append(amt, amt_end - amt);
+	payload += R"(,"post_only":true},"id":)";
+	payload.append(num, num_end);
+	payload += '}';
+	return payload;
+}
+
+std::string QuoteManager::cancel_request(const std::string& order_id, uint64_t id) const{
+	return R"({"jsonrpc":"2.0","method":"private/cancel","params":{"order_id":")" + order_id + R"("},"id":)" + std::to_string(id) + '}';
+}
@@ -0,0 +1,100 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <nlohmann/json.hpp>
+#include "../Price.hpp"
+#include "../market_data/Instruments.hpp"
+
+// Two sided quotes kept in line with what the strategy wants.
+//
+// The strategy states the quote it wants per instrument and side as often
+// as it likes; the manager compares it with the live order and only sends
+// a request when they differ by at least the instrument's threshold. Each
+// side has at most one request in flight: quotes set meanwhile replace one
+// another, and once the reply is in only the latest goes out (one
+// private/edit however many ticks passed). Requests leave through `send`
+// and their replies come back through on_reply(), so any transport works
+// (OrderClient::submit / poll, USocket::post and its reply handler).
+// Not thread safe, the owner serializes calls.
+class QuoteManager{
+public:
+	enum Side : uint8_t { BID, ASK };
+	// Sends `request`, whose JSON-RPC id is `id` (a new one per request),
+	// returns its tag (0 when it could not be sent). Transports matching
+	// replies by id can return `id` itself. Must not call on_reply() from inside
+	using Send = std::function<uint64_t(uint64_t id, const std::string& request)>;
+
+	struct Stats{
+		uint64_t updates = 0;         // quote() calls
+		uint64_t sent_new = 0;
+		uint64_t sent_edit = 0;
+		uint64_t sent_cancel = 0;
+		uint64_t below_threshold = 0; // changes too small to send
+		uint64_t conflated = 0;       // changes replaced by a later one while a request was in flight
+		uint64_t rejected = 0;        // requests that failed at the exchange
+	};
+	// Side as the exchange has it, empty order_id when none
+	struct Live{
+		std::string order_id;
+		Price price;
+		Qty qty;
+		bool pending = false;         // a request is in flight
+	};
+
+	// Constructor
+	QuoteManager(const Instruments& instruments, Send send);
+
+	// Changes smaller than `ticks` in price and `lots` in amount are not sent, 1 / 1 by default
+	void set_threshold(InstrumentId id, int64_t ticks, int64_t lots);
+	// Quote wanted on `side`, a zero `qty` pulls it. Returns 1 when a request could not be sent
+	int quote(InstrumentId id, Side side, Price price, Qty qty);
+	// Pulls both sides
+	int pull(InstrumentId id);
+
+	// Reply to a request, returns 1 when `tag` is not one of ours
+	int on_reply(uint64_t tag, int status, const std::string& reply);
+	// `data` of a user.orders.* notification (one order or an array): fills
+	// and cancels on the exchange side
+	void on_order(const nlohmann::json& data);
+
+	[[nodiscard]] const Live* live(InstrumentId id, Side side) const;
+	const Stats& stats() const { return m_stats; }
+private:
+	enum Op : uint8_t { NONE, NEW, EDIT, CANCEL };
+	struct Leg{
+		Price want_price;
+		Qty want_qty;              // 0: no quote wanted
+		Live live;
+		Op op = NONE;              // request in flight
+		uint64_t tag = 0;
+		Price sent_price;          // what it asks for
+		Qty sent_qty;
+		bool stale = false;        // the wanted quote changed while it was in flight
+	};
+	struct Quotes{
+		Leg legs[2];
+		int64_t min_ticks = 1;
+		int64_t min_lots = 1;
+	};
+
+	Quotes& quotes(InstrumentId id);
+	// Sends what it takes to bring the leg to the wanted quote, 1 when sending failed
+	int work(InstrumentId id, Side side);
+	// Live state from an order object of a reply or notification
+	void apply_order(Leg& leg, const Instrument& ins, const nlohmann::json& order);
+	void forget(Leg& leg);
+	// Empty when a number does not fit
+	std::string order_request(const char* method, std::string_view target, const Instrument& ins, Price price, Qty qty, uint64_t id) const;
+	std::string cancel_request(const std::string& order_id, uint64_t id) const;
+
+	const Instruments& m_instruments;
+	Send m_send;
+	uint64_t m_next_id = 1;
+	std::vector<Quotes> m_quotes;                          // by instrument id
+	std::unordered_map<uint64_t, uint64_t> m_tags;         // request tag -> (instrument << 1) | side
+	std::unordered_map<std::string, uint64_t> m_orders;    // live order id -> (instrument << 1) | side
+	Stats m_stats;
+};
@@ -0,0 +1,293 @@
+#include "StateJournal.hpp"
+#include "../utility.hpp"
+#include <atomic>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// File layout: the header on its own page, then half 0 and half 1 of
+// `capacity` records each
+struct StateJournal::Header{
+	static constexpr uint64_t MAGIC = 0x4c4e524a54415453ull; // "STATJRNL"
+	static constexpr uint32_t VERSION = 2;
+	uint64_t magic;
+	uint32_t version;
+	uint32_t record_size;
+	uint64_t capacity;
+	uint32_t active;     // half the log grows in, switched by this one store
+	uint32_t reserved;
+	uint64_t base_seq[2]; // half h starts at base_seq[h] + 1
+};
+
+struct StateJournal::Record{
+	enum Type : uint8_t { ORDER_OPEN = 1, ORDER_CLOSED, POSITION };
+	uint64_t seq;
+	uint32_t checksum;   // FNV-1a of the record with this field 0
+	uint8_t type;
+	uint8_t inverse;
+	uint16_t reserved;
+	char key[KEY_BYTES];          // order id, or the instrument of a position
+	char instrument[KEY_BYTES];   // of an order
+	double price, amount;         // orders
+	double size, avg_price, realized_pnl, fees, mark_price; // positions
+	uint64_t trade_seq;
+	int64_t updated_ms;
+	int64_t reconciled_ms;
+};
+
+static constexpr size_t HEADER_BYTES = 4096;
+// A half of a multiple of 64 records ends on a page boundary
+static constexpr size_t HALF_RECORDS = 64;
+
+static uint32_t checksum(const void* data, size_t n){
+	const uint8_t* p = static_cast<const uint8_t*>(data);
+	uint32_t h = 2166136261u;
+	for(size_t i = 0; i < n; i++){
+		h ^= p[i];
+		h *= 16777619u;
+	}
+	return h;
+}
+
+static int copy_key(char* out, std::string_view in){
+	if(in.empty() || in.size() >= StateJournal::KEY_BYTES) return 1;
+	std::memcpy(out, in.data(), in.size());
+	return 0;
+}
+
+// Constructor
+StateJournal::StateJournal() {}
+
+// Destructor
+StateJournal::~StateJournal(){
+	if(m_base){
+		msync(m_base, m_size, MS_SYNC);
+		munmap(m_base, m_size);
+	}
+}
+
+StateJournal::Record* StateJournal::slot(uint32_t half, size_t index) const{
+	static_assert(sizeof(Record) == 192, "records should stay three cache lines");
+	return reinterpret_cast<Record*>(m_base + HEADER_BYTES + (half * m_capacity + index) * sizeof(Record));
+}
+
+int StateJournal::open(const std::string& path, size_t records){
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if(m_base || records == 0) return 1;
+	records = (records + HALF_RECORDS - 1) & ~(HALF_RECORDS - 1);
+	int64_t start = mono_ns();
+	int fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0600);
+	if(fd < 0) return 1;
+	struct stat st;
+	Header h{};
+	bool valid = fstat(fd, &st) == 0 && static_cast<size_t>(st.st_size) >= HEADER_BYTES
+		&& pread(fd, &h, sizeof(h), 0) == static_cast<ssize_t>(sizeof(h))
+		&& h.magic == Header::MAGIC && h.version == Header::VERSION && h.record_size == sizeof(Record) && h.active < 2
+		&& h.capacity % HALF_RECORDS == 0 && static_cast<size_t>(st.st_size) == HEADER_BYTES + 2 * h.capacity * sizeof(Record);
+	// A journal of another size is kept as it is
+	size_t capacity = valid ? h.capacity : records;
+	size_t size = HEADER_BYTES + 2 * capacity * sizeof(Record);
+	if(!valid){
+		// Starts over from zeroes
+		if(ftruncate(fd, 0) || ftruncate(fd, static_cast<off_t>(size))){
+			::close(fd);
+			return 1;
+		}
+	}
+	void* p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	::close(fd);
+	if(p == MAP_FAILED) return 1;
+	m_base = static_cast<char*>(p);
+	m_size = size;
+	m_capacity = capacity;
+
+	Header& header = *reinterpret_cast<Header*>(m_base);
+	if(!valid){
+		// The magic goes last
+		header.version = Header::VERSION;
+		header.record_size = sizeof(Record);
+		header.capacity = capacity;
+		header.active = 0;
+		header.base_seq[0] = 0;
+		header.base_seq[1] = 0;
+		msync(m_base, HEADER_BYTES, MS_SYNC);
+		header.magic = Header::MAGIC;
+		msync(m_base, HEADER_BYTES, MS_SYNC);
+	}
+	replay();
+	m_stats.recover_us = (mono_ns() - start) / 1000;
+	return 0;
+}
+
+void StateJournal::replay(){
+	const Header& header = *reinterpret_cast<const Header*>(m_base);
+	m_active = header.active;
+	m_seq = header.base_seq[m_active];
+	m_used = 0;
+	// Past the tail are records of an older round through this half, their sequence is lower
+	while(m_used < m_capacity){
+		Record r = *slot(m_active, m_used);
+		uint32_t sum = r.checksum;
+		r.checksum = 0;
+		if(r.seq != m_seq + 1 || sum != checksum(&r, sizeof(r))) break;
+		apply(r);
+		m_seq = r.seq;
+		m_used++;
+	}
+	m_stats.replayed = m_used;
+}
+
+void StateJournal::apply(const Record& r){
+	std::string key(r.key, strnlen(r.key, KEY_BYTES));
+	if(r.type == Record::ORDER_OPEN){
+		Order& o = m_orders[key];
+		o.instrument.assign(r.instrument, strnlen(r.instrument, KEY_BYTES));
+		o.price = r.price;
+		o.amount = r.amount;
+		o.updated_ms = r.updated_ms;
+	} else if(r.type == Record::ORDER_CLOSED){
+		m_orders.erase(key);
+	} else if(r.type == Record::POSITION){
+		Position& p = m_positions[key];
+		p.inverse = r.inverse;
+		p.size = r.size;
+		p.avg_price = r.avg_price;
+		p.realized_pnl = r.realized_pnl;
+		p.fees = r.fees;
+		p.mark_price = r.mark_price;
+		p.last_trade_seq = r.trade_seq;
+		p.updated_ms = r.updated_ms;
+		p.reconciled_ms = r.reconciled_ms;
+	}
+}
+
+int StateJournal::append(Record& r){
+	if(!m_base) return 1;
+	if(m_used == m_capacity && checkpoint()) return 1;
+	r.seq = m_seq + 1;
+	r.checksum = 0;
+	r.checksum = checksum(&r, sizeof(r));
+	std::memcpy(static_cast<void*>(slot(m_active, m_used)), &r, sizeof(r));
+	m_seq = r.seq;
+	m_used++;
+	m_stats.appended++;
+	apply(r);
+	return 0;
+}
+
+// The live state opens the other half, which becomes active once it is on disk
+int StateJournal::checkpoint(){
+	if(m_orders.size() + m_positions.size() >= m_capacity) return 1;
+	uint32_t next = 1 - m_active;
+	uint64_t base = m_seq;
+	uint64_t seq = base;
+	size_t used = 0;
+	auto put = [&](Record& r){
+		r.seq = ++seq;
+		r.checksum = 0;
+		r.checksum = checksum(&r, sizeof(r));
+		std::memcpy(static_cast<void*>(slot(next, used++)), &r, sizeof(r));
+	};
+	for(const auto& [id, o] : m_orders){
+		Record r{};
+		r.type = Record::ORDER_OPEN;
+		std::memcpy(r.key, id.data(), id.size());
+		std::memcpy(r.instrument, o.instrument.data(), o.instrument.size());
+		r.price = o.price;
+		r.amount = o.amount;
+		r.updated_ms = o.updated_ms;
+		put(r);
+	}
+	for(const auto& [name, p] : m_positions){
+		Record r{};
+		r.type = Record::POSITION;
+		std::memcpy(r.key, name.data(), name.size());
+		r.inverse = p.inverse;
+		r.size = p.size;
+		r.avg_price = p.avg_price;
+		r.realized_pnl = p.realized_pnl;
+		r.fees = p.fees;
+		r.mark_price = p.mark_price;
+		r.trade_seq = p.last_trade_seq;
+		r.updated_ms = p.updated_ms;
+		r.reconciled_ms = p.reconciled_ms;
+		put(r);
+	}
+	// Halves start on a page, as msync wants
+	msync(slot(next, 0), (used * sizeof(Record) + 4095) & ~static_cast<size_t>(4095), MS_SYNC);
+
+	// The inactive half's base is not read until `active` names it: a crash
+	// before that store replays the old half as it was
+	Header& header = *reinterpret_cast<Header*>(m_base);
+	header.base_seq[next] = base;
+	std::atomic_ref<uint32_t>(header.active).store(next, std::memory_order_release);
+	msync(m_base, HEADER_BYTES, MS_SYNC);
+	m_active = next;
+	m_used = used;
+	m_seq = seq;
+	m_stats.checkpoints++;
+	return 0;
+}
+
+int StateJournal::order_open(std::string_view order_id, std::string_view instrument, double price, double amount, int64_t now_ms){
+	Record r{};
+	r.type = Record::ORDER_OPEN;
+	if(copy_key(r.key, order_id) || copy_key(r.instrument, instrument)) return 1;
+	r.price = price;
+	r.amount = amount;
+	r.updated_ms = now_ms;
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return append(r);
+}
+
+int StateJournal::order_closed(std::string_view order_id){
+	Record r{};
+	r.type = Record::ORDER_CLOSED;
+	if(copy_key(r.key, order_id)) return 1;
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if(m_orders.find(std::string(order_id)) == m_orders.end()) return 0;
+	return append(r);
+}
+
+int StateJournal::position(std::string_view instrument, const Position& p){
+	Record r{};
+	r.type = Record::POSITION;
+	if(copy_key(r.key, instrument)) return 1;
+	r.inverse = p.inverse;
+	r.size = p.size;
+	r.avg_price = p.avg_price;
+	r.realized_pnl = p.realized_pnl;
+	r.fees = p.fees;
+	r.mark_price = p.mark_price;
+	r.trade_seq = p.last_trade_seq;
+	r.updated_ms = p.updated_ms;
+	r.reconciled_ms = p.reconciled_ms;
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return append(r);
+}
+
+int StateJournal::sync(){
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if(!m_base) return 1;
+	return msync(m_base, m_size, MS_SYNC) == 0 ? 0 : 1;
+}
+
+std::unordered_map<std::string, StateJournal::Order> StateJournal::orders() const{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_orders;
+}
+
+std::unordered_map<std::string, Position> StateJournal::positions() const{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_positions;
+}
+
+StateJournal::Stats StateJournal::stats() const{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	Stats s = m_stats;
+	s.used = m_used;
+	s.capacity = m_capacity;
+	return s;
+}
@@ -0,0 +1,83 @@
+#pragma once
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include "PositionKeeper.hpp"
+
+// Open orders and positions kept in a memory mapped file, so a restarted
+// process has them back without asking the exchange one by one.
+//
+// Every change is appended to a write-ahead log of fixed size records in
+// the mapping: once a call returns the record is in the page cache and
+// survives the process crashing. The file has two halves. The log grows in
+// the active one; when it is full the current state is written at the
+// start of the other half, synced, and the header switched over to it, so
+// a crash at any point leaves one whole half. Records carry consecutive
+// sequence numbers and a checksum, replay stops at the first torn or stale
+// one. Power loss keeps what was last synced (every checkpoint, sync()).
+// Thread safe.
+class StateJournal{
+public:
+	static constexpr size_t KEY_BYTES = 48; // order ids and instrument names, with the terminator
+
+	struct Order{
+		std::string instrument;
+		double price = 0;
+		double amount = 0;
+		int64_t updated_ms = 0;
+	};
+	struct Stats{
+		uint64_t replayed = 0;    // records read back by open()
+		int64_t recover_us = 0;   // time open() took
+		uint64_t appended = 0;
+		uint64_t checkpoints = 0;
+		size_t used = 0;          // records in the active half
+		size_t capacity = 0;      // records per half
+	};
+
+	// Constructor
+	StateJournal();
+	// Destructor
+	~StateJournal();
+	StateJournal(const StateJournal&) = delete;
+	StateJournal& operator=(const StateJournal&) = delete;
+
+	// Maps `path`, created with room for `records` records per half when
+	// missing or unreadable, and replays it. Returns 0 on success
+	int open(const std::string& path, size_t records = 65536);
+	bool is_open() const { return m_base != nullptr; }
+
+	// Return 1 when not open, a name does not fit or the state outgrew a half
+	int order_open(std::string_view order_id, std::string_view instrument, double price, double amount, int64_t now_ms);
+	int order_closed(std::string_view order_id);
+	int position(std::string_view instrument, const Position& p);
+	// Writes the mapping back to the file, returns 0 on success
+	int sync();
+
+	// State as of the last record
+	std::unordered_map<std::string, Order> orders() const;
+	std::unordered_map<std::string, Position> positions() const;
+	Stats stats() const;
+private:
+	struct Header;
+	struct Record;
+
+	Record* slot(uint32_t half, size_t index) const;
+	int append(Record& r);
+	int checkpoint();
+	void replay();
+	void apply(const Record& r);
+
+	mutable std::mutex m_mutex;
+	char* m_base = nullptr;
+	size_t m_size = 0;
+	size_t m_capacity = 0;   // records per half
+	uint32_t m_active = 0;
+	size_t m_used = 0;
+	uint64_t m_seq = 0;      // of the last record written
+	std::unordered_map<std::string, Order> m_orders;
+	std::unordered_map<std::string, Position> m_positions;
+	Stats m_stats;
+};
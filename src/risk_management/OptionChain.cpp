@@ -0,0 +1,268 @@
+#include "OptionChain.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <ctime>
+
+static constexpr double MS_PER_YEAR = 365.0 * 24 * 3600 * 1000;
+static constexpr double INV_SQRT2 = 0.70710678118654752440;
+static constexpr double INV_SQRT_2PI = 0.39894228040143267794;
+static constexpr int IV_ITERS = 12;
+static constexpr double SIGMA_MIN = 1e-3;
+static constexpr double SIGMA_MAX = 10.0;
+
+// Price one block of the chain. Every loop is a straight-line simd loop so
+// the compiler emits AVX-512 / AVX2 code (one clone per target, dispatched at
+// load time) calling glibc's vector exp/log/erf.
+__attribute__((target_clones("avx512f", "avx2", "default")))
+static void bs_block(size_t n, double now_ms, double r,
+	const double* __restrict K, const double* __restrict expiry, const double* __restrict put,
+	const double* __restrict S, const double* __restrict market, const double* __restrict sigma_in,
+	double* __restrict iv, double* __restrict price, double* __restrict delta,
+	double* __restrict gamma, double* __restrict vega, double* __restrict theta)
+{
+	double T[OptionChain::BLOCK];
+	double sig[OptionChain::BLOCK];
+	double lo[OptionChain::BLOCK];
+	double hi[OptionChain::BLOCK];
+
+	#pragma omp simd
+	for(size_t i = 0; i < n; i++){
+		double t = (expiry[i] - now_ms) / MS_PER_YEAR;
+		T[i] = t > 1e-8 ? t : 1e-8;
+		sig[i] = sigma_in[i] > SIGMA_MIN ? sigma_in[i] : 0.5;
+		lo[i] = SIGMA_MIN;
+		hi[i] = SIGMA_MAX;
+	}
+
+	// Implied vol: fixed count safeguarded Newton steps on sigma, seeded with
+	// the last value, only where an option price was observed. The price is
+	// increasing in sigma so every step also narrows a bracket, and a Newton
+	// step leaving the bracket (tiny vega) falls back to bisection.
+	for(int it = 0; it < IV_ITERS; it++){
+		#pragma omp simd
+		for(size_t i = 0; i < n; i++){
+			double sqrt_t = std::sqrt(T[i]);
+			double vs = sig[i] * sqrt_t;
+			double d1 = (std::log(S[i] / K[i]) + (r + 0.5 * sig[i] * sig[i]) * T[i]) / vs;
+			double d2 = d1 - vs;
+			double kdf = K[i] * std::exp(-r * T[i]);
+			double call = S[i] * 0.5 * (1.0 + std::erf(d1 * INV_SQRT2)) - kdf * 0.5 * (1.0 + std::erf(d2 * INV_SQRT2));
+			double p = call - put[i] * (S[i] - kdf);
+			double v = S[i] * std::exp(-0.5 * d1 * d1) * INV_SQRT_2PI * sqrt_t;
+			double diff = p - market[i];
+			hi[i] = diff > 0 ? sig[i] : hi[i];
+			lo[i] = diff > 0 ? lo[i] : sig[i];
+			double next = sig[i] - diff / (v > 1e-12 ? v : 1e-12);
+			next = (next >= lo[i] && next <= hi[i]) ? next : 0.5 * (lo[i] + hi[i]);
+			sig[i] = market[i] > 0 ? next : sig[i];
+		}
+	}
+
+	#pragma omp simd
+	for(size_t i = 0; i < n; i++){
+		double sqrt_t = std::sqrt(T[i]);
+		double vs = sig[i] * sqrt_t;
+		double d1 = (std::log(S[i] / K[i]) + (r + 0.5 * sig[i] * sig[i]) * T[i]) / vs;
+		double d2 = d1 - vs;
+		double kdf = K[i] * std::exp(-r * T[i]);
+		double nd1 = 0.5 * (1.0 + std::erf(d1 * INV_SQRT2));
+		double nd2 = 0.5 * (1.0 + std::erf(d2 * INV_SQRT2));
+		double pdf = std::exp(-0.5 * d1 * d1) * INV_SQRT_2PI;
+		double call = S[i] * nd1 - kdf * nd2;
+		double theta_call = -S[i] * pdf * sig[i] / (2.0 * sqrt_t) - r * kdf * nd2;
+
+		iv[i] = sig[i];
+		price[i] = call - put[i] * (S[i] - kdf);
+		delta[i] = nd1 - put[i];
+		gamma[i] = pdf / (S[i] * vs);
+		vega[i] = S[i] * pdf * sqrt_t / 100.0;
+		theta[i] = (theta_call + put[i] * r * kdf) / 365.0;
+	}
+}
+
+// Constructor
+OptionChain::OptionChain(double rate, unsigned threads) : m_rate(rate) {
+	if(threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+	m_shares = threads;
+	// The calling thread works too, spawn the rest
+	for(unsigned id = 1; id < threads; id++){
+		m_workers.emplace_back(&OptionChain::worker, this, id);
+	}
+}
+
+// Destructor
+OptionChain::~OptionChain(){
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stop = true;
+	}
+	m_cv.notify_all();
+	for(auto& t : m_workers) t.join();
+}
+
+bool OptionChain::parse_name(const std::string& name, int64_t& expiry_ms, double& strike, bool& is_put){
+	// CUR-DMMMYY-STRIKE-C/P, eg BTC-27DEC24-60000-C (day may be one digit)
+	size_t a = name.find('-');
+	size_t b = name.find('-', a + 1);
+	size_t c = name.find('-', b + 1);
+	if(a == std::string::npos || b == std::string::npos || c == std::string::npos || c + 2 != name.size()) return false;
+	char kind = name[c + 1];
+	if(kind != 'C' && kind != 'P') return false;
+
+	std::string date = name.substr(a + 1, b - a - 1);
+	if(date.size() < 6) return false;
+	static const char* const months[] = {"JAN","FEB","MAR","APR","MAY","JUN","JUL","AUG","SEP","OCT","NOV","DEC"};
+	size_t dlen = date.size() - 5;
+	tm t{};
+	t.tm_mday = std::atoi(date.substr(0, dlen).c_str());
+	t.tm_mon = -1;
+	for(int m = 0; m < 12; m++) if(date.compare(dlen, 3, months[m]) == 0) t.tm_mon = m;
+	if(t.tm_mon < 0 || t.tm_mday <= 0) return false;
+	t.tm_year = 100 + std::atoi(date.substr(dlen + 3).c_str());
+	t.tm_hour = 8; // Deribit options expire at 08:00 UTC
+
+	// Strikes may use 'd' as decimal point (eg XRP_USDC-...-0d5-C)
+	std::string k = name.substr(b + 1, c - b - 1);
+	std::replace(k.begin(), k.end(), 'd', '.');
+	strike = std::atof(k.c_str());
+	expiry_ms = static_cast<int64_t>(timegm(&t)) * 1000;
+	is_put = kind == 'P';
+	return strike > 0;
+}
+
+int OptionChain::add(const std::string& instrument){
+	auto it = m_index.find(instrument);
+	if(it != m_index.end()) return static_cast<int>(it->second);
+
+	int64_t expiry; double strike; bool is_put;
+	if(!parse_name(instrument, expiry, strike, is_put)) return -1;
+
+	size_t i = m_names.size();
+	m_names.push_back(instrument);
+	m_index[instrument] = i;
+	m_cols.strike.push_back(strike);
+	m_cols.expiry_ms.push_back(static_cast<double>(expiry));
+	m_cols.put.push_back(is_put ? 1.0 : 0.0);
+	m_cols.spot.push_back(0);
+	m_cols.market.push_back(0);
+	m_cols.sigma_in.push_back(0);
+	for(auto* col : {&m_cols.iv, &m_cols.price, &m_cols.delta, &m_cols.gamma, &m_cols.vega, &m_cols.theta}){
+		col->push_back(0);
+	}
+	if(i / BLOCK >= m_dirty.size()) m_dirty.push_back(0);
+	return static_cast<int>(i);
+}
+
+[[nodiscard]] int OptionChain::index(const std::string& instrument) const{
+	auto it = m_index.find(instrument);
+	return it == m_index.end() ? -1 : static_cast<int>(it->second);
+}
+
+void OptionChain::set_market(size_t i, double spot, double market_price, double sigma){
+	m_cols.spot[i] = spot;
+	m_cols.market[i] = market_price;
+	if(sigma > 0) m_cols.sigma_in[i] = sigma;
+	m_dirty[i / BLOCK] = 1;
+}
+
+void OptionChain::on_ticker(const nlohmann::json& data){
+	int i = add(data["instrument_name"].get<std::string>());
+	if(i < 0) return; // not an option
+	double spot = data.value("underlying_price", 0.0);
+	// Option prices are quoted in the underlying coin
+	double mark = data.value("mark_price", 0.0) * spot;
+	double sigma = data.value("mark_iv", 0.0) / 100.0;
+	if(spot > 0) set_market(i, spot, mark, sigma);
+}
+
+void OptionChain::reprice(int64_t now_ms){
+	std::vector<size_t> blocks;
+	for(size_t b = 0; b < m_dirty.size(); b++){
+		if(m_dirty[b]){
+			blocks.push_back(b);
+			m_dirty[b] = 0;
+		}
+	}
+	if(!blocks.empty()) run_blocks(blocks, now_ms);
+}
+
+void OptionChain::reprice_all(int64_t now_ms){
+	std::vector<size_t> blocks(m_dirty.size());
+	for(size_t b = 0; b < blocks.size(); b++) blocks[b] = b;
+	std::fill(m_dirty.begin(), m_dirty.end(), 0);
+	run_blocks(blocks, now_ms);
+}
+
+// Price every `stride`-th listed block starting at `first`
+void OptionChain::price_blocks(const std::vector<size_t>& blocks, int64_t now_ms, unsigned first, unsigned stride){
+	Columns& c = m_cols;
+	for(size_t j = first; j < blocks.size(); j += stride){
+		size_t begin = blocks[j] * BLOCK;
+		size_t n = std::min(BLOCK, m_names.size() - begin);
+		bs_block(n, static_cast<double>(now_ms), m_rate,
+			&c.strike[begin], &c.expiry_ms[begin], &c.put[begin], &c.spot[begin], &c.market[begin], &c.sigma_in[begin],
+			&c.iv[begin], &c.price[begin], &c.delta[begin], &c.gamma[begin], &c.vega[begin], &c.theta[begin]);
+	}
+}
+
+// Price the listed blocks across the pool, the calling thread takes share 0
+void OptionChain::run_blocks(const std::vector<size_t>& blocks, int64_t now_ms){
+	// Not worth waking the pool for a couple of blocks
+	if(m_shares == 1 || blocks.size() < 2 * m_shares){
+		price_blocks(blocks, now_ms, 0, 1);
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_job = &blocks;
+		m_job_now = now_ms;
+		m_pending = m_shares - 1;
+		m_generation++;
+	}
+	m_cv.notify_all();
+	price_blocks(blocks, now_ms, 0, m_shares);
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_done_cv.wait(lock, [this]() { return m_pending == 0; });
+	m_job = nullptr;
+}
+
+void OptionChain::worker(unsigned id){
+	uint64_t seen = 0;
+	while(true){
+		const std::vector<size_t>* job;
+		int64_t now_ms;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_cv.wait(lock, [this, seen]() { return m_stop || m_generation != seen; });
+			if(m_stop) return;
+			seen = m_generation;
+			job = m_job;
+			now_ms = m_job_now;
+		}
+		price_blocks(*job, now_ms, id, m_shares);
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			if(--m_pending == 0) m_done_cv.notify_one();
+		}
+	}
+}
+
+[[nodiscard]] nlohmann::json OptionChain::summary(const std::string& instrument) const{
+	int i = index(instrument);
+	if(i < 0) return nullptr;
+	nlohmann::json out;
+	out["instrument_name"] = instrument;
+	out["underlying_price"] = m_cols.spot[i];
+	out["strike"] = m_cols.strike[i];
+	out["mark_price_usd"] = m_cols.market[i];
+	out["iv"] = m_cols.iv[i] * 100.0;
+	out["price"] = m_cols.price[i];
+	out["delta"] = m_cols.delta[i];
+	out["gamma"] = m_cols.gamma[i];
+	out["vega"] = m_cols.vega[i];
+	out["theta"] = m_cols.theta[i];
+	return out;
+}
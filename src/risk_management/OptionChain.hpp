@@ -0,0 +1,94 @@
+#pragma once
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <nlohmann/json.hpp>
+
+// Black-Scholes price, greeks and implied volatility for a whole option chain.
+//
+// The chain is stored as structure-of-arrays so the kernel runs straight
+// vector loops: the translation unit is built with AVX-512 / AVX2 / baseline
+// clones (picked at load time) and glibc's vector exp/log/erf. Work is split
+// in blocks of BLOCK options across a small persistent worker pool, and a
+// ticker update only marks its block dirty so reprice() touches just those.
+//
+// Conventions follow Deribit: prices in USD of one underlying unit, vega per
+// 1 vol point, theta per calendar day, rate defaults to 0 (the underlying
+// price is already the forward).
+class OptionChain{
+public:
+	static constexpr size_t BLOCK = 64;
+
+	// Columns of the chain, index i is one option
+	struct Columns{
+		// inputs
+		std::vector<double> strike;
+		std::vector<double> expiry_ms;
+		std::vector<double> put;       // 1 for puts, 0 for calls
+		std::vector<double> spot;      // underlying_price
+		std::vector<double> market;    // observed option price (USD), 0 if none
+		std::vector<double> sigma_in;  // mark_iv / seed for the solver
+		// outputs
+		std::vector<double> iv;
+		std::vector<double> price;
+		std::vector<double> delta;
+		std::vector<double> gamma;
+		std::vector<double> vega;
+		std::vector<double> theta;
+	};
+
+	// Constructor: threads = 0 uses all cores
+	OptionChain(double rate = 0.0, unsigned threads = 0);
+	// Destructor
+	~OptionChain();
+
+	// Add an option by Deribit name (eg BTC-27DEC24-60000-C), returns its index or -1
+	int add(const std::string& instrument);
+	[[nodiscard]] int index(const std::string& instrument) const;
+	size_t size() const { return m_names.size(); }
+	const Columns& columns() const { return m_cols; }
+
+	// Update inputs of one option and mark its block for repricing
+	void set_market(size_t i, double spot, double market_price, double sigma);
+	// `data` of a ticker.{option}.{interval} notification, adds unknown options
+	void on_ticker(const nlohmann::json& data);
+
+	// Reprice blocks touched since the last call / every option
+	void reprice(int64_t now_ms);
+	void reprice_all(int64_t now_ms);
+
+	[[nodiscard]] nlohmann::json summary(const std::string& instrument) const;
+
+	// Deribit option names end in -C / -P
+	static bool is_option(const std::string& name){
+		return name.size() > 2 && name[name.size() - 2] == '-' && (name.back() == 'C' || name.back() == 'P');
+	}
+	// Parse expiry (08:00 UTC), strike and type out of a Deribit option name
+	static bool parse_name(const std::string& name, int64_t& expiry_ms, double& strike, bool& is_put);
+private:
+	void run_blocks(const std::vector<size_t>& blocks, int64_t now_ms);
+	void price_blocks(const std::vector<size_t>& blocks, int64_t now_ms, unsigned first, unsigned stride);
+	void worker(unsigned id);
+
+	double m_rate;
+	Columns m_cols;
+	std::vector<std::string> m_names;
+	std::unordered_map<std::string, size_t> m_index;
+	std::vector<uint8_t> m_dirty; // per block
+
+	// Persistent workers, each takes every n-th block of the current job
+	std::vector<std::thread> m_workers;
+	unsigned m_shares = 1;
+	std::mutex m_mutex;
+	std::condition_variable m_cv;
+	std::condition_variable m_done_cv;
+	uint64_t m_generation = 0;
+	unsigned m_pending = 0;
+	bool m_stop = false;
+	const std::vector<size_t>* m_job = nullptr;
+	int64_t m_job_now = 0;
+};
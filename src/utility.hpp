@@ -4,6 +4,25 @@
 #include <memory>
 #include <functional>
 #include <sstream>
+#include <chrono>
+
+// Wall clock in milliseconds, the unit of Deribit timestamps
+inline int64_t now_ms(){
+	return std::chrono::duration_cast<std::chrono::milliseconds>(
+		std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+// Wall clock in microseconds, the unit of usIn/usOut
+inline int64_t now_us(){
+	return std::chrono::duration_cast<std::chrono::microseconds>(
+		std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+// Monotonic clock in nanoseconds, for deadlines
+inline int64_t mono_ns(){
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
 
 struct Json{
 	std::string method;
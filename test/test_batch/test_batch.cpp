@@ -0,0 +1,154 @@
+// Write coalescing benchmark: bursts of `burst` cancels against the local
+// Deribit stand-in through USocket, plain and over TLS 1.3 (user space TLS,
+// or kernel TLS where the kernel has it)
+//   sequential  one ws_request() per cancel, each waits for its reply
+//   posted      post() per cancel, coalescing off (coalesce_us = 0)
+//   batched     post() per cancel then wait_replies(): one write, one run
+//               of TLS records for the burst
+// For each: time per burst, io_uring_enter syscalls, frames per write and
+// TLS records per burst.
+//   tags        request ids swapped for the socket's tags and back
+//   late        against a stand-in slower than the request timeout: the late
+//               reply goes to the reply handler, the next request with the
+//               same id gets its own
+//
+// usage: ./test_batch.exe [bursts] [burst] [port]
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include "../test_throughput/StandIn.hpp"
+#include "Histogram.hpp"
+#include "Logger.hpp"
+#include "Custom_WebSocket/USocket.hpp"
+
+using Clock = std::chrono::steady_clock;
+
+static const std::string CANCEL = R"({"jsonrpc":"2.0","method":"private/cancel","params":{"order_id":"ETH-123456789"},"id":"1"})";
+
+static const std::string BUY = R"({"jsonrpc":"2.0","method":"private/buy","params":{"instrument_name":"ETH-PERPETUAL","amount":1,"price":1000},"id":"1"})";
+
+enum Mode { SEQUENTIAL, POSTED, BATCHED };
+static const char* const MODES[] = {"sequential", "posted", "batched"};
+
+static void run(const std::string& port, bool tls, Mode mode, size_t bursts, size_t burst){
+	USocket::Options opt;
+	opt.host = "127.0.0.1";
+	opt.port = port;
+	opt.tls = tls;
+	opt.verify = false;
+	opt.ktls = tls;
+	opt.coalesce_us = mode == POSTED ? 0 : 1000;
+	USocket sock(opt);
+	sock.switch_to_ws();
+	if(!sock.is_open()){
+		std::printf("%-4s %-10s connection failed\n", tls ? "tls" : "ws", MODES[mode]);
+		return;
+	}
+	auto one = [&](){
+		int errors = 0;
+		if(mode == SEQUENTIAL){
+			for(size_t i = 0; i < burst; i++) errors += sock.ws_request(CANCEL).first;
+			return errors;
+		}
+		for(size_t i = 0; i < burst; i++) errors += sock.post(CANCEL);
+		return errors + sock.wait_replies();
+	};
+	for(int i = 0; i < 50; i++) one();
+	USocket::Stats before = sock.stats();
+	Histogram time;
+	int errors = 0;
+	for(size_t i = 0; i < bursts; i++){
+		Clock::time_point t = Clock::now();
+		errors += one();
+		time.record(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - t).count());
+	}
+	USocket::Stats s = sock.stats();
+	double frames = static_cast<double>(s.frames - before.frames);
+	std::printf("%-4s %-10s burst p50 %7.1f us  p99 %7.1f us  enters/burst %5.2f  frames/write %5.2f  records/burst %5.2f  errors %d\n",
+		tls ? (sock.ktls() ? "ktls" : "tls") : "ws", MODES[mode], time.percentile(50) / 1e3, time.percentile(99) / 1e3,
+		static_cast<double>(s.enters - before.enters) / bursts, frames / (s.sends - before.sends),
+		static_cast<double>(s.records - before.records) / bursts, errors);
+}
+
+static int check_tags(){
+	struct{ const char* msg; const char* tagged; const char* id; } cases[] = {
+		{R"({"jsonrpc":"2.0","id":"1","method":"public/test"})", R"({"jsonrpc":"2.0","id":42,"method":"public/test"})", R"("1")"},
+		{"{\n  \"method\": \"public/auth\",\n  \"id\" : 9929\n}", "{\n  \"method\": \"public/auth\",\n  \"id\" : 42\n}", "9929"},
+		{R"({"params":{"order_id":"ETH-1"},"id":null})", R"({"params":{"order_id":"ETH-1"},"id":42})", "null"},
+		{R"({"method":"public/test"})", R"({"id":42,"method":"public/test"})", "null"},
+	};
+	int failures = 0;
+	for(const auto& c : cases){
+		std::string out, id;
+		Socket::tag_request(c.msg, 42, out, id);
+		std::string reply = R"({"jsonrpc":"2.0","id":42,"result":{}})";
+		uint64_t tag = Socket::reply_tag(reply);
+		Socket::untag_reply(reply, id);
+		bool ok = out == c.tagged && id == c.id && tag == 42 && reply == std::string(R"({"jsonrpc":"2.0","id":)") + c.id + R"(,"result":{}})";
+		if(!ok) failures++;
+		std::printf("tags       caller id %-6s sent as 42, reply back with %s %s\n", c.id, id.c_str(), ok ? "ok" : "FAILED");
+	}
+	bool ok = Socket::reply_tag(R"({"id":"42","result":{}})") == 0 && Socket::reply_tag(R"({"id":42x,"result":{}})") == 0;
+	std::printf("tags       ids that are not tags refused %s\n", ok ? "ok" : "FAILED");
+	return failures || !ok ? 1 : 0;
+}
+
+static int check_late(const std::string& port){
+	USocket::Options opt;
+	opt.host = "127.0.0.1";
+	opt.port = port;
+	opt.tls = false;
+	USocket sock(opt);
+	sock.switch_to_ws();
+	if(!sock.is_open()) return 1;
+	std::vector<std::string> late;
+	sock.set_reply_handler([&](const std::string& r){ late.push_back(r); });
+	sock.set_request_timeout(50);
+	std::pair<int, std::string> first = sock.ws_request(BUY);
+	sock.set_request_timeout(5000);
+	std::pair<int, std::string> second = sock.ws_request(BUY);
+	bool own = second.first == 0 && second.second.find("STANDIN-2") != std::string::npos
+		&& second.second.find(R"("id":"1")") != std::string::npos;
+	bool handed = late.size() == 1 && late[0].find("STANDIN-1") != std::string::npos
+		&& late[0].find(R"("id":"1")") != std::string::npos;
+	bool ok = first.first == 1 && own && handed;
+	std::printf("late       first request %s, its reply %s, the next one got %s %s\n", first.first ? "timed out" : "answered",
+		handed ? "to the reply handler" : "lost", own ? "its own" : "another's", ok ? "ok" : "FAILED");
+	return ok ? 0 : 1;
+}
+
+int main(int argc, char** argv){
+	size_t bursts = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 5000;
+	size_t burst = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 8;
+	unsigned short port = argc > 3 ? static_cast<unsigned short>(std::atoi(argv[3])) : 9445;
+	Logger::instance().start("test_batch.log");
+	ssl::context server_ctx{ssl::context::tlsv13_server};
+	if(StandIn::use_self_signed(server_ctx)){
+		std::printf("could not create the stand-in certificate\n");
+		return 1;
+	}
+	StandIn plain(port, 0);
+	plain.start();
+	StandIn secure(port + 1, 0, &server_ctx);
+	secure.start();
+
+	std::printf("%zu bursts of %zu cancels (%zu B each)\n", bursts, burst, CANCEL.size());
+	for(bool tls : {false, true}){
+		std::string p = std::to_string(tls ? port + 1 : port);
+		for(Mode mode : {SEQUENTIAL, POSTED, BATCHED}) run(p, tls, mode, bursts, burst);
+	}
+
+	plain.stop();
+	secure.stop();
+
+	int status = check_tags();
+	// Replies take longer than the first request waits
+	StandIn slow(port + 2, 200000);
+	slow.start();
+	status |= check_late(std::to_string(port + 2));
+	slow.stop();
+	std::printf("%s\n", status ? "FAILED" : "all checks passed");
+	Logger::instance().stop();
+	return status;
+}
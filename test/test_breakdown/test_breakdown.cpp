@@ -0,0 +1,164 @@
+// Latency breakdown check and benchmark
+//   offset    round trips built from a known exchange clock offset and known
+//             legs: symmetric legs give the offset exactly, asymmetric ones
+//             within half the network delay, and the least delayed sample of
+//             the window is the one in use until it ages out
+//   legs      a trip recorded once synced splits into the outbound, exchange
+//             and inbound legs it was built from
+//   skew      an offset error larger than a leg: the leg is recorded as 0 and
+//             counted as skewed
+//   stamps    usIn/usOut read from the end of a reply, missing or malformed
+//             ones refused
+//   timing    record() of a synced breakdown
+//
+// usage: ./test_breakdown.exe [records]
+#include <chrono>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include "LatencyBreakdown.hpp"
+
+using Clock = std::chrono::steady_clock;
+
+static int failures = 0;
+
+static void report(bool ok, const char* fmt, ...) __attribute__((format(printf, 2, 3)));
+static void report(bool ok, const char* fmt, ...){
+	if(!ok) failures++;
+	va_list args;
+	va_start(args, fmt);
+	std::vprintf(fmt, args);
+	va_end(args);
+	std::printf(" %s\n", ok ? "ok" : "FAILED");
+}
+
+// Exchange clock ahead of the local one by OFFSET, a 1.7e15 us epoch like Deribit's
+static constexpr int64_t OFFSET = 500000;
+static constexpr int64_t T0 = 1700000000000000;
+
+// One round trip sent at `send` with the given legs, stamped as the exchange would
+struct Trip{
+	int64_t send, recv, us_in, us_out;
+};
+
+static Trip trip(int64_t send, int64_t offset, int64_t out, int64_t exch, int64_t in){
+	Trip t;
+	t.send = send;
+	t.us_in = send + out + offset;
+	t.us_out = t.us_in + exch;
+	t.recv = send + out + exch + in;
+	return t;
+}
+
+static void add(LatencyBreakdown& lb, const Trip& t){
+	lb.add_offset_sample(t.send, t.recv, t.us_in, t.us_out);
+}
+
+static void check_offset(){
+	for(int64_t offset : {OFFSET, -2 * OFFSET, int64_t(0)}){
+		LatencyBreakdown lb;
+		add(lb, trip(T0, offset, 100, 20, 100));
+		report(lb.synced() && lb.offset_us() == offset && lb.offset_delay_us() == 200 && lb.synced_at_us() == T0 + 220,
+			"offset    symmetric 100/20/100 us at %+lld: offset %lld, delay %lld",
+			static_cast<long long>(offset), static_cast<long long>(lb.offset_us()), static_cast<long long>(lb.offset_delay_us()));
+	}
+
+	// 300 us out, 100 back: off by half the asymmetry, within half the delay
+	LatencyBreakdown lb;
+	add(lb, trip(T0, OFFSET, 300, 20, 100));
+	int64_t err = lb.offset_us() - OFFSET;
+	report(err == 100 && lb.offset_delay_us() == 400 && 2 * err <= lb.offset_delay_us(),
+		"offset    asymmetric 300/20/100 us: error %lld us, delay %lld", static_cast<long long>(err), static_cast<long long>(lb.offset_delay_us()));
+
+	// A less delayed sample replaces it, slower ones after it do not
+	add(lb, trip(T0 + 1000, OFFSET, 100, 20, 100));
+	for(int i = 0; i < 6; i++) add(lb, trip(T0 + 2000 + i * 1000, OFFSET, 350, 20, 250));
+	bool kept = lb.offset_us() == OFFSET && lb.offset_delay_us() == 200;
+	add(lb, trip(T0 + 9000, OFFSET, 350, 20, 250));
+	kept = kept && lb.offset_us() == OFFSET;
+	report(kept, "offset    least delayed of the window kept: error %lld us", static_cast<long long>(lb.offset_us() - OFFSET));
+	// Eight slower samples later it has aged out
+	add(lb, trip(T0 + 10000, OFFSET, 350, 20, 250));
+	report(lb.offset_us() == OFFSET + 50 && lb.offset_delay_us() == 600,
+		"offset    aged out after the window: error %lld us, delay %lld",
+		static_cast<long long>(lb.offset_us() - OFFSET), static_cast<long long>(lb.offset_delay_us()));
+}
+
+static void check_legs(){
+	LatencyBreakdown lb;
+	Trip t = trip(T0, OFFSET, 150, 30, 70);
+	lb.record("private/buy", t.send, t.recv, t.us_in, t.us_out);
+	report(lb.methods().empty(), "legs      ignored until synced");
+
+	add(lb, trip(T0, OFFSET, 100, 20, 100));
+	t = trip(T0 + 5000, OFFSET, 150, 30, 70);
+	lb.record("private/buy", t.send, t.recv, t.us_in, t.us_out);
+	t = trip(T0 + 6000, OFFSET, 250, 10, 40);
+	lb.record("private/buy", t.send, t.recv, t.us_in, t.us_out);
+	const LatencyBreakdown::Breakdown& b = lb.methods().find("private/buy")->second;
+	report(b.outbound.count() == 2 && b.outbound.min() == 150000 && b.outbound.max() == 250000
+		&& b.exchange.min() == 10000 && b.exchange.max() == 30000
+		&& b.inbound.min() == 40000 && b.inbound.max() == 70000 && b.skewed == 0,
+		"legs      150/30/70 and 250/10/40 us: outbound %llu-%llu ns, exchange %llu-%llu, inbound %llu-%llu",
+		static_cast<unsigned long long>(b.outbound.min()), static_cast<unsigned long long>(b.outbound.max()),
+		static_cast<unsigned long long>(b.exchange.min()), static_cast<unsigned long long>(b.exchange.max()),
+		static_cast<unsigned long long>(b.inbound.min()), static_cast<unsigned long long>(b.inbound.max()));
+}
+
+static void check_skew(){
+	// Offset 100 us too high: outbound legs shrink by 100, inbound grow by 100
+	LatencyBreakdown lb;
+	add(lb, trip(T0, OFFSET, 300, 20, 100));
+	Trip t = trip(T0 + 5000, OFFSET, 50, 20, 150);
+	lb.record("public/get_order_book", t.send, t.recv, t.us_in, t.us_out);
+	const LatencyBreakdown::Breakdown& b = lb.methods().find("public/get_order_book")->second;
+	report(b.skewed == 1 && b.outbound.count() == 1 && b.outbound.max() == 0 && b.inbound.min() == 250000 && b.exchange.min() == 20000,
+		"skew      50 us outbound leg, offset 100 us off: %llu skewed, outbound %llu ns, inbound %llu ns",
+		static_cast<unsigned long long>(b.skewed), static_cast<unsigned long long>(b.outbound.max()),
+		static_cast<unsigned long long>(b.inbound.min()));
+}
+
+static void check_stamps(){
+	struct{ const char* reply; int rc; int64_t in, out; } cases[] = {
+		{R"({"jsonrpc":"2.0","id":9930,"result":1700000000000,"usIn":1700000000000123,"usOut":1700000000000456,"usDiff":333,"testnet":true})",
+			0, 1700000000000123, 1700000000000456},
+		// A usIn inside the result is not the reply's own
+		{R"({"jsonrpc":"2.0","result":{"note":{"usIn":1,"usOut":2}},"usIn":1700000000000900,"usOut":1700000000000950,"usDiff":50})",
+			0, 1700000000000900, 1700000000000950},
+		{R"({"jsonrpc":"2.0","result":1700000000000})", 1, 0, 0},
+		{R"({"jsonrpc":"2.0","result":1,"usIn":1700000000000123})", 1, 0, 0},
+		{R"({"jsonrpc":"2.0","result":1,"usIn":"x","usOut":1700000000000456})", 1, 0, 0},
+	};
+	int n = 0;
+	for(const auto& c : cases){
+		int64_t in = 0, out = 0;
+		int rc = LatencyBreakdown::stamps(c.reply, in, out);
+		report(rc == c.rc && (rc || (in == c.in && out == c.out)), "stamps    reply %d: rc %d usIn %lld usOut %lld",
+			n++, rc, static_cast<long long>(in), static_cast<long long>(out));
+	}
+}
+
+int main(int argc, char* argv[]){
+	size_t records = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 5000000;
+
+	check_offset();
+	check_legs();
+	check_skew();
+	check_stamps();
+
+	LatencyBreakdown lb;
+	add(lb, trip(T0, OFFSET, 100, 20, 100));
+	Clock::time_point t = Clock::now();
+	for(size_t i = 0; i < records; i++){
+		int64_t send = T0 + static_cast<int64_t>(i) * 1000;
+		Trip r = trip(send, OFFSET, 100 + (i & 63), 20 + (i & 7), 100 + (i & 31));
+		lb.record((i & 1) ? "private/buy" : "private/cancel", r.send, r.recv, r.us_in, r.us_out);
+	}
+	double ns = std::chrono::duration<double, std::nano>(Clock::now() - t).count() / static_cast<double>(records);
+	std::printf("timing    %zu records: %.1f ns each (%llu skewed)\n", records, ns,
+		static_cast<unsigned long long>(lb.methods().find("private/buy")->second.skewed));
+
+	std::printf("%s\n", failures ? "FAILED" : "all checks passed");
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,147 @@
+// Concurrent request flows: the same order requests against the local
+// Deribit stand-in (TLS) through
+//   sync        Beast websocket, blocking, one request at a time
+//   coro xN     AsyncApi with N coroutines on one thread, each sending its
+//               share of the requests back to back
+// Throughput and per request latency; with N > 1 requests are pipelined on
+// the one connection while no thread blocks.
+// First AsyncApi connects to the stand-in, whose certificate is self-signed,
+// with verification on (must be refused) and off (must connect).
+//
+// usage: ./test_coro.exe [requests] [port]
+#include <boost/asio/connect.hpp>
+#include <boost/asio/io_context.hpp>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include "../test_throughput/StandIn.hpp"
+#include "AsyncApi.hpp"
+#include "Histogram.hpp"
+#include "Logger.hpp"
+
+using Clock = std::chrono::steady_clock;
+
+static const char* PARAMS = R"("instrument_name":"BTC-PERPETUAL","type":"limit","price":50000,"amount":10)";
+static const std::string REQUEST = std::string(R"({"jsonrpc":"2.0","method":"private/buy","params":{)") + PARAMS + R"(},"id":1})";
+
+struct Result{
+	Histogram rtt;
+	double seconds = 0;
+	int errors = 0;
+};
+
+static void report(const char* name, size_t n, const Result& r){
+	std::printf("%-9s %9.0f req/s  p50 %7.1f us  p99 %7.1f us  max %8.1f us  errors %d\n",
+		name, n / r.seconds, r.rtt.percentile(50) / 1e3, r.rtt.percentile(99) / 1e3, r.rtt.max() / 1e3, r.errors);
+}
+
+static Result run_sync(const std::string& port, size_t n){
+	net::io_context ioc;
+	ssl::context ctx{ssl::context::tlsv12_client};
+	websocket::stream<beast::ssl_stream<tcp::socket>> ws(ioc, ctx);
+	tcp::resolver resolver{ioc};
+	auto const results = resolver.resolve("127.0.0.1", port);
+	net::connect(beast::get_lowest_layer(ws), results.begin(), results.end());
+	beast::get_lowest_layer(ws).set_option(tcp::no_delay(true));
+	ws.next_layer().handshake(ssl::stream_base::client);
+	ws.handshake("127.0.0.1", "/ws/api/v2");
+	ws.text(true);
+	beast::flat_buffer buffer;
+	Result r;
+	Clock::time_point start = Clock::now();
+	for(size_t i = 0; i < n; i++){
+		Clock::time_point t = Clock::now();
+		ws.write(net::buffer(REQUEST));
+		buffer.clear();
+		ws.read(buffer);
+		if(buffer.size() == 0) r.errors++;
+		r.rtt.record(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - t).count());
+	}
+	r.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+	return r;
+}
+
+struct Flows{
+	size_t left;
+	Clock::time_point start;
+	Result r;
+};
+
+static net::awaitable<void> flow(AsyncApi& api, size_t n, Flows& f){
+	for(size_t i = 0; i < n; i++){
+		Clock::time_point t = Clock::now();
+		auto [status, reply] = co_await api.call("private/buy", PARAMS);
+		if(status) f.r.errors++;
+		f.r.rtt.record(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - t).count());
+	}
+	if(--f.left) co_return;
+	// Last one out stops the clock and closes, which lets ioc.run() return
+	f.r.seconds = std::chrono::duration<double>(Clock::now() - f.start).count();
+	co_await api.close();
+}
+
+static Result run_coro(const std::string& port, size_t n, size_t flows){
+	net::io_context ioc;
+	AsyncApi api(ioc.get_executor(), "127.0.0.1", port, false);
+	Flows f;
+	f.left = flows;
+	net::co_spawn(api.executor(), [&]() -> net::awaitable<void> {
+		if(co_await api.connect()){
+			f.r.errors = static_cast<int>(n);
+			co_return;
+		}
+		for(int i = 0; i < 100; i++) co_await api.call("private/buy", PARAMS);
+		f.start = Clock::now();
+		for(size_t i = 0; i < flows; i++) net::co_spawn(api.executor(), flow(api, n / flows, f), net::detached);
+	}, net::detached);
+	ioc.run();
+	return f.r;
+}
+
+static int connect_once(const std::string& port, bool verify){
+	net::io_context ioc;
+	AsyncApi api(ioc.get_executor(), "127.0.0.1", port, verify);
+	int rc = -1;
+	net::co_spawn(api.executor(), [&]() -> net::awaitable<void> {
+		rc = co_await api.connect();
+		if(rc == 0) co_await api.close();
+	}, net::detached);
+	ioc.run();
+	return rc;
+}
+
+static int check_verify(const std::string& port){
+	int verified = connect_once(port, true);
+	int unverified = connect_once(port, false);
+	bool ok = verified == 1 && unverified == 0;
+	std::printf("verify    self-signed stand-in: connect() %d with verification, %d without %s\n",
+		verified, unverified, ok ? "ok" : "FAILED");
+	return ok ? 0 : 1;
+}
+
+int main(int argc, char** argv){
+	size_t n = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 20000;
+	unsigned short port = argc > 2 ? static_cast<unsigned short>(std::atoi(argv[2])) : 9445;
+	Logger::instance().start("test_coro.log");
+	ssl::context server_ctx{ssl::context::tlsv12_server};
+	if(StandIn::use_self_signed(server_ctx)){
+		std::printf("could not create the stand-in certificate\n");
+		return 1;
+	}
+	StandIn standin(port, 0, &server_ctx);
+	standin.start();
+	std::string p = std::to_string(port);
+
+	int status = check_verify(p);
+	std::printf("%zu requests per row over TLS, %u cpu(s)\n", n, std::thread::hardware_concurrency());
+	report("sync", n, run_sync(p, n));
+	for(size_t flows : {1, 8, 32}){
+		char name[16];
+		std::snprintf(name, sizeof(name), "coro x%zu", flows);
+		report(name, n, run_coro(p, n, flows));
+	}
+
+	standin.stop();
+	Logger::instance().stop();
+	return status;
+}
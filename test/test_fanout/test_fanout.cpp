@@ -0,0 +1,199 @@
+// Market data distribution benchmark: a producer publishing book updates
+// for `instruments` instruments at `rate` per second to two consumer threads
+//   fast   takes each update and moves on
+//   slow   analytics, `work_us` of work per update, far below the rate
+// through
+//   queue    a mutex guarded queue per consumer, every update kept (what a
+//            single msg_queue does)
+//   fanout   MarketDataFanout, latest message per instrument for a consumer
+//            that lags
+// For each: publish cost, the deepest a consumer's queue got, and for the
+// fanout each consumer's delivered / conflated counts and lag.
+//   gaps     book changes, trades and tickers on one thread, taken every few
+//            publishes: a book or trades message that does not follow the
+//            last one taken must be flagged as a gap, tickers never are
+//
+// usage: ./test_fanout.exe [updates] [instruments] [rate] [work_us]
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include "Histogram.hpp"
+#include "market_data/MarketDataFanout.hpp"
+
+using Clock = std::chrono::steady_clock;
+
+static void spin_for(int64_t ns){
+	Clock::time_point until = Clock::now() + std::chrono::nanoseconds(ns);
+	while(Clock::now() < until) {}
+}
+
+// A book notification of about 600 bytes
+static std::string book_msg(size_t inst, size_t seq){
+	std::string msg = R"({"jsonrpc":"2.0","method":"subscription","params":{"channel":"book.INST-)" + std::to_string(inst)
+		+ R"(.100ms","data":{"change_id":)" + std::to_string(seq) + R"(,"bids":[)";
+	for(int i = 0; i < 10; i++) msg += R"(["new",65000.5,1200.0],)";
+	msg += R"(["new",65000.5,1200.0]],"asks":[)";
+	for(int i = 0; i < 10; i++) msg += R"(["new",65001.0,800.0],)";
+	msg += R"(["new",65001.0,800.0]]}}})";
+	return msg;
+}
+
+struct Queue{
+	std::mutex mutex;
+	std::deque<std::string> q;
+	size_t depth_max = 0;
+};
+
+template<typename Publish>
+static Histogram produce(size_t updates, size_t instruments, double rate, const std::vector<std::string>& msgs, Publish publish){
+	Histogram cost;
+	int64_t step_ns = static_cast<int64_t>(1e9 / rate);
+	Clock::time_point start = Clock::now();
+	for(size_t i = 0; i < updates; i++){
+		// Paced, the consumers get the rest of the cpu
+		while(Clock::now() - start < std::chrono::nanoseconds(static_cast<int64_t>(i) * step_ns)) std::this_thread::yield();
+		Clock::time_point t = Clock::now();
+		publish(i % instruments, msgs[i % msgs.size()]);
+		cost.record(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - t).count());
+	}
+	return cost;
+}
+
+static void run_queue(size_t updates, size_t instruments, double rate, int64_t work_ns, const std::vector<std::string>& msgs){
+	Queue queues[2];
+	std::atomic<bool> running{true};
+	std::thread consumers[2];
+	for(int c = 0; c < 2; c++){
+		consumers[c] = std::thread([&, c](){
+			std::string msg;
+			while(running.load(std::memory_order_relaxed)){
+				{
+					std::lock_guard<std::mutex> lock(queues[c].mutex);
+					if(queues[c].q.empty()){
+						msg.clear();
+					} else {
+						msg = std::move(queues[c].q.front());
+						queues[c].q.pop_front();
+					}
+				}
+				if(msg.empty()){
+					std::this_thread::yield();
+					continue;
+				}
+				if(c == 1) spin_for(work_ns);
+			}
+		});
+	}
+	Histogram cost = produce(updates, instruments, rate, msgs, [&](size_t, const std::string& msg){
+		for(Queue& q : queues){
+			std::lock_guard<std::mutex> lock(q.mutex);
+			q.q.push_back(msg);
+			if(q.q.size() > q.depth_max) q.depth_max = q.q.size();
+		}
+	});
+	running = false;
+	for(std::thread& t : consumers) t.join();
+	std::printf("queue   publish p50 %6lu ns p99 %7lu ns  fast depth max %7zu  slow depth max %7zu (~%zu KB held)\n",
+		static_cast<unsigned long>(cost.percentile(50)), static_cast<unsigned long>(cost.percentile(99)),
+		queues[0].depth_max, queues[1].depth_max, queues[1].depth_max * msgs[0].size() / 1024);
+}
+
+// Sequence number a message was made with
+static uint64_t seq_of(const std::string& msg){
+	size_t pos = msg.find("\"change_id\":");
+	return pos == std::string::npos ? 0 : std::strtoull(msg.c_str() + pos + 12, nullptr, 10);
+}
+
+static int check_gaps(){
+	MarketDataFanout fanout;
+	fanout.init(4);
+	int c = fanout.subscribe("gaps");
+	uint64_t last[MarketDataFanout::CHANNELS] = {};
+	uint64_t unflagged = 0, flagged = 0, ticker_gaps = 0, late_first = 0;
+	auto drain = [&](int consumer, uint64_t* seen){
+		MarketDataFanout::Update u;
+		while(fanout.poll(consumer, u) == 0){
+			uint64_t seq = seq_of(u.msg);
+			if(u.channel == MarketDataFanout::TICKER){
+				if(u.gap) ticker_gaps++;
+			} else if(u.gap){
+				flagged++;
+			} else if(seq != seen[u.channel] + 1){
+				unflagged++;
+			}
+			seen[u.channel] = seq;
+		}
+	};
+	int late = -1;
+	for(uint64_t seq = 1; seq <= 1000; seq++){
+		for(MarketDataFanout::Channel ch : {MarketDataFanout::BOOK, MarketDataFanout::TRADES, MarketDataFanout::TICKER}){
+			fanout.publish(1, ch, book_msg(1, seq));
+		}
+		// Keeps up for a while, then takes every 7th
+		if(seq < 100 || seq % 7 == 0) drain(c, last);
+		if(seq == 500) late = fanout.subscribe("late");
+		if(late >= 0 && seq == 510){
+			MarketDataFanout::Update u;
+			if(fanout.poll(late, u) == 0 && u.gap) late_first++;
+		}
+	}
+	drain(c, last);
+	MarketDataFanout::Stats s = fanout.stats(c);
+	bool ok = unflagged == 0 && ticker_gaps == 0 && flagged > 0 && s.gaps == flagged && late_first == 1;
+	std::printf("gaps    %lu delivered, %lu flagged, %lu out of sequence unflagged, %lu tickers flagged, late subscriber's first flagged %s %s\n",
+		static_cast<unsigned long>(s.delivered), static_cast<unsigned long>(flagged), static_cast<unsigned long>(unflagged),
+		static_cast<unsigned long>(ticker_gaps), late_first ? "yes" : "no", ok ? "ok" : "FAILED");
+	return ok ? 0 : 1;
+}
+
+static void run_fanout(size_t updates, size_t instruments, double rate, int64_t work_ns, const std::vector<std::string>& msgs){
+	MarketDataFanout fanout;
+	fanout.init(instruments);
+	int ids[2] = {fanout.subscribe("fast"), fanout.subscribe("slow")};
+	std::atomic<bool> running{true};
+	std::thread consumers[2];
+	for(int c = 0; c < 2; c++){
+		consumers[c] = std::thread([&, c](){
+			MarketDataFanout::Update u;
+			while(fanout.next(ids[c], u, running) == 0){
+				if(c == 1) spin_for(work_ns);
+			}
+		});
+	}
+	Histogram cost = produce(updates, instruments, rate, msgs, [&](size_t inst, const std::string& msg){
+		fanout.publish(static_cast<InstrumentId>(inst), MarketDataFanout::BOOK, msg);
+	});
+	running = false;
+	for(int c = 0; c < 2; c++) fanout.wake(ids[c]);
+	for(std::thread& t : consumers) t.join();
+	std::printf("fanout  publish p50 %6lu ns p99 %7lu ns\n",
+		static_cast<unsigned long>(cost.percentile(50)), static_cast<unsigned long>(cost.percentile(99)));
+	for(int c = 0; c < 2; c++){
+		MarketDataFanout::Stats s = fanout.stats(ids[c]);
+		std::printf("  %-5s delivered %8lu  conflated %8lu  gaps %8lu  depth max %5zu  lag max %8.1f us\n", s.name,
+			static_cast<unsigned long>(s.delivered), static_cast<unsigned long>(s.conflated), static_cast<unsigned long>(s.gaps),
+			s.depth_max, s.lag_max_ns / 1e3);
+	}
+}
+
+int main(int argc, char** argv){
+	size_t updates = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 200000;
+	size_t instruments = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 200;
+	double rate = argc > 3 ? std::atof(argv[3]) : 50000;
+	int64_t work_ns = (argc > 4 ? std::atoll(argv[4]) : 100) * 1000;
+	std::vector<std::string> msgs;
+	for(size_t i = 0; i < 64; i++) msgs.push_back(book_msg(i, i));
+
+	std::printf("%zu updates of %zu B over %zu instruments at %.0f/s, slow consumer %ld us per update, %u cpu(s)\n",
+		updates, msgs[0].size(), instruments, rate, static_cast<long>(work_ns / 1000), std::thread::hardware_concurrency());
+	run_queue(updates, instruments, rate, work_ns, msgs);
+	run_fanout(updates, instruments, rate, work_ns, msgs);
+	int status = check_gaps();
+	std::printf("%s\n", status ? "FAILED" : "all checks passed");
+	return status;
+}
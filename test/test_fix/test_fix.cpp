@@ -0,0 +1,397 @@
+// FIX order entry benchmark against a local acceptor stand-in
+//   encode    a NewOrderSingle from FixSession's templates, next to the
+//             JSON-RPC private/buy request QuoteManager builds
+//   decode    an ExecutionReport indexed by FixMessage and five fields
+//             read, next to the JSON-RPC order reply parsed by nlohmann
+//   resend    two sessions in process, the wire to the initiator losing
+//             `drop` per mille of its messages: every ExecutionReport
+//             must still arrive once and in order through ResendRequests
+//   socket    FixSocket under Api's requests over loopback TCP to the
+//             stand-in (private/buy, edit, cancel round trips)
+//   reconnect the stand-in drops the connection: FixSocket connects again,
+//             logs on without reset and the stand-in's session goes on
+//             with the sequence numbers where they were
+//
+// usage: ./test_fix.exe [messages] [round_trips] [drop]
+#include <arpa/inet.h>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <unordered_map>
+#include <nlohmann/json.hpp>
+#include "Histogram.hpp"
+#include "Price.hpp"
+#include "fix/FixSocket.hpp"
+
+using Clock = std::chrono::steady_clock;
+
+static int64_t wall_ns(){
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+static double ns_since(Clock::time_point t, size_t n){
+	return std::chrono::duration<double, std::nano>(Clock::now() - t).count() / static_cast<double>(n);
+}
+
+// Deribit's FIX gateway as far as orders go: every order is acknowledged
+// as New, replaced and cancelled on request, unknown ones rejected
+class Acceptor{
+public:
+	explicit Acceptor(FixSession::Send send)
+		: m_session(FixSession::ACCEPTOR, options(), std::move(send)) {
+		m_session.on_message([this](const FixMessage& msg){ on_order(msg); });
+	}
+	FixSession& session(){ return m_session; }
+private:
+	struct Order{
+		std::string symbol;
+		char side;
+		double qty;
+		double price;
+		std::string label;
+	};
+	static FixSession::Options options(){
+		FixSession::Options o;
+		o.sender_comp_id = "DERIBITSERVER";
+		o.target_comp_id = "CLIENT";
+		return o;
+	}
+	void report(const std::string& id, const Order& o, char status, char exec, int64_t now){
+		FixWriter& w = m_session.begin('8', now);
+		w.add(FixMessage::ORDER_ID, id);
+		w.add(FixMessage::CL_ORD_ID, o.label);
+		w.add_int(FixMessage::EXEC_ID, static_cast<int64_t>(++m_exec));
+		w.add(FixMessage::EXEC_TYPE, exec);
+		w.add(FixMessage::ORD_STATUS, status);
+		w.add(FixMessage::SYMBOL, o.symbol);
+		w.add(FixMessage::SIDE, o.side);
+		w.add(FixMessage::ORD_TYPE, '2');
+		w.add_double(FixMessage::ORDER_QTY, o.qty);
+		w.add_double(FixMessage::PRICE, o.price);
+		w.add_double(FixMessage::CUM_QTY, 0);
+		w.add_double(FixMessage::LEAVES_QTY, status == '4' ? 0 : o.qty);
+		w.add_double(FixMessage::AVG_PX, 0);
+		w.add(FixMessage::EXEC_INST, '6');
+		w.add_time(FixMessage::TRANSACT_TIME, now);
+		m_session.send();
+	}
+	void on_order(const FixMessage& msg){
+		int64_t now = wall_ns();
+		char type = msg.type()[0];
+		if(type == 'D'){
+			std::string id = "ETH-" + std::to_string(++m_next_id);
+			Order& o = m_orders[id];
+			o = Order{std::string(msg.get(FixMessage::SYMBOL)), msg.get_char(FixMessage::SIDE), msg.get_double(FixMessage::ORDER_QTY),
+				msg.get_double(FixMessage::PRICE), std::string(msg.get(FixMessage::CL_ORD_ID))};
+			report(id, o, '0', '0', now);
+			return;
+		}
+		auto it = m_orders.find(std::string(msg.get(FixMessage::ORIG_CL_ORD_ID)));
+		if(it == m_orders.end()){
+			FixWriter& w = m_session.begin('9', now);
+			w.add(FixMessage::ORDER_ID, "NONE");
+			w.add(FixMessage::CL_ORD_ID, msg.get(FixMessage::CL_ORD_ID));
+			w.add(FixMessage::ORIG_CL_ORD_ID, msg.get(FixMessage::ORIG_CL_ORD_ID));
+			w.add(FixMessage::ORD_STATUS, '8');
+			w.add_int(FixMessage::CXL_REJ_REASON, 1);
+			w.add(FixMessage::CXL_REJ_RESPONSE_TO, type == 'F' ? '1' : '2');
+			m_session.send();
+		} else if(type == 'G'){
+			it->second.qty = msg.get_double(FixMessage::ORDER_QTY);
+			it->second.price = msg.get_double(FixMessage::PRICE);
+			report(it->first, it->second, '0', '5', now);
+		} else if(type == 'F'){
+			report(it->first, it->second, '4', '4', now);
+			m_orders.erase(it);
+		}
+	}
+
+	FixSession m_session;
+	std::unordered_map<std::string, Order> m_orders;
+	uint64_t m_next_id = 0;
+	uint64_t m_exec = 0;
+};
+
+static void bench_codec(size_t messages){
+	std::string wire;
+	FixSession::Options o;
+	FixSession client(FixSession::INITIATOR, o, [&wire](std::string_view msg){ wire.assign(msg); return 0; });
+	std::string to_client;
+	Acceptor acceptor([&to_client](std::string_view msg){ to_client.assign(msg); return 0; });
+	int64_t now = wall_ns();
+	if(client.logon(now)) return;
+	acceptor.session().on_data(wire, now);
+	client.on_data(to_client, now);
+	// An ExecutionReport as the stand-in writes it
+	if(client.new_order("q1", "BTC-PERPETUAL", true, 100, 60000.5, FixSession::POST_ONLY, now)) return;
+	acceptor.session().on_data(wire, now);
+	std::string report = to_client;
+	client.on_data(report, now);
+
+	Clock::time_point t = Clock::now();
+	for(size_t i = 0; i < messages; i++){
+		if(client.new_order("q1", "BTC-PERPETUAL", true, 100, 60000.5, FixSession::POST_ONLY, now)) return;
+	}
+	double fix_encode = ns_since(t, messages);
+	// Same request as QuoteManager::order_request
+	t = Clock::now();
+	size_t bytes = 0;
+	for(size_t i = 0; i < messages; i++){
+		char px[32], amt[32];
+		char* px_end = format_decimal(px, px + sizeof(px), Price(120001), Scale{5, 1});
+		char* amt_end = format_decimal(amt, amt + sizeof(amt), Qty(100), Scale{1, 0});
+		std::string payload;
+		payload.reserve(192);
+		payload += R"({"jsonrpc":"2.0","method":")";
+		payload += "private/buy";
+		payload += R"(","params":{)";
+		payload += R"("instrument_name":"BTC-PERPETUAL")";
+		payload += R"(,"price":)";
+		payload.append(px, px_end);
+		payload += R"(,"amount":)";
+		payload.append(amt, amt_end);
+		payload += R"(,"post_only":true},"id":)";
+		char num[24];
+		payload.append(num, std::to_chars(num, num + sizeof(num), i + 1).ptr);
+		payload += '}';
+		bytes += payload.size();
+	}
+	double json_encode = ns_since(t, messages);
+	std::printf("encode   NewOrderSingle %.0f ns (%zu bytes), JSON private/buy %.0f ns (%zu bytes)\n",
+		fix_encode, wire.size(), json_encode, bytes / messages);
+
+	FixMessage msg;
+	double sum = 0;
+	t = Clock::now();
+	for(size_t i = 0; i < messages; i++){
+		if(msg.parse(report)) return;
+		sum += msg.get_double(FixMessage::PRICE) + msg.get_double(FixMessage::CUM_QTY);
+		sum += static_cast<double>(msg.get(FixMessage::ORDER_ID).size() + msg.get(FixMessage::SYMBOL).size() + msg.get_char(FixMessage::ORD_STATUS));
+	}
+	double fix_decode = ns_since(t, messages);
+	const std::string reply = R"({"jsonrpc":"2.0","id":11,"result":{"trades":[],"order":{"web":false,"time_in_force":"good_til_cancelled","replaced":false,"reduce_only":false,"price":60000.5,"post_only":true,"order_type":"limit","order_state":"open","order_id":"ETH-1000001","max_show":100.0,"last_update_timestamp":1700000000000,"label":"q1","is_liquidation":false,"instrument_name":"BTC-PERPETUAL","filled_amount":0.0,"direction":"buy","creation_timestamp":1700000000000,"average_price":0.0,"api":true,"amount":100.0}},"usIn":1700000000000000,"usOut":1700000000000100,"usDiff":100,"testnet":true})";
+	t = Clock::now();
+	for(size_t i = 0; i < messages; i++){
+		nlohmann::json j = nlohmann::json::parse(reply);
+		const nlohmann::json& order = j["result"]["order"];
+		sum += order["price"].get<double>() + order["filled_amount"].get<double>();
+		sum += static_cast<double>(order["order_id"].get<std::string>().size() + order["instrument_name"].get<std::string>().size() + order["order_state"].get<std::string>().size());
+	}
+	double json_decode = ns_since(t, messages);
+	std::printf("decode   ExecutionReport %.0f ns (%zu bytes), JSON order reply %.0f ns (%zu bytes)%s\n",
+		fix_decode, report.size(), json_decode, reply.size(), sum > 0 ? "" : " ");
+}
+
+// Both ends in process, each message goes through the other's on_data.
+// With `drop` per mille odds per batch of orders the connection is lost
+// part way through its ExecutionReports, the rest of them with it; the
+// client logs on again keeping its sequence numbers and the gap is filled
+// by a resend
+static int bench_resend(size_t messages, int drop){
+	constexpr size_t BATCH = 8;
+	std::string to_server, to_client;
+	uint64_t lost = 0, seen = 0, reconnects = 0;
+	int64_t until_cut = -1;
+	uint64_t rng = 0x2545f4914f6cdd1dull;
+	auto next = [&rng](){
+		rng ^= rng << 13;
+		rng ^= rng >> 7;
+		rng ^= rng << 17;
+		return rng;
+	};
+	FixSession::Options o;
+	o.reset_seq = false;
+	FixSession client(FixSession::INITIATOR, o, [&to_server](std::string_view msg){ to_server.append(msg); return 0; });
+	Acceptor acceptor([&](std::string_view msg){
+		if(until_cut == 0){
+			lost++;
+			return 0;
+		}
+		if(until_cut > 0) until_cut--;
+		to_client.append(msg);
+		return 0;
+	});
+	size_t expected = 1;
+	bool in_order = true;
+	client.on_message([&](const FixMessage& msg){
+		if(msg.type() != "8") return;
+		size_t id = static_cast<size_t>(std::strtoull(msg.get(FixMessage::ORDER_ID).data() + 4, nullptr, 10));
+		if(id != expected) in_order = false;
+		expected = id + 1;
+		seen++;
+	});
+	auto pump = [&](int64_t now){
+		while(!to_server.empty() || !to_client.empty()){
+			std::string in;
+			in.swap(to_server);
+			acceptor.session().on_data(in, now);
+			in.clear();
+			in.swap(to_client);
+			client.on_data(in, now);
+		}
+	};
+	int64_t now = wall_ns();
+	if(client.logon(now)) return 1;
+	pump(now);
+	Clock::time_point t = Clock::now();
+	for(size_t i = 0; i < messages; i += BATCH){
+		if(static_cast<int>(next() % 1000) < drop) until_cut = static_cast<int64_t>(next() % BATCH);
+		for(size_t j = i; j < i + BATCH && j < messages; j++){
+			if(client.new_order("r", "BTC-PERPETUAL", j & 1, 10, 60000, 0, now)) return 1;
+		}
+		pump(now);
+		if(until_cut == 0){
+			until_cut = -1;
+			reconnects++;
+			if(client.logon(now)) return 1;
+			pump(now);
+		}
+		until_cut = -1;
+	}
+	double s = std::chrono::duration<double>(Clock::now() - t).count();
+	const FixSession::Stats& cs = client.stats();
+	const FixSession::Stats& as = acceptor.session().stats();
+	bool ok = seen == messages && in_order;
+	std::printf("resend   %zu orders, %lu reconnects losing %lu messages, %lu ResendRequests, %lu resent: %lu reports %s in %.3f s\n",
+		messages, reconnects, lost, cs.gaps, as.resent, seen, ok ? "all once and in order" : "MISSING OR OUT OF ORDER", s);
+	return ok ? 0 : 1;
+}
+
+// One stand-in session over `connections` connections in turn. `resumed`:
+// the first Logon on a later connection took the sequence number next in line
+static void serve(int listener, int connections, std::atomic<int>& current, std::atomic<bool>& resumed){
+	int fd = -1;
+	Acceptor acceptor([&fd](std::string_view msg){
+		return send(fd, msg.data(), msg.size(), MSG_NOSIGNAL) == static_cast<ssize_t>(msg.size()) ? 0 : 1;
+	});
+	for(int c = 0; c < connections; c++){
+		fd = accept(listener, nullptr, nullptr);
+		if(fd < 0) return;
+		int one = 1;
+		setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+		current = fd;
+		uint64_t expected = acceptor.session().next_in();
+		bool first = c > 0;
+		std::string buf;
+		char chunk[16384];
+		while(true){
+			ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+			if(n <= 0) break;
+			buf.append(chunk, static_cast<size_t>(n));
+			int64_t used = acceptor.session().on_data(buf, wall_ns());
+			if(used < 0) break;
+			buf.erase(0, static_cast<size_t>(used));
+			if(first && acceptor.session().next_in() != expected){
+				resumed = acceptor.session().next_in() == expected + 1;
+				first = false;
+			}
+		}
+		current = -1;
+		close(fd);
+	}
+}
+
+static int bench_socket(size_t round_trips){
+	int listener = socket(AF_INET, SOCK_STREAM, 0);
+	sockaddr_in addr{};
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	socklen_t len = sizeof(addr);
+	if(bind(listener, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) || listen(listener, 1)
+		|| getsockname(listener, reinterpret_cast<sockaddr*>(&addr), &len)) return 1;
+	std::atomic<int> current{-1};
+	std::atomic<bool> resumed{false};
+	std::thread server(serve, listener, 2, std::ref(current), std::ref(resumed));
+
+	FixSocket::Options options;
+	options.host = "127.0.0.1";
+	options.port = std::to_string(ntohs(addr.sin_port));
+	int status = 0;
+	{
+		FixSocket fix(options);
+		fix.switch_to_ws();
+		std::pair<int, std::string> r = fix.ws_request(R"({"jsonrpc":"2.0","id":1,"method":"public/auth","params":{"grant_type":"client_credentials","client_id":"id","client_secret":"secret"}})");
+		if(r.first || r.second.find("access_token") == std::string::npos){
+			std::printf("socket   logon failed: %s\n", r.second.c_str());
+			status = 1;
+		}
+		Histogram buy, edit, cancel;
+		for(size_t i = 0; i < round_trips && !status; i++){
+			Clock::time_point t = Clock::now();
+			r = fix.ws_request(R"({"jsonrpc":"2.0","method":"private/buy","params":{"instrument_name":"BTC-PERPETUAL","price":60000.5,"amount":100,"post_only":true},"id":"11"})");
+			buy.record(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - t).count());
+			nlohmann::json reply = nlohmann::json::parse(r.second, nullptr, false);
+			if(r.first || !reply.contains("result")){
+				std::printf("socket   buy failed: %s\n", r.second.c_str());
+				status = 1;
+				break;
+			}
+			std::string order_id = reply["result"]["order"]["order_id"];
+			t = Clock::now();
+			r = fix.ws_request(R"({"jsonrpc":"2.0","method":"private/edit","params":{"order_id":")" + order_id + R"(","price":60001,"amount":90,"post_only":true},"id":"12"})");
+			edit.record(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - t).count());
+			if(r.first || r.second.find(R"("amount":90)") == std::string::npos){
+				std::printf("socket   edit failed: %s\n", r.second.c_str());
+				status = 1;
+				break;
+			}
+			t = Clock::now();
+			r = fix.ws_request(R"({"jsonrpc":"2.0","method":"private/cancel","params":{"order_id":")" + order_id + R"("},"id":"13"})");
+			cancel.record(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - t).count());
+			if(r.first || r.second.find(R"("order_state":"cancelled")") == std::string::npos){
+				std::printf("socket   cancel failed: %s\n", r.second.c_str());
+				status = 1;
+				break;
+			}
+		}
+		// A cancel of an order the stand-in does not know
+		r = fix.ws_request(R"({"jsonrpc":"2.0","method":"private/cancel","params":{"order_id":"ETH-0"},"id":"14"})");
+		if(r.first || r.second.find("not_open_order") == std::string::npos){
+			std::printf("socket   unknown order cancel: %s\n", r.second.c_str());
+			status = 1;
+		}
+		// The stand-in drops the connection, the next order goes out once the session is back
+		int fd = current.load();
+		if(!status && fd >= 0){
+			shutdown(fd, SHUT_RDWR);
+			Clock::time_point t = Clock::now();
+			do{
+				std::this_thread::sleep_for(std::chrono::milliseconds(5));
+				r = fix.ws_request(R"({"jsonrpc":"2.0","method":"private/buy","params":{"instrument_name":"BTC-PERPETUAL","price":60000.5,"amount":100,"post_only":true},"id":"15"})");
+			} while(r.first && Clock::now() - t < std::chrono::seconds(5));
+			bool ok = r.first == 0 && r.second.find(R"("order_state":"open")") != std::string::npos && resumed.load();
+			std::printf("reconnect order placed %.1f ms after the drop, Logon %s %s\n", std::chrono::duration<double, std::milli>(Clock::now() - t).count(),
+				resumed.load() ? "resumed the sequence numbers" : "reset or missing", ok ? "ok" : "FAILED");
+			if(!ok) status = 1;
+		}
+		if(!status){
+			std::printf("socket   %zu round trips each over loopback, p50 / p99 us: buy %.1f / %.1f  edit %.1f / %.1f  cancel %.1f / %.1f\n",
+				round_trips, buy.percentile(50) / 1e3, buy.percentile(99) / 1e3, edit.percentile(50) / 1e3, edit.percentile(99) / 1e3,
+				cancel.percentile(50) / 1e3, cancel.percentile(99) / 1e3);
+		}
+	}
+	// Not waiting for a second connection that never came
+	shutdown(listener, SHUT_RDWR);
+	server.join();
+	close(listener);
+	return status;
+}
+
+int main(int argc, char* argv[]){
+	size_t messages = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+	size_t round_trips = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 20000;
+	int drop = argc > 3 ? std::atoi(argv[3]) : 10;
+
+	bench_codec(messages);
+	int status = bench_resend(messages / 10, drop);
+	status |= bench_socket(round_trips);
+	return status;
+}
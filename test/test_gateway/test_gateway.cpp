@@ -0,0 +1,167 @@
+// Order gateway slot reuse check and benchmark
+//   reuse     client process A sends `requests` requests and leaves while
+//             the gateway still holds one (rate limited) and has replies
+//             queued for it (its response ring is full); client process B
+//             claims the same slot before the gateway's next pass. Every
+//             reply B gets must answer one of B's own requests
+//   dead      the same with A SIGKILLed instead of leaving: its slot is
+//             reclaimed and B gets only its own replies
+//   timing    request -> reply round trips of one client through a gateway
+//             polling on a thread of this process; past the rate limiter's
+//             burst (100) they run at its pace
+//
+// usage: ./test_gateway.exe [requests] [round trips]
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+#include "oms/OrderGateway.hpp"
+
+using Clock = std::chrono::steady_clock;
+
+// Replies echo the request and are large enough to fill a response ring in a few dozen
+static std::pair<int, std::string> echo(const std::string& request){
+	std::string reply = R"({"result":")" + request + R"(","pad":")";
+	reply.append(60000, 'x');
+	reply += R"("})";
+	return std::make_pair(0, reply);
+}
+
+static void wait_byte(int fd){
+	char c;
+	while(read(fd, &c, 1) < 0 && errno == EINTR) {}
+}
+
+static void send_byte(int fd){
+	char c = 1;
+	while(write(fd, &c, 1) < 0 && errno == EINTR) {}
+}
+
+// Client A: sends `requests` requests, reads nothing, leaves (or is killed) on cue
+static pid_t spawn_first(const std::string& name, int requests, int submitted, int go){
+	pid_t pid = fork();
+	if(pid != 0) return pid;
+	{
+		OrderClient client;
+		if(client.connect(name)) _exit(1);
+		for(int i = 1; i <= requests; i++){
+			if(client.submit("A " + std::to_string(i)) == 0) _exit(1);
+		}
+		send_byte(submitted);
+		wait_byte(go);
+	} // releases the slot
+	_exit(0);
+}
+
+// Client B: claims a slot, sends three requests and checks every reply is its own
+static pid_t spawn_second(const std::string& name, int submitted){
+	pid_t pid = fork();
+	if(pid != 0) return pid;
+	OrderClient client;
+	if(client.connect(name)) _exit(1);
+	for(int i = 1; i <= 3; i++){
+		if(client.submit("B " + std::to_string(i)) == 0) _exit(1);
+	}
+	send_byte(submitted);
+	int got = 0, foreign = 0;
+	uint64_t tag;
+	int status;
+	std::string reply;
+	Clock::time_point until = Clock::now() + std::chrono::seconds(10);
+	while(got < 3 && Clock::now() < until){
+		if(client.poll(tag, status, reply)){
+			std::this_thread::yield();
+			continue;
+		}
+		got++;
+		if(reply.find(R"({"result":"B )" + std::to_string(tag) + '"') != 0) foreign++;
+	}
+	_exit(got == 3 && foreign == 0 ? 0 : 2 + std::min(foreign, 100));
+}
+
+static int check_reuse(const std::string& name, int requests, bool kill_first){
+	OrderGateway gateway;
+	if(gateway.open(name)) return 1;
+	int a_submitted[2], a_go[2], b_submitted[2];
+	if(pipe(a_submitted) || pipe(a_go) || pipe(b_submitted)) return 1;
+
+	pid_t a = spawn_first(name, requests, a_submitted[1], a_go[0]);
+	wait_byte(a_submitted[0]);
+	// Until A's token bucket runs dry with a request held and its ring overflows
+	int forwarded = 0;
+	for(int pass = 0; pass < requests; pass++) forwarded += gateway.poll(echo);
+
+	// A goes away, B claims the slot, then the gateway's next pass
+	if(kill_first) kill(a, SIGKILL);
+	send_byte(a_go[1]);
+	waitpid(a, nullptr, 0);
+	if(kill_first){
+		// The dead client's slot comes back on the gateway's once a second check
+		Clock::time_point until = Clock::now() + std::chrono::milliseconds(1100);
+		while(Clock::now() < until){
+			gateway.poll(echo);
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		}
+	}
+	pid_t b = spawn_second(name, b_submitted[1]);
+	wait_byte(b_submitted[0]);
+	int status = 0;
+	while(waitpid(b, &status, WNOHANG) == 0){
+		gateway.poll(echo);
+		std::this_thread::yield();
+	}
+	int rc = WIFEXITED(status) ? WEXITSTATUS(status) : 1;
+	bool ok = rc == 0;
+	std::printf("%-9s A sent %d, %d forwarded before it %s; B got %s %s\n", kill_first ? "dead" : "reuse", requests, forwarded,
+		kill_first ? "was killed" : "left", rc == 0 ? "only its own replies" : (rc == 1 ? "no slot" : "replies of A"), ok ? "ok" : "FAILED");
+	for(int fd : {a_submitted[0], a_submitted[1], a_go[0], a_go[1], b_submitted[0], b_submitted[1]}) close(fd);
+	return ok ? 0 : 1;
+}
+
+static void measure(const std::string& name, int trips){
+	OrderGateway gateway;
+	if(gateway.open(name)) return;
+	std::atomic<bool> running{true};
+	// Unthrottled handler: only the rings and the polling are measured
+	std::thread gw([&]{
+		while(running.load(std::memory_order_relaxed)){
+			if(gateway.poll([](const std::string& r){ return std::make_pair(0, r); }) == 0) std::this_thread::yield();
+		}
+	});
+	OrderClient client;
+	std::vector<double> us;
+	if(client.connect(name) == 0){
+		for(int i = 0; i < trips; i++){
+			Clock::time_point t = Clock::now();
+			std::pair<int, std::string> resp = client.request(R"({"method":"public/test"})");
+			if(resp.first) break;
+			us.push_back(std::chrono::duration<double, std::micro>(Clock::now() - t).count());
+		}
+	}
+	running = false;
+	gw.join();
+	if(us.empty()) return;
+	std::sort(us.begin(), us.end());
+	std::printf("timing    %zu round trips within the rate limiter's burst: p50 %.1f us, p99 %.1f us\n",
+		us.size(), us[us.size() / 2], us[us.size() * 99 / 100]);
+}
+
+int main(int argc, char* argv[]){
+	int requests = argc > 1 ? std::atoi(argv[1]) : 150;
+	int trips = argc > 2 ? std::atoi(argv[2]) : 100;
+
+	std::string name = "/hft_gateway_test_" + std::to_string(getpid());
+	int status = check_reuse(name, requests, false);
+	status |= check_reuse(name, requests, true);
+	measure(name, trips);
+	std::printf("%s\n", status ? "FAILED" : "all checks passed");
+	return status;
+}
@@ -0,0 +1,173 @@
+// TLS cost benchmark: request/reply round trips against the local Deribit
+// stand-in over TLS 1.3 through
+//   asio-ssl    Beast websocket on an Asio SSL stream (what the three
+//               existing transports do)
+//   user-tls    USocket, OpenSSL on memory BIOs
+//   ktls        USocket with the session keys handed to the kernel
+// For each, round trip percentiles and the CPU time the client thread spent
+// per message (user + system, from getrusage), at two request sizes.
+// First the keys handed to the kernel are checked: the HKDF-Expand-Label
+// key / IV of the four traffic secrets of RFC 8448's simple 1-RTT handshake
+// (TLS_AES_128_GCM_SHA256), and of the SHA-384 and ChaCha20 suites against
+// values from an independent HMAC based HKDF.
+//
+// usage: ./test_ktls.exe [requests] [port]
+#include <boost/asio/connect.hpp>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <sys/resource.h>
+#include "../test_throughput/StandIn.hpp"
+#include "Histogram.hpp"
+#include "Logger.hpp"
+#include "Custom_WebSocket/USocket.hpp"
+
+using Clock = std::chrono::steady_clock;
+
+struct Result{
+	Histogram rtt;
+	double cpu_us = 0; // per message
+	int errors = 0;
+	const char* note = "";
+};
+
+static std::string unhex(const char* hex){
+	std::string out;
+	for(; hex[0] && hex[1]; hex += 2) out += static_cast<char>(std::stoi(std::string(hex, 2), nullptr, 16));
+	return out;
+}
+
+static int check_traffic_keys(){
+	struct{ const char* what; uint16_t cipher; const char* secret; const char* key; const char* iv; } cases[] = {
+		{"RFC 8448 server handshake", 0x1301, "b67b7d690cc16c4e75e54213cb2d37b4e9c912bcded9105d42befd59d391ad38",
+			"3fce516009c21727d0f2e4e86ee403bc", "5d313eb2671276ee13000b30"},
+		{"RFC 8448 client handshake", 0x1301, "b3eddb126e067f35a780b3abf45e2d8f3b1a950738f52e9600746a0e27a55a21",
+			"dbfaa693d1762c5b666af5d950258d01", "5bd3c71b836e0b76bb73265f"},
+		{"RFC 8448 server application", 0x1301, "a11af9f05531f856ad47116b45a950328204b4f44bfb6b3a4b4f1f3fcb631643",
+			"9f02283b6c9c07efc26bb9f2ac92e356", "cf782b88dd83549aadf1e984"},
+		{"RFC 8448 client application", 0x1301, "9e40646ce79a7f9dc05af8889bce6552875afa0b06df0087f792ebb7c17504a5",
+			"17422dda596ed5d9acd890e3c63f5051", "5b78923dee08579033e523d9"},
+		{"AES-256-GCM-SHA384, secret 00..2f", 0x1302, "000102030405060708090a0b0c0d0e0f101112131415161718191a1b1c1d1e1f202122232425262728292a2b2c2d2e2f",
+			"6877d022f1c61d24ebb7487c16752d9a4798e40431c75b39320e537c90e23225", "42822531a0fe88648fc09e9f"},
+		{"CHACHA20-POLY1305, secret 00..1f", 0x1303, "000102030405060708090a0b0c0d0e0f101112131415161718191a1b1c1d1e1f",
+			"2ffbc449e87844051c7768f61ffd8ad070830f01ec2c520ef65f08e8296dffa0", "2f41c846a431a163814bcd71"},
+	};
+	int failures = 0;
+	for(const auto& c : cases){
+		unsigned char key[32], iv[12];
+		size_t key_len = 0;
+		std::string want_key = unhex(c.key), want_iv = unhex(c.iv);
+		bool ok = USocket::traffic_keys(c.cipher, unhex(c.secret), key, key_len, iv) == 0 && key_len == want_key.size()
+			&& std::memcmp(key, want_key.data(), key_len) == 0 && std::memcmp(iv, want_iv.data(), sizeof(iv)) == 0;
+		if(!ok) failures++;
+		std::printf("keys      %-36s %s\n", c.what, ok ? "ok" : "FAILED");
+	}
+	unsigned char key[32], iv[12];
+	size_t key_len = 0;
+	bool refused = USocket::traffic_keys(0x1304, std::string(32, '\0'), key, key_len, iv) == 1;
+	if(!refused) failures++;
+	std::printf("keys      %-36s %s\n", "AES-128-CCM refused", refused ? "ok" : "FAILED");
+	return failures ? 1 : 0;
+}
+
+static int64_t thread_cpu_us(){
+	rusage ru;
+	getrusage(RUSAGE_THREAD, &ru);
+	return (ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) * 1000000ll + ru.ru_utime.tv_usec + ru.ru_stime.tv_usec;
+}
+
+static void report(const char* name, size_t bytes, const Result& r){
+	std::printf("%-9s %5zu B  p50 %7.1f us  p99 %7.1f us  cpu/msg %6.2f us  errors %d  %s\n",
+		name, bytes, r.rtt.percentile(50) / 1e3, r.rtt.percentile(99) / 1e3, r.cpu_us, r.errors, r.note);
+}
+
+// Times `n` calls of `one` (returning 0 on success) after a short warm up
+template<typename F>
+static Result measure(size_t n, F one){
+	Result r;
+	for(int i = 0; i < 100; i++) one();
+	int64_t cpu = thread_cpu_us();
+	for(size_t i = 0; i < n; i++){
+		Clock::time_point t = Clock::now();
+		if(one()) r.errors++;
+		r.rtt.record(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - t).count());
+	}
+	r.cpu_us = static_cast<double>(thread_cpu_us() - cpu) / n;
+	return r;
+}
+
+// A Deribit shaped order request padded to roughly `bytes`
+static std::string make_request(size_t bytes){
+	std::string req = R"({"jsonrpc":"2.0","method":"private/buy","params":{"instrument_name":"BTC-PERPETUAL","type":"limit","price":50000,"amount":10,"label":")";
+	size_t tail = std::string(R"("},"id":"1"})").size();
+	if(bytes > req.size() + tail) req.append(bytes - req.size() - tail, 'x');
+	return req + R"("},"id":"1"})";
+}
+
+static Result run_asio_ssl(const std::string& port, const std::string& request, size_t n){
+	net::io_context ioc;
+	ssl::context ctx{ssl::context::tlsv13_client};
+	ctx.set_verify_mode(ssl::verify_none);
+	websocket::stream<beast::ssl_stream<tcp::socket>> ws(ioc, ctx);
+	tcp::resolver resolver{ioc};
+	auto const results = resolver.resolve("127.0.0.1", port);
+	net::connect(beast::get_lowest_layer(ws), results.begin(), results.end());
+	beast::get_lowest_layer(ws).set_option(tcp::no_delay(true));
+	ws.next_layer().handshake(ssl::stream_base::client);
+	ws.handshake("127.0.0.1", "/ws/api/v2");
+	ws.text(true);
+	beast::flat_buffer buffer;
+	return measure(n, [&](){
+		ws.write(net::buffer(request));
+		buffer.clear();
+		ws.read(buffer);
+		return buffer.size() ? 0 : 1;
+	});
+}
+
+static Result run_usocket(const std::string& port, const std::string& request, size_t n, bool ktls){
+	USocket::Options opt;
+	opt.host = "127.0.0.1";
+	opt.port = port;
+	opt.verify = false;
+	opt.ktls = ktls;
+	USocket sock(opt);
+	sock.switch_to_ws();
+	if(!sock.is_open()){
+		Result r;
+		r.errors = static_cast<int>(n);
+		return r;
+	}
+	Result r = measure(n, [&](){ return sock.ws_request(request).first; });
+	if(ktls) r.note = sock.ktls() ? "(kernel TLS)" : "(kTLS unavailable, user space TLS, see test_ktls.log)";
+	return r;
+}
+
+int main(int argc, char** argv){
+	size_t n = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 20000;
+	unsigned short port = argc > 2 ? static_cast<unsigned short>(std::atoi(argv[2])) : 9444;
+	Logger::instance().start("test_ktls.log");
+	int status = check_traffic_keys();
+	ssl::context server_ctx{ssl::context::tlsv13_server};
+	if(StandIn::use_self_signed(server_ctx)){
+		std::printf("could not create the stand-in certificate\n");
+		return 1;
+	}
+	StandIn standin(port, 0, &server_ctx);
+	standin.start();
+	std::string p = std::to_string(port);
+
+	std::printf("%zu round trips per row over TLS 1.3\n", n);
+	for(size_t bytes : {size_t(135), size_t(4096)}){
+		std::string request = make_request(bytes);
+		report("asio-ssl", request.size(), run_asio_ssl(p, request, n));
+		report("user-tls", request.size(), run_usocket(p, request, n, false));
+		report("ktls", request.size(), run_usocket(p, request, n, true));
+	}
+
+	standin.stop();
+	Logger::instance().stop();
+	return status;
+}
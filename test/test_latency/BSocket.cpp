@@ -133,12 +133,12 @@ void BSocket::ws_request_async(const std::string& message, std::function<void(in
 	m_ws_async -> async_write(boost::asio::buffer(*_msg), [this, _msg, callback, start_time](const boost::system::error_code &ec, std::size_t bytes_transferred){
 		q_empty = true; // callback called write was successfull
 		if (ec) {
-			std::cout << "Error in async_write: " << ec.message() << std::endl;
+			Logger::instance().log_text(LogId::SOCKET_ERROR, ec.message(), "async_write");
 			callback(1, ""); // Indicate failure
 		} else {
 			auto end_time = std::chrono::high_resolution_clock::now();				
     			auto duration = std::chrono::duration_cast<std::chrono::microseconds>(end_time - start_time);
-			std::cout << "Message written successfully and " << bytes_transferred << " bytes transferred in " << duration.count() << " us\n";
+			Logger::instance().log(LogId::SOCKET_WRITE_DONE, bytes_transferred, duration.count());
 			callback(0, "Success\n");
 		}
 	});
@@ -147,7 +147,7 @@ void BSocket::ws_request_async(const std::string& message, std::function<void(in
 // Async resp
 void BSocket::ws_response_async(int status, const std::string &resp) { 
 	m_response_buffer.push_back(make_pair(status, resp));
-	std::cout << resp << '\n';	
+	Logger::instance().log_text(LogId::SOCKET_RESPONSE, resp);
 	return;
 }
 
@@ -14,6 +14,7 @@
 #include <semaphore>
 
 #include "Socket.hpp"
+#include "Logger.hpp"
 
 namespace beast = boost::beast;         // from <boost/beast.hpp>
 namespace http = beast::http;           // from <boost/beast/http.hpp>
@@ -75,6 +75,7 @@ int main(){
   		"id": 0
 	})";
 
+	Logger::instance().start("test_latency.log");
 	Api api = Api();
 	std::pair<int, std::string> reply = api.api_private(summary);
 	if(reply.first){
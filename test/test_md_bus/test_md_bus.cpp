@@ -0,0 +1,215 @@
+// Shared memory market data bus check and benchmark
+//   torn      a writer process publishes as fast as it can, every field of
+//             snapshot k derived from k; the reader checks every copy it
+//             gets is one whole snapshot and counts busy answers
+//   latency   the writer publishes every `gap_us`, the reader polls
+//             version() and measures publish -> copied (CLOCK_REALTIME);
+//             on a single core the writer yields after each publish and
+//             this is mostly a context switch, not the bus
+//   dead      a writer that stopped between the two sequence stores: read()
+//             answers busy (2) in bounded time instead of spinning forever
+//   shrink    a publisher reopening the region with a smaller capacity
+//             keeps its size; a reader mapped before reads the slots past
+//             the new capacity as never published instead of faulting
+//
+// usage: ./test_md_bus.exe [publishes] [latency samples] [gap_us]
+#include <algorithm>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <sched.h>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+#include "market_data/MarketDataBus.hpp"
+
+using Clock = std::chrono::steady_clock;
+
+static int64_t realtime_ns(){
+	timespec ts;
+	clock_gettime(CLOCK_REALTIME, &ts);
+	return ts.tv_sec * 1000000000ll + ts.tv_nsec;
+}
+
+// Snapshot k: every field a function of k, so a mix of two shows
+static void fill(BookSnapshot& s, int64_t k){
+	std::memset(&s, 0, sizeof(s));
+	std::snprintf(s.instrument, sizeof(s.instrument), "BTC-PERPETUAL");
+	s.exchange_ts_ms = k;
+	s.change_id = k;
+	s.bid_levels = BookSnapshot::DEPTH;
+	s.ask_levels = BookSnapshot::DEPTH;
+	for(int i = 0; i < BookSnapshot::DEPTH; i++){
+		s.bid_price[i] = static_cast<double>(k - i);
+		s.bid_amount[i] = static_cast<double>(k * 2 + i);
+		s.ask_price[i] = static_cast<double>(k + 1 + i);
+		s.ask_amount[i] = static_cast<double>(k * 3 + i);
+	}
+}
+
+static bool whole(const BookSnapshot& s){
+	int64_t k = s.change_id;
+	if(s.exchange_ts_ms != k || s.bid_levels != BookSnapshot::DEPTH || s.ask_levels != BookSnapshot::DEPTH) return false;
+	for(int i = 0; i < BookSnapshot::DEPTH; i++){
+		if(s.bid_price[i] != static_cast<double>(k - i) || s.bid_amount[i] != static_cast<double>(k * 2 + i)
+			|| s.ask_price[i] != static_cast<double>(k + 1 + i) || s.ask_amount[i] != static_cast<double>(k * 3 + i)) return false;
+	}
+	return true;
+}
+
+// Writer process: `count` publishes on slot 0, `gap_us` apart (0: back to back)
+static pid_t spawn_writer(const std::string& name, int64_t count, int gap_us){
+	pid_t pid = fork();
+	if(pid != 0) return pid;
+	MarketDataPublisher pub;
+	if(pub.open(name, 16)) _exit(1);
+	BookSnapshot snap;
+	for(int64_t k = 1; k <= count; k++){
+		fill(snap, k);
+		if(gap_us){
+			Clock::time_point until = Clock::now() + std::chrono::microseconds(gap_us);
+			while(Clock::now() < until) {}
+		}
+		pub.publish(0, snap);
+		// Paced: let a reader sharing the core see it
+		if(gap_us) sched_yield();
+	}
+	_exit(0);
+}
+
+static int check_torn(const std::string& name, int64_t publishes){
+	// The region exists before the reader attaches
+	MarketDataPublisher pub;
+	if(pub.open(name, 16)) return 1;
+	MarketDataReader reader;
+	if(reader.open(name)) return 1;
+	pid_t pid = spawn_writer(name, publishes, 0);
+	uint64_t reads = 0, busy = 0, torn = 0, empty = 0;
+	int64_t last = 0, backwards = 0;
+	BookSnapshot snap;
+	while(waitpid(pid, nullptr, WNOHANG) == 0){
+		int rc = reader.read(0, snap);
+		if(rc == 2){ busy++; continue; }
+		if(rc == 1){ empty++; continue; }
+		reads++;
+		if(!whole(snap)) torn++;
+		if(snap.change_id < last) backwards++;
+		last = snap.change_id;
+	}
+	bool ok = torn == 0 && backwards == 0 && reads > 0;
+	std::printf("torn      %lld publishes, %llu reads (last saw %lld), %llu busy, %llu before the first publish, %llu torn, %lld out of order %s\n",
+		static_cast<long long>(publishes), static_cast<unsigned long long>(reads), static_cast<long long>(last),
+		static_cast<unsigned long long>(busy), static_cast<unsigned long long>(empty), static_cast<unsigned long long>(torn),
+		static_cast<long long>(backwards), ok ? "ok" : "FAILED");
+	return ok ? 0 : 1;
+}
+
+static int check_latency(const std::string& name, int64_t samples, int gap_us){
+	MarketDataPublisher pub;
+	if(pub.open(name, 16)) return 1;
+	MarketDataReader reader;
+	if(reader.open(name)) return 1;
+	pid_t pid = spawn_writer(name, samples, gap_us);
+	std::vector<double> us;
+	us.reserve(static_cast<size_t>(samples));
+	uint64_t seen = reader.version(0);
+	BookSnapshot snap;
+	while(waitpid(pid, nullptr, WNOHANG) == 0){
+		uint64_t v = reader.version(0);
+		if(v == seen || (v & 1)) continue;
+		seen = v;
+		if(reader.read(0, snap) == 0) us.push_back(static_cast<double>(realtime_ns() - snap.publish_ns) / 1000.0);
+	}
+	if(us.empty()) return 1;
+	std::sort(us.begin(), us.end());
+	std::printf("latency   %zu of %lld publishes seen, publish -> copied p50 %.2f us, p99 %.2f us, max %.1f us\n",
+		us.size(), static_cast<long long>(samples), us[us.size() / 2], us[us.size() * 99 / 100], us.back());
+	return 0;
+}
+
+static int check_dead_writer(const std::string& name){
+	MarketDataPublisher pub;
+	if(pub.open(name, 16)) return 1;
+	BookSnapshot snap;
+	fill(snap, 1);
+	pub.publish(1, snap);
+	MarketDataReader reader;
+	if(reader.open(name)) return 1;
+
+	// A writer killed between the two sequence stores leaves the slot odd
+	pid_t pid = fork();
+	if(pid == 0){
+		int fd = shm_open(name.c_str(), O_RDWR, 0);
+		void* p = mmap(nullptr, sizeof(BusHeader) + 16 * sizeof(BookSlot), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		BookSlot* slots = reinterpret_cast<BookSlot*>(static_cast<char*>(p) + sizeof(BusHeader));
+		slots[1].seq.fetch_add(1);
+		std::memset(slots[1].data.bid_price, 0xff, sizeof(slots[1].data.bid_price));
+		raise(SIGKILL);
+	}
+	int status = 0;
+	waitpid(pid, &status, 0);
+
+	Clock::time_point t = Clock::now();
+	int rc = reader.read(1, snap);
+	double us = std::chrono::duration<double, std::micro>(Clock::now() - t).count();
+	int other = reader.read(0, snap);
+	bool ok = rc == 2 && other == 1;
+	std::printf("dead      slot left mid-publish: read() %d (busy) after %.1f us, other slots unaffected %s\n", rc, us, ok ? "ok" : "FAILED");
+	return ok ? 0 : 1;
+}
+
+static int check_shrink(const std::string& name){
+	BookSnapshot snap;
+	MarketDataReader reader;
+	size_t before = 0;
+	{
+		MarketDataPublisher big;
+		if(big.open(name, 4096)) return 1;
+		fill(snap, 7);
+		big.publish(4000, snap);
+		if(reader.open(name)) return 1;
+		struct stat st;
+		int fd = shm_open(name.c_str(), O_RDONLY, 0);
+		fstat(fd, &st);
+		close(fd);
+		before = static_cast<size_t>(st.st_size);
+	}
+	// A new run with fewer instruments, the reader is still attached
+	MarketDataPublisher small;
+	if(small.open(name, 16)) return 1;
+	struct stat st;
+	int fd = shm_open(name.c_str(), O_RDONLY, 0);
+	fstat(fd, &st);
+	close(fd);
+	int stale = reader.read(4000, snap);
+	fill(snap, 9);
+	small.publish(3, snap);
+	int fresh = reader.read(3, snap);
+	bool ok = static_cast<size_t>(st.st_size) == before && stale == 1 && fresh == 0 && snap.change_id == 9;
+	std::printf("shrink    region %zu -> %zu bytes, old reader: slot 4000 read() %d (never published), slot 3 read() %d %s\n",
+		before, static_cast<size_t>(st.st_size), stale, fresh, ok ? "ok" : "FAILED");
+	return ok ? 0 : 1;
+}
+
+int main(int argc, char* argv[]){
+	int64_t publishes = argc > 1 ? std::atoll(argv[1]) : 2000000;
+	int64_t samples = argc > 2 ? std::atoll(argv[2]) : 20000;
+	int gap_us = argc > 3 ? std::atoi(argv[3]) : 20;
+
+	std::string name = "/hft_md_test_" + std::to_string(getpid());
+	int status = check_torn(name, publishes);
+	status |= check_latency(name, samples, gap_us);
+	status |= check_dead_writer(name);
+	shm_unlink(name.c_str());
+	status |= check_shrink(name);
+	shm_unlink(name.c_str());
+	std::printf("%s\n", status ? "FAILED" : "all checks passed");
+	return status;
+}
@@ -0,0 +1,73 @@
+// Hot path memory benchmark: price levels inserted and removed in a book
+// (std::map nodes, as OrderBook keeps them) while the book grows to
+// `levels` levels, the first minutes of a session on a wide book.
+//   heap    default allocator, no setup: nodes land on fresh heap pages
+//   arena   setup_memory(): nodes from the locked, prefaulted process arena
+// Each mode runs in its own process so fault counts do not mix. For each:
+//   faults  minor page faults taken during the updates (after setup)
+//   update  latency of one level insert / remove
+//
+// usage: ./test_memory.exe [levels] [updates]
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <map>
+#include <random>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "Histogram.hpp"
+#include "HugeArena.hpp"
+#include "Logger.hpp"
+
+static int64_t mono_ns(){
+	timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ll + ts.tv_nsec;
+}
+
+template<typename Book>
+static void run(const char* mode, size_t levels, size_t updates){
+	Book book;
+	std::mt19937_64 rng(42);
+	Histogram update;
+	PageFaults start = page_faults();
+	for(size_t i = 0; i < updates; i++){
+		// Grows towards `levels`, one removal for every three inserts
+		int64_t tick = static_cast<int64_t>(rng() % (levels * 4 / 3));
+		int64_t t0 = mono_ns();
+		if(i % 4 == 3) book.erase(tick);
+		else book[tick] = static_cast<double>(i);
+		update.record(mono_ns() - t0);
+	}
+	PageFaults end = page_faults();
+	std::printf("%-6s %zu levels  faults %7ld minor %3ld major  update p50 %6lu ns  p99 %7lu ns  p99.9 %8lu ns  max %9lu ns\n",
+		mode, book.size(), end.minor - start.minor, end.major - start.major,
+		update.percentile(50), update.percentile(99), update.percentile(99.9), update.max());
+}
+
+int main(int argc, char** argv){
+	size_t levels = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 200000;
+	size_t updates = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 1000000;
+	using Level = std::pair<const int64_t, double>;
+
+	std::printf("%zu updates, book growing to %zu levels\n", updates, levels);
+	std::fflush(stdout);
+	if(fork() == 0){
+		run<std::map<int64_t, double>>("heap", levels, updates);
+		return 0;
+	}
+	wait(nullptr);
+	if(fork() == 0){
+		Logger::instance().start("memory.log");
+		setup_memory(64 * 1024 * 1024, 256 * 1024);
+		HugeArena& arena = HugeArena::instance();
+		std::printf("arena  %zu MB on %s, %s\n", arena.capacity() >> 20, HugeArena::name(arena.backing()),
+			arena.locked() ? "locked" : "not locked");
+		run<std::map<int64_t, double, std::less<int64_t>, ArenaAllocator<Level>>>("arena", levels, updates);
+		Logger::instance().stop();
+		return 0;
+	}
+	wait(nullptr);
+	return 0;
+}
@@ -0,0 +1,175 @@
+// Option chain check and benchmark
+//   reference   S = K = 100, T = 1, sigma = 0.2, r = 0: the textbook call
+//               (7.9656, delta 0.5398) and put, and the implied vol read
+//               back from the call's price
+//   chain       `options` random calls and puts (moneyness 0.6 - 1.4, 2
+//               weeks to 2 years, vols 15% - 150%) priced by the vector
+//               kernel against a scalar Black-Scholes, then their implied
+//               vols solved from the reference prices
+//   timing      reprice_all() of the chain, implied vols included
+//
+// usage: ./test_options.exe [options] [runs] [threads]
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <random>
+#include <string>
+#include <vector>
+#include "risk_management/OptionChain.hpp"
+
+using Clock = std::chrono::steady_clock;
+
+static constexpr double MS_PER_YEAR = 365.0 * 24 * 3600 * 1000;
+
+struct Greeks{
+	double price, delta, gamma, vega, theta;
+};
+
+// Scalar Black-Scholes in the chain's conventions (vega per vol point, theta per day)
+static Greeks black_scholes(double S, double K, double T, double sigma, double r, bool put){
+	double vs = sigma * std::sqrt(T);
+	double d1 = (std::log(S / K) + (r + 0.5 * sigma * sigma) * T) / vs;
+	double d2 = d1 - vs;
+	double nd1 = 0.5 * std::erfc(-d1 / std::sqrt(2.0));
+	double nd2 = 0.5 * std::erfc(-d2 / std::sqrt(2.0));
+	double pdf = std::exp(-0.5 * d1 * d1) / std::sqrt(2.0 * M_PI);
+	double kdf = K * std::exp(-r * T);
+	double call = S * nd1 - kdf * nd2;
+	double theta_call = -S * pdf * sigma / (2.0 * std::sqrt(T)) - r * kdf * nd2;
+	Greeks g;
+	g.price = put ? call - S + kdf : call;
+	g.delta = put ? nd1 - 1.0 : nd1;
+	g.gamma = pdf / (S * vs);
+	g.vega = S * pdf * std::sqrt(T) / 100.0;
+	g.theta = (put ? theta_call + r * kdf : theta_call) / 365.0;
+	return g;
+}
+
+// Deribit name of an option expiring `days` after 1 Jan 2030, 08:00 UTC
+static std::string option_name(int days, double strike, bool put, int64_t& expiry_ms){
+	static const char* const months[] = {"JAN","FEB","MAR","APR","MAY","JUN","JUL","AUG","SEP","OCT","NOV","DEC"};
+	time_t t = 1893456000 + static_cast<time_t>(days) * 86400 + 8 * 3600; // 2030-01-01
+	tm utc;
+	gmtime_r(&t, &utc);
+	expiry_ms = static_cast<int64_t>(t) * 1000;
+	char name[64];
+	std::snprintf(name, sizeof(name), "BTC-%d%s%02d-%d-%c", utc.tm_mday, months[utc.tm_mon], utc.tm_year % 100,
+		static_cast<int>(strike), put ? 'P' : 'C');
+	return name;
+}
+
+static bool near(double got, double want, double tol){
+	return std::fabs(got - want) <= tol;
+}
+
+static int check_reference(){
+	OptionChain chain(0.0, 1);
+	int64_t expiry_ms = 0;
+	int call = chain.add(option_name(365, 100, false, expiry_ms));
+	int put = chain.add(option_name(365, 100, true, expiry_ms));
+	int64_t now = expiry_ms - static_cast<int64_t>(MS_PER_YEAR); // T = 1
+	chain.set_market(call, 100, 0, 0.2);
+	chain.set_market(put, 100, 0, 0.2);
+	chain.reprice(now);
+	const OptionChain::Columns& c = chain.columns();
+	Greeks ref = black_scholes(100, 100, 1, 0.2, 0, false);
+	bool ok = near(c.price[call], 7.9656, 5e-5) && near(c.delta[call], 0.5398, 5e-5)
+		&& near(c.price[put], 7.9656, 5e-5) && near(c.delta[put], -0.4602, 5e-5)
+		&& near(c.gamma[call], ref.gamma, 1e-12) && near(c.vega[call], ref.vega, 1e-10) && near(c.theta[call], ref.theta, 1e-12);
+	std::printf("reference call %.4f delta %.4f gamma %.6f vega %.5f theta %.6f, put %.4f delta %.4f\n",
+		c.price[call], c.delta[call], c.gamma[call], c.vega[call], c.theta[call], c.price[put], c.delta[put]);
+
+	// The vol back from the price, the solver seeded away from it
+	double price = c.price[call];
+	chain.set_market(call, 100, price, 0.9);
+	chain.reprice(now);
+	ok = ok && near(c.iv[call], 0.2, 1e-9);
+	std::printf("reference implied vol from %.6f: %.9f %s\n", price, c.iv[call], ok ? "ok" : "FAILED");
+	return ok ? 0 : 1;
+}
+
+struct Case{
+	double spot, strike, T, sigma;
+	bool put;
+};
+
+static int check_chain(OptionChain& chain, std::vector<Case>& cases, int64_t& now, size_t options){
+	std::mt19937_64 rng(42);
+	std::uniform_real_distribution<double> moneyness(0.6, 1.4), vol(0.15, 1.5);
+	std::uniform_int_distribution<int> days(14, 730);
+	now = 1893456000000; // 2030-01-01 00:00 UTC
+	for(size_t i = 0; cases.size() < options && i < options * 4; i++){
+		double spot = 60000;
+		double strike = std::round(spot * moneyness(rng) / 100) * 100;
+		int64_t expiry_ms;
+		std::string name = option_name(days(rng), strike, i & 1, expiry_ms);
+		if(chain.index(name) >= 0) continue;
+		int id = chain.add(name);
+		if(id < 0) return 1;
+		Case k{spot, strike, (static_cast<double>(expiry_ms) - static_cast<double>(now)) / MS_PER_YEAR, vol(rng), (i & 1) != 0};
+		chain.set_market(static_cast<size_t>(id), spot, 0, k.sigma);
+		cases.push_back(k);
+	}
+	chain.reprice_all(now);
+	const OptionChain::Columns& c = chain.columns();
+	double err_price = 0, err_delta = 0, err_gamma = 0, err_vega = 0, err_theta = 0;
+	for(size_t i = 0; i < cases.size(); i++){
+		const Case& k = cases[i];
+		Greeks g = black_scholes(k.spot, k.strike, k.T, k.sigma, 0, k.put);
+		err_price = std::max(err_price, std::fabs(c.price[i] - g.price) / k.spot);
+		err_delta = std::max(err_delta, std::fabs(c.delta[i] - g.delta));
+		err_gamma = std::max(err_gamma, std::fabs(c.gamma[i] - g.gamma) * k.spot);
+		err_vega = std::max(err_vega, std::fabs(c.vega[i] - g.vega) / k.spot);
+		err_theta = std::max(err_theta, std::fabs(c.theta[i] - g.theta) / k.spot);
+	}
+	bool ok = std::max({err_price, err_delta, err_gamma, err_vega, err_theta}) < 1e-9;
+	std::printf("chain     %zu options, largest error against scalar (per unit of spot): price %.1e delta %.1e gamma %.1e vega %.1e theta %.1e %s\n",
+		cases.size(), err_price, err_delta, err_gamma, err_vega, err_theta, ok ? "ok" : "FAILED");
+
+	// Implied vols from the reference prices, seeded at 50%
+	double err_iv = 0;
+	size_t solved = 0;
+	for(size_t i = 0; i < cases.size(); i++){
+		const Case& k = cases[i];
+		Greeks g = black_scholes(k.spot, k.strike, k.T, k.sigma, 0, k.put);
+		// Far out of the money the price carries no vol information left
+		if(g.vega < 1e-4 * k.spot) continue;
+		chain.set_market(i, k.spot, g.price, 0.5);
+		solved++;
+	}
+	chain.reprice(now);
+	for(size_t i = 0; i < cases.size(); i++){
+		const Case& k = cases[i];
+		if(c.market[i] > 0) err_iv = std::max(err_iv, std::fabs(c.iv[i] - k.sigma));
+	}
+	bool iv_ok = err_iv < 1e-6;
+	std::printf("chain     %zu implied vols read back, largest error %.1e %s\n", solved, err_iv, iv_ok ? "ok" : "FAILED");
+	return ok && iv_ok ? 0 : 1;
+}
+
+int main(int argc, char* argv[]){
+	size_t options = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 5000;
+	int runs = argc > 2 ? std::atoi(argv[2]) : 200;
+	unsigned threads = argc > 3 ? static_cast<unsigned>(std::atoi(argv[3])) : 0;
+
+	int status = check_reference();
+	OptionChain chain(0.0, threads);
+	std::vector<Case> cases;
+	int64_t now;
+	status |= check_chain(chain, cases, now, options);
+
+	std::vector<double> us;
+	for(int r = 0; r < runs; r++){
+		Clock::time_point t = Clock::now();
+		chain.reprice_all(now + r);
+		us.push_back(std::chrono::duration<double, std::micro>(Clock::now() - t).count());
+	}
+	std::sort(us.begin(), us.end());
+	std::printf("timing    reprice_all of %zu options (%zu with implied vols), %u threads: p50 %.0f us, p99 %.0f us\n",
+		cases.size(), static_cast<size_t>(std::count_if(chain.columns().market.begin(), chain.columns().market.end(), [](double m){ return m > 0; })),
+		threads ? threads : std::max(1u, std::thread::hardware_concurrency()), us[us.size() / 2], us[us.size() * 99 / 100]);
+	return status;
+}
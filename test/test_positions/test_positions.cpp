@@ -0,0 +1,139 @@
+// Position keeper check and benchmark
+//   linear    adds at two prices, a partial close with a fee, a flip through
+//             zero and a mark on the new short, on an option
+//   inverse   the same on BTC-PERPETUAL: harmonic entry, PnL in the coin and
+//             a maker rebate
+//   feed      user.trades / ticker payloads, a replayed trade_seq, and the
+//             instruments classed as inverse or linear
+//   timing    apply_fill + apply_mark over `instruments` instruments
+//
+// usage: ./test_positions.exe [fills] [instruments]
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include "oms/PositionKeeper.hpp"
+
+using Clock = std::chrono::steady_clock;
+
+static int failures = 0;
+
+static void expect(const char* what, double got, double want, double tol = 1e-9){
+	bool ok = std::fabs(got - want) <= tol * std::fmax(1.0, std::fabs(want));
+	if(!ok) failures++;
+	std::printf("  %-36s %16.10f  want %16.10f %s\n", what, got, want, ok ? "ok" : "FAILED");
+}
+
+static void check_linear(){
+	std::printf("linear (BTC-27DEC24-100000-C)\n");
+	PositionKeeper keeper;
+	const std::string inst = "BTC-27DEC24-100000-C";
+	keeper.apply_fill(inst, true, 0.0100, 2, 0.0003, 1, 1);
+	keeper.apply_fill(inst, true, 0.0110, 2, 0.0003, 2, 2);
+	const Position* p = keeper.find(inst);
+	expect("size after two buys", p->size, 4);
+	expect("average entry", p->avg_price, 0.0105);
+	expect("fees", p->fees, 0.0006);
+	keeper.apply_mark(inst, 0.0120);
+	expect("unrealized at 0.0120", p->unrealized_pnl, 4 * 0.0015);
+
+	// Partial close: 3 out of 4 at 0.0115, the entry stays
+	keeper.apply_fill(inst, false, 0.0115, 3, 0.0003, 3, 3);
+	expect("size after partial close", p->size, 1);
+	expect("entry kept", p->avg_price, 0.0105);
+	expect("realized less fees", p->realized_pnl, 3 * 0.0010 - 0.0009);
+
+	// Sell 3 at 0.0090: closes 1 at a loss, opens 2 short at the fill price
+	keeper.apply_fill(inst, false, 0.0090, 3, 0.0003, 4, 4);
+	expect("size after flip", p->size, -2);
+	expect("entry of the new short", p->avg_price, 0.0090);
+	expect("realized after flip", p->realized_pnl, 3 * 0.0010 - 1 * 0.0015 - 0.0012);
+	keeper.apply_mark(inst, 0.0080);
+	expect("unrealized of the short at 0.0080", p->unrealized_pnl, 2 * 0.0010);
+
+	// Buy back exactly: flat, no entry, nothing unrealized
+	keeper.apply_fill(inst, true, 0.0085, 2, 0, 5, 5);
+	expect("size when flat", p->size, 0);
+	expect("entry when flat", p->avg_price, 0);
+	expect("unrealized when flat", p->unrealized_pnl, 0);
+	expect("realized total", p->realized_pnl, 3 * 0.0010 - 0.0015 + 2 * 0.0005 - 0.0012);
+}
+
+static void check_inverse(){
+	std::printf("inverse (BTC-PERPETUAL)\n");
+	PositionKeeper keeper;
+	const std::string inst = "BTC-PERPETUAL";
+	keeper.apply_fill(inst, true, 50000, 10000, 0.00001, 1, 1);
+	keeper.apply_fill(inst, true, 40000, 10000, 0.00001, 2, 2);
+	const Position* p = keeper.find(inst);
+	// 20000 USD bought with 0.2 + 0.25 BTC
+	expect("harmonic entry", p->avg_price, 20000 / 0.45);
+	keeper.apply_mark(inst, 50000);
+	expect("unrealized in BTC at 50000", p->unrealized_pnl, 0.45 - 0.4);
+
+	// Sell 30000 at 60000 with a maker rebate: closes 20000, opens 10000 short
+	keeper.apply_fill(inst, false, 60000, 30000, -0.00002, 3, 3);
+	expect("size after flip", p->size, -10000);
+	expect("entry of the new short", p->avg_price, 60000);
+	expect("fees net of the rebate", p->fees, 0);
+	expect("realized in BTC", p->realized_pnl, 0.45 - 20000.0 / 60000);
+	keeper.apply_mark(inst, 48000);
+	expect("unrealized of the short at 48000", p->unrealized_pnl, -10000 * (1.0 / 60000 - 1.0 / 48000));
+}
+
+static void check_feed(){
+	std::printf("feed\n");
+	PositionKeeper keeper;
+	nlohmann::json trades = nlohmann::json::parse(R"([
+		{"instrument_name":"ETH-PERPETUAL","direction":"buy","price":2000,"amount":100,"fee":0.0001,"trade_seq":7,"timestamp":1000},
+		{"instrument_name":"ETH-PERPETUAL","direction":"sell","price":2500,"amount":40,"fee":0,"trade_seq":8,"timestamp":1001}
+	])");
+	keeper.on_trades(trades);
+	// The same batch again, as after a resubscribe
+	keeper.on_trades(trades);
+	const Position* p = keeper.find("ETH-PERPETUAL");
+	expect("size, replayed batch ignored", p->size, 60);
+	expect("realized in ETH", p->realized_pnl, 40 * (1.0 / 2000 - 1.0 / 2500) - 0.0001);
+	keeper.on_ticker(nlohmann::json::parse(R"({"instrument_name":"ETH-PERPETUAL","mark_price":2400})"));
+	expect("unrealized from the ticker", p->unrealized_pnl, 60 * (1.0 / 2000 - 1.0 / 2400));
+	keeper.on_ticker(nlohmann::json::parse(R"({"instrument_name":"BTC-PERPETUAL","mark_price":60000})"));
+	bool ok = keeper.find("BTC-PERPETUAL") == nullptr;
+	if(!ok) failures++;
+	std::printf("  %-36s %s\n", "no position from a mark alone", ok ? "ok" : "FAILED");
+
+	struct{ const char* inst; bool inverse; } kinds[] = {
+		{"BTC-PERPETUAL", true}, {"ETH-27DEC24", true}, {"BTC-27DEC24-100000-C", false},
+		{"ETH-27DEC24-3000-P", false}, {"SOL_USDC-PERPETUAL", false}, {"BTC_USDC", false},
+	};
+	for(const auto& k : kinds){
+		bool got = PositionKeeper::is_inverse(k.inst);
+		if(got != k.inverse) failures++;
+		std::printf("  %-36s %s %s\n", k.inst, got ? "inverse" : "linear", got == k.inverse ? "ok" : "FAILED");
+	}
+}
+
+int main(int argc, char* argv[]){
+	size_t fills = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 2000000;
+	size_t instruments = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 100;
+
+	check_linear();
+	check_inverse();
+	check_feed();
+
+	PositionKeeper keeper;
+	std::vector<std::string> names;
+	for(size_t i = 0; i < instruments; i++) names.push_back("BTC-27DEC24-" + std::to_string(20000 + i * 500) + "-C");
+	Clock::time_point t = Clock::now();
+	for(size_t i = 0; i < fills; i++){
+		const std::string& inst = names[i % instruments];
+		keeper.apply_fill(inst, (i & 3) != 0, 0.01 + (i & 7) * 0.0005, 1 + (i & 1), 0.0003, i + 1, static_cast<int64_t>(i));
+		keeper.apply_mark(inst, 0.012);
+	}
+	double ns = std::chrono::duration<double, std::nano>(Clock::now() - t).count() / static_cast<double>(fills);
+	std::printf("timing    %zu fills + marks over %zu instruments: %.1f ns each\n", fills, instruments, ns);
+
+	std::printf("%s\n", failures ? "FAILED" : "all checks passed");
+	return failures ? 1 : 0;
+}
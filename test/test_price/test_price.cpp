@@ -0,0 +1,166 @@
+// Decimal price check and benchmark
+//   round trip  format_decimal / parse_decimal over tick and lot sizes seen
+//               on Deribit: every value parses back to the same step count,
+//               and the text matches printf's for the same decimals
+//   parse       off grid, malformed and padded inputs, and values that
+//               only overflow once scaled to the grid
+//   tick steps  Instrument::snap on an option with tick_size_steps
+//               (0.0001, 0.0005 above 0.005) and a made up grid with two coarser bands
+//   timing      format_decimal against snprintf("%.*f")
+//
+// usage: ./test_price.exe [values]
+#include <chrono>
+#include <cmath>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+#include <nlohmann/json.hpp>
+#include "market_data/Instruments.hpp"
+
+using Clock = std::chrono::steady_clock;
+
+static int failures = 0;
+
+static void report(bool ok, const char* fmt, ...) __attribute__((format(printf, 2, 3)));
+static void report(bool ok, const char* fmt, ...){
+	if(!ok) failures++;
+	va_list args;
+	va_start(args, fmt);
+	std::vprintf(fmt, args);
+	va_end(args);
+	std::printf(" %s\n", ok ? "ok" : "FAILED");
+}
+
+static void check_round_trip(size_t values){
+	static const double steps[] = {0.5, 0.05, 0.0001, 0.0005, 2.5, 10, 1, 0.001, 0.000001, 25, 0.1};
+	std::mt19937_64 rng(7);
+	for(double step : steps){
+		Scale s = Scale::from_double(step);
+		std::uniform_int_distribution<int64_t> dist(-2000000000, 2000000000);
+		size_t bad = 0, mismatch = 0;
+		for(size_t i = 0; i < values; i++){
+			// Small counts and the 18 digit extremes as well as random ones
+			int64_t top = 999999999999999999 / s.mantissa;
+			int64_t n = i < 64 ? static_cast<int64_t>(i) - 32 : (i < 66 ? (i == 64 ? top : -top) : dist(rng));
+			char buf[32];
+			char* end = format_decimal(buf, buf + sizeof(buf), n, s);
+			int64_t back = 0;
+			if(!end || parse_decimal(buf, end, s, back) || back != n){
+				bad++;
+				continue;
+			}
+			// Same text as printf, trailing fractional zeros aside
+			if(i >= 64 && i < 66) continue; // beyond a double's precision
+			char ref[48];
+			int len = std::snprintf(ref, sizeof(ref), "%.*f", s.decimals, Price(n).to_double(s));
+			while(s.decimals && ref[len - 1] == '0') len--;
+			if(ref[len - 1] == '.') len--;
+			if(std::string_view(ref, static_cast<size_t>(len)) == "-0") len = 1, ref[0] = '0';
+			if(std::string_view(buf, static_cast<size_t>(end - buf)) != std::string_view(ref, static_cast<size_t>(len))) mismatch++;
+		}
+		report(bad == 0 && mismatch == 0, "round trip  step %-9g %zu values, %zu not read back, %zu unlike printf", step, values, bad, mismatch);
+	}
+	// A buffer one short of the text is refused, never overrun
+	char small[8];
+	std::memset(small, 'x', sizeof(small));
+	char* end = format_decimal(small, small + 6, 1234567, Scale::from_double(0.5));
+	report(end == nullptr && small[0] == 'x', "round trip  short buffer refused");
+}
+
+static void check_parse(){
+	Scale tick = Scale::from_double(0.5);
+	struct{ const char* text; int rc; int64_t steps; } cases[] = {
+		{"65432.5", 0, 130865}, {"65432.50000", 0, 130865}, {"+1", 0, 2}, {"-0.5", 0, -1},
+		{"0", 0, 0}, {".5", 0, 1}, {"3.", 0, 6},
+		{"65432.25", 1, 0}, {"65432.51", 1, 0}, {"", 1, 0}, {"-", 1, 0}, {".", 1, 0},
+		{"1e3", 1, 0}, {"1.2.3", 1, 0}, {" 1", 1, 0}, {"1234567890123456789", 1, 0},
+	};
+	for(const auto& c : cases){
+		int64_t out = 0;
+		int rc = parse_decimal(c.text, c.text + std::strlen(c.text), tick, out);
+		report(rc == c.rc && (rc || out == c.steps), "parse       \"%s\" at 0.5: rc %d steps %lld", c.text, rc, static_cast<long long>(out));
+	}
+	// 18 digits that only overflow once scaled to the grid's 8 decimals
+	Scale fine{1, 8};
+	struct{ const char* text; int rc; int64_t steps; } scaled[] = {
+		{"99999999999999.9999", 1, 0}, {"9999999999.99999999", 0, 999999999999999999}, {"0.00000001", 0, 1},
+		{"0000000000000000000.5", 0, 50000000},
+	};
+	for(const auto& c : scaled){
+		int64_t out = 0;
+		int rc = parse_decimal(c.text, c.text + std::strlen(c.text), fine, out);
+		report(rc == c.rc && (rc || out == c.steps), "parse       \"%s\" at 1e-8: rc %d steps %lld", c.text, rc, static_cast<long long>(out));
+	}
+}
+
+static void check_tick_steps(){
+	Instruments instruments;
+	instruments.load_json(R"({"result":[
+		{"instrument_name":"BTC-27DEC24-100000-C","kind":"option","tick_size":0.0001,"contract_size":1,"min_trade_amount":0.1,
+		 "tick_size_steps":[{"above_price":0.005,"tick_size":0.0005}]},
+		{"instrument_name":"BTC-BANDS","kind":"future","tick_size":0.5,"contract_size":10,
+		 "tick_size_steps":[{"above_price":1000,"tick_size":5},{"above_price":100,"tick_size":1},{"above_price":2000,"tick_size":0.3}]}
+	]})");
+	const Instrument& opt = instruments.get(instruments.id("BTC-27DEC24-100000-C"));
+	const Instrument& bands = instruments.get(instruments.id("BTC-BANDS"));
+	// The 0.3 step is not a multiple of the 0.5 base tick and is dropped
+	report(opt.tick_step_count == 1 && bands.tick_step_count == 2 && bands.tick_steps[0].above == 200,
+		"tick steps  parsed %u and %u bands", opt.tick_step_count, bands.tick_step_count);
+
+	struct{ const Instrument* ins; double price; Price::Round r; double want; } cases[] = {
+		{&opt, 0.0037, Price::NEAREST, 0.0037},  // fine band
+		{&opt, 0.0050, Price::NEAREST, 0.0050},  // the level itself is in the fine band
+		{&opt, 0.0052, Price::NEAREST, 0.0050},
+		{&opt, 0.0053, Price::NEAREST, 0.0055},
+		{&opt, 0.0123, Price::DOWN, 0.0120},
+		{&opt, 0.0121, Price::UP, 0.0125},
+		{&opt, 0.0125, Price::UP, 0.0125},
+		{&bands, 99.5, Price::NEAREST, 99.5},
+		{&bands, 100.5, Price::DOWN, 100},
+		{&bands, 100.5, Price::UP, 101},
+		{&bands, 999.5, Price::UP, 1000},
+		{&bands, 1000.5, Price::UP, 1005},       // into the coarsest band
+		{&bands, 1002.5, Price::NEAREST, 1005},
+		{&bands, 1001.5, Price::DOWN, 1000},
+	};
+	for(const auto& c : cases){
+		Price p = c.ins->to_price(c.price, c.r);
+		double got = p.to_double(c.ins->price_scale);
+		char text[32];
+		char* end = format_decimal(text, text + sizeof(text), p, c.ins->price_scale);
+		report(std::fabs(got - c.want) < 1e-12 && end, "tick steps  %-22s %-8g %-7s -> %.*s",
+			std::string(c.ins->name_view()).c_str(), c.price, c.r == Price::UP ? "up" : (c.r == Price::DOWN ? "down" : "nearest"),
+			static_cast<int>(end ? end - text : 0), text);
+	}
+}
+
+int main(int argc, char* argv[]){
+	size_t values = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+
+	check_round_trip(values);
+	check_parse();
+	check_tick_steps();
+
+	// Timing over option prices
+	Scale s = Scale::from_double(0.0005);
+	std::vector<int64_t> ns(values);
+	std::mt19937_64 rng(11);
+	std::uniform_int_distribution<int64_t> dist(1, 2000);
+	for(int64_t& n : ns) n = dist(rng);
+	char buf[32];
+	size_t sink = 0;
+	Clock::time_point t = Clock::now();
+	for(int64_t n : ns) sink += static_cast<size_t>(format_decimal(buf, buf + sizeof(buf), n, s) - buf);
+	double fmt_ns = std::chrono::duration<double, std::nano>(Clock::now() - t).count() / static_cast<double>(values);
+	t = Clock::now();
+	for(int64_t n : ns) sink += static_cast<size_t>(std::snprintf(buf, sizeof(buf), "%.*f", s.decimals, Price(n).to_double(s)));
+	double printf_ns = std::chrono::duration<double, std::nano>(Clock::now() - t).count() / static_cast<double>(values);
+	std::printf("timing      format_decimal %.1f ns, snprintf %.1f ns per price (%zu chars)\n", fmt_ns, printf_ns, sink);
+
+	std::printf("%s\n", failures ? "FAILED" : "all checks passed");
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,127 @@
+// Quote engine benchmark: a market maker quoting both sides around a mid
+// that moves a tick at a time, `rate` updates per second, against a
+// simulated exchange answering each request after `rtt` us.
+//   naive       private/edit of both orders on every update that changes them
+//   manager     QuoteManager, 1 tick threshold: one request in flight per
+//               order, updates meanwhile conflated to the latest
+//   manager-2   the same with a 2 tick threshold
+// For each: requests sent per 1000 updates, the update -> request split and
+// the time spent in quote(). Every request must carry the id handed to the
+// send callback, a new one each time.
+//
+// usage: ./test_quote.exe [updates] [rate] [rtt_us]
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <random>
+#include "Histogram.hpp"
+#include "Logger.hpp"
+#include "oms/QuoteManager.hpp"
+
+using Clock = std::chrono::steady_clock;
+
+// Replies in send order, each due `rtt_ns` after its request
+struct Exchange{
+	struct Pending{
+		uint64_t tag;
+		uint64_t id;
+		int64_t due_ns;
+		bool is_new;
+	};
+	int64_t rtt_ns;
+	int64_t now_ns = 0;
+	uint64_t next_tag = 1;
+	uint64_t next_order = 1;
+	uint64_t requests = 0;
+	uint64_t last_id = 0;
+	uint64_t bad_ids = 0; // ids not carried by their request, or not new
+	std::deque<Pending> pending;
+
+	uint64_t send(uint64_t id, const std::string& request){
+		requests++;
+		std::string tail = R"("id":)" + std::to_string(id) + '}';
+		if(id <= last_id || request.compare(request.size() - std::min(request.size(), tail.size()), std::string::npos, tail) != 0) bad_ids++;
+		last_id = id;
+		bool is_new = request.find("private/edit") == std::string::npos && request.find("private/cancel") == std::string::npos;
+		pending.push_back(Pending{next_tag, id, now_ns + rtt_ns, is_new});
+		return next_tag++;
+	}
+	template<typename F>
+	void deliver(F on_reply){
+		while(!pending.empty() && pending.front().due_ns <= now_ns){
+			Pending p = pending.front();
+			pending.pop_front();
+			std::string head = R"({"jsonrpc":"2.0","id":)" + std::to_string(p.id);
+			std::string reply = p.is_new
+				? head + R"(,"result":{"trades":[],"order":{"order_id":"SIM-)" + std::to_string(next_order++) + R"(","order_state":"open"}}})"
+				: head + R"(,"result":{"trades":[],"order":{"order_state":"open"}}})";
+			on_reply(p.tag, reply);
+		}
+	}
+};
+
+static void report(const char* name, size_t updates, uint64_t requests, const Histogram* cost, const QuoteManager::Stats* s){
+	std::printf("%-10s requests/1000 updates %7.1f", name, 1000.0 * requests / updates);
+	if(s){
+		std::printf("  new %lu edit %lu  conflated %lu  below threshold %lu  quote() p50 %4lu ns p99 %5lu ns",
+			static_cast<unsigned long>(s->sent_new), static_cast<unsigned long>(s->sent_edit),
+			static_cast<unsigned long>(s->conflated), static_cast<unsigned long>(s->below_threshold),
+			static_cast<unsigned long>(cost->percentile(50)), static_cast<unsigned long>(cost->percentile(99)));
+	}
+	std::printf("\n");
+}
+
+int main(int argc, char** argv){
+	size_t updates = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 200000;
+	double rate = argc > 2 ? std::atof(argv[2]) : 20000;
+	int64_t rtt_us = argc > 3 ? std::atoll(argv[3]) : 1000;
+	Logger::instance().start("test_quote.log");
+	Instruments instruments;
+	InstrumentId id = instruments.add("BTC-PERPETUAL", Instrument::FUTURE, 0.5, 10);
+	const Instrument& ins = instruments.get(id);
+	int64_t step_ns = static_cast<int64_t>(1e9 / rate);
+	Qty size = Qty::from_double(100, ins.qty_scale);
+
+	// Mid in ticks: a walk of single ticks, quotes 4 ticks either side
+	std::vector<int64_t> mids(updates);
+	std::mt19937_64 rng(7);
+	int64_t mid = 200000;
+	for(int64_t& m : mids){
+		int r = static_cast<int>(rng() % 4);
+		mid += r == 0 ? -1 : r == 1 ? 1 : 0;
+		m = mid;
+	}
+
+	std::printf("%zu updates at %.0f/s, exchange round trip %ld us\n", updates, rate, static_cast<long>(rtt_us));
+	// Every change of a quote becomes an edit of its order
+	{
+		uint64_t edits = 2;
+		for(size_t i = 1; i < updates; i++) if(mids[i] != mids[i - 1]) edits += 2;
+		report("naive", updates, edits, nullptr, nullptr);
+	}
+	int status = 0;
+	for(int64_t threshold : {1, 2}){
+		Exchange ex;
+		ex.rtt_ns = rtt_us * 1000;
+		QuoteManager quotes(instruments, [&](uint64_t rpc_id, const std::string& r){ return ex.send(rpc_id, r); });
+		quotes.set_threshold(id, threshold, 1);
+		Histogram cost;
+		for(size_t i = 0; i < updates; i++){
+			ex.now_ns = static_cast<int64_t>(i) * step_ns;
+			ex.deliver([&](uint64_t tag, const std::string& reply){ quotes.on_reply(tag, 0, reply); });
+			Clock::time_point t = Clock::now();
+			quotes.quote(id, QuoteManager::BID, Price(mids[i] - 4), size);
+			quotes.quote(id, QuoteManager::ASK, Price(mids[i] + 4), size);
+			cost.record(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - t).count());
+		}
+		report(threshold == 1 ? "manager" : "manager-2", updates, ex.requests, &cost, &quotes.stats());
+		bool ok = ex.bad_ids == 0;
+		if(!ok) status = 1;
+		std::printf("%-10s %lu requests, %lu without their own id %s\n", "", static_cast<unsigned long>(ex.requests),
+			static_cast<unsigned long>(ex.bad_ids), ok ? "ok" : "FAILED");
+	}
+	Logger::instance().stop();
+	return status;
+}
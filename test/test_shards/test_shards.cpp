@@ -0,0 +1,158 @@
+// Book update throughput over a large instrument universe (a few futures,
+// thousands of options), every frame a book.* notification
+//   inline   parse and apply on the I/O thread, one map of books (what
+//            Trader::on_notification did)
+//   shards   BookShards with 1, 2, 4 ... workers up to the cores given,
+//            the I/O thread only routes
+// For each: frames per second applied, and for the shards the I/O thread's
+// cost per frame and the deepest a shard's queue got. Every book must end
+// valid with no frame rejected. Workers are pinned to cpus 1.. when the
+// machine has a core for each of them and one for the I/O thread.
+//
+// usage: ./test_shards.exe [updates] [instruments] [max_shards]
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "HugeArena.hpp"
+#include "Logger.hpp"
+#include "market_data/BookShards.hpp"
+
+using Clock = std::chrono::steady_clock;
+
+static double seconds_since(Clock::time_point t){
+	return std::chrono::duration<double>(Clock::now() - t).count();
+}
+
+// Snapshot of 20 levels a side, then changes of a few levels chained by change_id
+static std::string book_msg(const std::string& name, size_t seq){
+	std::string msg = R"({"jsonrpc":"2.0","method":"subscription","params":{"channel":"book.)" + name
+		+ R"(.100ms","data":{"instrument_name":")" + name + R"(","timestamp":1700000000000,)";
+	int levels = 3;
+	if(seq == 0){
+		msg += R"("type":"snapshot","change_id":1,)";
+		levels = 20;
+	} else {
+		msg += R"("type":"change","change_id":)" + std::to_string(seq + 1) + R"(,"prev_change_id":)" + std::to_string(seq) + ",";
+	}
+	auto side = [&](const char* key, double base, double step){
+		msg += '"';
+		msg += key;
+		msg += R"(":[)";
+		for(int i = 0; i < levels; i++){
+			double price = base + step * static_cast<double>((seq * 7 + i * 3) % 40);
+			msg += seq == 0 ? R"(["new",)" : (i == 2 ? R"(["delete",)" : R"(["change",)");
+			msg += std::to_string(price) + "," + std::to_string(10.0 + static_cast<double>(seq % 13)) + "]";
+			if(i + 1 < levels) msg += ',';
+		}
+		msg += ']';
+	};
+	side("bids", 0.05, -0.0005);
+	msg += ',';
+	side("asks", 0.06, 0.0005);
+	msg += "}}}";
+	return msg;
+}
+
+struct Feed{
+	Instruments instruments;
+	std::vector<std::string> channels; // book.<name>.100ms by id
+	std::vector<std::pair<InstrumentId, std::string>> frames;
+};
+
+static void build(Feed& feed, size_t updates, size_t instruments){
+	for(size_t i = 0; i < instruments; i++){
+		// Futures first, then options
+		std::string name = i < 20 ? "FUT-" + std::to_string(i) : "BTC-27DEC24-" + std::to_string(20000 + i * 500) + (i % 2 ? "-C" : "-P");
+		feed.instruments.add(name, i < 20 ? Instrument::FUTURE : Instrument::OPTION, i < 20 ? 0.5 : 0.0005, i < 20 ? 10.0 : 0.1);
+		feed.channels.push_back("book." + name + ".100ms");
+	}
+	size_t per = std::max<size_t>(1, updates / instruments);
+	feed.frames.reserve(per * instruments);
+	for(size_t seq = 0; seq < per; seq++){
+		for(InstrumentId id = 0; id < instruments; id++){
+			feed.frames.emplace_back(id, book_msg(std::string(feed.instruments.get(id).name_view()), seq));
+		}
+	}
+}
+
+static void run_inline(const Feed& feed){
+	std::unordered_map<InstrumentId, OrderBook> books;
+	for(InstrumentId id = 0; id < feed.instruments.size(); id++){
+		books.emplace(id, OrderBook(feed.instruments.get(id).price_scale, feed.channels[id]));
+	}
+	uint64_t rejected = 0;
+	Clock::time_point start = Clock::now();
+	for(const auto& [id, msg] : feed.frames){
+		nlohmann::json obj = nlohmann::json::parse(msg);
+		auto it = books.find(id);
+		if(it->second.on_book(obj["params"]["data"], 0)) rejected++;
+	}
+	double s = seconds_since(start);
+	std::printf("%-10s %10.0f frames/s  io %8.0f ns/frame  queue max %5s  rejected %lu\n",
+		"inline", static_cast<double>(feed.frames.size()) / s, s * 1e9 / static_cast<double>(feed.frames.size()), "-", rejected);
+}
+
+static void run_shards(const Feed& feed, size_t shards, unsigned cores){
+	BookShards books;
+	int first_cpu = cores > shards ? 1 : -1;
+	if(books.start(feed.instruments, nullptr, shards, first_cpu)){
+		std::printf("shards %zu: start failed\n", shards);
+		return;
+	}
+	for(InstrumentId id = 0; id < feed.instruments.size(); id++){
+		books.add(id, OrderBook(feed.instruments.get(id).price_scale, feed.channels[id]));
+	}
+	Clock::time_point start = Clock::now();
+	for(const auto& [id, msg] : feed.frames){
+		if(books.route(id, msg)) std::abort();
+	}
+	double io = seconds_since(start);
+	uint64_t done = 0;
+	while(done < feed.frames.size()){
+		done = 0;
+		for(size_t i = 0; i < shards; i++) done += books.stats(i).updates;
+		if(done < feed.frames.size()) std::this_thread::yield();
+	}
+	double s = seconds_since(start);
+
+	uint64_t rejected = 0, full_waits = 0;
+	size_t depth_max = 0;
+	for(size_t i = 0; i < shards; i++){
+		BookShards::Stats st = books.stats(i);
+		rejected += st.rejected;
+		full_waits += st.full_waits;
+		depth_max = std::max(depth_max, st.depth_max);
+	}
+	size_t invalid = 0;
+	books.for_each([&](InstrumentId, const OrderBook& book){ if(!book.valid()) invalid++; });
+	char label[32];
+	std::snprintf(label, sizeof(label), "shards %zu", shards);
+	std::printf("%-10s %10.0f frames/s  io %8.0f ns/frame  queue max %5zu  rejected %lu  invalid %zu  full waits %lu%s\n",
+		label, static_cast<double>(feed.frames.size()) / s, io * 1e9 / static_cast<double>(feed.frames.size()),
+		depth_max, rejected, invalid, full_waits, first_cpu >= 0 ? "  pinned" : "");
+}
+
+int main(int argc, char* argv[]){
+	size_t updates = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 400000;
+	size_t instruments = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 2000;
+	unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+	size_t max_shards = argc > 3 ? std::strtoull(argv[3], nullptr, 10) : std::max(1u, cores - 1);
+	if(instruments == 0 || instruments > 100000 || max_shards == 0) return 1;
+
+	Logger::instance().start("test_shards.log");
+	setup_memory(256 * 1024 * 1024, 256 * 1024);
+	Feed feed;
+	build(feed, updates, instruments);
+	std::printf("%zu frames over %zu books, %u cores\n", feed.frames.size(), instruments, cores);
+
+	run_inline(feed);
+	for(size_t shards = 1; shards <= max_shards; shards *= 2) run_shards(feed, shards, cores);
+	if(max_shards & (max_shards - 1)) run_shards(feed, max_shards, cores);
+	Logger::instance().stop();
+	return 0;
+}
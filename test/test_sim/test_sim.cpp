@@ -0,0 +1,187 @@
+// Exchange simulator benchmark
+//   engine    MatchingEngine alone: a random mix of limit orders around the
+//             touch (some cross), cancels and edits against 50 levels of
+//             market depth a side, orders per second
+//   socket    SimSocket through the JSON path Api uses: private/buy then
+//             private/cancel of the returned order id, round trips per second
+//   queue     virtual time until a one lot bid joining the touch behind
+//             ~100 lots fills, under each QueueModel, with the same market:
+//             depth at the bid moving by a few lots and 1-3 lot prints
+//             hitting it every 100 us, 200 us one way latency
+//
+// usage: ./test_sim.exe [orders] [round_trips] [trials]
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <nlohmann/json.hpp>
+#include "SimSocket.hpp"
+#include "oms/MatchingEngine.hpp"
+
+using Clock = std::chrono::steady_clock;
+
+static double seconds_since(Clock::time_point t){
+	return std::chrono::duration<double>(Clock::now() - t).count();
+}
+
+struct Rng{
+	uint64_t s;
+	uint64_t next(){
+		s ^= s << 13;
+		s ^= s >> 7;
+		s ^= s << 17;
+		return s;
+	}
+	int64_t range(int64_t lo, int64_t hi){ return lo + static_cast<int64_t>(next() % static_cast<uint64_t>(hi - lo + 1)); }
+};
+
+static void bench_engine(size_t orders){
+	struct Op{ uint8_t type; MatchingEngine::Side side; int64_t price; int64_t qty; uint64_t pick; };
+	Rng rng{88172645463325252ull};
+	std::vector<Op> ops(orders);
+	for(Op& op : ops){
+		uint64_t r = rng.next() % 100;
+		op.type = r < 60 ? 0 : (r < 90 ? 1 : 2);
+		op.side = rng.next() & 1 ? MatchingEngine::BUY : MatchingEngine::SELL;
+		// Bids from 99990 up, asks from 100010 down, the inner ten ticks cross
+		op.price = op.side == MatchingEngine::BUY ? rng.range(99990, 100012) : rng.range(99988, 100010);
+		op.qty = rng.range(1, 5);
+		op.pick = rng.next();
+	}
+
+	MatchingEngine engine;
+	uint64_t fills = 0;
+	engine.on_fill([&fills](const MatchingEngine::Fill&){ fills++; });
+	for(int64_t i = 0; i < 50; i++){
+		engine.set_level(MatchingEngine::BUY, 99990 - i, 100);
+		engine.set_level(MatchingEngine::SELL, 100010 + i, 100);
+	}
+	std::vector<uint64_t> ids;
+	ids.reserve(orders);
+	Clock::time_point t = Clock::now();
+	for(const Op& op : ops){
+		if(op.type == 0 || ids.empty()){
+			MatchingEngine::Result r = engine.submit(op.side, op.price, op.qty, 1);
+			if(r.open) ids.push_back(r.id);
+			continue;
+		}
+		size_t k = op.pick % ids.size();
+		if(op.type == 1){
+			engine.cancel(ids[k]);
+			ids[k] = ids.back();
+			ids.pop_back();
+		} else {
+			const MatchingEngine::Order* o = engine.find(ids[k]);
+			// Filled since: forget it
+			if(!o || engine.edit(ids[k], o->price, o->filled + op.qty).open == 0){
+				ids[k] = ids.back();
+				ids.pop_back();
+			}
+		}
+	}
+	double s = seconds_since(t);
+	MatchingEngine::Stats st = engine.stats();
+	std::printf("engine   %zu operations in %.3f s: %.2f M/s (%lu orders, %lu cancels, %lu edits, %lu fills, %zu resting)\n",
+		orders, s, static_cast<double>(orders) / s / 1e6, st.orders, st.cancels, st.edits, fills, st.resting);
+}
+
+static void bench_socket(size_t round_trips){
+	SimSocket sim;
+	sim.add_instrument("BTC-PERPETUAL", 0.5, 10);
+	for(int64_t i = 0; i < 50; i++){
+		sim.engine(0).set_level(MatchingEngine::BUY, 120000 - i, 100);
+		sim.engine(0).set_level(MatchingEngine::SELL, 120010 + i, 100);
+	}
+	Clock::time_point t = Clock::now();
+	for(size_t i = 0; i < round_trips; i++){
+		double price = 59990.0 - static_cast<double>(i % 20) * 0.5;
+		std::string buy = R"({"jsonrpc":"2.0","id":)" + std::to_string(2 * i) + R"(,"method":"private/buy","params":{"instrument_name":"BTC-PERPETUAL","amount":10,"type":"limit","price":)"
+			+ std::to_string(price) + R"(,"post_only":true,"label":"bench"}})";
+		std::pair<int, std::string> r = sim.ws_request(buy);
+		nlohmann::json reply = nlohmann::json::parse(r.second);
+		std::string order_id = reply["result"]["order"]["order_id"];
+		std::string cancel = R"({"jsonrpc":"2.0","id":)" + std::to_string(2 * i + 1) + R"(,"method":"private/cancel","params":{"order_id":")" + order_id + R"("}})";
+		r = sim.ws_request(cancel);
+		if(r.first || r.second.find("\"cancelled\"") == std::string::npos){
+			std::printf("socket   cancel failed: %s\n", r.second.c_str());
+			return;
+		}
+	}
+	double s = seconds_since(t);
+	std::printf("socket   %zu buy + cancel round trips in %.3f s: %.0f requests/s\n",
+		round_trips, s, static_cast<double>(2 * round_trips) / s);
+}
+
+// Virtual milliseconds until the bid filled, -1 if not within a minute
+static double time_to_fill(MatchingEngine::QueueModel model, uint64_t seed){
+	SimSocket::Options options;
+	options.latency_us = 200;
+	options.queue = model;
+	SimSocket sim(options);
+	uint32_t btc = sim.add_instrument("BTC-PERPETUAL", 0.5, 10);
+	const double bid = 60000, ask = 60000.5;
+	sim.engine(btc).set_level(MatchingEngine::BUY, Price::from_double(bid, Scale::from_double(0.5)).n, 100);
+	sim.engine(btc).set_level(MatchingEngine::SELL, Price::from_double(ask, Scale::from_double(0.5)).n, 100);
+
+	Rng rng{seed};
+	int64_t ts = 0, depth = 100;
+	sim.set_feed([&](SimSocket::MarketEvent& e){
+		ts += 100000;
+		e.ts_ns = ts;
+		e.instrument = btc;
+		if(rng.next() % 100 < 25){
+			int64_t lots = rng.range(1, 3);
+			e.type = SimSocket::MarketEvent::TRADE;
+			e.side = MatchingEngine::SELL;
+			e.price = bid;
+			e.amount = static_cast<double>(lots * 10);
+			depth = std::max<int64_t>(depth - lots, 0);
+		} else {
+			depth = std::clamp<int64_t>(depth + rng.range(-4, 4), 10, 200);
+			e.type = SimSocket::MarketEvent::LEVEL;
+			e.side = MatchingEngine::BUY;
+			e.price = bid;
+			e.amount = static_cast<double>(depth * 10);
+		}
+		return 0;
+	});
+	bool filled = false;
+	sim.set_notification_handler([&filled](const std::string& msg){
+		if(msg.find("user.trades") != std::string::npos) filled = true;
+	});
+	std::pair<int, std::string> r = sim.ws_request(R"({"jsonrpc":"2.0","id":1,"method":"private/buy","params":{"instrument_name":"BTC-PERPETUAL","amount":10,"type":"limit","price":60000,"post_only":true}})");
+	if(r.first || r.second.find("\"open\"") == std::string::npos) return -1;
+	int64_t sent = sim.now_ns() - 2 * options.latency_us * 1000;
+	while(!filled && sim.now_ns() < 60000000000){
+		sim.run_until(sim.now_ns() + 1000000);
+	}
+	return filled ? static_cast<double>(sim.now_ns() - sent) / 1e6 : -1;
+}
+
+int main(int argc, char* argv[]){
+	size_t orders = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 5000000;
+	size_t round_trips = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 100000;
+	int trials = argc > 3 ? std::atoi(argv[3]) : 200;
+
+	bench_engine(orders);
+	bench_socket(round_trips);
+
+	const char* names[] = {"BACK", "PRO_RATA", "FRONT"};
+	for(MatchingEngine::QueueModel model : {MatchingEngine::BACK, MatchingEngine::PRO_RATA, MatchingEngine::FRONT}){
+		std::vector<double> ms;
+		for(int i = 0; i < trials; i++){
+			double t = time_to_fill(model, 0x9E3779B97F4A7C15ull * static_cast<uint64_t>(i + 1));
+			if(t >= 0) ms.push_back(t);
+		}
+		std::sort(ms.begin(), ms.end());
+		if(ms.empty()){
+			std::printf("queue    %-8s never filled\n", names[model]);
+			continue;
+		}
+		std::printf("queue    %-8s filled %zu/%d, time to fill p50 %.1f ms  p90 %.1f ms\n", names[model], ms.size(), trials,
+			ms[ms.size() / 2], ms[ms.size() * 9 / 10]);
+	}
+	return 0;
+}
@@ -0,0 +1,184 @@
+// State journal benchmark and crash check
+//   append    cost of a step (an order opens, the one `live` steps back
+//             closes, every fourth step a position), checkpoints included
+//   recover   a new journal on the same file: time to have every order and
+//             position back, and whether they match what was written
+//   crash     a child process appending as fast as it can is SIGKILLed;
+//             the parent recovers and checks every acknowledged step is
+//             there and nothing else, over `rounds` kills
+//   switch    a checkpoint cut short after it wrote the new half and its
+//             base but before the header's switch: the old half is
+//             replayed and the state is the one the checkpoint started from
+//
+// usage: ./test_state.exe [records] [live] [rounds]
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <fcntl.h>
+#include <string>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+#include "Histogram.hpp"
+#include "oms/StateJournal.hpp"
+
+using Clock = std::chrono::steady_clock;
+
+static std::string order_id(size_t i){
+	return "ETH-" + std::to_string(1000000 + i);
+}
+
+static std::string instrument(size_t i){
+	return "BTC-27DEC24-" + std::to_string(20000 + (i % 500) * 500) + "-C";
+}
+
+static Position position_of(size_t i){
+	Position p;
+	p.size = static_cast<double>(i % 17) - 8;
+	p.avg_price = 0.05 + static_cast<double>(i % 100) * 0.0005;
+	p.realized_pnl = static_cast<double>(i) * 0.001;
+	p.last_trade_seq = i;
+	p.updated_ms = static_cast<int64_t>(i);
+	return p;
+}
+
+// Order i opens, order i - live closes, every fourth step a position
+static int step(StateJournal& journal, size_t i, size_t live){
+	int status = journal.order_open(order_id(i), instrument(i), 0.05, 1.0, static_cast<int64_t>(i));
+	if(i >= live) status |= journal.order_closed(order_id(i - live));
+	if(i % 4 == 0) status |= journal.position(instrument(i), position_of(i));
+	return status;
+}
+
+static int check(const StateJournal& journal, size_t done, size_t live){
+	std::unordered_map<std::string, StateJournal::Order> orders = journal.orders();
+	size_t from = done > live ? done - live : 0;
+	if(orders.size() != done - from) return 1;
+	for(size_t i = from; i < done; i++){
+		auto it = orders.find(order_id(i));
+		if(it == orders.end() || it->second.instrument != instrument(i)) return 1;
+	}
+	std::unordered_map<std::string, Position> positions = journal.positions();
+	// The last position written for each instrument
+	for(size_t i = done > 2000 ? done - 2000 : 0; i < done; i++){
+		if(i % 4) continue;
+		bool last = true;
+		for(size_t j = i + 500; j < done && last; j += 500) last = j % 4 != 0;
+		if(!last) continue;
+		auto it = positions.find(instrument(i));
+		if(it == positions.end() || it->second.last_trade_seq != i) return 1;
+	}
+	return 0;
+}
+
+// Positions of 8 instruments in turn until the append that checkpoints, then
+// the header's `active` (at offset 24 of the file) put back as if the
+// process died before that store
+static int check_switch(const char* path){
+	unlink(path);
+	size_t k = 0;
+	{
+		StateJournal journal;
+		if(journal.open(path, 64)) return 1;
+		for(; journal.stats().checkpoints == 0 && k < 1000; k++){
+			if(journal.position(instrument(k % 8), position_of(k))) return 1;
+		}
+	}
+	int fd = ::open(path, O_RDWR);
+	uint32_t active = 0;
+	if(fd < 0 || pread(fd, &active, sizeof(active), 24) != sizeof(active)) return 1;
+	active = 1 - active;
+	int rc = pwrite(fd, &active, sizeof(active), 24) == sizeof(active) ? 0 : 1;
+	close(fd);
+	if(rc) return 1;
+
+	StateJournal journal;
+	if(journal.open(path, 64)) return 1;
+	// Everything before the append that found the half full
+	std::unordered_map<std::string, Position> positions = journal.positions();
+	bool ok = positions.size() == 8;
+	for(size_t i = k - 9; i < k - 1 && ok; i++){
+		auto it = positions.find(instrument(i % 8));
+		ok = it != positions.end() && it->second.last_trade_seq == i;
+	}
+	std::printf("switch   crash between a checkpoint's writes, %zu of %zu records replayed, %s\n",
+		journal.stats().replayed, k - 1, ok ? "state before the checkpoint" : "STATE LOST");
+	unlink(path);
+	return ok ? 0 : 1;
+}
+
+int main(int argc, char* argv[]){
+	size_t records = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 200000;
+	size_t live = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 500;
+	int rounds = argc > 3 ? std::atoi(argv[3]) : 20;
+	const char* path = "bench.state";
+	unlink(path);
+
+	{
+		StateJournal journal;
+		if(journal.open(path, 16384)){
+			std::printf("open failed\n");
+			return 1;
+		}
+		Histogram cost;
+		for(size_t i = 0; i < records; i++){
+			Clock::time_point t = Clock::now();
+			if(step(journal, i, live)){
+				std::printf("append failed at %zu\n", i);
+				return 1;
+			}
+			cost.record(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - t).count());
+		}
+		StateJournal::Stats st = journal.stats();
+		std::printf("append   %lu records in %zu steps, per step p50 %lu ns  p99 %lu ns  max %lu us, %lu checkpoints\n",
+			st.appended, records, cost.percentile(50), cost.percentile(99), cost.max() / 1000, st.checkpoints);
+	}
+	{
+		StateJournal journal;
+		if(journal.open(path)) return 1;
+		StateJournal::Stats st = journal.stats();
+		std::printf("recover  %zu orders, %zu positions from %lu records in %ld us, %s\n",
+			journal.orders().size(), journal.positions().size(), st.replayed, st.recover_us,
+			check(journal, records, live) ? "MISMATCH" : "state matches");
+	}
+
+	// The child acknowledges each step after it returned
+	unlink(path);
+	auto* acked = static_cast<volatile size_t*>(mmap(nullptr, 4096, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0));
+	int failed = 0;
+	size_t total = 0;
+	for(int round = 0; round < rounds; round++){
+		size_t start = *acked;
+		pid_t pid = fork();
+		if(pid == 0){
+			StateJournal journal;
+			if(journal.open(path, 4096)) _exit(1);
+			for(size_t i = start;; i++){
+				step(journal, i, live);
+				*acked = i + 1;
+			}
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(20 + round % 7 * 3));
+		kill(pid, SIGKILL);
+		waitpid(pid, nullptr, 0);
+		size_t done = *acked;
+		StateJournal journal;
+		if(journal.open(path, 4096)) return 1;
+		// The step in flight may be in whole or in part: finish it the way the child would have
+		if(journal.orders().count(order_id(done))){
+			step(journal, done, live);
+			*acked = ++done;
+		}
+		if(check(journal, done, live)){
+			failed++;
+			std::printf("round %d: state after %zu steps does not match\n", round, done);
+		}
+		total += done - start;
+	}
+	std::printf("crash    %d kills, %zu steps, %d mismatches\n", rounds, total, failed);
+	unlink(path);
+	failed += check_switch(path);
+	return failed ? 1 : 0;
+}
@@ -0,0 +1,144 @@
+#include "StandIn.hpp"
+#include <chrono>
+#include <iostream>
+#include <sstream>
+#include <openssl/evp.h>
+#include <openssl/x509.h>
+
+static int64_t now_us(){
+	return std::chrono::duration_cast<std::chrono::microseconds>(
+		std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+// Pull the raw text of a top level field ("id", "method") out of a request
+static std::string field(const std::string& req, const std::string& name){
+	std::string key = "\"" + name + "\"";
+	size_t pos = req.find(key);
+	if(pos == std::string::npos) return "";
+	pos = req.find(':', pos + key.size());
+	if(pos == std::string::npos) return "";
+	pos = req.find_first_not_of(" \t\r\n", pos + 1);
+	if(pos == std::string::npos) return "";
+	size_t end = (req[pos] == '"') ? req.find('"', pos + 1) + 1 : req.find_first_of(",}\r\n", pos);
+	return req.substr(pos, end - pos);
+}
+
+// Constructor
+StandIn::StandIn(unsigned short port, int service_us, ssl::context* tls)
+	: m_acceptor(m_ioc, tcp::endpoint(net::ip::make_address("127.0.0.1"), port)), m_service_us(service_us), m_tls(tls) {}
+
+// Destructor
+StandIn::~StandIn(){
+	stop();
+}
+
+void StandIn::start(){
+	m_running = true;
+	m_thread = std::thread([this](){
+		try {
+			// One client at a time, which is all the load generator needs
+			while(m_running){
+				tcp::socket sock{m_ioc};
+				m_acceptor.accept(sock);
+				if(!m_running) break;
+				serve(std::move(sock));
+			}
+		} catch (const std::exception& e) {
+			if(m_running) std::cout << "StandIn error: " << e.what() << '\n';
+		}
+	});
+}
+
+void StandIn::stop(){
+	if(!m_running) return;
+	m_running = false;
+	// A blocking accept() is not woken by close(), poke it with a connection
+	boost::system::error_code ec;
+	tcp::socket poke{m_ioc};
+	poke.connect(m_acceptor.local_endpoint(ec), ec);
+	if(m_thread.joinable()) m_thread.join();
+	m_acceptor.close(ec);
+}
+
+void StandIn::serve(tcp::socket sock){
+	sock.set_option(tcp::no_delay(true));
+	if(m_tls){
+		websocket::stream<beast::ssl_stream<tcp::socket>> ws{std::move(sock), *m_tls};
+		boost::system::error_code ec;
+		ws.next_layer().handshake(ssl::stream_base::server, ec);
+		if(!ec) serve_ws(ws);
+		return;
+	}
+	websocket::stream<tcp::socket> ws{std::move(sock)};
+	serve_ws(ws);
+}
+
+template<typename Stream>
+void StandIn::serve_ws(websocket::stream<Stream>& ws){
+	ws.set_option(websocket::stream_base::decorator([](websocket::response_type& res){
+		res.set(beast::http::field::server, "deribit-stand-in");
+	}));
+	boost::system::error_code ec;
+	ws.accept(ec);
+	if(ec) return;
+	ws.text(true);
+
+	beast::flat_buffer buffer;
+	while(m_running){
+		ws.read(buffer, ec);
+		if(ec) return; // client went away
+		std::string resp = reply(beast::buffers_to_string(buffer.data()));
+		buffer.consume(buffer.size());
+		ws.write(net::buffer(resp), ec);
+		if(ec) return;
+	}
+}
+
+std::string StandIn::reply(const std::string& req){
+	int64_t us_in = now_us();
+	std::string id = field(req, "id");
+	std::string method = field(req, "method");
+
+	// Simulated matching engine service time
+	if(m_service_us > 0){
+		auto until = std::chrono::steady_clock::now() + std::chrono::microseconds(m_service_us);
+		while(std::chrono::steady_clock::now() < until);
+	}
+
+	std::ostringstream result;
+	if(method == "\"public/auth\""){
+		result << R"({"access_token":"stand-in","expires_in":31536000,"refresh_token":"stand-in","scope":"trade:read_write","token_type":"bearer"})";
+	} else if(method == "\"private/buy\"" || method == "\"private/sell\""){
+		result << R"({"trades":[],"order":{"order_id":"STANDIN-)" << ++m_order_seq
+			<< R"(","order_state":"open","order_type":"limit","time_in_force":"good_til_cancelled","instrument_name":"ETH-PERPETUAL","filled_amount":0,"creation_timestamp":)"
+			<< us_in / 1000 << "}}";
+	} else {
+		result << "{}";
+	}
+
+	int64_t us_out = now_us();
+	std::ostringstream resp;
+	resp << R"({"jsonrpc":"2.0","id":)" << (id.empty() ? "null" : id) << R"(,"result":)" << result.str()
+		<< R"(,"usIn":)" << us_in << R"(,"usOut":)" << us_out << R"(,"usDiff":)" << us_out - us_in << R"(,"testnet":true})";
+	return resp.str();
+}
+
+int StandIn::use_self_signed(ssl::context& ctx){
+	EVP_PKEY* key = EVP_EC_gen("P-256");
+	X509* cert = X509_new();
+	if(!key || !cert) return 1;
+	X509_set_version(cert, 2);
+	ASN1_INTEGER_set(X509_get_serialNumber(cert), 1);
+	X509_gmtime_adj(X509_getm_notBefore(cert), 0);
+	X509_gmtime_adj(X509_getm_notAfter(cert), 86400);
+	X509_set_pubkey(cert, key);
+	X509_NAME* name = X509_get_subject_name(cert);
+	X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC, reinterpret_cast<const unsigned char*>("127.0.0.1"), -1, -1, 0);
+	X509_set_issuer_name(cert, name);
+	int ok = X509_sign(cert, key, EVP_sha256()) > 0
+		&& SSL_CTX_use_certificate(ctx.native_handle(), cert) == 1
+		&& SSL_CTX_use_PrivateKey(ctx.native_handle(), key) == 1;
+	X509_free(cert);
+	EVP_PKEY_free(key);
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,42 @@
+#pragma once
+#include <boost/beast/core.hpp>
+#include <boost/beast/ssl.hpp>
+#include <boost/beast/websocket.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <atomic>
+#include <string>
+#include <thread>
+
+namespace beast = boost::beast;         // from <boost/beast.hpp>
+namespace websocket = beast::websocket; // from <boost/beast/websocket.hpp>
+namespace net = boost::asio;            // from <boost/asio.hpp>
+namespace ssl = boost::asio::ssl;       // from <boost/asio/ssl.hpp>
+
+using tcp = boost::asio::ip::tcp;       // from <boost/asio/ip/tcp.hpp>
+
+// Local stand-in for the Deribit JSON-RPC endpoint.
+// Websocket on 127.0.0.1, plain unless a server TLS context is given,
+// answers every request with a Deribit shaped reply carrying the same id
+// plus usIn/usOut/usDiff.
+class StandIn{
+public:
+	StandIn(unsigned short port, int service_us, ssl::context* tls = nullptr); // Constructor
+	~StandIn(); // Destructor
+	void start();
+	void stop();
+	// Self signed P-256 certificate for 127.0.0.1, generated per run. 0 on success
+	static int use_self_signed(ssl::context& ctx);
+private:
+	void serve(tcp::socket sock);
+	template<typename Stream>
+	void serve_ws(websocket::stream<Stream>& ws);
+	std::string reply(const std::string& req);
+
+	net::io_context m_ioc;
+	tcp::acceptor m_acceptor;
+	std::thread m_thread;
+	std::atomic<bool> m_running{false};
+	int m_service_us;
+	ssl::context* m_tls;
+	uint64_t m_order_seq = 0;
+};
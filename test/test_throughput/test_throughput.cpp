@@ -0,0 +1,213 @@
+// Open-loop throughput test.
+//
+// Orders are sent on a fixed schedule (t0 + i / rate) regardless of how fast
+// replies come back, and every latency sample is measured from the order's
+// *intended* send time to its ack. A stalled endpoint therefore shows up in
+// the percentiles instead of silently slowing the sender down (coordinated
+// omission).
+//
+// usage: ./test_throughput.exe [rate/s] [seconds] [service_us] [host port]
+// Without host/port a local Deribit stand-in is started on 127.0.0.1:9443.
+#include <boost/beast/core.hpp>
+#include <boost/beast/websocket.hpp>
+#include <boost/asio/connect.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <atomic>
+#include <vector>
+#include "StandIn.hpp"
+#include "Histogram.hpp"
+
+using Clock = std::chrono::steady_clock;
+
+static int64_t ns_since(Clock::time_point t0, Clock::time_point t){
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(t - t0).count();
+}
+
+class LoadClient{
+public:
+	LoadClient(const std::string& host, const std::string& port, size_t total)
+		: m_ws(m_ioc), m_intended(total + 1, -1) {
+		tcp::resolver resolver{m_ioc};
+		auto const results = resolver.resolve(host, port);
+		net::connect(m_ws.next_layer(), results.begin(), results.end());
+		m_ws.next_layer().set_option(tcp::no_delay(true));
+		m_ws.handshake(host, "/ws/api/v2");
+		m_ws.text(true);
+	}
+
+	// Same credentials flow as Api::Authenticate, done synchronously before the run
+	int authenticate(const std::string& auth_msg){
+		m_ws.write(net::buffer(auth_msg));
+		beast::flat_buffer buffer;
+		m_ws.read(buffer);
+		std::string resp = beast::buffers_to_string(buffer.data());
+		return resp.find("\"error\"") == std::string::npos ? 0 : 1;
+	}
+
+	void start(Clock::time_point t0){
+		m_t0 = t0;
+		do_read();
+		m_io_thread = std::thread([this](){ m_ioc.run(); });
+	}
+
+	// Called from the sender thread: records the intended time and hands the
+	// frame to the io thread which owns the stream
+	void send(uint64_t id, Clock::time_point intended, std::string msg){
+		m_intended[id] = ns_since(m_t0, intended);
+		net::post(m_ioc, [this, msg = std::move(msg)]() mutable {
+			m_out.push_back(std::move(msg));
+			if(m_out.size() == 1) do_write();
+		});
+	}
+
+	void stop(){
+		net::post(m_ioc, [this](){
+			boost::system::error_code ec;
+			m_ws.next_layer().close(ec);
+		});
+		if(m_io_thread.joinable()) m_io_thread.join();
+	}
+
+	uint64_t acks() const { return m_acks; }
+	uint64_t errors() const { return m_errors; }
+	int64_t last_ack_ns() const { return m_last_ack; }
+	const Histogram& latency() const { return m_latency; }
+
+private:
+	void do_write(){
+		m_ws.async_write(net::buffer(m_out.front()), [this](const boost::system::error_code& ec, std::size_t){
+			if(ec){
+				std::cout << "Error in async_write: " << ec.message() << '\n';
+				return;
+			}
+			m_out.pop_front();
+			if(!m_out.empty()) do_write();
+		});
+	}
+
+	void do_read(){
+		m_ws.async_read(m_buffer, [this](const boost::system::error_code& ec, std::size_t){
+			if(ec) return; // closed
+			on_reply();
+			m_buffer.consume(m_buffer.size());
+			do_read();
+		});
+	}
+
+	void on_reply(){
+		int64_t now = ns_since(m_t0, Clock::now());
+		const char* data = static_cast<const char*>(m_buffer.data().data());
+		std::string_view resp(data, m_buffer.size());
+		size_t pos = resp.find("\"id\":");
+		if(pos == std::string_view::npos) return; // not a reply
+		uint64_t id = std::strtoull(data + pos + 5, nullptr, 10);
+		if(id == 0 || id >= m_intended.size() || m_intended[id] < 0) return;
+		if(resp.find("\"error\"") != std::string_view::npos) m_errors++;
+		m_latency.record(now - m_intended[id]);
+		m_intended[id] = -1;
+		m_last_ack = now;
+		m_acks++;
+	}
+
+	net::io_context m_ioc;
+	websocket::stream<tcp::socket> m_ws;
+	beast::flat_buffer m_buffer;
+	std::deque<std::string> m_out;
+	std::thread m_io_thread;
+	Clock::time_point m_t0;
+	std::vector<int64_t> m_intended; // ns after t0, indexed by request id
+	Histogram m_latency;
+	std::atomic<uint64_t> m_acks{0};
+	uint64_t m_errors = 0;
+	int64_t m_last_ack = 0;
+};
+
+static std::string order_msg(uint64_t id){
+	char buf[256];
+	int n = std::snprintf(buf, sizeof(buf),
+		R"({"jsonrpc":"2.0","method":"private/buy","params":{"instrument_name":"ETH-PERPETUAL","type":"limit","price":1000,"amount":10},"id":%llu})",
+		static_cast<unsigned long long>(id));
+	return std::string(buf, n);
+}
+
+int main(int argc, char** argv){
+	const std::string auth_msg = R"({
+  	"jsonrpc": "2.0",
+	"id": 9929,
+  	"method": "public/auth",
+  	"params": {
+    		"grant_type": "client_credentials",
+    		"client_id": "vO3I_xM-",
+    		"client_secret": "urHDx-2Kd6PXic3zKmmyMHyHDP0JYZBTsq_9b_ojE98"
+  	}})";
+
+	double rate = argc > 1 ? std::atof(argv[1]) : 10000.0;
+	double seconds = argc > 2 ? std::atof(argv[2]) : 5.0;
+	int service_us = argc > 3 ? std::atoi(argv[3]) : 0;
+	std::string host = argc > 5 ? argv[4] : "127.0.0.1";
+	std::string port = argc > 5 ? argv[5] : "9443";
+	if(rate <= 0 || seconds <= 0){
+		std::cout << "usage: " << argv[0] << " [rate/s] [seconds] [service_us] [host port]\n";
+		return 1;
+	}
+
+	std::unique_ptr<StandIn> stand_in;
+	if(argc <= 5){
+		stand_in = std::make_unique<StandIn>(static_cast<unsigned short>(std::stoi(port)), service_us);
+		stand_in->start();
+		std::cout << "> Stand-in endpoint on " << host << ':' << port << " (service " << service_us << " us)\n";
+	}
+
+	const uint64_t total = static_cast<uint64_t>(rate * seconds);
+	const auto interval = std::chrono::nanoseconds(static_cast<int64_t>(1e9 / rate));
+
+	LoadClient client(host, port, total);
+	if(client.authenticate(auth_msg)){
+		std::cout << "Authentication failed!\n";
+		return 1;
+	}
+	std::cout << "> Sending " << total << " orders at " << rate << "/s\n";
+
+	// Pre-build payloads so the sender loop only waits and posts
+	std::vector<std::string> payloads;
+	payloads.reserve(total);
+	for(uint64_t id = 1; id <= total; id++) payloads.push_back(order_msg(id));
+
+	Clock::time_point t0 = Clock::now();
+	client.start(t0);
+
+	Histogram send_lag; // how far behind schedule the sender itself was
+	for(uint64_t id = 1; id <= total; id++){
+		Clock::time_point intended = t0 + interval * (id - 1);
+		Clock::time_point now;
+		while((now = Clock::now()) < intended); // spin, never skip a slot
+		send_lag.record(ns_since(intended, now));
+		client.send(id, intended, std::move(payloads[id - 1]));
+	}
+	int64_t send_ns = ns_since(t0, Clock::now());
+
+	// Drain: give outstanding orders a grace period to be acked
+	auto drain_until = Clock::now() + std::chrono::seconds(2);
+	while(client.acks() < total && Clock::now() < drain_until){
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	client.stop();
+	if(stand_in) stand_in->stop();
+
+	std::cout << "\n> Results\n";
+	std::cout << "Target rate:    " << rate << " orders/s\n";
+	std::cout << "Achieved send:  " << (1e9 * total) / send_ns << " orders/s\n";
+	std::cout << "Achieved acks:  " << (client.last_ack_ns() ? (1e9 * client.acks()) / client.last_ack_ns() : 0.0) << " orders/s\n";
+	std::cout << "Acked:          " << client.acks() << " / " << total << " (" << client.errors() << " errors)\n";
+	client.latency().print(std::cout, "Intended-send to ack latency");
+	send_lag.print(std::cout, "Sender schedule lag");
+	return client.acks() == total ? 0 : 1;
+}
@@ -0,0 +1,190 @@
+// Transport benchmark: request/reply round trips against the local Deribit
+// stand-in through
+//   asio-sync   Beast websocket, blocking socket calls
+//   asio-async  Beast websocket, async ops on the epoll reactor
+//   uring       USocket, io_uring with a multishot receive
+//   uring-sq    USocket with SQPOLL
+//   uring-ts    USocket with kernel software timestamps, followed by where
+//               the time of a reply went: kernel receive -> completion
+//               handled -> handed to the caller, and write queued -> kernel
+//               send stamp
+// Syscalls made by the client thread are counted by wrapping the libc entry
+// points at link time (see the Makefile), the stand-in's own are excluded.
+//
+// usage: ./test_uring.exe [requests] [port]
+#include <boost/asio/connect.hpp>
+#include <chrono>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include "../test_throughput/StandIn.hpp"
+#include "Histogram.hpp"
+#include "Logger.hpp"
+#include "Custom_WebSocket/USocket.hpp"
+
+using Clock = std::chrono::steady_clock;
+
+// Syscall accounting, only while the measuring thread enables it
+static thread_local bool t_counting = false;
+static uint64_t g_syscalls = 0;
+
+extern "C" {
+ssize_t __real_sendmsg(int, const struct msghdr*, int);
+ssize_t __real_recvmsg(int, struct msghdr*, int);
+ssize_t __real_send(int, const void*, size_t, int);
+ssize_t __real_recv(int, void*, size_t, int);
+ssize_t __real_read(int, void*, size_t);
+ssize_t __real_write(int, const void*, size_t);
+int __real_poll(struct pollfd*, nfds_t, int);
+int __real_epoll_wait(int, struct epoll_event*, int, int);
+long __real_syscall(long, ...);
+
+ssize_t __wrap_sendmsg(int fd, const struct msghdr* m, int f){ if(t_counting) g_syscalls++; return __real_sendmsg(fd, m, f); }
+ssize_t __wrap_recvmsg(int fd, struct msghdr* m, int f){ if(t_counting) g_syscalls++; return __real_recvmsg(fd, m, f); }
+ssize_t __wrap_send(int fd, const void* b, size_t n, int f){ if(t_counting) g_syscalls++; return __real_send(fd, b, n, f); }
+ssize_t __wrap_recv(int fd, void* b, size_t n, int f){ if(t_counting) g_syscalls++; return __real_recv(fd, b, n, f); }
+ssize_t __wrap_read(int fd, void* b, size_t n){ if(t_counting) g_syscalls++; return __real_read(fd, b, n); }
+ssize_t __wrap_write(int fd, const void* b, size_t n){ if(t_counting) g_syscalls++; return __real_write(fd, b, n); }
+int __wrap_poll(struct pollfd* p, nfds_t n, int t){ if(t_counting) g_syscalls++; return __real_poll(p, n, t); }
+int __wrap_epoll_wait(int e, struct epoll_event* ev, int n, int t){ if(t_counting) g_syscalls++; return __real_epoll_wait(e, ev, n, t); }
+// io_uring has no libc wrapper, URing goes through syscall(); six arguments covers io_uring_enter
+long __wrap_syscall(long nr, ...){
+	va_list ap;
+	va_start(ap, nr);
+	long a[6];
+	for(long& x : a) x = va_arg(ap, long);
+	va_end(ap);
+	if(t_counting) g_syscalls++;
+	return __real_syscall(nr, a[0], a[1], a[2], a[3], a[4], a[5]);
+}
+}
+
+static const std::string REQUEST = R"({"jsonrpc":"2.0","method":"private/buy","params":{"instrument_name":"BTC-PERPETUAL","type":"limit","price":50000,"amount":10},"id":"1"})";
+
+struct Result{
+	Histogram rtt;
+	uint64_t syscalls = 0;
+	int errors = 0;
+};
+
+static void report(const char* name, const Result& r, size_t n){
+	std::printf("%-11s p50 %7.1f us  p99 %7.1f us  p99.9 %7.1f us  max %7.1f us  syscalls/request %.2f  errors %d\n",
+		name, r.rtt.percentile(50) / 1e3, r.rtt.percentile(99) / 1e3, r.rtt.percentile(99.9) / 1e3,
+		r.rtt.max() / 1e3, static_cast<double>(r.syscalls) / n, r.errors);
+}
+
+// Times `n` calls of `one` (returning 0 on success) after a short warm up
+template<typename F>
+static Result measure(size_t n, F one){
+	Result r;
+	for(int i = 0; i < 100; i++) one();
+	g_syscalls = 0;
+	t_counting = true;
+	for(size_t i = 0; i < n; i++){
+		Clock::time_point t = Clock::now();
+		if(one()) r.errors++;
+		r.rtt.record(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - t).count());
+	}
+	t_counting = false;
+	r.syscalls = g_syscalls;
+	return r;
+}
+
+static Result run_asio_sync(const std::string& port, size_t n){
+	net::io_context ioc;
+	websocket::stream<tcp::socket> ws(ioc);
+	tcp::resolver resolver{ioc};
+	auto const results = resolver.resolve("127.0.0.1", port);
+	net::connect(ws.next_layer(), results.begin(), results.end());
+	ws.next_layer().set_option(tcp::no_delay(true));
+	ws.handshake("127.0.0.1", "/ws/api/v2");
+	ws.text(true);
+	beast::flat_buffer buffer;
+	return measure(n, [&](){
+		ws.write(net::buffer(REQUEST));
+		buffer.clear();
+		ws.read(buffer);
+		return buffer.size() ? 0 : 1;
+	});
+}
+
+static Result run_asio_async(const std::string& port, size_t n){
+	net::io_context ioc;
+	websocket::stream<tcp::socket> ws(ioc);
+	tcp::resolver resolver{ioc};
+	auto const results = resolver.resolve("127.0.0.1", port);
+	net::connect(ws.next_layer(), results.begin(), results.end());
+	ws.next_layer().set_option(tcp::no_delay(true));
+	ws.handshake("127.0.0.1", "/ws/api/v2");
+	ws.text(true);
+	beast::flat_buffer buffer;
+	return measure(n, [&](){
+		int status = 1;
+		buffer.clear();
+		ws.async_write(net::buffer(REQUEST), [&](beast::error_code ec, size_t){
+			if(ec) return;
+			ws.async_read(buffer, [&](beast::error_code ec, size_t){ status = ec ? 1 : 0; });
+		});
+		ioc.restart();
+		ioc.run();
+		return status;
+	});
+}
+
+static void report_timings(const USocket::Timings& t){
+	auto row = [](const char* name, const Histogram& h){
+		std::printf("  %-20s p50 %7.2f us  p99 %7.2f us  max %8.2f us  (%lu)\n",
+			name, h.percentile(50) / 1e3, h.percentile(99) / 1e3, h.max() / 1e3, static_cast<unsigned long>(h.count()));
+	};
+	row("kernel -> handler", t.kernel_to_handler);
+	row("handler -> strategy", t.handler_to_strategy);
+	row("queued -> kernel tx", t.send_to_kernel);
+}
+
+static Result run_uring(const std::string& port, size_t n, bool sqpoll, bool timestamps = false){
+	USocket::Options opt;
+	opt.host = "127.0.0.1";
+	opt.port = port;
+	opt.tls = false;
+	opt.sqpoll = sqpoll;
+	opt.timestamps = timestamps;
+	USocket sock(opt);
+	sock.switch_to_ws();
+	if(!sock.is_open()){
+		Result r;
+		r.errors = static_cast<int>(n);
+		return r;
+	}
+	Result r = measure(n, [&](){ return sock.ws_request(REQUEST).first; });
+	if(timestamps){
+		report("uring-ts", r, n);
+		if(sock.timings()) report_timings(*sock.timings());
+	}
+	return r;
+}
+
+int main(int argc, char** argv){
+	size_t n = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 20000;
+	unsigned short port = argc > 2 ? static_cast<unsigned short>(std::atoi(argv[2])) : 9443;
+	Logger::instance().start("test_uring.log");
+	StandIn standin(port, 0);
+	standin.start();
+	std::string p = std::to_string(port);
+
+	std::printf("%zu round trips of a %zu byte request, %u cpu(s)\n", n, REQUEST.size(), std::thread::hardware_concurrency());
+	report("asio-sync", run_asio_sync(p, n), n);
+	report("asio-async", run_asio_async(p, n), n);
+	report("uring", run_uring(p, n, false), n);
+	report("uring-sq", run_uring(p, n, true), n);
+	run_uring(p, n, false, true);
+
+	standin.stop();
+	Logger::instance().stop();
+	return 0;
+}
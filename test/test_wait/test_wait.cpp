@@ -0,0 +1,101 @@
+// Wait strategy benchmark: the reply handoff of Socketpp::ws_request.
+// A producer thread stands in for the I/O thread: it sleeps until the
+// reply "arrives" `delay` us after the request (as the I/O thread sits in
+// epoll while the reply is on the wire), publishes it and calls notify().
+// The requester waits with each WaitStrategy mode. For each:
+//   wakeup   notify() -> the requester running again with the reply
+//   cpu      CPU time of the requester thread per reply (user + system),
+//            the price of the mode: up to `delay` us for the spinners
+//
+// usage: ./test_wait.exe [replies] [delay_us]
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <ctime>
+#include <sys/prctl.h>
+#include <sys/resource.h>
+#include "Histogram.hpp"
+#include "WaitStrategy.hpp"
+
+static int64_t mono_ns(){
+	timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ll + ts.tv_nsec;
+}
+
+static int64_t thread_cpu_us(){
+	rusage ru;
+	getrusage(RUSAGE_THREAD, &ru);
+	return (ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) * 1000000ll + ru.ru_utime.tv_usec + ru.ru_stime.tv_usec;
+}
+
+struct Result{
+	Histogram wakeup;
+	double cpu_us = 0; // per reply
+};
+
+static Result run(WaitStrategy::Mode mode, size_t n, int64_t delay_ns){
+	WaitStrategy wait(mode);
+	WaitStrategy sent(WaitStrategy::BLOCK); // requests to the producer, not measured
+	std::atomic<uint64_t> request{0};  // sequence of the last request sent
+	std::atomic<uint64_t> reply{0};    // sequence of the last reply published
+	std::atomic<int64_t> notified_ns{0};
+	std::atomic<bool> running{true};
+
+	std::thread producer([&](){
+		prctl(PR_SET_TIMERSLACK, 1, 0, 0, 0);
+		uint64_t served = 0;
+		while(running.load(std::memory_order_relaxed)){
+			uint32_t seen = sent.epoch();
+			uint64_t r = request.load(std::memory_order_acquire);
+			if(r == served){
+				sent.wait(seen);
+				continue;
+			}
+			served = r;
+			timespec at;
+			int64_t due = mono_ns() + delay_ns;
+			at.tv_sec = due / 1000000000;
+			at.tv_nsec = due % 1000000000;
+			clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &at, nullptr);
+			notified_ns.store(mono_ns(), std::memory_order_relaxed);
+			reply.store(r, std::memory_order_release);
+			wait.notify();
+		}
+	});
+
+	Result res;
+	int64_t cpu = 0;
+	for(size_t i = 0; i < n + 100; i++){
+		if(i == 100) cpu = thread_cpu_us(); // after warm up
+		request.store(i + 1, std::memory_order_release);
+		sent.notify();
+		while(true){
+			uint32_t seen = wait.epoch();
+			if(reply.load(std::memory_order_acquire) == i + 1) break;
+			wait.wait(seen);
+		}
+		if(i >= 100) res.wakeup.record(mono_ns() - notified_ns.load(std::memory_order_relaxed));
+	}
+	res.cpu_us = static_cast<double>(thread_cpu_us() - cpu) / n;
+	running = false;
+	sent.notify();
+	producer.join();
+	return res;
+}
+
+int main(int argc, char** argv){
+	size_t n = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 20000;
+	int64_t delay_us = argc > 2 ? std::atoll(argv[2]) : 20;
+
+	std::printf("%zu replies, each %ld us after its request, %u cpu(s)\n", n, static_cast<long>(delay_us), std::thread::hardware_concurrency());
+	for(WaitStrategy::Mode mode : {WaitStrategy::SPIN, WaitStrategy::SPIN_YIELD, WaitStrategy::SPIN_FUTEX, WaitStrategy::BLOCK}){
+		Result r = run(mode, n, delay_us * 1000);
+		std::printf("%-11s wakeup p50 %7.2f us  p99 %8.2f us  max %9.2f us  cpu/reply %6.2f us\n",
+			WaitStrategy::name(mode), r.wakeup.percentile(50) / 1e3, r.wakeup.percentile(99) / 1e3,
+			r.wakeup.max() / 1e3, r.cpu_us);
+	}
+	return 0;
+}